@@ -0,0 +1,199 @@
+#include "aggregator.h"
+
+#include <chrono>
+#include <frame_bytes.h>
+#include <mqtt_frame.h>
+#include <mqtt_handler.h>
+#include <single_writer.h>
+#include <wifi_radar.h>
+
+/* PRIVATE CONSTANTS */
+constexpr size_t POP_BATCH = 256;
+constexpr int IDLE_SPINS = 64;  // Empty polls before a worker sleeps
+constexpr auto IDLE_SLEEP = std::chrono::microseconds(200);
+constexpr uint32_t SWEEP_INTERVAL_MS = 1000;
+constexpr std::string_view TOPIC_PREFIX = "radar/";
+constexpr std::string_view TOPIC_SUFFIX = "/from";
+
+/* FUNCTIONS */
+Aggregator::Aggregator(size_t shards_count, size_t queue_bytes, uint32_t stale_ms) : stale_ms(stale_ms) {
+  for (size_t i = 0; i < (shards_count ? shards_count : 1); i++) {
+    shards.push_back(std::make_unique<Shard>(queue_bytes));
+  }
+}
+
+Aggregator::~Aggregator() {
+  stop();
+}
+
+void Aggregator::start() {
+  running.store(true);
+  for (auto& shard : shards) {
+    shard->worker = std::thread(&Aggregator::run_worker, this, shard.get());
+  }
+}
+
+void Aggregator::stop() {
+  running.store(false);
+  for (auto& shard : shards) {
+    if (shard->worker.joinable()) {
+      shard->worker.join();
+    }
+  }
+}
+
+void Aggregator::ingest(std::string_view topic, const uint8_t* frame, size_t frame_size) {
+  if (topic.size() <= TOPIC_PREFIX.size() + TOPIC_SUFFIX.size() || topic.substr(0, TOPIC_PREFIX.size()) != TOPIC_PREFIX ||
+      topic.substr(topic.size() - TOPIC_SUFFIX.size()) != TOPIC_SUFFIX) {
+    single_writer_add(rejected, uint64_t{1});
+    return;
+  }
+  const std::string_view id = topic.substr(TOPIC_PREFIX.size(), topic.size() - TOPIC_PREFIX.size() - TOPIC_SUFFIX.size());
+  if (id.size() > DEVICE_ID_MAX_SIZE || id.find('/') != std::string_view::npos || frame_size > MQTT_FRAME_MAX_SIZE) {
+    single_writer_add(rejected, uint64_t{1});
+    return;
+  }
+
+  // High bits pick the shard, the table of the shard uses the low ones
+  const uint32_t hash = DeviceTable::hash(id);
+  Shard* shard = shards[((uint64_t)hash * shards.size()) >> 32].get();
+  if (!shard->queue.push(id, frame, frame_size)) {
+    single_writer_add(shard->dropped, uint64_t{1});
+  }
+}
+
+Occupancy Aggregator::occupancy() const {
+  Occupancy occupancy = {};
+  occupancy.malformed = rejected.load(std::memory_order_relaxed);
+  for (const auto& shard : shards) {
+    const ShardCounters& counters = shard->counters;
+    occupancy.devices += counters.devices.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < ROOM_STATUS_COUNT; i++) {
+      occupancy.statuses[i] += counters.statuses[i].load(std::memory_order_relaxed);
+    }
+    occupancy.offline += counters.offline.load(std::memory_order_relaxed);
+    occupancy.frames += counters.frames.load(std::memory_order_relaxed);
+    occupancy.malformed += counters.malformed.load(std::memory_order_relaxed);
+    occupancy.dropped += shard->dropped.load(std::memory_order_relaxed);
+  }
+  return occupancy;
+}
+
+/* Drains the queue before leaving, so stop() loses no frame */
+void Aggregator::run_worker(Shard* shard) {
+  uint32_t now = now_ms();
+  const auto handle = [&](std::string_view id, const uint8_t* frame, size_t frame_size) {
+    handle_frame(shard, id, frame, frame_size, now);
+  };
+  int idle_spins = 0;
+  while (true) {
+    now = now_ms();
+    const size_t count = shard->queue.pop(handle, POP_BATCH);
+    if (now - shard->swept_at_ms >= SWEEP_INTERVAL_MS) {
+      sweep_stale(shard, now);
+      shard->swept_at_ms = now;
+    }
+    if (count > 0) {
+      idle_spins = 0;
+      continue;
+    }
+    if (!running.load(std::memory_order_acquire)) {
+      // The network thread stops pushing before it stops the workers, so one more look finds the last frames
+      if (shard->queue.pop(handle, SIZE_MAX) == 0) {
+        return;
+      }
+      continue;
+    }
+    if (++idle_spins < IDLE_SPINS) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(IDLE_SLEEP);
+    }
+  }
+}
+
+void Aggregator::handle_frame(Shard* shard, std::string_view id, const uint8_t* frame, size_t frame_size, uint32_t now) {
+  ShardCounters& counters = shard->counters;
+  single_writer_add(counters.frames, uint64_t{1});
+
+  bool inserted;
+  DeviceEntry* device = shard->table.get(id, DeviceTable::hash(id), &inserted);
+  if (inserted) {
+    device->room_status = ROOM_UNDEFINED;
+    device->first_seen_ms = now;
+    single_writer_add(counters.devices, 1u);
+    single_writer_add(counters.statuses[ROOM_UNDEFINED], 1u);
+  } else if (device->offline) {
+    device->offline = false;
+    single_writer_add(counters.offline, -1u);
+    single_writer_add(counters.statuses[device->room_status], 1u);
+  }
+  device->last_seen_ms = now;
+  device->frames++;
+
+  MqttFrame decoded;
+  if (!mqtt_frame_decode(frame, frame_size, &decoded)) {
+    single_writer_add(counters.malformed, uint64_t{1});
+    return;
+  }
+  switch (decoded.msg_id) {
+    case MQTT_TX_MSG_ROOM_STATUS:
+      if (decoded.payload_size >= 1) {
+        set_room_status(shard, device, decoded.payload[0]);
+      }
+      break;
+
+    case MQTT_TX_MSG_TELEMETRY: {
+      TelemetrySample samples[TELEMETRY_MAX_SAMPLES];
+      const int count = mqtt_frame_decode_telemetry(decoded.payload, decoded.payload_size, samples, TELEMETRY_MAX_SAMPLES);
+      if (count < 0) {
+        single_writer_add(counters.malformed, uint64_t{1});
+      } else if (count > 0) {
+        const TelemetrySample& last = samples[count - 1];
+        device->waveform_jitter = last.waveform_jitter;
+        device->waveform_wander = last.waveform_wander;
+        device->rssi = last.rssi;
+        set_room_status(shard, device, last.room_status);
+      }
+      break;
+    }
+
+    case MQTT_TX_MSG_SAMPLE_RATE:
+      if (decoded.payload_size >= 4) {
+        device->ping_interval_ms = get_u32(decoded.payload);
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+void Aggregator::set_room_status(Shard* shard, DeviceEntry* device, uint8_t room_status) {
+  if (room_status >= ROOM_STATUS_COUNT) {
+    single_writer_add(shard->counters.malformed, uint64_t{1});
+    return;
+  }
+  if (room_status == device->room_status) {
+    return;
+  }
+  single_writer_add(shard->counters.statuses[device->room_status], -1u);
+  single_writer_add(shard->counters.statuses[room_status], 1u);
+  device->room_status = room_status;
+  device->status_changes++;
+}
+
+void Aggregator::sweep_stale(Shard* shard, uint32_t now) {
+  shard->table.for_each([&](DeviceEntry& device) {
+    if (!device.offline && now - device.last_seen_ms > stale_ms) {
+      device.offline = true;
+      single_writer_add(shard->counters.statuses[device.room_status], -1u);
+      single_writer_add(shard->counters.offline, 1u);
+    }
+  });
+}
+
+uint32_t Aggregator::now_ms() const {
+  using namespace std::chrono;
+  return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,88 @@
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include "device_table.h"
+#include "frame_queue.h"
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/* Room occupancy of a fleet of radar devices from the frames they publish.
+ *
+ * The network thread hands every frame to the shard of its device through a
+ * lock-free FrameQueue, and each shard's worker thread alone decodes its
+ * frames and owns its DeviceTable, so devices are never locked. Workers
+ * publish their totals through single-writer atomics, which occupancy() adds
+ * up at any time without stopping them. A device that stays silent longer
+ * than the stale time counts as offline until it's heard from again. */
+
+/* PUBLIC CONSTANTS */
+constexpr size_t ROOM_STATUS_COUNT = 5;  // RoomStatus values, up to STATIONARY_PRESENCE
+
+/* PUBLIC TYPES */
+struct Occupancy {
+  uint32_t devices;
+  uint32_t statuses[ROOM_STATUS_COUNT];  // Of the online devices, by RoomStatus
+  uint32_t offline;
+  uint64_t frames;
+  uint64_t dropped;    // Frames of full shard queues
+  uint64_t malformed;  // Frames or topics that couldn't be decoded
+};
+
+class Aggregator {
+ public:
+  Aggregator(size_t shards_count, size_t queue_bytes, uint32_t stale_ms);
+  ~Aggregator();
+
+  void start();
+  /* Processes the queued frames first */
+  void stop();
+  /* Network thread only. Takes "radar/<id>/from" topics. */
+  void ingest(std::string_view topic, const uint8_t* frame, size_t frame_size);
+  Occupancy occupancy() const;
+  /* Only while stopped */
+  template <typename Visitor>
+  void for_each_device(Visitor&& visit) {
+    for (auto& shard : shards) {
+      shard->table.for_each(visit);
+    }
+  }
+
+ private:
+  struct alignas(64) ShardCounters {  // Written by the worker of the shard only
+    std::atomic<uint32_t> devices{0};
+    std::atomic<uint32_t> statuses[ROOM_STATUS_COUNT] = {};
+    std::atomic<uint32_t> offline{0};
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> malformed{0};
+  };
+
+  struct Shard {
+    Shard(size_t queue_bytes) : queue(queue_bytes), table(1024) {}
+
+    FrameQueue queue;
+    DeviceTable table;
+    ShardCounters counters;
+    alignas(64) std::atomic<uint64_t> dropped{0};  // Written by the network thread only
+    std::thread worker;
+    uint32_t swept_at_ms = 0;
+  };
+
+  void run_worker(Shard* shard);
+  void handle_frame(Shard* shard, std::string_view id, const uint8_t* frame, size_t frame_size, uint32_t now_ms);
+  void set_room_status(Shard* shard, DeviceEntry* device, uint8_t room_status);
+  void sweep_stale(Shard* shard, uint32_t now_ms);
+  uint32_t now_ms() const;
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  const uint32_t stale_ms;
+  std::atomic<bool> running{false};
+  std::atomic<uint64_t> rejected{0};  // Written by the network thread only
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "device_table.h"
+
+#include <string.h>
+
+/* PRIVATE CONSTANTS */
+constexpr uint32_t FNV_OFFSET = 2166136261u;
+constexpr uint32_t FNV_PRIME = 16777619u;
+
+/* FUNCTIONS */
+DeviceTable::DeviceTable(size_t capacity) {
+  size_t size = 16;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  hashes.assign(size, 0);
+  entries.resize(size);
+}
+
+uint32_t DeviceTable::hash(std::string_view id) {
+  uint32_t value = FNV_OFFSET;
+  for (const char c : id) {
+    value = (value ^ (uint8_t)c) * FNV_PRIME;
+  }
+  return value ? value : 1;
+}
+
+DeviceEntry* DeviceTable::get(std::string_view id, uint32_t hash, bool* inserted) {
+  *inserted = false;
+  if (id.size() > DEVICE_ID_MAX_SIZE) {
+    return nullptr;
+  }
+  if (4 * (count + 1) > 3 * hashes.size()) {
+    grow();
+  }
+
+  const size_t mask = hashes.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    if (hashes[i] == hash && entries[i].id_size == id.size() && memcmp(entries[i].id, id.data(), id.size()) == 0) {
+      return &entries[i];
+    }
+    if (hashes[i] == 0) {
+      hashes[i] = hash;
+      entries[i] = DeviceEntry{};
+      memcpy(entries[i].id, id.data(), id.size());
+      entries[i].id_size = id.size();
+      count++;
+      *inserted = true;
+      return &entries[i];
+    }
+  }
+}
+
+void DeviceTable::grow() {
+  std::vector<uint32_t> old_hashes(hashes.size() * 2, 0);
+  std::vector<DeviceEntry> old_entries(entries.size() * 2);
+  old_hashes.swap(hashes);
+  old_entries.swap(entries);
+
+  const size_t mask = hashes.size() - 1;
+  for (size_t i = 0; i < old_hashes.size(); i++) {
+    if (!old_hashes[i]) {
+      continue;
+    }
+    size_t j = old_hashes[i] & mask;
+    while (hashes[j]) {
+      j = (j + 1) & mask;
+    }
+    hashes[j] = old_hashes[i];
+    entries[j] = old_entries[i];
+  }
+}
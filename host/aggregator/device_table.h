@@ -0,0 +1,63 @@
+#ifndef DEVICE_TABLE_H
+#define DEVICE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+#include <vector>
+
+/* The devices of one shard, owned by its worker thread.
+ *
+ * Open addressing with linear probing. Probes only touch a dense array of
+ * hashes, 16 to a cache line, and every device is one cache line of its own,
+ * so a lookup usually costs two cache misses however many devices there are.
+ * The table doubles when it gets 3/4 full, which the worker does between
+ * frames. */
+
+/* PUBLIC CONSTANTS */
+constexpr size_t DEVICE_ID_MAX_SIZE = 31;
+
+/* PUBLIC TYPES */
+struct alignas(64) DeviceEntry {
+  char id[DEVICE_ID_MAX_SIZE];
+  uint8_t id_size;
+  uint8_t room_status;  // RoomStatus
+  int8_t rssi;          // Of the last telemetry sample
+  bool offline;         // Not heard from within the stale time
+  uint32_t first_seen_ms;
+  uint32_t last_seen_ms;
+  uint32_t frames;
+  uint32_t status_changes;
+  uint32_t ping_interval_ms;  // Of the last sample rate report
+  float waveform_jitter;      // Of the last telemetry sample
+  float waveform_wander;
+};
+static_assert(sizeof(DeviceEntry) == 64, "DeviceEntry should fill one cache line");
+
+class DeviceTable {
+ public:
+  explicit DeviceTable(size_t capacity);
+
+  static uint32_t hash(std::string_view id);
+  /* Inserts a new device with inserted set. Returns nullptr if the ID is too long. */
+  DeviceEntry* get(std::string_view id, uint32_t hash, bool* inserted);
+  size_t size() const { return count; }
+
+  template <typename Visitor>
+  void for_each(Visitor&& visit) {
+    for (size_t i = 0; i < hashes.size(); i++) {
+      if (hashes[i]) {
+        visit(entries[i]);
+      }
+    }
+  }
+
+ private:
+  void grow();
+
+  std::vector<uint32_t> hashes;  // 0 for free slots
+  std::vector<DeviceEntry> entries;
+  size_t count = 0;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <assert.h>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string_view>
+#include <vector>
+
+/* Single producer, single consumer queue of device frames, the hand-off from
+ * the network thread to a shard. Records are packed back to back into one
+ * byte ring, so a 10-byte status frame takes 24 bytes instead of a slot sized
+ * for the largest frame. A record that doesn't fit before the end of the ring
+ * leaves a padding record and starts over at the beginning.
+ *
+ * Record: [size, u32] [frame size, u16] [device ID size, u8] [padding, u8]
+ *         [device ID] [frame], rounded up to RECORD_ALIGNMENT
+ *
+ * Each side keeps a copy of the other side's position and only reloads it
+ * when the copy says the ring is full or empty, so the shared positions stay
+ * out of the hot loop. */
+
+/* PUBLIC TYPES */
+class FrameQueue {
+ public:
+  static constexpr size_t RECORD_ALIGNMENT = 8;
+  static constexpr size_t HEADER_SIZE = 8;
+
+  /* Capacity is rounded up to a power of two */
+  explicit FrameQueue(size_t capacity) : bytes(round_up_power_of_two(capacity)), mask(bytes.size() - 1) {}
+
+  /* Producer only. Returns false if the queue is full. */
+  bool push(std::string_view device_id, const uint8_t* frame, size_t frame_size) {
+    assert(device_id.size() <= UINT8_MAX && frame_size <= UINT16_MAX);
+    const size_t size = align(HEADER_SIZE + device_id.size() + frame_size);
+    const size_t tail = tail_position.load(std::memory_order_relaxed);
+    const size_t contiguous = bytes.size() - (tail & mask);
+    const size_t needed = contiguous < size ? contiguous + size : size;
+    if (needed > bytes.size() - (tail - cached_head)) {
+      cached_head = head_position.load(std::memory_order_acquire);
+      if (needed > bytes.size() - (tail - cached_head)) {
+        return false;
+      }
+    }
+
+    size_t index = tail & mask;
+    if (contiguous < size) {
+      write_header(index, contiguous, 0, 0, true);
+      index = 0;
+    }
+    write_header(index, size, frame_size, device_id.size(), false);
+    memcpy(&bytes[index + HEADER_SIZE], device_id.data(), device_id.size());
+    memcpy(&bytes[index + HEADER_SIZE + device_id.size()], frame, frame_size);
+    tail_position.store(tail + needed, std::memory_order_release);
+    return true;
+  }
+
+  /* Consumer only. Calls handle(device_id, frame, frame_size) for up to
+   * max_records records and returns their number. */
+  template <typename Handler>
+  size_t pop(Handler&& handle, size_t max_records) {
+    size_t head = head_position.load(std::memory_order_relaxed);
+    if (head == cached_tail) {
+      cached_tail = tail_position.load(std::memory_order_acquire);
+    }
+    size_t count = 0;
+    while (head != cached_tail && count < max_records) {
+      const size_t index = head & mask;
+      uint32_t size;
+      memcpy(&size, &bytes[index], sizeof(size));
+      const bool padding = bytes[index + 7];
+      if (!padding) {
+        uint16_t frame_size;
+        memcpy(&frame_size, &bytes[index + 4], sizeof(frame_size));
+        const uint8_t id_size = bytes[index + 6];
+        const char* id = (const char*)&bytes[index + HEADER_SIZE];
+        handle(std::string_view(id, id_size), &bytes[index + HEADER_SIZE + id_size], frame_size);
+        count++;
+      }
+      head += size;
+    }
+    head_position.store(head, std::memory_order_release);
+    return count;
+  }
+
+ private:
+  static size_t round_up_power_of_two(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  static size_t align(size_t size) {
+    return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+  }
+
+  void write_header(size_t index, uint32_t size, uint16_t frame_size, uint8_t id_size, bool padding) {
+    memcpy(&bytes[index], &size, sizeof(size));
+    memcpy(&bytes[index + 4], &frame_size, sizeof(frame_size));
+    bytes[index + 6] = id_size;
+    bytes[index + 7] = padding;
+  }
+
+  std::vector<uint8_t> bytes;
+  const size_t mask;
+  alignas(64) std::atomic<size_t> tail_position{0};
+  size_t cached_head = 0;  // Producer's copy
+  alignas(64) std::atomic<size_t> head_position{0};
+  size_t cached_tail = 0;  // Consumer's copy
+};
+
+#endif
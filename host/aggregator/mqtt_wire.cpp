@@ -0,0 +1,274 @@
+#include "mqtt_wire.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace mqtt {
+
+/* PRIVATE CONSTANTS */
+constexpr size_t READ_SIZE = 16 * 1024;
+constexpr size_t LENGTH_MAX_SIZE = 4;
+
+/* PRIVATE PROTOTYPES */
+static void append_length(std::vector<uint8_t>& out, size_t length);
+static void append_u16(std::vector<uint8_t>& out, uint16_t value);
+static void append_string(std::vector<uint8_t>& out, std::string_view value);
+static uint16_t get_u16(const uint8_t* cursor);
+
+/* FUNCTIONS */
+PacketReader::PacketReader() : buffer(PACKET_MAX_SIZE + READ_SIZE) {}
+
+bool PacketReader::fill(int fd) {
+  if (start > 0) {
+    memmove(buffer.data(), buffer.data() + start, end - start);
+    end -= start;
+    start = 0;
+  }
+  while (true) {
+    const ssize_t count = read(fd, buffer.data() + end, buffer.size() - end);
+    if (count > 0) {
+      end += count;
+      return true;
+    }
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    return false;
+  }
+}
+
+bool PacketReader::next(Packet* packet) {
+  if (is_malformed || end - start < 2) {
+    return false;
+  }
+  const uint8_t* data = buffer.data() + start;
+  const size_t available = end - start;
+
+  // Remaining length is a varint of up to 4 bytes
+  size_t length = 0;
+  size_t header_size = 1;
+  for (size_t i = 0;; i++) {
+    if (i == LENGTH_MAX_SIZE) {
+      is_malformed = true;
+      return false;
+    }
+    if (header_size >= available) {
+      return false;
+    }
+    const uint8_t byte = data[header_size++];
+    length |= (size_t)(byte & 0x7F) << (7 * i);
+    if (!(byte & 0x80)) {
+      break;
+    }
+  }
+  if (length > PACKET_MAX_SIZE) {
+    is_malformed = true;
+    return false;
+  }
+  if (available < header_size + length) {
+    return false;
+  }
+
+  *packet = Packet{(uint8_t)(data[0] >> 4), (uint8_t)(data[0] & 0x0F), data + header_size, length};
+  start += header_size + length;
+  return true;
+}
+
+bool parse_publish(const Packet& packet, Publish* publish) {
+  if (packet.type != PUBLISH || packet.size < 2) {
+    return false;
+  }
+  const size_t topic_size = get_u16(packet.body);
+  // QoS 1 and 2 have a packet ID after the topic
+  const size_t id_size = (packet.flags & 0x06) ? 2 : 0;
+  if (packet.size < 2 + topic_size + id_size) {
+    return false;
+  }
+  publish->topic = std::string_view((const char*)packet.body + 2, topic_size);
+  publish->payload = packet.body + 2 + topic_size + id_size;
+  publish->payload_size = packet.size - 2 - topic_size - id_size;
+  return true;
+}
+
+bool parse_subscribe(const Packet& packet, uint16_t* packet_id, std::string_view* filter) {
+  if (packet.type != SUBSCRIBE || packet.size < 4) {
+    return false;
+  }
+  *packet_id = get_u16(packet.body);
+  const size_t filter_size = get_u16(packet.body + 2);
+  if (packet.size < 4 + filter_size) {
+    return false;
+  }
+  *filter = std::string_view((const char*)packet.body + 4, filter_size);
+  return true;
+}
+
+bool topic_matches(std::string_view filter, std::string_view topic) {
+  while (true) {
+    const size_t filter_end = filter.find('/');
+    const size_t topic_end = topic.find('/');
+    const std::string_view filter_level = filter.substr(0, filter_end);
+    if (filter_level == "#") {
+      return true;
+    }
+    if (filter_level != "+" && filter_level != topic.substr(0, topic_end)) {
+      return false;
+    }
+    if (filter_end == std::string_view::npos || topic_end == std::string_view::npos) {
+      return filter_end == topic_end;
+    }
+    filter.remove_prefix(filter_end + 1);
+    topic.remove_prefix(topic_end + 1);
+  }
+}
+
+void append_connect(std::vector<uint8_t>& out, std::string_view client_id, uint16_t keep_alive_s) {
+  static constexpr uint8_t protocol[] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x02};  // Level 4, clean session
+  out.push_back(CONNECT << 4);
+  append_length(out, sizeof(protocol) + 2 + 2 + client_id.size());
+  out.insert(out.end(), protocol, protocol + sizeof(protocol));
+  append_u16(out, keep_alive_s);
+  append_string(out, client_id);
+}
+
+void append_connack(std::vector<uint8_t>& out) {
+  out.insert(out.end(), {CONNACK << 4, 0x02, 0x00, 0x00});
+}
+
+void append_subscribe(std::vector<uint8_t>& out, uint16_t packet_id, std::string_view filter) {
+  out.push_back(SUBSCRIBE << 4 | 0x02);
+  append_length(out, 2 + 2 + filter.size() + 1);
+  append_u16(out, packet_id);
+  append_string(out, filter);
+  out.push_back(0x00);  // QoS 0
+}
+
+void append_suback(std::vector<uint8_t>& out, uint16_t packet_id) {
+  out.insert(out.end(), {SUBACK << 4, 0x03});
+  append_u16(out, packet_id);
+  out.push_back(0x00);
+}
+
+void append_publish(std::vector<uint8_t>& out, std::string_view topic, const uint8_t* payload, size_t payload_size) {
+  out.push_back(PUBLISH << 4);
+  append_length(out, 2 + topic.size() + payload_size);
+  append_string(out, topic);
+  out.insert(out.end(), payload, payload + payload_size);
+}
+
+void append_empty(std::vector<uint8_t>& out, PacketType type) {
+  out.insert(out.end(), {(uint8_t)(type << 4), 0x00});
+}
+
+bool send_all(int fd, const std::vector<uint8_t>& bytes) {
+  size_t sent = 0;
+  while (sent < bytes.size()) {
+    const ssize_t count = write(fd, bytes.data() + sent, bytes.size() - sent);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+    sent += count;
+  }
+  return true;
+}
+
+int accept_subscriber(uint16_t port, std::string* filter) {
+  const int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+  const int reuse = 1;
+  setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(server_fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(server_fd, 1) != 0) {
+    perror("listen");
+    close(server_fd);
+    return -1;
+  }
+  fprintf(stderr, "Waiting for a subscriber on port %u\n", port);
+  const int fd = accept(server_fd, nullptr, nullptr);
+  close(server_fd);
+  if (fd < 0) {
+    perror("accept");
+    return -1;
+  }
+
+  PacketReader reader;
+  std::vector<uint8_t> out;
+  while (reader.fill(fd)) {
+    Packet packet;
+    while (reader.next(&packet)) {
+      out.clear();
+      uint16_t packet_id;
+      std::string_view subscribed;
+      if (packet.type == CONNECT) {
+        append_connack(out);
+      } else if (parse_subscribe(packet, &packet_id, &subscribed)) {
+        append_suback(out, packet_id);
+        *filter = std::string(subscribed);
+      }
+      if (!send_all(fd, out)) {
+        break;
+      }
+      if (!filter->empty()) {
+        return fd;
+      }
+    }
+  }
+  fprintf(stderr, "Subscriber left before subscribing\n");
+  close(fd);
+  return -1;
+}
+
+bool answer_pings(int fd, PacketReader& reader) {
+  pollfd poll_fd = {fd, POLLIN, 0};
+  if (poll(&poll_fd, 1, 0) <= 0) {
+    return true;
+  }
+  if (!reader.fill(fd)) {
+    return false;
+  }
+  std::vector<uint8_t> out;
+  Packet packet;
+  while (reader.next(&packet)) {
+    if (packet.type == PINGREQ) {
+      append_empty(out, PINGRESP);
+    } else if (packet.type == DISCONNECT) {
+      return false;
+    }
+  }
+  return send_all(fd, out);
+}
+
+static void append_length(std::vector<uint8_t>& out, size_t length) {
+  do {
+    const uint8_t byte = length & 0x7F;
+    length >>= 7;
+    out.push_back(length ? byte | 0x80 : byte);
+  } while (length);
+}
+
+static void append_u16(std::vector<uint8_t>& out, uint16_t value) {
+  out.push_back(value >> 8);
+  out.push_back(value & 0xFF);
+}
+
+static void append_string(std::vector<uint8_t>& out, std::string_view value) {
+  append_u16(out, value.size());
+  out.insert(out.end(), value.begin(), value.end());
+}
+
+static uint16_t get_u16(const uint8_t* cursor) {
+  return (uint16_t)(cursor[0] << 8 | cursor[1]);
+}
+
+}  // namespace mqtt
@@ -0,0 +1,89 @@
+#ifndef MQTT_WIRE_H
+#define MQTT_WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* The part of MQTT 3.1.1 that the aggregator and the broker stand-ins speak:
+ * connect, subscribe, QoS 0 publish and pings. Packets are parsed in place
+ * from the receive buffer, so a publish costs no copy until its frame is
+ * queued. */
+
+namespace mqtt {
+
+/* PUBLIC CONSTANTS */
+constexpr size_t PACKET_MAX_SIZE = 64 * 1024;  // Device frames are at most ~1 KiB
+
+/* PUBLIC ENUMS */
+enum PacketType : uint8_t {
+  CONNECT = 1,
+  CONNACK = 2,
+  PUBLISH = 3,
+  SUBSCRIBE = 8,
+  SUBACK = 9,
+  PINGREQ = 12,
+  PINGRESP = 13,
+  DISCONNECT = 14,
+};
+
+/* PUBLIC TYPES */
+struct Packet {
+  uint8_t type;
+  uint8_t flags;
+  const uint8_t* body;
+  size_t size;
+};
+
+struct Publish {
+  std::string_view topic;
+  const uint8_t* payload;
+  size_t payload_size;
+};
+
+/* Buffers what a socket delivers and splits it into packets */
+class PacketReader {
+ public:
+  PacketReader();
+  /* Reads what the socket has. Returns false on end of stream or error. */
+  bool fill(int fd);
+  /* Next complete packet, valid until the next fill. Returns false if there
+   * is none yet or the stream is malformed. */
+  bool next(Packet* packet);
+  bool malformed() const { return is_malformed; }
+
+ private:
+  std::vector<uint8_t> buffer;
+  size_t start = 0;
+  size_t end = 0;
+  bool is_malformed = false;
+};
+
+/* PUBLIC PROTOTYPES */
+bool parse_publish(const Packet& packet, Publish* publish);
+/* Topic of SUBSCRIBE, only the first filter is used */
+bool parse_subscribe(const Packet& packet, uint16_t* packet_id, std::string_view* filter);
+/* Supports the + and # wildcards */
+bool topic_matches(std::string_view filter, std::string_view topic);
+
+void append_connect(std::vector<uint8_t>& out, std::string_view client_id, uint16_t keep_alive_s);
+void append_connack(std::vector<uint8_t>& out);
+void append_subscribe(std::vector<uint8_t>& out, uint16_t packet_id, std::string_view filter);
+void append_suback(std::vector<uint8_t>& out, uint16_t packet_id);
+void append_publish(std::vector<uint8_t>& out, std::string_view topic, const uint8_t* payload, size_t payload_size);
+void append_empty(std::vector<uint8_t>& out, PacketType type);
+
+/* Blocks until everything is written. Returns false on error. */
+bool send_all(int fd, const std::vector<uint8_t>& bytes);
+
+/* For the stand-ins that play the broker: waits for one client on localhost
+ * and answers its CONNECT and SUBSCRIBE. Returns the socket or -1. */
+int accept_subscriber(uint16_t port, std::string* filter);
+/* Keeps the subscriber's keep alive happy without blocking. Returns false once it's gone. */
+bool answer_pings(int fd, PacketReader& reader);
+
+}  // namespace mqtt
+
+#endif
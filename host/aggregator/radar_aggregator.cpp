@@ -0,0 +1,264 @@
+#include "aggregator.h"
+#include "mqtt_wire.h"
+
+#include <getopt.h>
+#include <host_clock.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <wifi_radar.h>
+
+/* Subscribes to the frames of all radar devices and prints the occupancy of
+ * their rooms as a CSV row every report interval: how many devices there are,
+ * how many rooms are empty, have movement, are undefined or calibrating, how
+ * many devices went offline, and the frames that were processed, dropped or
+ * malformed. Runs until the broker disconnects, the duration is over or
+ * SIGINT / SIGTERM, and can then write a CSV row per device. */
+
+/* PRIVATE CONSTANTS */
+constexpr const char* DEFAULT_HOST = "127.0.0.1";
+constexpr const char* DEFAULT_PORT = "1883";
+constexpr const char* SUBSCRIPTION = "radar/+/from";
+constexpr const char* CLIENT_ID = "radar-aggregator";
+constexpr uint16_t KEEP_ALIVE_S = 60;
+constexpr size_t DEFAULT_QUEUE_BYTES = 4 * 1024 * 1024;
+constexpr uint32_t DEFAULT_REPORT_INTERVAL_MS = 1000;
+constexpr uint32_t DEFAULT_STALE_S = 180;  // Three missed status heartbeats
+
+/* GLOBAL VARIABLES */
+static volatile sig_atomic_t g_stop_requested = 0;
+
+/* PRIVATE PROTOTYPES */
+static void print_usage(const char* program);
+static void request_stop(int signal);
+static int connect_to_broker(const char* host, const char* port);
+static bool subscribe(int fd, mqtt::PacketReader& reader);
+static bool handle_packets(mqtt::PacketReader& reader, Aggregator& aggregator);
+static void print_report(const Occupancy& occupancy, double elapsed_s, uint64_t reported_frames, double interval_s);
+static bool write_devices(const char* path, Aggregator& aggregator);
+
+/* MAIN */
+int main(int argc, char** argv) {
+  const char* host = DEFAULT_HOST;
+  const char* port = DEFAULT_PORT;
+  size_t shards_count = std::thread::hardware_concurrency();
+  uint32_t report_interval_ms = DEFAULT_REPORT_INTERVAL_MS;
+  uint32_t stale_s = DEFAULT_STALE_S;
+  double duration_s = 0;
+  const char* devices_path = nullptr;
+
+  int option;
+  while ((option = getopt(argc, argv, "H:p:n:i:s:t:d:h")) != -1) {
+    switch (option) {
+      case 'H':
+        host = optarg;
+        break;
+      case 'p':
+        port = optarg;
+        break;
+      case 'n':
+        shards_count = strtoul(optarg, nullptr, 10);
+        break;
+      case 'i':
+        report_interval_ms = strtoul(optarg, nullptr, 10);
+        break;
+      case 's':
+        stale_s = strtoul(optarg, nullptr, 10);
+        break;
+      case 't':
+        duration_s = strtod(optarg, nullptr);
+        break;
+      case 'd':
+        devices_path = optarg;
+        break;
+      default:
+        print_usage(argv[0]);
+        return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (optind != argc || report_interval_ms == 0) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const int fd = connect_to_broker(host, port);
+  if (fd < 0) {
+    return EXIT_FAILURE;
+  }
+  mqtt::PacketReader reader;
+  if (!subscribe(fd, reader)) {
+    fprintf(stderr, "%s:%s: subscription failed\n", host, port);
+    close(fd);
+    return EXIT_FAILURE;
+  }
+  signal(SIGINT, request_stop);
+  signal(SIGTERM, request_stop);
+  signal(SIGPIPE, SIG_IGN);
+
+  Aggregator aggregator(shards_count ? shards_count : 1, DEFAULT_QUEUE_BYTES, stale_s * 1000);
+  aggregator.start();
+  printf("time_s,devices,undefined,empty,occupied,calibrating,stationary,offline,frames,frames_per_s,dropped,malformed\n");
+
+  const double start_s = host_wall_time_s();
+  double reported_at_s = start_s;
+  double pinged_at_s = start_s;
+  uint64_t reported_frames = 0;
+  bool connected = handle_packets(reader, aggregator);
+  std::vector<uint8_t> out;
+  while (connected && !g_stop_requested && (duration_s <= 0 || host_wall_time_s() - start_s < duration_s)) {
+    pollfd poll_fd = {fd, POLLIN, 0};
+    const int ready = poll(&poll_fd, 1, report_interval_ms / 4 + 1);
+    if (ready > 0) {
+      connected = reader.fill(fd) && handle_packets(reader, aggregator);
+    }
+
+    const double now_s = host_wall_time_s();
+    if (now_s - pinged_at_s >= KEEP_ALIVE_S / 2) {
+      out.clear();
+      mqtt::append_empty(out, mqtt::PINGREQ);
+      connected = connected && mqtt::send_all(fd, out);
+      pinged_at_s = now_s;
+    }
+    if (now_s - reported_at_s >= report_interval_ms / 1000.0) {
+      const Occupancy occupancy = aggregator.occupancy();
+      print_report(occupancy, now_s - start_s, reported_frames, now_s - reported_at_s);
+      reported_frames = occupancy.frames;
+      reported_at_s = now_s;
+    }
+  }
+  close(fd);
+
+  aggregator.stop();
+  const double end_s = host_wall_time_s();
+  const Occupancy occupancy = aggregator.occupancy();
+  print_report(occupancy, end_s - start_s, reported_frames, end_s - reported_at_s);
+  fprintf(stderr, "Frames: %llu in %.3f s, %.0f/s; dropped: %llu; malformed: %llu; devices: %u\n",
+          (unsigned long long)occupancy.frames, end_s - start_s, occupancy.frames / (end_s - start_s),
+          (unsigned long long)occupancy.dropped, (unsigned long long)occupancy.malformed, occupancy.devices);
+  if (devices_path && !write_devices(devices_path, aggregator)) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* FUNCTIONS */
+static void print_usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -H <host>  broker host (default %s)\n"
+          "  -p <port>  broker port (default %s)\n"
+          "  -n <count> shards, each with a worker thread (default: one per CPU)\n"
+          "  -i <ms>    report interval (default %u)\n"
+          "  -s <s>     silence after which a device counts as offline (default %u)\n"
+          "  -t <s>     stop after this long\n"
+          "  -d <file>  write a CSV row per device at the end\n",
+          program, DEFAULT_HOST, DEFAULT_PORT, DEFAULT_REPORT_INTERVAL_MS, DEFAULT_STALE_S);
+}
+
+static void request_stop(int signal) {
+  g_stop_requested = 1;
+}
+
+static int connect_to_broker(const char* host, const char* port) {
+  addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addresses;
+  const int res = getaddrinfo(host, port, &hints, &addresses);
+  if (res != 0) {
+    fprintf(stderr, "%s:%s: %s\n", host, port, gai_strerror(res));
+    return -1;
+  }
+  int fd = -1;
+  for (addrinfo* address = addresses; address; address = address->ai_next) {
+    fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+    if (fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+      break;
+    }
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0) {
+    fprintf(stderr, "%s:%s: can't connect\n", host, port);
+  }
+  return fd;
+}
+
+static bool subscribe(int fd, mqtt::PacketReader& reader) {
+  std::vector<uint8_t> out;
+  mqtt::append_connect(out, CLIENT_ID, KEEP_ALIVE_S);
+  mqtt::append_subscribe(out, 1, SUBSCRIPTION);
+  if (!mqtt::send_all(fd, out)) {
+    return false;
+  }
+  bool connected = false;
+  while (reader.fill(fd)) {
+    mqtt::Packet packet;
+    while (reader.next(&packet)) {
+      if (packet.type == mqtt::CONNACK) {
+        connected = packet.size >= 2 && packet.body[1] == 0;
+        if (!connected) {
+          return false;
+        }
+      } else if (packet.type == mqtt::SUBACK) {
+        // Publishes that follow stay in the reader
+        return connected && packet.size >= 3 && packet.body[2] != 0x80;
+      }
+    }
+  }
+  return false;
+}
+
+/* Returns false when the broker disconnects */
+static bool handle_packets(mqtt::PacketReader& reader, Aggregator& aggregator) {
+  mqtt::Packet packet;
+  while (reader.next(&packet)) {
+    mqtt::Publish publish;
+    if (packet.type == mqtt::PUBLISH && mqtt::parse_publish(packet, &publish)) {
+      aggregator.ingest(publish.topic, publish.payload, publish.payload_size);
+    } else if (packet.type == mqtt::DISCONNECT) {
+      return false;
+    }
+  }
+  if (reader.malformed()) {
+    fprintf(stderr, "Malformed MQTT stream\n");
+    return false;
+  }
+  return true;
+}
+
+static void print_report(const Occupancy& occupancy, double elapsed_s, uint64_t reported_frames, double interval_s) {
+  printf("%.3f,%u,%u,%u,%u,%u,%u,%u,%llu,%.0f,%llu,%llu\n", elapsed_s, occupancy.devices, occupancy.statuses[ROOM_UNDEFINED],
+         occupancy.statuses[NO_MOVEMENT], occupancy.statuses[MOVEMENT_DETECTED], occupancy.statuses[ROOM_CALIBRATION_ACTIVE],
+         occupancy.statuses[STATIONARY_PRESENCE], occupancy.offline, (unsigned long long)occupancy.frames,
+         interval_s > 0 ? (occupancy.frames - reported_frames) / interval_s : 0.0, (unsigned long long)occupancy.dropped,
+         (unsigned long long)occupancy.malformed);
+  fflush(stdout);
+}
+
+static bool write_devices(const char* path, Aggregator& aggregator) {
+  FILE* file = fopen(path, "w");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  fprintf(file, "device,room_status,offline,frames,status_changes,ping_interval_ms,waveform_jitter,waveform_wander,rssi\n");
+  aggregator.for_each_device([&](const DeviceEntry& device) {
+    fprintf(file, "%.*s,%u,%d,%u,%u,%u,%g,%g,%d\n", device.id_size, device.id, device.room_status, device.offline, device.frames,
+            device.status_changes, device.ping_interval_ms, device.waveform_jitter, device.waveform_wander, device.rssi);
+  });
+  if (fclose(file) != 0) {
+    perror(path);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,181 @@
+#include "mqtt_wire.h"
+
+#include <chrono>
+#include <getopt.h>
+#include <host_clock.h>
+#include <mqtt_frame.h>
+#include <mqtt_handler.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <wifi_radar.h>
+
+/* Local stand-in for the MQTT broker of a radar fleet, for scaling tests of
+ * radar_aggregator. It accepts one subscriber and publishes the frames of
+ * simulated devices to it on radar/<id>/from: room status frames, and every
+ * TELEMETRY_EVERY-th frame a telemetry batch, with rooms that change status
+ * now and then. Frames are paced to the given rate per device, or sent as
+ * fast as the subscriber takes them with a rate of 0. At the end it prints
+ * what it sent and the final status of the rooms, which the last row of the
+ * aggregator should match. */
+
+/* PRIVATE CONSTANTS */
+constexpr uint16_t DEFAULT_PORT = 1883;
+constexpr uint32_t DEFAULT_DEVICES = 1000;
+constexpr double DEFAULT_RATE = 1.0;
+constexpr double DEFAULT_DURATION_S = 10;
+constexpr auto TICK = std::chrono::milliseconds(10);
+constexpr size_t UNTHROTTLED_BATCH = 4096;  // Frames per write without a rate
+constexpr uint32_t TELEMETRY_EVERY = 4;
+constexpr uint32_t TELEMETRY_SAMPLES = 8;
+constexpr uint32_t STATUS_CHANGE_PER_MILLE = 50;
+
+/* PRIVATE TYPES */
+struct SimulatedDevice {
+  std::string topic;
+  uint8_t room_status;
+  uint32_t frames;
+};
+
+/* GLOBAL VARIABLES */
+static uint32_t g_random_state = 1;
+
+/* PRIVATE PROTOTYPES */
+static void print_usage(const char* program);
+static void append_device_frame(std::vector<uint8_t>& out, SimulatedDevice& device);
+static uint32_t next_random();
+
+/* MAIN */
+int main(int argc, char** argv) {
+  uint16_t port = DEFAULT_PORT;
+  uint32_t devices_count = DEFAULT_DEVICES;
+  double rate = DEFAULT_RATE;
+  double duration_s = DEFAULT_DURATION_S;
+
+  int option;
+  while ((option = getopt(argc, argv, "p:n:r:t:h")) != -1) {
+    switch (option) {
+      case 'p':
+        port = strtoul(optarg, nullptr, 10);
+        break;
+      case 'n':
+        devices_count = strtoul(optarg, nullptr, 10);
+        break;
+      case 'r':
+        rate = strtod(optarg, nullptr);
+        break;
+      case 't':
+        duration_s = strtod(optarg, nullptr);
+        break;
+      default:
+        print_usage(argv[0]);
+        return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (optind != argc || devices_count == 0) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  std::vector<SimulatedDevice> devices(devices_count);
+  for (uint32_t i = 0; i < devices_count; i++) {
+    devices[i] = SimulatedDevice{"radar/" + std::to_string(i + 1) + "/from", NO_MOVEMENT, 0};
+  }
+
+  std::string filter;
+  const int fd = mqtt::accept_subscriber(port, &filter);
+  if (fd < 0) {
+    return EXIT_FAILURE;
+  }
+  if (!mqtt::topic_matches(filter, devices[0].topic)) {
+    fprintf(stderr, "Subscription %s doesn't cover the devices\n", filter.c_str());
+    close(fd);
+    return EXIT_FAILURE;
+  }
+
+  mqtt::PacketReader reader;
+  std::vector<uint8_t> out;
+  uint64_t frames = 0;
+  uint64_t bytes = 0;
+  size_t next_device = 0;
+  bool connected = true;
+  const double start_s = host_wall_time_s();
+  double now_s = start_s;
+  while (connected && now_s - start_s < duration_s) {
+    // Frames that are due by now, or a batch without a rate
+    const uint64_t due = rate > 0 ? (uint64_t)((now_s - start_s) * rate * devices_count) : frames + UNTHROTTLED_BATCH;
+    out.clear();
+    for (; frames < due; frames++) {
+      append_device_frame(out, devices[next_device]);
+      next_device = (next_device + 1) % devices_count;
+    }
+    bytes += out.size();
+    connected = mqtt::send_all(fd, out) && mqtt::answer_pings(fd, reader);
+    if (rate > 0) {
+      std::this_thread::sleep_for(TICK);
+    }
+    now_s = host_wall_time_s();
+  }
+
+  out.clear();
+  mqtt::append_empty(out, mqtt::DISCONNECT);
+  mqtt::send_all(fd, out);
+  close(fd);
+
+  uint32_t statuses[ROOM_CALIBRATION_ACTIVE + 1] = {};
+  for (const SimulatedDevice& device : devices) {
+    statuses[device.room_status]++;
+  }
+  const double elapsed_s = host_wall_time_s() - start_s;
+  fprintf(stderr, "Sent: %llu frames, %llu bytes in %.3f s, %.0f frames/s; devices: %u; empty: %u; occupied: %u%s\n",
+          (unsigned long long)frames, (unsigned long long)bytes, elapsed_s, frames / elapsed_s, devices_count,
+          statuses[NO_MOVEMENT], statuses[MOVEMENT_DETECTED], connected ? "" : "; subscriber disconnected");
+  return connected ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* FUNCTIONS */
+static void print_usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -p <port>  port to listen on (default %u)\n"
+          "  -n <count> simulated devices (default %u)\n"
+          "  -r <rate>  frames per second of each device, 0 for as fast as possible (default %g)\n"
+          "  -t <s>     how long to publish (default %g)\n",
+          program, DEFAULT_PORT, DEFAULT_DEVICES, DEFAULT_RATE, DEFAULT_DURATION_S);
+}
+
+static void append_device_frame(std::vector<uint8_t>& out, SimulatedDevice& device) {
+  uint8_t frame[MQTT_FRAME_MAX_SIZE];
+  uint8_t payload[MQTT_FRAME_PAYLOAD_MAX_SIZE];
+  if (next_random() % 1000 < STATUS_CHANGE_PER_MILLE) {
+    device.room_status = device.room_status == NO_MOVEMENT ? MOVEMENT_DETECTED : NO_MOVEMENT;
+  }
+
+  size_t size;
+  if (++device.frames % TELEMETRY_EVERY == 0) {
+    TelemetrySample samples[TELEMETRY_SAMPLES];
+    for (uint32_t i = 0; i < TELEMETRY_SAMPLES; i++) {
+      const bool moving = device.room_status == MOVEMENT_DETECTED;
+      samples[i] = TelemetrySample{device.frames * 100 + i * 10, (moving ? 0.05f : 0.01f) + (next_random() % 100) / 10000.0f,
+                                   0.02f, (int8_t)(-40 - (int)(next_random() % 40)), device.room_status};
+    }
+    const size_t payload_size = mqtt_frame_encode_telemetry(payload, sizeof(payload), samples, TELEMETRY_SAMPLES);
+    size = mqtt_frame_encode(frame, sizeof(frame), MQTT_TX_MSG_TELEMETRY, payload, payload_size);
+  } else {
+    size = mqtt_frame_encode(frame, sizeof(frame), MQTT_TX_MSG_ROOM_STATUS, &device.room_status, 1);
+  }
+  mqtt::append_publish(out, device.topic, frame, size);
+}
+
+/* xorshift32, reproducible runs */
+static uint32_t next_random() {
+  g_random_state ^= g_random_state << 13;
+  g_random_state ^= g_random_state >> 17;
+  g_random_state ^= g_random_state << 5;
+  return g_random_state;
+}
@@ -0,0 +1,951 @@
+#include <csi_codec.h>
+#include <ctype.h>
+#include <getopt.h>
+#include <math.h>
+#include <mqtt_frame.h>
+#include <mqtt_handler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rv32.h"
+
+/* Replays the frames of a CSI stream through libesp-csi.a on an emulated
+ * ESP32-C3 and writes the stream back with the jitter and wander that the
+ * library reported for them, as the device records them. The library runs
+ * unchanged, only the FreeRTOS, heap and soft-float calls it makes are served
+ * by the host. With -t it's trained like the device calibration. */
+
+/* PRIVATE CONSTANTS */
+#define LINE_MAX_LENGTH (2 * MQTT_FRAME_MAX_SIZE + 256)
+#define TICK_MS         10  // CONFIG_FREERTOS_HZ 100
+#define MAX_DELAY       UINT32_MAX
+#define MAX_TASKS       8
+#define MAX_QUEUES      8
+#define TASK_STACK_SIZE 0x10000
+#define HEAP_SIZE       0x01000000
+#define BATCH_CAPACITY  900
+
+#define RAW_CSI_SIZE     128  // LLTF of a non-HT 20 MHz packet
+#define RX_CTRL_SIZE     48
+#define CSI_INFO_SIZE    64
+#define CSI_INFO_MAC     48
+#define CSI_INFO_BUF     56
+#define CSI_INFO_LEN     60
+#define FILTERED_VALID_LEN  60
+#define FILTERED_VALID_DATA 65
+#define CONFIG_SIZE      40
+
+/* PRIVATE TYPES */
+typedef enum {
+  WAIT_NONE,
+  WAIT_RECEIVE,
+  WAIT_SEND,
+  WAIT_BITS,
+  WAIT_DELAY,
+} WaitKind;
+
+typedef struct {
+  Rv32Cpu cpu;
+  uint32_t priority;
+  bool alive;
+  WaitKind wait;
+  uint32_t wait_object;
+  uint32_t wait_bits;
+  bool wait_all;
+  uint64_t deadline_ms;
+  bool timed_out;
+  uint64_t runs;
+} Task;
+
+typedef struct {
+  uint32_t length;
+  uint32_t item_size;
+  uint32_t count;
+  uint32_t head;
+  uint8_t* items;
+} Queue;
+
+typedef struct {
+  uint32_t address;
+  uint32_t size;
+} Block;
+
+/* GLOBAL VARIABLES */
+static Task g_tasks[MAX_TASKS];
+static size_t g_tasks_count;
+static Task* g_current;
+static Queue g_queues[MAX_QUEUES];
+static size_t g_queues_count;
+static uint32_t g_event_bits[MAX_QUEUES];
+static size_t g_event_groups_count;
+static uint64_t g_now_ms;
+static uint32_t g_heap_next;
+static uint32_t g_heap_end;
+static Block* g_free_blocks;
+static size_t g_free_count;
+static size_t g_free_capacity;
+static uint32_t g_csi_rx_cb;
+static uint32_t g_csi_rx_ctx;
+static int g_verbose;
+
+static float g_jitter;
+static float g_wander;
+static uint64_t g_radar_outputs;
+static const CsiFrame* g_input;
+static bool g_input_seen;
+static CsiBatchWriter g_writer;
+static uint8_t g_batch[BATCH_CAPACITY];
+static uint64_t g_frames_written;
+static uint32_t g_train_start_ms = UINT32_MAX;
+static uint32_t g_train_stop_ms = UINT32_MAX;
+
+/* PRIVATE PROTOTYPES */
+static uint32_t arg(const Rv32Cpu* cpu, size_t index);
+static float arg_float(const Rv32Cpu* cpu, size_t index);
+static double arg_double(const Rv32Cpu* cpu, size_t index);
+static Rv32NativeResult return_value(Rv32Cpu* cpu, uint32_t value);
+static Rv32NativeResult return_float(Rv32Cpu* cpu, float value);
+static Rv32NativeResult return_double(Rv32Cpu* cpu, double value);
+static void format_guest(const Rv32Cpu* cpu, size_t format_index, FILE* output);
+static uint32_t heap_alloc(uint32_t size);
+static void heap_free(uint32_t address);
+static bool ready(Task* task);
+static void run_ready_tasks(void);
+static void advance_to(uint64_t now_ms);
+static Rv32NativeResult block(Rv32Cpu* cpu, WaitKind wait, uint32_t object, uint32_t ticks, Rv32Native retry);
+static void flush_batch(void);
+static void feed_frame(const CsiFrame* frame, uint32_t info, uint32_t buffer);
+static void train(uint32_t timestamp_ms);
+static Rv32NativeResult radar_callback(Rv32Cpu* cpu);
+static Rv32NativeResult csi_callback(Rv32Cpu* cpu);
+static bool parse_interval(const char* text, uint32_t* start_ms, uint32_t* stop_ms);
+static size_t parse_hex(const char* hex, uint8_t* bytes, size_t max_size);
+static void define_natives(void);
+
+/* MAIN */
+int main(int argc, char** argv) {
+  static char line[LINE_MAX_LENGTH];
+  static uint8_t bytes[MQTT_FRAME_MAX_SIZE];
+  static CsiFrame frames[UINT8_MAX];
+
+  int option;
+  while ((option = getopt(argc, argv, "t:vh")) != -1) {
+    switch (option) {
+      case 't':
+        if (!parse_interval(optarg, &g_train_start_ms, &g_train_stop_ms)) {
+          fprintf(stderr, "Invalid training interval: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'v':
+        g_verbose++;
+        break;
+      default:
+        fprintf(stderr,
+                "Usage: %s [options] <libesp-csi.a> [frames.txt]\n"
+                "  -t <start:stop>  train from start_ms to stop_ms of the stream timestamps\n"
+                "  -v               log every output of the library\n",
+                argv[0]);
+        return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (optind < argc - 2 || optind == argc) {
+    fprintf(stderr, "Usage: %s [options] <libesp-csi.a> [frames.txt]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (optind == argc - 2 && !freopen(argv[optind + 1], "r", stdin)) {
+    perror(argv[optind + 1]);
+    return EXIT_FAILURE;
+  }
+
+  define_natives();
+  rv32_load_archive(argv[optind]);
+  rv32_link();
+  g_heap_next = rv32_reserve(HEAP_SIZE, 16);
+  g_heap_end = g_heap_next + HEAP_SIZE;
+
+  // The application task that sets up the radar and then receives the CSI
+  Task* app = &g_tasks[g_tasks_count++];
+  app->alive = true;
+  app->priority = 23;
+  app->cpu.x[2] = rv32_reserve(TASK_STACK_SIZE, 16) + TASK_STACK_SIZE;
+  g_current = app;
+
+  const uint32_t config = heap_alloc(CONFIG_SIZE);
+  memset(rv32_memory(config, CONFIG_SIZE), 0, CONFIG_SIZE);
+  memset(rv32_memory(config, 6), 0xff, 6);
+  rv32_store32(config + 8, rv32_native_address(radar_callback));
+  rv32_store32(config + 16, rv32_native_address(csi_callback));
+  if (rv32_call(&app->cpu, rv32_symbol("esp_radar_init"), NULL, 0) != 0 ||
+      rv32_call(&app->cpu, rv32_symbol("esp_radar_set_config"), &config, 1) != 0 ||
+      rv32_call(&app->cpu, rv32_symbol("esp_radar_start"), NULL, 0) != 0) {
+    fprintf(stderr, "esp-radar failed to start\n");
+    return EXIT_FAILURE;
+  }
+  g_current = NULL;
+  run_ready_tasks();
+  if (!g_csi_rx_cb) {
+    fprintf(stderr, "esp-radar registered no CSI callback\n");
+    return EXIT_FAILURE;
+  }
+
+  const uint32_t info = heap_alloc(CSI_INFO_SIZE);
+  const uint32_t buffer = heap_alloc(RAW_CSI_SIZE);
+  csi_batch_begin(&g_writer, g_batch, sizeof(g_batch), 0);
+  uint64_t frames_read = 0;
+  while (fgets(line, sizeof(line), stdin)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    const char* hex = strrchr(line, ' ');
+    hex = hex ? hex + 1 : line;
+    MqttFrame frame;
+    const size_t size = parse_hex(hex, bytes, sizeof(bytes));
+    if (size == 0 || !mqtt_frame_decode(bytes, size, &frame) || frame.msg_id != MQTT_TX_MSG_CSI) {
+      continue;
+    }
+    const int count = csi_batch_decode(frame.payload, frame.payload_size, frames, UINT8_MAX);
+    for (int i = 0; i < count; i++) {
+      train(frames[i].timestamp_ms);
+      feed_frame(&frames[i], info, buffer);
+      frames_read++;
+    }
+  }
+  advance_to(g_now_ms + 1000);
+  flush_batch();
+  fprintf(stderr, "Frames: %llu read, %llu written; radar outputs: %llu\n", (unsigned long long)frames_read,
+          (unsigned long long)g_frames_written, (unsigned long long)g_radar_outputs);
+  return EXIT_SUCCESS;
+}
+
+/* FUNCTIONS */
+static void feed_frame(const CsiFrame* frame, uint32_t info, uint32_t buffer) {
+  static const uint8_t mac[6] = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01};
+  static uint32_t previous_ms;
+
+  if (frame->values_count != 104) {
+    fprintf(stderr, "Only LLTF frames of 52 subcarriers are supported, got %u values\n", frame->values_count);
+    exit(EXIT_FAILURE);
+  }
+  advance_to(frame->timestamp_ms > previous_ms ? frame->timestamp_ms : previous_ms);
+  previous_ms = frame->timestamp_ms;
+
+  uint8_t* raw = rv32_memory(buffer, RAW_CSI_SIZE);
+  memset(raw, 0, RAW_CSI_SIZE);
+  memcpy(raw + 2, frame->values, 52);
+  memcpy(raw + 76, frame->values + 52, 52);
+
+  uint8_t* csi_info = rv32_memory(info, CSI_INFO_SIZE);
+  memset(csi_info, 0, CSI_INFO_SIZE);
+  const uint32_t words[] = {
+      (uint8_t)frame->rssi | 11u << 8,  // rate, sig_mode 0 (non-HT)
+      0,                                // mcs, cwb 0 (20 MHz), stbc 0
+      6u << 16,                         // channel 6, no secondary channel
+      (uint32_t)(frame->timestamp_ms * 1000ull),
+  };
+  memcpy(csi_info, words, sizeof(words));
+  csi_info[20] = (uint8_t)-95;  // noise floor
+  memcpy(csi_info + CSI_INFO_MAC, mac, sizeof(mac));
+  rv32_store32(info + CSI_INFO_BUF, buffer);
+  memcpy(csi_info + CSI_INFO_LEN, &(uint16_t){RAW_CSI_SIZE}, 2);
+
+  g_input = frame;
+  g_input_seen = false;
+  const uint32_t args[] = {g_csi_rx_ctx, info};
+  g_current = &g_tasks[0];
+  rv32_call(&g_tasks[0].cpu, g_csi_rx_cb, args, 2);
+  g_current = NULL;
+  run_ready_tasks();
+}
+
+/* The calibration commands of the device, from the application task */
+static void train(uint32_t timestamp_ms) {
+  static bool started;
+  static bool stopped;
+  if (!started && timestamp_ms >= g_train_start_ms) {
+    g_current = &g_tasks[0];
+    rv32_call(&g_tasks[0].cpu, rv32_symbol("esp_radar_train_remove"), NULL, 0);
+    rv32_call(&g_tasks[0].cpu, rv32_symbol("esp_radar_train_start"), NULL, 0);
+    g_current = NULL;
+    started = true;
+  }
+  if (started && !stopped && timestamp_ms >= g_train_stop_ms) {
+    const uint32_t thresholds = heap_alloc(2 * sizeof(float));
+    const uint32_t args[] = {thresholds, thresholds + sizeof(float)};
+    g_current = &g_tasks[0];
+    rv32_call(&g_tasks[0].cpu, rv32_symbol("esp_radar_train_stop"), args, 2);
+    g_current = NULL;
+    float wander;
+    float jitter;
+    memcpy(&wander, rv32_memory(args[0], sizeof(float)), sizeof(float));
+    memcpy(&jitter, rv32_memory(args[1], sizeof(float)), sizeof(float));
+    fprintf(stderr, "Training thresholds: jitter %g, wander %g\n", jitter, wander);
+    heap_free(thresholds);
+    stopped = true;
+  }
+}
+
+static Rv32NativeResult radar_callback(Rv32Cpu* cpu) {
+  const uint32_t info = arg(cpu, 0);
+  memcpy(&g_jitter, rv32_memory(info, 4), 4);
+  memcpy(&g_wander, rv32_memory(info + 4, 4), 4);
+  g_radar_outputs++;
+  if (g_verbose) {
+    fprintf(stderr, "%llu ms: jitter %g, wander %g\n", (unsigned long long)g_now_ms, g_jitter, g_wander);
+  }
+  return RV32_NATIVE_RETURN;
+}
+
+static Rv32NativeResult csi_callback(Rv32Cpu* cpu) {
+  const uint32_t info = arg(cpu, 0);
+  int16_t valid_len;
+  memcpy(&valid_len, rv32_memory(info + FILTERED_VALID_LEN, 2), 2);
+  if (valid_len <= 0 || valid_len > CSI_MAX_VALUES) {
+    fprintf(stderr, "Unexpected valid length %d\n", valid_len);
+    exit(EXIT_FAILURE);
+  }
+  CsiFrame frame = *g_input;
+  frame.values_count = valid_len;
+  memcpy(frame.values, rv32_memory(info + FILTERED_VALID_DATA, valid_len), valid_len);
+  if (memcmp(frame.values, g_input->values, valid_len) != 0) {
+    fprintf(stderr, "The library changed the CSI values of frame %u\n", g_input->timestamp_ms);
+  }
+  frame.waveform_jitter = g_jitter;
+  frame.waveform_wander = g_wander;
+  if (!csi_batch_append(&g_writer, &frame)) {
+    flush_batch();
+    csi_batch_append(&g_writer, &frame);
+  }
+  g_frames_written++;
+  g_input_seen = true;
+  return RV32_NATIVE_RETURN;
+}
+
+static void flush_batch(void) {
+  static uint8_t encoded[MQTT_FRAME_MAX_SIZE];
+  if (g_writer.frames_count == 0) {
+    return;
+  }
+  const size_t size = mqtt_frame_encode(encoded, sizeof(encoded), MQTT_TX_MSG_CSI, g_batch, g_writer.size);
+  for (size_t i = 0; i < size; i++) {
+    printf("%02x", encoded[i]);
+  }
+  printf("\n");
+  csi_batch_begin(&g_writer, g_batch, sizeof(g_batch), 0);
+}
+
+/* Scheduling, tasks run one at a time in priority order whenever the
+ * application task is done with a frame */
+static bool ready(Task* task) {
+  if (!task->alive) {
+    return false;
+  }
+  bool satisfied = false;
+  switch (task->wait) {
+    case WAIT_NONE:
+      return true;
+    case WAIT_RECEIVE:
+      satisfied = g_queues[task->wait_object].count > 0;
+      break;
+    case WAIT_SEND:
+      satisfied = g_queues[task->wait_object].count < g_queues[task->wait_object].length;
+      break;
+    case WAIT_BITS: {
+      const uint32_t bits = g_event_bits[task->wait_object] & task->wait_bits;
+      satisfied = task->wait_all ? bits == task->wait_bits : bits != 0;
+      break;
+    }
+    case WAIT_DELAY:
+      break;
+  }
+  if (!satisfied && g_now_ms >= task->deadline_ms) {
+    task->timed_out = task->wait != WAIT_DELAY;
+    satisfied = true;
+  }
+  if (satisfied) {
+    task->wait = WAIT_NONE;
+  }
+  return satisfied;
+}
+
+static void run_ready_tasks(void) {
+  Task* const caller = g_current;
+  for (;;) {
+    Task* best = NULL;
+    for (size_t i = 1; i < g_tasks_count; i++) {
+      Task* task = &g_tasks[i];
+      if (task != caller && ready(task) &&
+          (!best || task->priority > best->priority || (task->priority == best->priority && task->runs < best->runs))) {
+        best = task;
+      }
+    }
+    if (!best) {
+      break;
+    }
+    best->runs++;
+    g_current = best;
+    if (rv32_run(&best->cpu) != RV32_RUN_BLOCKED) {
+      best->alive = false;
+    }
+  }
+  g_current = caller;
+}
+
+static void advance_to(uint64_t now_ms) {
+  for (;;) {
+    run_ready_tasks();
+    uint64_t next_ms = now_ms;
+    for (size_t i = 1; i < g_tasks_count; i++) {
+      if (g_tasks[i].alive && g_tasks[i].wait != WAIT_NONE && g_tasks[i].deadline_ms < next_ms) {
+        next_ms = g_tasks[i].deadline_ms;
+      }
+    }
+    if (next_ms > g_now_ms) {
+      g_now_ms = next_ms;
+    }
+    if (next_ms >= now_ms) {
+      run_ready_tasks();
+      return;
+    }
+  }
+}
+
+static Rv32NativeResult block(Rv32Cpu* cpu, WaitKind wait, uint32_t object, uint32_t ticks, Rv32Native retry) {
+  Task* task = g_current;
+  if (task == &g_tasks[0]) {
+    // The application task is inside a nested call, it lets the others run and retries once
+    if (wait == WAIT_DELAY) {
+      advance_to(g_now_ms + (uint64_t)ticks * TICK_MS);
+      return return_value(cpu, 0);
+    }
+    run_ready_tasks();
+    Task probe = *task;
+    probe.wait = wait;
+    probe.wait_object = object;
+    probe.deadline_ms = UINT64_MAX;
+    return ready(&probe) ? retry(cpu) : return_value(cpu, 0);
+  }
+  if (task->timed_out) {
+    task->timed_out = false;
+    return return_value(cpu, 0);
+  }
+  task->wait = wait;
+  task->wait_object = object;
+  task->deadline_ms = ticks == MAX_DELAY ? UINT64_MAX : g_now_ms + (uint64_t)ticks * TICK_MS;
+  return RV32_NATIVE_BLOCK;
+}
+
+/* Arguments, floats and doubles go in integer registers on the soft-float ABI */
+static uint32_t arg(const Rv32Cpu* cpu, size_t index) {
+  return index < 8 ? cpu->x[10 + index] : rv32_load32(cpu->x[2] + 4 * (index - 8));
+}
+
+static float arg_float(const Rv32Cpu* cpu, size_t index) {
+  const uint32_t bits = arg(cpu, index);
+  float value;
+  memcpy(&value, &bits, 4);
+  return value;
+}
+
+static double arg_double(const Rv32Cpu* cpu, size_t index) {
+  const uint64_t bits = arg(cpu, index) | (uint64_t)arg(cpu, index + 1) << 32;
+  double value;
+  memcpy(&value, &bits, 8);
+  return value;
+}
+
+static Rv32NativeResult return_value(Rv32Cpu* cpu, uint32_t value) {
+  cpu->x[10] = value;
+  return RV32_NATIVE_RETURN;
+}
+
+static Rv32NativeResult return_float(Rv32Cpu* cpu, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, 4);
+  return return_value(cpu, bits);
+}
+
+static Rv32NativeResult return_double(Rv32Cpu* cpu, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, 8);
+  cpu->x[11] = bits >> 32;
+  return return_value(cpu, (uint32_t)bits);
+}
+
+static void format_guest(const Rv32Cpu* cpu, size_t format_index, FILE* output) {
+  const char* format = (const char*)rv32_memory(arg(cpu, format_index), 1);
+  size_t next = format_index + 1;
+  for (const char* c = format; *c; c++) {
+    if (*c != '%') {
+      fputc(*c, output);
+      continue;
+    }
+    char spec[32] = "%";
+    size_t length = 1;
+    while (c[1] && strchr("-+ #0123456789.l", c[1]) && length < sizeof(spec) - 2) {
+      spec[length++] = *++c;
+    }
+    const char conversion = *++c;
+    if (!conversion) {
+      break;
+    }
+    spec[length] = '\0';
+    char plain[32];
+    size_t plain_length = 0;
+    for (size_t i = 0; i < length; i++) {
+      if (spec[i] != 'l') {
+        plain[plain_length++] = spec[i];
+      }
+    }
+    plain[plain_length++] = conversion;
+    plain[plain_length] = '\0';
+    switch (conversion) {
+      case 'd':
+      case 'i':
+        fprintf(output, plain, (int32_t)arg(cpu, next++));
+        break;
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'c':
+        fprintf(output, plain, arg(cpu, next++));
+        break;
+      case 'p':
+        fprintf(output, "0x%08x", arg(cpu, next++));
+        break;
+      case 's':
+        fprintf(output, plain, (const char*)rv32_memory(arg(cpu, next++), 1));
+        break;
+      case 'f':
+      case 'g':
+      case 'e':
+        next += next % 2;
+        fprintf(output, plain, arg_double(cpu, next));
+        next += 2;
+        break;
+      case '%':
+        fputc('%', output);
+        break;
+      default:
+        fprintf(output, "<%%%c>", conversion);
+    }
+  }
+}
+
+/* Heap, freed blocks are reused by exact size which is all the library needs */
+static uint32_t heap_alloc(uint32_t size) {
+  size = (size + 15) & ~15u;
+  for (size_t i = 0; i < g_free_count; i++) {
+    if (g_free_blocks[i].size == size) {
+      const uint32_t address = g_free_blocks[i].address;
+      g_free_blocks[i] = g_free_blocks[--g_free_count];
+      return address;
+    }
+  }
+  if (g_heap_next + 16 + size > g_heap_end) {
+    return 0;
+  }
+  rv32_store32(g_heap_next, size);
+  const uint32_t address = g_heap_next + 16;
+  g_heap_next += 16 + size;
+  return address;
+}
+
+static void heap_free(uint32_t address) {
+  if (!address) {
+    return;
+  }
+  if (g_free_count == g_free_capacity) {
+    g_free_capacity = g_free_capacity ? 2 * g_free_capacity : 64;
+    g_free_blocks = realloc(g_free_blocks, g_free_capacity * sizeof(Block));
+  }
+  g_free_blocks[g_free_count++] = (Block){address, rv32_load32(address - 16)};
+}
+
+/* Natives */
+static Rv32NativeResult native_addsf3(Rv32Cpu* cpu) {
+  return return_float(cpu, arg_float(cpu, 0) + arg_float(cpu, 1));
+}
+
+static Rv32NativeResult native_subsf3(Rv32Cpu* cpu) {
+  return return_float(cpu, arg_float(cpu, 0) - arg_float(cpu, 1));
+}
+
+static Rv32NativeResult native_mulsf3(Rv32Cpu* cpu) {
+  return return_float(cpu, arg_float(cpu, 0) * arg_float(cpu, 1));
+}
+
+static Rv32NativeResult native_divsf3(Rv32Cpu* cpu) {
+  return return_float(cpu, arg_float(cpu, 0) / arg_float(cpu, 1));
+}
+
+static Rv32NativeResult native_gtsf2(Rv32Cpu* cpu) {
+  const float a = arg_float(cpu, 0);
+  const float b = arg_float(cpu, 1);
+  return return_value(cpu, a > b ? 1 : a == b ? 0 : (uint32_t)-1);
+}
+
+static Rv32NativeResult native_ltsf2(Rv32Cpu* cpu) {
+  const float a = arg_float(cpu, 0);
+  const float b = arg_float(cpu, 1);
+  return return_value(cpu, a < b ? (uint32_t)-1 : a == b ? 0 : 1);
+}
+
+static Rv32NativeResult native_floatsisf(Rv32Cpu* cpu) {
+  return return_float(cpu, (float)(int32_t)arg(cpu, 0));
+}
+
+static Rv32NativeResult native_floatunsisf(Rv32Cpu* cpu) {
+  return return_float(cpu, (float)arg(cpu, 0));
+}
+
+static Rv32NativeResult native_extendsfdf2(Rv32Cpu* cpu) {
+  return return_double(cpu, arg_float(cpu, 0));
+}
+
+static Rv32NativeResult native_truncdfsf2(Rv32Cpu* cpu) {
+  return return_float(cpu, (float)arg_double(cpu, 0));
+}
+
+static Rv32NativeResult native_adddf3(Rv32Cpu* cpu) {
+  return return_double(cpu, arg_double(cpu, 0) + arg_double(cpu, 2));
+}
+
+static Rv32NativeResult native_subdf3(Rv32Cpu* cpu) {
+  return return_double(cpu, arg_double(cpu, 0) - arg_double(cpu, 2));
+}
+
+static Rv32NativeResult native_divdf3(Rv32Cpu* cpu) {
+  return return_double(cpu, arg_double(cpu, 0) / arg_double(cpu, 2));
+}
+
+static Rv32NativeResult native_gtdf2(Rv32Cpu* cpu) {
+  const double a = arg_double(cpu, 0);
+  const double b = arg_double(cpu, 2);
+  return return_value(cpu, a > b ? 1 : a == b ? 0 : (uint32_t)-1);
+}
+
+static Rv32NativeResult native_ltdf2(Rv32Cpu* cpu) {
+  const double a = arg_double(cpu, 0);
+  const double b = arg_double(cpu, 2);
+  return return_value(cpu, a < b ? (uint32_t)-1 : a == b ? 0 : 1);
+}
+
+static Rv32NativeResult native_fixdfsi(Rv32Cpu* cpu) {
+  const double value = arg_double(cpu, 0);
+  return return_value(cpu, isnan(value) ? 0 : value >= 2147483647.0 ? INT32_MAX : value <= -2147483648.0 ? (uint32_t)INT32_MIN : (uint32_t)(int32_t)value);
+}
+
+static Rv32NativeResult native_sqrtf(Rv32Cpu* cpu) {
+  return return_float(cpu, sqrtf(arg_float(cpu, 0)));
+}
+
+static Rv32NativeResult native_malloc(Rv32Cpu* cpu) {
+  return return_value(cpu, heap_alloc(arg(cpu, 0)));
+}
+
+static Rv32NativeResult native_heap_caps_malloc(Rv32Cpu* cpu) {
+  return return_value(cpu, heap_alloc(arg(cpu, 0)));
+}
+
+static Rv32NativeResult native_calloc(Rv32Cpu* cpu) {
+  const uint32_t size = arg(cpu, 0) * arg(cpu, 1);
+  const uint32_t address = heap_alloc(size);
+  if (address) {
+    memset(rv32_memory(address, size), 0, size);
+  }
+  return return_value(cpu, address);
+}
+
+static Rv32NativeResult native_free(Rv32Cpu* cpu) {
+  heap_free(arg(cpu, 0));
+  return RV32_NATIVE_RETURN;
+}
+
+static Rv32NativeResult native_memcpy(Rv32Cpu* cpu) {
+  const uint32_t size = arg(cpu, 2);
+  if (size) {
+    memmove(rv32_memory(arg(cpu, 0), size), rv32_memory(arg(cpu, 1), size), size);
+  }
+  return return_value(cpu, arg(cpu, 0));
+}
+
+static Rv32NativeResult native_memset(Rv32Cpu* cpu) {
+  const uint32_t size = arg(cpu, 2);
+  if (size) {
+    memset(rv32_memory(arg(cpu, 0), size), arg(cpu, 1), size);
+  }
+  return return_value(cpu, arg(cpu, 0));
+}
+
+static Rv32NativeResult native_memcmp(Rv32Cpu* cpu) {
+  const uint32_t size = arg(cpu, 2);
+  return return_value(cpu, size ? memcmp(rv32_memory(arg(cpu, 0), size), rv32_memory(arg(cpu, 1), size), size) : 0);
+}
+
+static Rv32NativeResult native_qsort(Rv32Cpu* cpu) {
+  // Insertion sort, stable and only ever used on short lists
+  const uint32_t base = arg(cpu, 0);
+  const uint32_t count = arg(cpu, 1);
+  const uint32_t size = arg(cpu, 2);
+  const uint32_t compare = arg(cpu, 3);
+  uint8_t item[64];
+  const uint32_t scratch = heap_alloc(size);
+  for (uint32_t i = 1; i < count; i++) {
+    memcpy(item, rv32_memory(base + i * size, size), size);
+    memcpy(rv32_memory(scratch, size), item, size);
+    uint32_t j = i;
+    while (j > 0) {
+      const uint32_t args[] = {base + (j - 1) * size, scratch};
+      if ((int32_t)rv32_call(cpu, compare, args, 2) <= 0) {
+        break;
+      }
+      memcpy(rv32_memory(base + j * size, size), rv32_memory(base + (j - 1) * size, size), size);
+      j--;
+    }
+    memcpy(rv32_memory(base + j * size, size), item, size);
+  }
+  heap_free(scratch);
+  return RV32_NATIVE_RETURN;
+}
+
+static Rv32NativeResult native_printf(Rv32Cpu* cpu) {
+  if (g_verbose > 1) {
+    format_guest(cpu, 0, stderr);
+  }
+  return return_value(cpu, 0);
+}
+
+static Rv32NativeResult native_puts(Rv32Cpu* cpu) {
+  if (g_verbose > 1) {
+    fprintf(stderr, "%s\n", (const char*)rv32_memory(arg(cpu, 0), 1));
+  }
+  return return_value(cpu, 0);
+}
+
+static Rv32NativeResult native_esp_log_write(Rv32Cpu* cpu) {
+  if (g_verbose > 1 || arg(cpu, 0) <= 2) {
+    format_guest(cpu, 2, stderr);
+  }
+  return RV32_NATIVE_RETURN;
+}
+
+static Rv32NativeResult native_esp_log_timestamp(Rv32Cpu* cpu) {
+  return return_value(cpu, (uint32_t)g_now_ms);
+}
+
+static Rv32NativeResult native_esp_get_free_heap_size(Rv32Cpu* cpu) {
+  return return_value(cpu, g_heap_end - g_heap_next);
+}
+
+static Rv32NativeResult native_esp_err_to_name(Rv32Cpu* cpu) {
+  static uint32_t name;
+  if (!name) {
+    name = heap_alloc(8);
+    memcpy(rv32_memory(name, 8), "ESP_ERR", 8);
+  }
+  return return_value(cpu, name);
+}
+
+static Rv32NativeResult native_esp_error_check_failed(Rv32Cpu* cpu) {
+  fprintf(stderr, "ESP_ERROR_CHECK failed: 0x%x at %s\n", arg(cpu, 0), (const char*)rv32_memory(arg(cpu, 4), 1));
+  exit(EXIT_FAILURE);
+}
+
+static Rv32NativeResult native_esp_ok(Rv32Cpu* cpu) {
+  return return_value(cpu, 0);
+}
+
+static Rv32NativeResult native_esp_wifi_set_csi_rx_cb(Rv32Cpu* cpu) {
+  g_csi_rx_cb = arg(cpu, 0);
+  g_csi_rx_ctx = arg(cpu, 1);
+  return return_value(cpu, 0);
+}
+
+static Rv32NativeResult native_xQueueGenericCreate(Rv32Cpu* cpu) {
+  if (g_queues_count == MAX_QUEUES) {
+    return return_value(cpu, 0);
+  }
+  Queue* queue = &g_queues[g_queues_count++];
+  queue->length = arg(cpu, 0);
+  queue->item_size = arg(cpu, 1);
+  queue->items = calloc(queue->length, queue->item_size ? queue->item_size : 1);
+  return return_value(cpu, g_queues_count);
+}
+
+static Rv32NativeResult native_xQueueGenericSend(Rv32Cpu* cpu) {
+  const uint32_t index = arg(cpu, 0) - 1;
+  Queue* queue = &g_queues[index];
+  const uint32_t position = arg(cpu, 3);
+  if (queue->count == queue->length && position != 2) {
+    if (arg(cpu, 2) == 0) {
+      return return_value(cpu, 0);
+    }
+    return block(cpu, WAIT_SEND, index, arg(cpu, 2), native_xQueueGenericSend);
+  }
+  uint32_t slot;
+  if (position == 2 && queue->count == queue->length) {
+    slot = (queue->head + queue->count - 1) % queue->length;
+  } else if (position == 1) {
+    queue->head = (queue->head + queue->length - 1) % queue->length;
+    slot = queue->head;
+    queue->count++;
+  } else {
+    slot = (queue->head + queue->count) % queue->length;
+    queue->count++;
+  }
+  memcpy(queue->items + slot * queue->item_size, rv32_memory(arg(cpu, 1), queue->item_size), queue->item_size);
+  return return_value(cpu, 1);
+}
+
+static Rv32NativeResult native_xQueueReceive(Rv32Cpu* cpu) {
+  const uint32_t index = arg(cpu, 0) - 1;
+  Queue* queue = &g_queues[index];
+  if (queue->count == 0) {
+    if (arg(cpu, 2) == 0) {
+      return return_value(cpu, 0);
+    }
+    return block(cpu, WAIT_RECEIVE, index, arg(cpu, 2), native_xQueueReceive);
+  }
+  memcpy(rv32_memory(arg(cpu, 1), queue->item_size), queue->items + queue->head * queue->item_size, queue->item_size);
+  queue->head = (queue->head + 1) % queue->length;
+  queue->count--;
+  return return_value(cpu, 1);
+}
+
+static Rv32NativeResult native_xTaskCreatePinnedToCore(Rv32Cpu* cpu) {
+  if (g_tasks_count == MAX_TASKS) {
+    return return_value(cpu, 0);
+  }
+  Task* task = &g_tasks[g_tasks_count++];
+  memset(task, 0, sizeof(*task));
+  task->alive = true;
+  task->priority = arg(cpu, 4);
+  task->cpu.pc = arg(cpu, 0);
+  task->cpu.x[10] = arg(cpu, 3);
+  task->cpu.x[1] = RV32_RETURN_TRAP;
+  task->cpu.x[2] = rv32_reserve(TASK_STACK_SIZE, 16) + TASK_STACK_SIZE;
+  if (arg(cpu, 5)) {
+    rv32_store32(arg(cpu, 5), g_tasks_count);
+  }
+  return return_value(cpu, 1);
+}
+
+static Rv32NativeResult native_vTaskDelay(Rv32Cpu* cpu) {
+  return block(cpu, WAIT_DELAY, 0, arg(cpu, 0), NULL);
+}
+
+static Rv32NativeResult native_vTaskDelete(Rv32Cpu* cpu) {
+  const uint32_t handle = arg(cpu, 0);
+  if (handle == 0 || &g_tasks[handle - 1] == g_current) {
+    return RV32_NATIVE_EXIT;
+  }
+  g_tasks[handle - 1].alive = false;
+  return RV32_NATIVE_RETURN;
+}
+
+static Rv32NativeResult native_xEventGroupCreate(Rv32Cpu* cpu) {
+  g_event_bits[g_event_groups_count] = 0;
+  return return_value(cpu, ++g_event_groups_count);
+}
+
+static Rv32NativeResult native_xEventGroupSetBits(Rv32Cpu* cpu) {
+  g_event_bits[arg(cpu, 0) - 1] |= arg(cpu, 1);
+  return return_value(cpu, g_event_bits[arg(cpu, 0) - 1]);
+}
+
+static Rv32NativeResult native_xEventGroupWaitBits(Rv32Cpu* cpu) {
+  const uint32_t index = arg(cpu, 0) - 1;
+  const uint32_t bits = arg(cpu, 1);
+  const uint32_t set = g_event_bits[index] & bits;
+  if ((arg(cpu, 3) ? set == bits : set != 0) || g_current->timed_out) {
+    g_current->timed_out = false;
+    const uint32_t value = g_event_bits[index];
+    if (arg(cpu, 2)) {
+      g_event_bits[index] &= ~bits;
+    }
+    return return_value(cpu, value);
+  }
+  g_current->wait_bits = bits;
+  g_current->wait_all = arg(cpu, 3);
+  return block(cpu, WAIT_BITS, index, arg(cpu, 4), native_xEventGroupWaitBits);
+}
+
+static Rv32NativeResult native_vEventGroupDelete(Rv32Cpu* cpu) {
+  (void)cpu;
+  return RV32_NATIVE_RETURN;
+}
+
+static void define_natives(void) {
+  rv32_define_native("__addsf3", native_addsf3);
+  rv32_define_native("__subsf3", native_subsf3);
+  rv32_define_native("__mulsf3", native_mulsf3);
+  rv32_define_native("__divsf3", native_divsf3);
+  rv32_define_native("__gtsf2", native_gtsf2);
+  rv32_define_native("__ltsf2", native_ltsf2);
+  rv32_define_native("__floatsisf", native_floatsisf);
+  rv32_define_native("__floatunsisf", native_floatunsisf);
+  rv32_define_native("__extendsfdf2", native_extendsfdf2);
+  rv32_define_native("__truncdfsf2", native_truncdfsf2);
+  rv32_define_native("__adddf3", native_adddf3);
+  rv32_define_native("__subdf3", native_subdf3);
+  rv32_define_native("__divdf3", native_divdf3);
+  rv32_define_native("__gtdf2", native_gtdf2);
+  rv32_define_native("__ltdf2", native_ltdf2);
+  rv32_define_native("__fixdfsi", native_fixdfsi);
+  rv32_define_native("sqrtf", native_sqrtf);
+  rv32_define_native("malloc", native_malloc);
+  rv32_define_native("heap_caps_malloc", native_heap_caps_malloc);
+  rv32_define_native("calloc", native_calloc);
+  rv32_define_native("free", native_free);
+  rv32_define_native("memcpy", native_memcpy);
+  rv32_define_native("memset", native_memset);
+  rv32_define_native("memcmp", native_memcmp);
+  rv32_define_native("qsort", native_qsort);
+  rv32_define_native("printf", native_printf);
+  rv32_define_native("puts", native_puts);
+  rv32_define_native("esp_log_write", native_esp_log_write);
+  rv32_define_native("esp_log_timestamp", native_esp_log_timestamp);
+  rv32_define_native("esp_get_free_heap_size", native_esp_get_free_heap_size);
+  rv32_define_native("esp_err_to_name", native_esp_err_to_name);
+  rv32_define_native("_esp_error_check_failed", native_esp_error_check_failed);
+  rv32_define_native("esp_wifi_set_csi", native_esp_ok);
+  rv32_define_native("esp_wifi_set_csi_config", native_esp_ok);
+  rv32_define_native("esp_wifi_set_promiscuous", native_esp_ok);
+  rv32_define_native("esp_wifi_set_csi_rx_cb", native_esp_wifi_set_csi_rx_cb);
+  rv32_define_native("xQueueGenericCreate", native_xQueueGenericCreate);
+  rv32_define_native("xQueueGenericSend", native_xQueueGenericSend);
+  rv32_define_native("xQueueReceive", native_xQueueReceive);
+  rv32_define_native("xTaskCreatePinnedToCore", native_xTaskCreatePinnedToCore);
+  rv32_define_native("vTaskDelay", native_vTaskDelay);
+  rv32_define_native("vTaskDelete", native_vTaskDelete);
+  rv32_define_native("xEventGroupCreate", native_xEventGroupCreate);
+  rv32_define_native("xEventGroupSetBits", native_xEventGroupSetBits);
+  rv32_define_native("xEventGroupWaitBits", native_xEventGroupWaitBits);
+  rv32_define_native("vEventGroupDelete", native_vEventGroupDelete);
+}
+
+static bool parse_interval(const char* text, uint32_t* start_ms, uint32_t* stop_ms) {
+  char* end;
+  *start_ms = strtoul(text, &end, 10);
+  if (end == text || *end != ':') {
+    return false;
+  }
+  const char* stop = end + 1;
+  *stop_ms = strtoul(stop, &end, 10);
+  return end != stop && *end == '\0' && *stop_ms >= *start_ms;
+}
+
+static size_t parse_hex(const char* hex, uint8_t* bytes, size_t max_size) {
+  const size_t length = strlen(hex);
+  if (length % 2 != 0 || length / 2 > max_size) {
+    return 0;
+  }
+  for (size_t i = 0; i < length / 2; i++) {
+    if (!isxdigit((unsigned char)hex[2 * i]) || !isxdigit((unsigned char)hex[2 * i + 1])) {
+      return 0;
+    }
+    const char byte_hex[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+    bytes[i] = strtoul(byte_hex, NULL, 16);
+  }
+  return length / 2;
+}
@@ -0,0 +1,734 @@
+#include "rv32.h"
+
+#include <ar.h>
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* PRIVATE CONSTANTS */
+#define LOAD_BASE        0x00010000u
+#define MAX_OBJECTS      8
+#define MAX_SYMBOLS      4096
+#define CALL_STACK_SLACK 256
+
+#ifndef R_RISCV_CALL_PLT
+#define R_RISCV_CALL_PLT 19
+#endif
+
+/* PRIVATE TYPES */
+typedef struct {
+  char name[256];
+  uint8_t* image;
+  size_t size;
+  Elf32_Ehdr* header;
+  Elf32_Shdr* sections;
+  uint32_t* addresses;  // Per section, 0 if not loaded
+  Elf32_Sym* symbols;
+  size_t symbols_count;
+  const char* names;
+} Object;
+
+typedef struct {
+  const char* name;
+  uint32_t address;
+} Symbol;
+
+typedef struct {
+  const char* name;
+  Rv32Native native;
+} Trap;
+
+/* GLOBAL VARIABLES */
+static uint8_t* g_memory;
+static uint32_t g_reserved = LOAD_BASE;
+static Object g_objects[MAX_OBJECTS];
+static size_t g_objects_count;
+static Symbol g_symbols[MAX_SYMBOLS];
+static size_t g_symbols_count;
+static Trap g_traps[RV32_TRAP_COUNT];
+static size_t g_traps_count = 1;  // The first one is the return trap
+
+/* PRIVATE PROTOTYPES */
+static void fail(const char* format, const char* detail, uint32_t value);
+static void load_object(const char* name, uint8_t* image, size_t size);
+static uint32_t add_trap(const char* name, Rv32Native native);
+static Rv32NativeResult undefined_native(Rv32Cpu* cpu);
+static uint32_t resolve(Object* object, uint32_t index);
+static uint32_t find_pcrel_hi(Object* object, const Elf32_Shdr* relocations, uint32_t address);
+static void relocate(Object* object, const Elf32_Shdr* relocations);
+static uint16_t load16(uint32_t address);
+static void step(Rv32Cpu* cpu);
+static void step_compressed(Rv32Cpu* cpu, uint32_t instruction);
+static int32_t sign_extend(uint32_t value, int bits);
+
+/* FUNCTIONS */
+uint8_t* rv32_memory(uint32_t address, uint32_t size) {
+  if (!g_memory) {
+    g_memory = calloc(1, RV32_MEMORY_SIZE);
+  }
+  if (address < 0x100 || address >= RV32_MEMORY_SIZE || size > RV32_MEMORY_SIZE - address) {
+    fail("Access out of memory: %s0x%08x\n", "", address);
+  }
+  return g_memory + address;
+}
+
+uint32_t rv32_load32(uint32_t address) {
+  uint32_t value;
+  memcpy(&value, rv32_memory(address, 4), 4);
+  return value;
+}
+
+void rv32_store32(uint32_t address, uint32_t value) {
+  memcpy(rv32_memory(address, 4), &value, 4);
+}
+
+void rv32_define_native(const char* name, Rv32Native native) {
+  if (g_symbols_count == MAX_SYMBOLS) {
+    fail("Too many symbols: %s\n", name, 0);
+  }
+  g_symbols[g_symbols_count++] = (Symbol){name, add_trap(name, native)};
+}
+
+uint32_t rv32_native_address(Rv32Native native) {
+  for (size_t i = 1; i < g_traps_count; i++) {
+    if (g_traps[i].native == native) {
+      return RV32_TRAP_BASE + 4 * i;
+    }
+  }
+  return add_trap("native", native);
+}
+
+uint32_t rv32_reserve(uint32_t size, uint32_t alignment) {
+  alignment = alignment ? alignment : 1;
+  const uint32_t address = (g_reserved + alignment - 1) / alignment * alignment;
+  if (address + size > RV32_TRAP_BASE) {
+    fail("Out of reserved memory%s at 0x%08x\n", "", address);
+  }
+  g_reserved = address + size;
+  memset(rv32_memory(address, size ? size : 1), 0, size);
+  return address;
+}
+
+void rv32_load_archive(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    fail("Can't open %s\n", path, 0);
+  }
+  char magic[SARMAG];
+  if (fread(magic, 1, SARMAG, file) != SARMAG || memcmp(magic, ARMAG, SARMAG) != 0) {
+    fail("Not an archive: %s\n", path, 0);
+  }
+  struct ar_hdr header;
+  while (fread(&header, 1, sizeof(header), file) == sizeof(header)) {
+    char name[sizeof(header.ar_name) + 1] = {0};
+    memcpy(name, header.ar_name, sizeof(header.ar_name));
+    name[strcspn(name, "/ ")] = '\0';
+    char size_text[sizeof(header.ar_size) + 1] = {0};
+    memcpy(size_text, header.ar_size, sizeof(header.ar_size));
+    const size_t size = strtoul(size_text, NULL, 10);
+    uint8_t* image = malloc(size ? size : 1);
+    if (fread(image, 1, size, file) != size) {
+      fail("Can't read %s\n", path, 0);
+    }
+    // Members are 2-byte aligned, the symbol index and long names aren't objects
+    if (size % 2 != 0) {
+      fgetc(file);
+    }
+    if (name[0] != '\0' && size >= SELFMAG && memcmp(image, ELFMAG, SELFMAG) == 0) {
+      load_object(name, image, size);
+    } else {
+      free(image);
+    }
+  }
+  fclose(file);
+}
+
+static void load_object(const char* name, uint8_t* image, size_t size) {
+  if (g_objects_count == MAX_OBJECTS) {
+    fail("Too many objects: %s\n", name, 0);
+  }
+  Object* object = &g_objects[g_objects_count++];
+  snprintf(object->name, sizeof(object->name), "%s", name);
+  object->image = image;
+  object->size = size;
+
+  object->header = (Elf32_Ehdr*)object->image;
+  if (object->header->e_machine != EM_RISCV ||
+      object->header->e_type != ET_REL) {
+    fail("Not a RISC-V object: %s\n", name, 0);
+  }
+  object->sections = (Elf32_Shdr*)(object->image + object->header->e_shoff);
+  object->addresses = calloc(object->header->e_shnum, sizeof(uint32_t));
+  for (size_t i = 0; i < object->header->e_shnum; i++) {
+    const Elf32_Shdr* section = &object->sections[i];
+    if (section->sh_type == SHT_SYMTAB) {
+      object->symbols = (Elf32_Sym*)(object->image + section->sh_offset);
+      object->symbols_count = section->sh_size / sizeof(Elf32_Sym);
+      object->names = (const char*)object->image + object->sections[section->sh_link].sh_offset;
+    }
+    if (!(section->sh_flags & SHF_ALLOC) || section->sh_size == 0) {
+      continue;
+    }
+    object->addresses[i] = rv32_reserve(section->sh_size, section->sh_addralign);
+    if (section->sh_type != SHT_NOBITS) {
+      memcpy(rv32_memory(object->addresses[i], section->sh_size), object->image + section->sh_offset, section->sh_size);
+    }
+  }
+
+  for (size_t i = 1; i < object->symbols_count; i++) {
+    const Elf32_Sym* symbol = &object->symbols[i];
+    if (ELF32_ST_BIND(symbol->st_info) != STB_GLOBAL || symbol->st_shndx == SHN_UNDEF) {
+      continue;
+    }
+    uint32_t address;
+    if (symbol->st_shndx == SHN_COMMON) {
+      address = rv32_reserve(symbol->st_size, symbol->st_value);
+    } else if (symbol->st_shndx == SHN_ABS) {
+      address = symbol->st_value;
+    } else {
+      address = object->addresses[symbol->st_shndx] + symbol->st_value;
+    }
+    if (g_symbols_count == MAX_SYMBOLS) {
+      fail("Too many symbols in %s\n", object->name, 0);
+    }
+    g_symbols[g_symbols_count++] = (Symbol){object->names + symbol->st_name, address};
+  }
+}
+
+void rv32_link(void) {
+  for (size_t i = 0; i < g_objects_count; i++) {
+    Object* object = &g_objects[i];
+    for (size_t j = 0; j < object->header->e_shnum; j++) {
+      const Elf32_Shdr* section = &object->sections[j];
+      if (section->sh_type == SHT_RELA && object->addresses[section->sh_info]) {
+        relocate(object, section);
+      }
+    }
+  }
+}
+
+uint32_t rv32_symbol(const char* name) {
+  for (size_t i = 0; i < g_symbols_count; i++) {
+    if (strcmp(g_symbols[i].name, name) == 0) {
+      return g_symbols[i].address;
+    }
+  }
+  fail("Undefined symbol %s\n", name, 0);
+  return 0;
+}
+
+Rv32RunResult rv32_run(Rv32Cpu* cpu) {
+  for (;;) {
+    if (cpu->pc >= RV32_TRAP_BASE && cpu->pc < RV32_TRAP_BASE + 4 * RV32_TRAP_COUNT) {
+      const uint32_t index = (cpu->pc - RV32_TRAP_BASE) / 4;
+      if (index == 0) {
+        return RV32_RUN_RETURNED;
+      }
+      switch (g_traps[index].native(cpu)) {
+        case RV32_NATIVE_RETURN:
+          cpu->pc = cpu->x[1];
+          break;
+        case RV32_NATIVE_BLOCK:
+          return RV32_RUN_BLOCKED;
+        case RV32_NATIVE_EXIT:
+          return RV32_RUN_EXITED;
+      }
+      continue;
+    }
+    step(cpu);
+  }
+}
+
+uint32_t rv32_call(const Rv32Cpu* cpu, uint32_t function, const uint32_t* args, size_t args_count) {
+  Rv32Cpu call = {0};
+  call.x[2] = ((cpu ? cpu->x[2] : RV32_TRAP_BASE) - CALL_STACK_SLACK) & ~15u;
+  call.x[1] = RV32_RETURN_TRAP;
+  for (size_t i = 0; i < args_count && i < 8; i++) {
+    call.x[10 + i] = args[i];
+  }
+  call.pc = function;
+  if (rv32_run(&call) != RV32_RUN_RETURNED) {
+    fail("Nested call to 0x%s%08x blocked\n", "", function);
+  }
+  return call.x[10];
+}
+
+static void fail(const char* format, const char* detail, uint32_t value) {
+  if (strstr(format, "%08x")) {
+    fprintf(stderr, format, detail, value);
+  } else {
+    fprintf(stderr, format, detail);
+  }
+  exit(EXIT_FAILURE);
+}
+
+static uint32_t add_trap(const char* name, Rv32Native native) {
+  if (g_traps_count == RV32_TRAP_COUNT) {
+    fail("Too many natives: %s\n", name, 0);
+  }
+  g_traps[g_traps_count] = (Trap){name, native};
+  return RV32_TRAP_BASE + 4 * g_traps_count++;
+}
+
+static Rv32NativeResult undefined_native(Rv32Cpu* cpu) {
+  const uint32_t index = (cpu->pc - RV32_TRAP_BASE) / 4;
+  fail("Called undefined %s from 0x%08x\n", g_traps[index].name, cpu->x[1]);
+  return RV32_NATIVE_EXIT;
+}
+
+static uint32_t resolve(Object* object, uint32_t index) {
+  const Elf32_Sym* symbol = &object->symbols[index];
+  const char* name = object->names + symbol->st_name;
+  if (symbol->st_shndx == SHN_UNDEF) {
+    for (size_t i = 0; i < g_symbols_count; i++) {
+      if (strcmp(g_symbols[i].name, name) == 0) {
+        return g_symbols[i].address;
+      }
+    }
+    const uint32_t address = add_trap(name, undefined_native);
+    g_symbols[g_symbols_count++] = (Symbol){name, address};
+    return address;
+  }
+  if (symbol->st_shndx == SHN_ABS) {
+    return symbol->st_value;
+  }
+  if (symbol->st_shndx == SHN_COMMON || ELF32_ST_BIND(symbol->st_info) == STB_GLOBAL) {
+    return rv32_symbol(name);
+  }
+  return object->addresses[symbol->st_shndx] + symbol->st_value;
+}
+
+static uint32_t find_pcrel_hi(Object* object, const Elf32_Shdr* relocations, uint32_t address) {
+  const Elf32_Rela* entries = (const Elf32_Rela*)(object->image + relocations->sh_offset);
+  const uint32_t base = object->addresses[relocations->sh_info];
+  for (size_t i = 0; i < relocations->sh_size / sizeof(Elf32_Rela); i++) {
+    if (ELF32_R_TYPE(entries[i].r_info) == R_RISCV_PCREL_HI20 && base + entries[i].r_offset == address) {
+      return resolve(object, ELF32_R_SYM(entries[i].r_info)) + entries[i].r_addend - address;
+    }
+  }
+  fail("No PCREL_HI20 in %s at 0x%08x\n", object->name, address);
+  return 0;
+}
+
+static void relocate(Object* object, const Elf32_Shdr* relocations) {
+  const Elf32_Rela* entries = (const Elf32_Rela*)(object->image + relocations->sh_offset);
+  const uint32_t base = object->addresses[relocations->sh_info];
+  for (size_t i = 0; i < relocations->sh_size / sizeof(Elf32_Rela); i++) {
+    const uint32_t type = ELF32_R_TYPE(entries[i].r_info);
+    const uint32_t place = base + entries[i].r_offset;
+    if (type == R_RISCV_RELAX || type == R_RISCV_ALIGN || type == R_RISCV_NONE) {
+      continue;
+    }
+    const uint32_t value = resolve(object, ELF32_R_SYM(entries[i].r_info)) + entries[i].r_addend;
+    const uint32_t offset = value - place;
+    uint32_t instruction = type == R_RISCV_RVC_BRANCH || type == R_RISCV_RVC_JUMP ? load16(place) : rv32_load32(place);
+    uint32_t hi;
+    uint32_t lo;
+    switch (type) {
+      case R_RISCV_32:
+        instruction = value;
+        break;
+      case R_RISCV_BRANCH:
+        instruction = (instruction & 0x01fff07fu) | ((offset >> 12 & 1) << 31) | ((offset >> 5 & 0x3f) << 25) |
+                      ((offset >> 1 & 0xf) << 8) | ((offset >> 11 & 1) << 7);
+        break;
+      case R_RISCV_JAL:
+        instruction = (instruction & 0xfffu) | ((offset >> 20 & 1) << 31) | ((offset >> 1 & 0x3ff) << 21) |
+                      ((offset >> 11 & 1) << 20) | ((offset >> 12 & 0xff) << 12);
+        break;
+      case R_RISCV_CALL:
+      case R_RISCV_CALL_PLT:
+        hi = (offset + 0x800) & 0xfffff000u;
+        lo = offset - hi;
+        rv32_store32(place, (instruction & 0xfffu) | hi);
+        rv32_store32(place + 4, (rv32_load32(place + 4) & 0xfffffu) | (lo << 20));
+        continue;
+      case R_RISCV_PCREL_HI20:
+        instruction = (instruction & 0xfffu) | ((offset + 0x800) & 0xfffff000u);
+        break;
+      case R_RISCV_PCREL_LO12_I:
+      case R_RISCV_PCREL_LO12_S:
+        hi = find_pcrel_hi(object, relocations, value);
+        lo = hi - ((hi + 0x800) & 0xfffff000u);
+        instruction = type == R_RISCV_PCREL_LO12_I
+                          ? (instruction & 0xfffffu) | (lo << 20)
+                          : (instruction & 0x01fff07fu) | ((lo >> 5 & 0x7f) << 25) | ((lo & 0x1f) << 7);
+        break;
+      case R_RISCV_HI20:
+        instruction = (instruction & 0xfffu) | ((value + 0x800) & 0xfffff000u);
+        break;
+      case R_RISCV_LO12_I:
+        lo = value - ((value + 0x800) & 0xfffff000u);
+        instruction = (instruction & 0xfffffu) | (lo << 20);
+        break;
+      case R_RISCV_LO12_S:
+        lo = value - ((value + 0x800) & 0xfffff000u);
+        instruction = (instruction & 0x01fff07fu) | ((lo >> 5 & 0x7f) << 25) | ((lo & 0x1f) << 7);
+        break;
+      case R_RISCV_RVC_BRANCH:
+        instruction = (instruction & 0xe383u) | ((offset >> 8 & 1) << 12) | ((offset >> 3 & 3) << 10) |
+                      ((offset >> 6 & 3) << 5) | ((offset >> 1 & 3) << 3) | ((offset >> 5 & 1) << 2);
+        memcpy(rv32_memory(place, 2), &(uint16_t){instruction}, 2);
+        continue;
+      case R_RISCV_RVC_JUMP:
+        instruction = (instruction & 0xe003u) | ((offset >> 11 & 1) << 12) | ((offset >> 4 & 1) << 11) |
+                      ((offset >> 8 & 3) << 9) | ((offset >> 10 & 1) << 8) | ((offset >> 6 & 1) << 7) |
+                      ((offset >> 7 & 1) << 6) | ((offset >> 1 & 7) << 3) | ((offset >> 5 & 1) << 2);
+        memcpy(rv32_memory(place, 2), &(uint16_t){instruction}, 2);
+        continue;
+      default:
+        fprintf(stderr, "Relocation type %u ", type);
+        fail("unsupported in %s at 0x%08x\n", object->name, place);
+    }
+    rv32_store32(place, instruction);
+  }
+}
+
+static uint16_t load16(uint32_t address) {
+  uint16_t value;
+  memcpy(&value, rv32_memory(address, 2), 2);
+  return value;
+}
+
+static int32_t sign_extend(uint32_t value, int bits) {
+  return (int32_t)(value << (32 - bits)) >> (32 - bits);
+}
+
+static void step(Rv32Cpu* cpu) {
+  uint32_t* x = cpu->x;
+  const uint32_t pc = cpu->pc;
+  const uint32_t low = load16(pc);
+  if ((low & 3) != 3) {
+    step_compressed(cpu, low);
+    x[0] = 0;
+    return;
+  }
+  const uint32_t instruction = low | (uint32_t)load16(pc + 2) << 16;
+  const uint32_t opcode = instruction & 0x7f;
+  const uint32_t rd = instruction >> 7 & 31;
+  const uint32_t funct3 = instruction >> 12 & 7;
+  const uint32_t rs1 = instruction >> 15 & 31;
+  const uint32_t rs2 = instruction >> 20 & 31;
+  const uint32_t funct7 = instruction >> 25;
+  const int32_t imm_i = (int32_t)instruction >> 20;
+  const int32_t imm_s = ((int32_t)instruction >> 25 << 5) | (int32_t)rd;
+  const uint32_t a = x[rs1];
+  const uint32_t b = x[rs2];
+  uint32_t next = pc + 4;
+  uint32_t address;
+
+  switch (opcode) {
+    case 0x37:
+      x[rd] = instruction & 0xfffff000u;
+      break;
+    case 0x17:
+      x[rd] = pc + (instruction & 0xfffff000u);
+      break;
+    case 0x6f:
+      x[rd] = next;
+      next = pc + sign_extend(((instruction >> 31 & 1) << 20) | ((instruction >> 21 & 0x3ff) << 1) |
+                                  ((instruction >> 20 & 1) << 11) | ((instruction >> 12 & 0xff) << 12),
+                              21);
+      break;
+    case 0x67:
+      x[rd] = next;
+      next = (a + imm_i) & ~1u;
+      break;
+    case 0x63: {
+      const int32_t offset = sign_extend(((instruction >> 31 & 1) << 12) | ((instruction >> 7 & 1) << 11) |
+                                             ((instruction >> 25 & 0x3f) << 5) | ((instruction >> 8 & 0xf) << 1),
+                                         13);
+      bool taken;
+      switch (funct3) {
+        case 0:
+          taken = a == b;
+          break;
+        case 1:
+          taken = a != b;
+          break;
+        case 4:
+          taken = (int32_t)a < (int32_t)b;
+          break;
+        case 5:
+          taken = (int32_t)a >= (int32_t)b;
+          break;
+        case 6:
+          taken = a < b;
+          break;
+        case 7:
+          taken = a >= b;
+          break;
+        default:
+          fail("Bad branch%s at 0x%08x\n", "", pc);
+          return;
+      }
+      if (taken) {
+        next = pc + offset;
+      }
+      break;
+    }
+    case 0x03:
+      address = a + imm_i;
+      switch (funct3) {
+        case 0:
+          x[rd] = (int8_t)*rv32_memory(address, 1);
+          break;
+        case 1:
+          x[rd] = (int16_t)load16(address);
+          break;
+        case 2:
+          x[rd] = rv32_load32(address);
+          break;
+        case 4:
+          x[rd] = *rv32_memory(address, 1);
+          break;
+        case 5:
+          x[rd] = load16(address);
+          break;
+        default:
+          fail("Bad load%s at 0x%08x\n", "", pc);
+      }
+      break;
+    case 0x23:
+      address = a + imm_s;
+      switch (funct3) {
+        case 0:
+          *rv32_memory(address, 1) = b;
+          break;
+        case 1:
+          memcpy(rv32_memory(address, 2), &(uint16_t){b}, 2);
+          break;
+        case 2:
+          rv32_store32(address, b);
+          break;
+        default:
+          fail("Bad store%s at 0x%08x\n", "", pc);
+      }
+      break;
+    case 0x13:
+      switch (funct3) {
+        case 0:
+          x[rd] = a + imm_i;
+          break;
+        case 1:
+          x[rd] = a << (imm_i & 31);
+          break;
+        case 2:
+          x[rd] = (int32_t)a < imm_i;
+          break;
+        case 3:
+          x[rd] = a < (uint32_t)imm_i;
+          break;
+        case 4:
+          x[rd] = a ^ imm_i;
+          break;
+        case 5:
+          x[rd] = funct7 & 0x20 ? (uint32_t)((int32_t)a >> (imm_i & 31)) : a >> (imm_i & 31);
+          break;
+        case 6:
+          x[rd] = a | imm_i;
+          break;
+        case 7:
+          x[rd] = a & imm_i;
+          break;
+      }
+      break;
+    case 0x33:
+      if (funct7 == 1) {
+        switch (funct3) {
+          case 0:
+            x[rd] = a * b;
+            break;
+          case 1:
+            x[rd] = (uint64_t)((int64_t)(int32_t)a * (int32_t)b) >> 32;
+            break;
+          case 2:
+            x[rd] = (uint64_t)((int64_t)(int32_t)a * (uint64_t)b) >> 32;
+            break;
+          case 3:
+            x[rd] = ((uint64_t)a * b) >> 32;
+            break;
+          case 4:
+            x[rd] = b == 0 ? UINT32_MAX : (a == 0x80000000u && b == UINT32_MAX) ? a : (uint32_t)((int32_t)a / (int32_t)b);
+            break;
+          case 5:
+            x[rd] = b == 0 ? UINT32_MAX : a / b;
+            break;
+          case 6:
+            x[rd] = b == 0 ? a : (a == 0x80000000u && b == UINT32_MAX) ? 0 : (uint32_t)((int32_t)a % (int32_t)b);
+            break;
+          case 7:
+            x[rd] = b == 0 ? a : a % b;
+            break;
+        }
+        break;
+      }
+      switch (funct3) {
+        case 0:
+          x[rd] = funct7 & 0x20 ? a - b : a + b;
+          break;
+        case 1:
+          x[rd] = a << (b & 31);
+          break;
+        case 2:
+          x[rd] = (int32_t)a < (int32_t)b;
+          break;
+        case 3:
+          x[rd] = a < b;
+          break;
+        case 4:
+          x[rd] = a ^ b;
+          break;
+        case 5:
+          x[rd] = funct7 & 0x20 ? (uint32_t)((int32_t)a >> (b & 31)) : a >> (b & 31);
+          break;
+        case 6:
+          x[rd] = a | b;
+          break;
+        case 7:
+          x[rd] = a & b;
+          break;
+      }
+      break;
+    case 0x0f:
+      break;
+    default:
+      fail("Unsupported instruction%s at 0x%08x\n", "", pc);
+  }
+  x[0] = 0;
+  cpu->pc = next;
+}
+
+static void step_compressed(Rv32Cpu* cpu, uint32_t instruction) {
+  uint32_t* x = cpu->x;
+  const uint32_t pc = cpu->pc;
+  const uint32_t funct3 = instruction >> 13;
+  const uint32_t rd = instruction >> 7 & 31;
+  const uint32_t rs2 = instruction >> 2 & 31;
+  const uint32_t rd_short = 8 + (instruction >> 7 & 7);
+  const uint32_t rs2_short = 8 + (instruction >> 2 & 7);
+  const int32_t imm6 = sign_extend(((instruction >> 12 & 1) << 5) | (instruction >> 2 & 31), 6);
+  const uint32_t word_offset = ((instruction >> 10 & 7) << 3) | ((instruction >> 6 & 1) << 2) | ((instruction >> 5 & 1) << 6);
+  const int32_t jump_offset =
+      sign_extend(((instruction >> 12 & 1) << 11) | ((instruction >> 11 & 1) << 4) | ((instruction >> 9 & 3) << 8) |
+                      ((instruction >> 8 & 1) << 10) | ((instruction >> 7 & 1) << 6) | ((instruction >> 6 & 1) << 7) |
+                      ((instruction >> 3 & 7) << 1) | ((instruction >> 2 & 1) << 5),
+                  12);
+  const int32_t branch_offset =
+      sign_extend(((instruction >> 12 & 1) << 8) | ((instruction >> 10 & 3) << 3) | ((instruction >> 5 & 3) << 6) |
+                      ((instruction >> 3 & 3) << 1) | ((instruction >> 2 & 1) << 5),
+                  9);
+  uint32_t next = pc + 2;
+
+  switch ((instruction & 3) << 3 | funct3) {
+    case 0x00:  // c.addi4spn
+      if (instruction == 0) {
+        fail("Illegal instruction%s at 0x%08x\n", "", pc);
+      }
+      x[rs2_short] = x[2] + (((instruction >> 11 & 3) << 4) | ((instruction >> 7 & 15) << 6) |
+                             ((instruction >> 6 & 1) << 2) | ((instruction >> 5 & 1) << 3));
+      break;
+    case 0x02:  // c.lw
+      x[rs2_short] = rv32_load32(x[rd_short] + word_offset);
+      break;
+    case 0x06:  // c.sw
+      rv32_store32(x[rd_short] + word_offset, x[rs2_short]);
+      break;
+    case 0x08:  // c.addi
+      x[rd] += imm6;
+      break;
+    case 0x09:  // c.jal
+      x[1] = next;
+      next = pc + jump_offset;
+      break;
+    case 0x0a:  // c.li
+      x[rd] = imm6;
+      break;
+    case 0x0b:
+      if (rd == 2) {  // c.addi16sp
+        x[2] += sign_extend(((instruction >> 12 & 1) << 9) | ((instruction >> 6 & 1) << 4) |
+                                ((instruction >> 5 & 1) << 6) | ((instruction >> 3 & 3) << 7) |
+                                ((instruction >> 2 & 1) << 5),
+                            10);
+      } else {  // c.lui
+        x[rd] = (uint32_t)imm6 << 12;
+      }
+      break;
+    case 0x0c: {
+      const uint32_t shift = ((instruction >> 12 & 1) << 5) | (instruction >> 2 & 31);
+      switch (instruction >> 10 & 3) {
+        case 0:
+          x[rd_short] >>= shift;
+          break;
+        case 1:
+          x[rd_short] = (int32_t)x[rd_short] >> shift;
+          break;
+        case 2:
+          x[rd_short] &= imm6;
+          break;
+        case 3:
+          switch (instruction >> 5 & 3) {
+            case 0:
+              x[rd_short] -= x[rs2_short];
+              break;
+            case 1:
+              x[rd_short] ^= x[rs2_short];
+              break;
+            case 2:
+              x[rd_short] |= x[rs2_short];
+              break;
+            case 3:
+              x[rd_short] &= x[rs2_short];
+              break;
+          }
+          break;
+      }
+      break;
+    }
+    case 0x0d:  // c.j
+      next = pc + jump_offset;
+      break;
+    case 0x0e:  // c.beqz
+      if (x[rd_short] == 0) {
+        next = pc + branch_offset;
+      }
+      break;
+    case 0x0f:  // c.bnez
+      if (x[rd_short] != 0) {
+        next = pc + branch_offset;
+      }
+      break;
+    case 0x10:  // c.slli
+      x[rd] <<= ((instruction >> 12 & 1) << 5) | rs2;
+      break;
+    case 0x12:  // c.lwsp
+      x[rd] = rv32_load32(x[2] + (((instruction >> 12 & 1) << 5) | ((instruction >> 4 & 7) << 2) |
+                                  ((instruction >> 2 & 3) << 6)));
+      break;
+    case 0x14:
+      if (!(instruction >> 12 & 1)) {
+        if (rs2 == 0) {  // c.jr
+          next = x[rd];
+        } else {  // c.mv
+          x[rd] = x[rs2];
+        }
+      } else if (rs2 == 0) {
+        if (rd == 0) {
+          fail("ebreak%s at 0x%08x\n", "", pc);
+        }
+        const uint32_t target = x[rd];  // c.jalr
+        x[1] = next;
+        next = target;
+      } else {  // c.add
+        x[rd] += x[rs2];
+      }
+      break;
+    case 0x16:  // c.swsp
+      rv32_store32(x[2] + (((instruction >> 9 & 15) << 2) | ((instruction >> 7 & 3) << 6)), x[rs2]);
+      break;
+    default:
+      fail("Unsupported compressed instruction%s at 0x%08x\n", "", pc);
+  }
+  cpu->pc = next;
+}
@@ -0,0 +1,57 @@
+#ifndef RV32_H
+#define RV32_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A small RV32IMC interpreter that loads relocatable objects, enough to run
+ * the esp-csi archive on the host. Calls to undefined symbols land on trap
+ * addresses that are served by native functions. */
+
+/* PUBLIC CONSTANTS */
+#define RV32_MEMORY_SIZE 0x04000000u
+#define RV32_TRAP_BASE   0x03f00000u
+#define RV32_TRAP_COUNT  0x1000u
+#define RV32_RETURN_TRAP RV32_TRAP_BASE
+
+/* PUBLIC TYPES */
+typedef struct {
+  uint32_t x[32];
+  uint32_t pc;
+} Rv32Cpu;
+
+typedef enum {
+  RV32_NATIVE_RETURN,  // Continue at ra
+  RV32_NATIVE_BLOCK,   // Leave the pc on the trap and stop, the call is retried on resume
+  RV32_NATIVE_EXIT,    // Stop for good
+} Rv32NativeResult;
+
+typedef enum {
+  RV32_RUN_RETURNED,
+  RV32_RUN_BLOCKED,
+  RV32_RUN_EXITED,
+} Rv32RunResult;
+
+typedef Rv32NativeResult (*Rv32Native)(Rv32Cpu* cpu);
+
+/* PUBLIC PROTOTYPES */
+uint8_t* rv32_memory(uint32_t address, uint32_t size);
+uint32_t rv32_load32(uint32_t address);
+void rv32_store32(uint32_t address, uint32_t value);
+
+void rv32_define_native(const char* name, Rv32Native native);
+/* Returns a trap address that runs native when called */
+uint32_t rv32_native_address(Rv32Native native);
+/* Allocates zeroed memory that is never freed, for sections and stacks */
+uint32_t rv32_reserve(uint32_t size, uint32_t alignment);
+/* Loads and relocates the objects of an ar archive, symbols resolve across all loaded objects */
+void rv32_load_archive(const char* path);
+void rv32_link(void);
+uint32_t rv32_symbol(const char* name);
+
+Rv32RunResult rv32_run(Rv32Cpu* cpu);
+/* Runs function until it returns, on a stack below the stack pointer of cpu */
+uint32_t rv32_call(const Rv32Cpu* cpu, uint32_t function, const uint32_t* args, size_t args_count);
+
+#endif
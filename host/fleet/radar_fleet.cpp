@@ -0,0 +1,506 @@
+#include "mqtt_wire.h"
+#include "work_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <dlfcn.h>
+#include <fstream>
+#include <getopt.h>
+#include <host_clock.h>
+#include <host_device.h>
+#include <iterator>
+#include <mqtt_frame.h>
+#include <mqtt_handler.h>
+#include <numeric>
+#include <proj_conf.h>
+#include <radar_trace.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <trace_pacer.h>
+#include <unistd.h>
+#include <vector>
+#include <wifi_radar.h>
+
+/* Simulates a fleet of radar devices, each running the firmware detection
+ * pipeline and MQTT handler unmodified on the host shims, and reports what
+ * the fleet publishes.
+ *
+ * The firmware keeps its state in globals, so every device is its own copy of
+ * the radar-device module, loaded from a temporary file. All devices
+ * share one virtual clock that moves in epochs: each epoch, a work-stealing
+ * pool moves every device to the end of the epoch, feeding it its samples on
+ * the way. A device only runs on one worker per epoch, so its publishes stay
+ * in order without locks. Devices replay the same trace from staggered
+ * offsets, looping, or a synthetic one of empty and occupied periods.
+ *
+ * Every report interval a CSV row of the publish rates and room status goes
+ * to stdout, and at the end a summary goes to stderr. It holds two latencies:
+ * in virtual time, from an occupancy change of a labeled trace to the status
+ * publish of the device that follows it, and in wall time, from feeding a
+ * sample to each publish it causes. With -p the publishes are
+ * also sent to one subscriber, like radar_broker_sim does, so
+ * radar_aggregator can follow the fleet. */
+
+/* PRIVATE CONSTANTS */
+#ifndef RADAR_DEVICE_MODULE
+#define RADAR_DEVICE_MODULE "radar-device.so"
+#endif
+
+constexpr uint32_t DEFAULT_DEVICES = 100;
+constexpr double DEFAULT_DURATION_S = 60;
+constexpr uint32_t DEFAULT_EPOCH_MS = 100;
+constexpr double DEFAULT_REPORT_S = 10;
+constexpr float DEFAULT_THRESHOLD = 0.035f;
+constexpr std::string_view DEVICE_TOPIC_PREFIX = "radar/" DEVICE_ID "/";
+constexpr uint32_t SYNTHETIC_PERIOD_MS = 120000;  // Empty for the first half, occupied for the second
+constexpr float SYNTHETIC_EMPTY_JITTER = 0.01f;
+constexpr float SYNTHETIC_MOVING_JITTER = 0.03f;
+constexpr float SYNTHETIC_WANDER = 0.02f;
+
+/* PRIVATE ENUMS */
+enum PublishKind {
+  PUBLISH_STATUS,
+  PUBLISH_TELEMETRY,
+  PUBLISH_METRICS,
+  PUBLISH_OTHER,
+  PUBLISH_KINDS_COUNT,
+};
+
+/* PRIVATE TYPES */
+struct alignas(64) WorkerStats {  // Written by its worker during epochs, read between them
+  uint64_t publishes[PUBLISH_KINDS_COUNT] = {};
+  uint64_t bytes = 0;
+  uint64_t status_changes = 0;
+  std::vector<uint32_t> status_delays_ms[2];  // From an occupancy change of the trace to the status publish, by label
+  uint64_t missed_changes = 0;                // Changed back before the device followed
+  std::vector<uint32_t> publish_wall_us;      // From feed() to the publish sink
+  std::vector<uint8_t> out;                   // PUBLISH packets for the subscriber
+};
+
+struct Device {
+  const HostDeviceApi* api;
+  std::string topic_prefix;  // "radar/<id>/"
+  size_t next_sample;
+  int64_t loop_start_ms;  // Virtual time of the first trace sample in this loop
+  TracePacer pacer;
+  int room_status = -1;
+  int8_t occupied = RADAR_TRACE_UNLABELED;  // Label of the last trace sample
+  bool change_pending = false;              // The status doesn't match the label yet
+  uint64_t changed_at_ms = 0;
+  double fed_at_s = -1;  // Wall time of the feed() on the way, -1 outside one
+  WorkerStats* stats;    // Of the worker running it this epoch
+};
+
+/* GLOBAL VARIABLES */
+static std::string g_filter;  // Of the subscriber, empty without one
+static uint32_t g_random_state = 1;
+
+/* PRIVATE PROTOTYPES */
+static void print_usage(const char* program);
+static bool load_devices(const char* path, uint32_t count, const RadarTrace& trace, uint32_t interval_ms,
+                         std::vector<Device>* devices);
+static void generate_trace(uint32_t interval_ms, RadarTrace* trace);
+static void advance_device(Device& device, const RadarTrace& trace, uint32_t interval_ms, uint64_t end_ms);
+static void handle_publish(const char* topic, const char* data, int len, void* ctx);
+static void track_occupancy(Device& device, int8_t occupied, uint64_t time_ms);
+static bool is_status_occupied(int room_status);
+static void print_latencies(const char* name, std::vector<uint32_t>& values, const char* unit);
+static uint32_t next_random();
+
+/* MAIN */
+int main(int argc, char** argv) {
+  uint32_t devices_count = DEFAULT_DEVICES;
+  unsigned workers_count = std::thread::hardware_concurrency();
+  double duration_s = DEFAULT_DURATION_S;
+  uint32_t epoch_ms = DEFAULT_EPOCH_MS;
+  float jitter_threshold = DEFAULT_THRESHOLD;
+  uint32_t interval_ms = GATEWAY_PING_INTERVAL_MS;
+  double speed = 0;
+  double report_s = DEFAULT_REPORT_S;
+  uint16_t port = 0;
+  const char* module_path = RADAR_DEVICE_MODULE;
+
+  int option;
+  while ((option = getopt(argc, argv, "n:w:t:e:j:i:x:s:p:m:h")) != -1) {
+    switch (option) {
+      case 'n':
+        devices_count = strtoul(optarg, nullptr, 10);
+        break;
+      case 'w':
+        workers_count = strtoul(optarg, nullptr, 10);
+        break;
+      case 't':
+        duration_s = strtod(optarg, nullptr);
+        break;
+      case 'e':
+        epoch_ms = strtoul(optarg, nullptr, 10);
+        break;
+      case 'j':
+        jitter_threshold = strtof(optarg, nullptr);
+        break;
+      case 'i':
+        interval_ms = strtoul(optarg, nullptr, 10);
+        break;
+      case 'x':
+        speed = strtod(optarg, nullptr);
+        break;
+      case 's':
+        report_s = strtod(optarg, nullptr);
+        break;
+      case 'p':
+        port = strtoul(optarg, nullptr, 10);
+        break;
+      case 'm':
+        module_path = optarg;
+        break;
+      default:
+        print_usage(argv[0]);
+        return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (optind < argc - 1 || devices_count == 0 || epoch_ms == 0 || interval_ms == 0) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  RadarTrace trace;
+  if (optind == argc - 1) {
+    if (!radar_trace_load(argv[optind], interval_ms, &trace)) {
+      return EXIT_FAILURE;
+    }
+    if (trace.count == 0) {
+      fprintf(stderr, "Trace is empty\n");
+      return EXIT_FAILURE;
+    }
+  } else {
+    generate_trace(interval_ms, &trace);
+  }
+
+  std::vector<Device> devices;
+  if (!load_devices(module_path, devices_count, trace, interval_ms, &devices)) {
+    return EXIT_FAILURE;
+  }
+
+  int subscriber_fd = -1;
+  if (port > 0) {
+    signal(SIGPIPE, SIG_IGN);
+    subscriber_fd = mqtt::accept_subscriber(port, &g_filter);
+    if (subscriber_fd < 0) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  WorkPool pool(workers_count);
+  std::vector<WorkerStats> stats(pool.size());
+  const double start_s = host_wall_time_s();
+  pool.run(devices.size(), [&](size_t index, unsigned worker) {
+    devices[index].stats = &stats[worker];
+    devices[index].api->start(jitter_threshold, handle_publish, &devices[index]);
+  });
+
+  printf("time_s,wall_s,publishes,publishes_per_s,status_changes,empty,occupied,steals\n");
+  const uint64_t duration_ms = (uint64_t)(duration_s * 1000);
+  const uint64_t report_ms = std::max<uint64_t>((uint64_t)(report_s * 1000), epoch_ms);
+  uint64_t reported_at_ms = 0;
+  uint64_t reported_publishes = 0;
+  std::vector<double> epoch_times_s;
+  mqtt::PacketReader reader;
+  bool connected = true;
+  for (uint64_t end_ms = 0; end_ms < duration_ms && connected;) {
+    end_ms = std::min(end_ms + epoch_ms, duration_ms);
+    const double epoch_start_s = host_wall_time_s();
+    pool.run(devices.size(), [&](size_t index, unsigned worker) {
+      devices[index].stats = &stats[worker];
+      advance_device(devices[index], trace, interval_ms, end_ms);
+    });
+    epoch_times_s.push_back(host_wall_time_s() - epoch_start_s);
+
+    if (subscriber_fd >= 0) {
+      for (WorkerStats& worker : stats) {
+        connected = connected && mqtt::send_all(subscriber_fd, worker.out);
+        worker.out.clear();
+      }
+      connected = connected && mqtt::answer_pings(subscriber_fd, reader);
+    }
+    if (speed > 0) {
+      const double due_s = start_s + end_ms / 1000.0 / speed;
+      std::this_thread::sleep_for(std::chrono::duration<double>(std::max(0.0, due_s - host_wall_time_s())));
+    }
+
+    if (end_ms - reported_at_ms >= report_ms || end_ms == duration_ms) {
+      uint64_t publishes = 0;
+      uint64_t status_changes = 0;
+      for (const WorkerStats& worker : stats) {
+        publishes += std::accumulate(std::begin(worker.publishes), std::end(worker.publishes), uint64_t{0});
+        status_changes += worker.status_changes;
+      }
+      uint32_t statuses[STATIONARY_PRESENCE + 1] = {};
+      for (const Device& device : devices) {
+        if (device.room_status >= 0) {
+          statuses[device.room_status]++;
+        }
+      }
+      printf("%.1f,%.3f,%llu,%.1f,%llu,%u,%u,%llu\n", end_ms / 1000.0, host_wall_time_s() - start_s,
+             (unsigned long long)publishes, (publishes - reported_publishes) * 1000.0 / (end_ms - reported_at_ms),
+             (unsigned long long)status_changes, statuses[NO_MOVEMENT], statuses[MOVEMENT_DETECTED] + statuses[STATIONARY_PRESENCE],
+             (unsigned long long)pool.steals());
+      fflush(stdout);
+      reported_at_ms = end_ms;
+      reported_publishes = publishes;
+    }
+  }
+  const double elapsed_s = host_wall_time_s() - start_s;
+  const double virtual_s = duration_ms / 1000.0;
+
+  if (subscriber_fd >= 0) {
+    std::vector<uint8_t> out;
+    mqtt::append_empty(out, mqtt::DISCONNECT);
+    mqtt::send_all(subscriber_fd, out);
+    close(subscriber_fd);
+  }
+
+  WorkerStats total;
+  for (const WorkerStats& worker : stats) {
+    for (int i = 0; i < PUBLISH_KINDS_COUNT; i++) {
+      total.publishes[i] += worker.publishes[i];
+    }
+    total.bytes += worker.bytes;
+    total.status_changes += worker.status_changes;
+  }
+  const uint64_t publishes = std::accumulate(std::begin(total.publishes), std::end(total.publishes), uint64_t{0});
+  uint64_t fed_count = 0;
+  for (const Device& device : devices) {
+    fed_count += device.pacer.fed_count;
+  }
+  std::sort(epoch_times_s.begin(), epoch_times_s.end());
+
+  fprintf(stderr, "Devices: %u on %u workers; virtual time: %.1f s; wall time: %.3f s; speed-up: %.1fx; steals: %llu\n",
+          devices_count, pool.size(), virtual_s, elapsed_s, virtual_s / elapsed_s, (unsigned long long)pool.steals());
+  fprintf(stderr, "Samples fed: %llu, %.0f/s of wall time\n", (unsigned long long)fed_count, fed_count / elapsed_s);
+  fprintf(stderr, "Publishes: %llu (status %llu, telemetry %llu, metrics %llu, other %llu), %llu bytes\n",
+          (unsigned long long)publishes, (unsigned long long)total.publishes[PUBLISH_STATUS],
+          (unsigned long long)total.publishes[PUBLISH_TELEMETRY], (unsigned long long)total.publishes[PUBLISH_METRICS],
+          (unsigned long long)total.publishes[PUBLISH_OTHER], (unsigned long long)total.bytes);
+  fprintf(stderr, "  %.1f/s of virtual time, %.0f/s of wall time; status changes: %llu\n", publishes / virtual_s,
+          publishes / elapsed_s, (unsigned long long)total.status_changes);
+  if (!epoch_times_s.empty()) {
+    fprintf(stderr, "Epoch wall time: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+            epoch_times_s[epoch_times_s.size() / 2] * 1000, epoch_times_s[epoch_times_s.size() * 99 / 100] * 1000,
+            epoch_times_s.back() * 1000);
+  }
+  std::vector<uint32_t> status_delays_ms[2];
+  std::vector<uint32_t> publish_wall_us;
+  uint64_t missed_changes = 0;
+  for (const WorkerStats& worker : stats) {
+    for (int i = 0; i < 2; i++) {
+      status_delays_ms[i].insert(status_delays_ms[i].end(), worker.status_delays_ms[i].begin(),
+                                 worker.status_delays_ms[i].end());
+    }
+    publish_wall_us.insert(publish_wall_us.end(), worker.publish_wall_us.begin(), worker.publish_wall_us.end());
+    missed_changes += worker.missed_changes;
+  }
+  fprintf(stderr, "Occupancy changes of the trace to the status publish, in virtual time; missed: %llu\n",
+          (unsigned long long)missed_changes);
+  print_latencies("arrival", status_delays_ms[1], "ms");
+  print_latencies("departure", status_delays_ms[0], "ms");
+  fprintf(stderr, "Sample fed to the publish it causes, in wall time:\n");
+  print_latencies("feed_to_publish", publish_wall_us, "us");
+
+  radar_trace_free(&trace);
+  return connected ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* FUNCTIONS */
+static void print_usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options] [trace.csv|trace.bin]\n"
+          "  -n <count>      simulated devices (default %u)\n"
+          "  -w <count>      worker threads (default: one per CPU)\n"
+          "  -t <s>          virtual time to simulate (default %g)\n"
+          "  -e <ms>         virtual time of an epoch, between which devices are in sync (default %u)\n"
+          "  -j <threshold>  jitter detection threshold of every device (default %g)\n"
+          "  -i <ms>         sample interval for traces without timestamps and the synthetic one (default %d)\n"
+          "  -x <factor>     pace virtual time to this many times real time (default: as fast as possible)\n"
+          "  -s <s>          virtual time between CSV rows (default %g)\n"
+          "  -p <port>       also publish to one subscriber on this port, like radar_broker_sim\n"
+          "  -m <file>       radar-device module (default %s)\n"
+          "Without a trace, devices replay a synthetic one, empty and occupied for %u s each.\n",
+          program, DEFAULT_DEVICES, DEFAULT_DURATION_S, DEFAULT_EPOCH_MS, DEFAULT_THRESHOLD, GATEWAY_PING_INTERVAL_MS,
+          DEFAULT_REPORT_S, RADAR_DEVICE_MODULE, SYNTHETIC_PERIOD_MS / 2000);
+}
+
+/* dlopen() loads a path only once, so every device gets a copy of the module under its own name */
+static bool load_devices(const char* path, uint32_t count, const RadarTrace& trace, uint32_t interval_ms,
+                         std::vector<Device>* devices) {
+  std::ifstream file(path, std::ios::binary);
+  const std::vector<char> module((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (module.empty()) {
+    fprintf(stderr, "%s: can't read the device module\n", path);
+    return false;
+  }
+  const char* temp_dir = getenv("TMPDIR");
+  std::string dir = std::string(temp_dir ? temp_dir : "/tmp") + "/radar_fleet.XXXXXX";
+  if (!mkdtemp(dir.data())) {
+    perror(dir.c_str());
+    return false;
+  }
+
+  devices->resize(count);
+  bool loaded = true;
+  for (uint32_t i = 0; i < count && loaded; i++) {
+    const std::string copy_path = dir + "/device-" + std::to_string(i + 1) + ".so";
+    std::ofstream copy(copy_path, std::ios::binary);
+    if (!copy.write(module.data(), module.size()) || (copy.close(), !copy)) {
+      perror(copy_path.c_str());
+      loaded = false;
+      continue;
+    }
+    void* handle = dlopen(copy_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    unlink(copy_path.c_str());
+    auto get_api = handle ? (const HostDeviceApi* (*)())dlsym(handle, HOST_DEVICE_API_SYMBOL) : nullptr;
+    if (!get_api) {
+      fprintf(stderr, "%s: %s\n", path, dlerror());
+      loaded = false;
+      continue;
+    }
+
+    // Staggered, so the devices don't all change status at once
+    Device& device = (*devices)[i];
+    device.api = get_api();
+    device.topic_prefix = "radar/" + std::to_string(i + 1) + "/";
+    device.next_sample = (size_t)((uint64_t)i * trace.count / count);
+    device.loop_start_ms = -(int64_t)(trace.samples[device.next_sample].timestamp_ms - trace.samples[0].timestamp_ms);
+    trace_pacer_init(&device.pacer, interval_ms);
+  }
+  rmdir(dir.c_str());
+  return loaded;
+}
+
+static void generate_trace(uint32_t interval_ms, RadarTrace* trace) {
+  trace->count = SYNTHETIC_PERIOD_MS / interval_ms;
+  trace->samples = (RadarTraceSample*)calloc(trace->count, sizeof(RadarTraceSample));
+  for (size_t i = 0; i < trace->count; i++) {
+    const uint32_t time_ms = i * interval_ms;
+    const float noise = (next_random() % 1000) / 1000.0f;
+    RadarTraceSample& sample = trace->samples[i];
+    sample.timestamp_ms = time_ms;
+    sample.info.waveform_jitter = time_ms < SYNTHETIC_PERIOD_MS / 2 ? SYNTHETIC_EMPTY_JITTER * (1 + noise)
+                                                                    : SYNTHETIC_MOVING_JITTER * (1 + 2 * noise);
+    sample.info.waveform_wander = SYNTHETIC_WANDER;
+    sample.occupied = time_ms >= SYNTHETIC_PERIOD_MS / 2;
+  }
+}
+
+/* Like radar_replay, samples are paced to the pings of the device */
+static void advance_device(Device& device, const RadarTrace& trace, uint32_t interval_ms, uint64_t end_ms) {
+  const uint32_t first_ms = trace.samples[0].timestamp_ms;
+  const uint32_t trace_ms = trace.samples[trace.count - 1].timestamp_ms - first_ms + interval_ms;
+  while (true) {
+    const RadarTraceSample& sample = trace.samples[device.next_sample];
+    const int64_t time_ms = device.loop_start_ms + (sample.timestamp_ms - first_ms);
+    if (time_ms >= (int64_t)end_ms) {
+      break;
+    }
+    device.api->advance_to_ms(time_ms);
+    track_occupancy(device, sample.occupied, time_ms);
+    if (trace_pacer_take(&device.pacer, time_ms, device.api->get_ping_interval_ms())) {
+      device.fed_at_s = host_wall_time_s();
+      device.api->feed(&sample.info);
+      device.fed_at_s = -1;
+    }
+    if (++device.next_sample == trace.count) {
+      device.next_sample = 0;
+      device.loop_start_ms += trace_ms;
+    }
+  }
+  device.api->advance_to_ms(end_ms);
+}
+
+/* Every device publishes on its DEVICE_ID topics, which become its own */
+static void handle_publish(const char* topic, const char* data, int len, void* ctx) {
+  Device* device = (Device*)ctx;
+  WorkerStats* stats = device->stats;
+  MqttFrame frame;
+  PublishKind kind = PUBLISH_OTHER;
+  if (mqtt_frame_decode((const uint8_t*)data, len, &frame)) {
+    switch (frame.msg_id) {
+      case MQTT_TX_MSG_ROOM_STATUS:
+        kind = PUBLISH_STATUS;
+        if (frame.payload_size == 1 && frame.payload[0] != device->room_status) {
+          stats->status_changes += device->room_status >= 0;
+          device->room_status = frame.payload[0] <= STATIONARY_PRESENCE ? frame.payload[0] : ROOM_UNDEFINED;
+          if (device->change_pending && is_status_occupied(device->room_status) == (device->occupied == 1)) {
+            stats->status_delays_ms[device->occupied].push_back(device->api->now_ms() - device->changed_at_ms);
+            device->change_pending = false;
+          }
+        }
+        break;
+      case MQTT_TX_MSG_TELEMETRY:
+        kind = PUBLISH_TELEMETRY;
+        break;
+      case MQTT_TX_MSG_METRICS:
+        kind = PUBLISH_METRICS;
+        break;
+    }
+  }
+  stats->publishes[kind]++;
+  stats->bytes += len;
+  if (device->fed_at_s >= 0) {
+    stats->publish_wall_us.push_back((uint32_t)((host_wall_time_s() - device->fed_at_s) * 1e6));
+  }
+
+  // Like the broker, only what the subscriber asked for
+  if (!g_filter.empty()) {
+    std::string_view suffix(topic);
+    if (suffix.substr(0, DEVICE_TOPIC_PREFIX.size()) == DEVICE_TOPIC_PREFIX) {
+      suffix.remove_prefix(DEVICE_TOPIC_PREFIX.size());
+    }
+    const std::string device_topic = device->topic_prefix + std::string(suffix);
+    if (mqtt::topic_matches(g_filter, device_topic)) {
+      mqtt::append_publish(stats->out, device_topic, (const uint8_t*)data, len);
+    }
+  }
+}
+
+/* A change the status already matches, e.g. after a false detection, isn't waited for */
+static void track_occupancy(Device& device, int8_t occupied, uint64_t time_ms) {
+  if (occupied == RADAR_TRACE_UNLABELED || occupied == device.occupied) {
+    return;
+  }
+  const bool first = device.occupied == RADAR_TRACE_UNLABELED;
+  device.occupied = occupied;
+  if (first) {
+    return;
+  }
+  device.stats->missed_changes += device.change_pending;
+  device.change_pending = is_status_occupied(device.room_status) != (occupied == 1);
+  device.changed_at_ms = time_ms;
+}
+
+static bool is_status_occupied(int room_status) {
+  return room_status == MOVEMENT_DETECTED || room_status == STATIONARY_PRESENCE;
+}
+
+static void print_latencies(const char* name, std::vector<uint32_t>& values, const char* unit) {
+  if (values.empty()) {
+    fprintf(stderr, "  %-16s none\n", name);
+    return;
+  }
+  std::sort(values.begin(), values.end());
+  const size_t count = values.size();
+  fprintf(stderr, "  %-16s %10zu  p50 %u %s  p90 %u %s  p99 %u %s  max %u %s\n", name, count, values[count / 2], unit,
+          values[count * 9 / 10], unit, values[count * 99 / 100], unit, values.back(), unit);
+}
+
+/* xorshift32, reproducible runs */
+static uint32_t next_random() {
+  g_random_state ^= g_random_state << 13;
+  g_random_state ^= g_random_state >> 17;
+  g_random_state ^= g_random_state << 5;
+  return g_random_state;
+}
@@ -0,0 +1,104 @@
+#include "work_pool.h"
+
+/* FUNCTIONS */
+WorkPool::WorkPool(unsigned workers_count) {
+  for (unsigned i = 0; i < (workers_count ? workers_count : 1); i++) {
+    workers.push_back(std::make_unique<Worker>());
+  }
+  for (unsigned i = 0; i < workers.size(); i++) {
+    workers[i]->thread = std::thread(&WorkPool::run_worker, this, i);
+  }
+}
+
+WorkPool::~WorkPool() {
+  {
+    std::lock_guard<std::mutex> lock(batch_mutex);
+    stopping = true;
+  }
+  batch_started.notify_all();
+  for (auto& worker : workers) {
+    worker->thread.join();
+  }
+}
+
+void WorkPool::run(size_t count, const Job& job) {
+  if (count == 0) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(batch_mutex);
+  batch_done.wait(lock, [this] { return active == 0; });
+  const size_t block = (count + workers.size() - 1) / workers.size();
+  for (size_t i = 0; i < workers.size(); i++) {
+    std::lock_guard<std::mutex> jobs_lock(workers[i]->mutex);
+    for (size_t index = i * block; index < count && index < (i + 1) * block; index++) {
+      workers[i]->jobs.push_back(index);
+    }
+  }
+  batch_job = &job;
+  remaining = count;
+  batch++;
+  batch_started.notify_all();
+  batch_done.wait(lock, [this] { return remaining == 0 && active == 0; });
+  batch_job = nullptr;
+}
+
+uint64_t WorkPool::steals() const {
+  uint64_t steals = 0;
+  for (const auto& worker : workers) {
+    steals += worker->steals;
+  }
+  return steals;
+}
+
+void WorkPool::run_worker(unsigned index) {
+  uint64_t seen_batch = 0;
+  while (true) {
+    const Job* job;
+    {
+      std::unique_lock<std::mutex> lock(batch_mutex);
+      batch_started.wait(lock, [&] { return stopping || batch != seen_batch; });
+      if (stopping) {
+        return;
+      }
+      seen_batch = batch;
+      job = batch_job;
+      active++;
+    }
+
+    size_t done = 0;
+    size_t job_index;
+    while (take_job(index, &job_index)) {
+      (*job)(job_index, index);
+      done++;
+    }
+    std::lock_guard<std::mutex> lock(batch_mutex);
+    remaining -= done;
+    if (--active == 0 && remaining == 0) {
+      batch_done.notify_all();
+    }
+  }
+}
+
+/* Newest own job first, it was dealt last and is the least likely to be stolen */
+bool WorkPool::take_job(unsigned index, size_t* job) {
+  Worker& own = *workers[index];
+  {
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.jobs.empty()) {
+      *job = own.jobs.back();
+      own.jobs.pop_back();
+      return true;
+    }
+  }
+  for (size_t i = 1; i < workers.size(); i++) {
+    Worker& victim = *workers[(index + i) % workers.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.jobs.empty()) {
+      *job = victim.jobs.front();
+      victim.jobs.pop_front();
+      own.steals++;
+      return true;
+    }
+  }
+  return false;
+}
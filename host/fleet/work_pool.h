@@ -0,0 +1,58 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+/* Fixed set of worker threads that run batches of independent jobs.
+ *
+ * run() deals the indices of a batch out to the workers in contiguous blocks.
+ * A worker takes its own jobs from the back of its deque, and once it runs
+ * out it steals from the front of the others', so a few slow jobs don't hold
+ * the batch back while other workers sit idle. Every deque has its own lock,
+ * which is only contended while stealing. */
+
+class WorkPool {
+ public:
+  using Job = std::function<void(size_t index, unsigned worker)>;
+
+  explicit WorkPool(unsigned workers_count);
+  ~WorkPool();
+
+  /* Runs job for every index below count and returns once all are done.
+   * Everything the jobs wrote is visible to the caller afterwards. */
+  void run(size_t count, const Job& job);
+  unsigned size() const { return workers.size(); }
+  /* Jobs run by another worker than the one they were dealt to, only between runs */
+  uint64_t steals() const;
+
+ private:
+  struct alignas(64) Worker {
+    std::mutex mutex;
+    std::deque<size_t> jobs;
+    uint64_t steals = 0;  // Written by the worker only
+    std::thread thread;
+  };
+
+  void run_worker(unsigned index);
+  bool take_job(unsigned index, size_t* job);
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::mutex batch_mutex;
+  std::condition_variable batch_started;
+  std::condition_variable batch_done;
+  const Job* batch_job = nullptr;
+  uint64_t batch = 0;
+  size_t remaining = 0;
+  unsigned active = 0;  // Workers looking for jobs, a batch is only dealt while there are none
+  bool stopping = false;
+};
+
+#endif
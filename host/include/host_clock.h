@@ -0,0 +1,15 @@
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC PROTOTYPES */
+/* Monotonic wall-clock time of the host, unlike the virtual clock of host_rtos.h */
+double host_wall_time_s();
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,38 @@
+#ifndef HOST_DEVICE_H
+#define HOST_DEVICE_H
+
+#include <esp_radar.h>
+#include <host_mqtt.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Entry points of the radar-device module, the firmware and its host shims
+ * built as one shared object for fleet simulation. The firmware keeps its
+ * state in globals, so every virtual device is a dlopen() of a separate copy
+ * of the module, found through HOST_DEVICE_API_SYMBOL. A device must only be
+ * driven by one thread at a time, but any thread may drive it. */
+
+/* PUBLIC CONSTANTS */
+#define HOST_DEVICE_API_SYMBOL "host_device_api"
+
+/* PUBLIC TYPES */
+typedef struct {
+  /* Stores the threshold like a calibration would and boots the firmware */
+  void (*start)(float jitter_threshold, host_mqtt_publish_cb_t sink, void* ctx);
+  /* One sample with its CSI packet, processed right away */
+  void (*feed)(const wifi_radar_info_t* info);
+  void (*advance_to_ms)(uint64_t time_ms);
+  uint64_t (*now_ms)();
+  uint32_t (*get_ping_interval_ms)();
+} HostDeviceApi;
+
+/* PUBLIC PROTOTYPES */
+const HostDeviceApi* host_device_api();
+
+#if __cplusplus
+}
+#endif
+#endif
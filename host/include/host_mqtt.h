@@ -0,0 +1,25 @@
+#ifndef HOST_MQTT_H
+#define HOST_MQTT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC TYPES */
+typedef void (*host_mqtt_publish_cb_t)(const char* topic, const char* data, int len, void* ctx);
+
+/* PUBLIC PROTOTYPES */
+/* Every esp_mqtt_client_publish() of the firmware ends up in this callback */
+void host_mqtt_set_publish_sink(host_mqtt_publish_cb_t callback, void* ctx);
+/* Deliver a message to the firmware as if it was received from the broker */
+void host_mqtt_deliver(const char* topic, const char* data, int len);
+/* Take the broker connection down or back up, with the events of esp-mqtt */
+void host_mqtt_set_connected(bool connected);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,17 @@
+#ifndef HOST_PARTITION_H
+#define HOST_PARTITION_H
+
+#include <stdbool.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC PROTOTYPES */
+/* Write the trace partition to a file, the same image a device download gives */
+bool host_partition_save(const char* path);
+
+#if __cplusplus
+}
+#endif
+#endif
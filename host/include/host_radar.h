@@ -0,0 +1,20 @@
+#ifndef HOST_RADAR_H
+#define HOST_RADAR_H
+
+#include <esp_radar.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC PROTOTYPES */
+/* Hand one sample to the callback registered through esp_radar_set_config(),
+ * like the CSI task of the library would. Dropped if the radar isn't started. */
+void host_radar_feed(const wifi_radar_info_t* info);
+/* Same for the filtered CSI callback */
+void host_radar_feed_csi(const wifi_csi_filtered_info_t* info);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,23 @@
+#ifndef HOST_RTOS_H
+#define HOST_RTOS_H
+
+#include <freertos/FreeRTOS.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC PROTOTYPES */
+/* Run every ready task until all of them are blocked. Time does not move. */
+void host_rtos_run_ready();
+/* Move the virtual clock forward to the given tick, firing timers and waking
+ * delayed tasks in order on the way. Never goes backwards. */
+void host_rtos_advance_to(uint64_t tick);
+uint64_t host_rtos_now_ticks();
+uint64_t host_rtos_now_ms();
+
+#if __cplusplus
+}
+#endif
+#endif
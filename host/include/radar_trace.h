@@ -0,0 +1,43 @@
+#ifndef RADAR_TRACE_H
+#define RADAR_TRACE_H
+
+#include <esp_radar.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC CONSTANTS */
+#define RADAR_TRACE_UNLABELED -1
+
+/* PUBLIC TYPES */
+typedef struct {
+  uint32_t timestamp_ms;
+  wifi_radar_info_t info;
+  int8_t occupied;  // Label: 1 if the room was occupied, 0 if empty, RADAR_TRACE_UNLABELED without one
+} RadarTraceSample;
+
+typedef struct {
+  RadarTraceSample* samples;
+  size_t count;
+} RadarTrace;
+
+/* PUBLIC PROTOTYPES */
+/* Reads "timestamp_ms,waveform_jitter,waveform_wander" lines. Lines with only
+ * "waveform_jitter,waveform_wander" are spaced by default_interval_ms, and a
+ * fourth value "occupied" (0 or 1) labels the sample. Empty lines, lines
+ * starting with '#' and a header line are skipped. */
+bool radar_trace_load_csv(const char* path, uint32_t default_interval_ms, RadarTrace* trace);
+/* Reads a trace partition image of the trace recorder, or else a CSV file.
+ * Every boot restarts the recorded timestamps, so the ones of later boots are
+ * moved behind the samples before them. */
+bool radar_trace_load(const char* path, uint32_t default_interval_ms, RadarTrace* trace);
+void radar_trace_free(RadarTrace* trace);
+
+#if __cplusplus
+}
+#endif
+#endif
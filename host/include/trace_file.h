@@ -0,0 +1,44 @@
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <trace_format.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Reader of trace partition images, see trace_format.h. The image is mapped
+ * and its records are used in place, only an index of the sectors in
+ * recording order is allocated, so even a full partition opens at once. */
+
+/* PUBLIC TYPES */
+typedef struct {
+  const TraceSectorHeader* header;
+  const TraceRecord* records;
+  size_t count;  // Written records
+} TraceSector;
+
+typedef struct {
+  const uint8_t* map;
+  size_t size;
+  TraceSector* sectors;  // Oldest first
+  size_t sectors_count;
+  size_t records_count;
+} TraceFile;
+
+/* PUBLIC PROTOTYPES */
+/* Returns false if the file can't be mapped or holds no trace sectors */
+bool trace_file_open(const char* path, TraceFile* file);
+void trace_file_close(TraceFile* file);
+
+static inline uint32_t trace_record_time_ms(const TraceSector* sector, const TraceRecord* record) {
+  return sector->header->base_ms + record->offset_ms;
+}
+
+#if __cplusplus
+}
+#endif
+#endif
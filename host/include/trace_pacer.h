@@ -0,0 +1,30 @@
+#ifndef TRACE_PACER_H
+#define TRACE_PACER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Thins the samples of a trace to the ones a device would see. Traces are
+ * recorded at one interval, but the firmware only gets a sample for every
+ * gateway ping, whose interval it changes on the way. */
+
+/* PUBLIC TYPES */
+typedef struct {
+  uint32_t interval_ms;  // Of the trace
+  uint64_t fed_at_ms;
+  uint64_t fed_count;
+} TracePacer;
+
+/* PUBLIC PROTOTYPES */
+void trace_pacer_init(TracePacer* pacer, uint32_t interval_ms);
+/* Whether the sample at time_ms is fed at the current ping interval, counted as fed if so */
+bool trace_pacer_take(TracePacer* pacer, uint64_t time_ms, uint32_t ping_interval_ms);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,47 @@
+#ifndef HOST_ESP_ERR_H
+#define HOST_ESP_ERR_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC TYPES */
+typedef int esp_err_t;
+
+/* PUBLIC CONSTANTS */
+#define ESP_OK   0
+#define ESP_FAIL -1
+
+#define ESP_ERR_NO_MEM        0x101
+#define ESP_ERR_INVALID_ARG   0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE  0x104
+#define ESP_ERR_NOT_FOUND     0x105
+#define ESP_ERR_TIMEOUT       0x107
+
+#define ESP_ERR_NVS_BASE              0x1100
+#define ESP_ERR_NVS_NOT_INITIALIZED   (ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND         (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_INVALID_HANDLE    (ESP_ERR_NVS_BASE + 0x07)
+#define ESP_ERR_NVS_INVALID_LENGTH    (ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_NO_FREE_PAGES     (ESP_ERR_NVS_BASE + 0x0d)
+#define ESP_ERR_NVS_NEW_VERSION_FOUND (ESP_ERR_NVS_BASE + 0x10)
+
+/* PUBLIC MACROS */
+#define ESP_ERROR_CHECK(x)                                                                    \
+  do {                                                                                        \
+    esp_err_t err_rc_ = (x);                                                                  \
+    if (err_rc_ != ESP_OK) {                                                                  \
+      fprintf(stderr, "ESP_ERROR_CHECK failed: 0x%x at %s:%d (%s)\n", err_rc_, __FILE__, __LINE__, #x); \
+      abort();                                                                                \
+    }                                                                                         \
+  } while (0)
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,21 @@
+#ifndef HOST_ESP_EVENT_H
+#define HOST_ESP_EVENT_H
+
+#include <esp_err.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC CONSTANTS */
+#define ESP_EVENT_ANY_ID -1
+
+/* PUBLIC TYPES */
+typedef const char* esp_event_base_t;
+typedef void (*esp_event_handler_t)(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,17 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC PROTOTYPES */
+/* Virtual time since boot, so it has the resolution of the FreeRTOS tick */
+int64_t esp_timer_get_time(void);
+
+#if __cplusplus
+}
+#endif
+#endif
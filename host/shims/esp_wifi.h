@@ -0,0 +1,43 @@
+#ifndef HOST_ESP_WIFI_H
+#define HOST_ESP_WIFI_H
+
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC ENUMS */
+typedef enum {
+  WIFI_PKT_MGMT,
+  WIFI_PKT_CTRL,
+  WIFI_PKT_DATA,
+  WIFI_PKT_MISC,
+} wifi_promiscuous_pkt_type_t;
+
+/* PUBLIC TYPES */
+/* Same fields as the ESP32-C3 radio metadata header, without the exact bit layout */
+typedef struct {
+  signed rssi : 8;
+  unsigned rate : 5;
+  unsigned sig_mode : 2;
+  unsigned mcs : 7;
+  unsigned cwb : 1;
+  unsigned stbc : 2;
+  unsigned channel : 4;
+  unsigned secondary_channel : 4;
+  unsigned timestamp : 32;
+  signed noise_floor : 8;
+  unsigned sig_len : 12;
+  unsigned rx_state : 8;
+} wifi_pkt_rx_ctrl_t;
+
+typedef void (*wifi_promiscuous_cb_t)(void* buf, wifi_promiscuous_pkt_type_t type);
+
+#if __cplusplus
+}
+#endif
+#endif
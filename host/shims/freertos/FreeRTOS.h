@@ -0,0 +1,42 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC CONSTANTS */
+#define configTICK_RATE_HZ 100  // Same as CONFIG_FREERTOS_HZ in sdkconfig
+
+#define pdFALSE        0
+#define pdTRUE         1
+#define pdPASS         pdTRUE
+#define pdFAIL         pdFALSE
+#define errQUEUE_FULL  0
+#define errQUEUE_EMPTY 0
+
+#define portMAX_DELAY      ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+
+/* PUBLIC TYPES */
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+/* PUBLIC MACROS */
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000U))
+
+#if __cplusplus
+}
+#endif
+
+/* The firmware relies on FreeRTOS.h pulling these in transitively */
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include <freertos/timers.h>
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef HOST_FREERTOS_EVENT_GROUPS_H
+#define HOST_FREERTOS_EVENT_GROUPS_H
+
+#include <freertos/FreeRTOS.h>
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+#include <freertos/FreeRTOS.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC TYPES */
+typedef struct host_queue* QueueHandle_t;
+typedef QueueHandle_t xQueueHandle;
+
+/* PUBLIC PROTOTYPES */
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait);
+/* Replaces the item of a queue of length 1, never blocks */
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+/* PUBLIC MACROS */
+#define xQueueSendToBack(queue, item, ticks_to_wait) xQueueSend(queue, item, ticks_to_wait)
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,36 @@
+#ifndef HOST_FREERTOS_SEMPHR_H
+#define HOST_FREERTOS_SEMPHR_H
+
+#include <freertos/FreeRTOS.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* A mutex is a queue of one token, like in FreeRTOS, without priority inheritance */
+
+/* PUBLIC TYPES */
+typedef QueueHandle_t SemaphoreHandle_t;
+
+/* PUBLIC FUNCTIONS */
+static inline SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  const uint8_t token = 0;
+  QueueHandle_t queue = xQueueCreate(1, sizeof(token));
+  xQueueSend(queue, &token, 0);
+  return queue;
+}
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait) {
+  uint8_t token;
+  return xQueueReceive(semaphore, &token, ticks_to_wait);
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  const uint8_t token = 0;
+  return xQueueSend(semaphore, &token, 0);
+}
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,30 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include <freertos/FreeRTOS.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC TYPES */
+typedef struct host_task* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* arg);
+
+/* PUBLIC PROTOTYPES */
+BaseType_t xTaskCreate(TaskFunction_t task_code,
+                       const char* name,
+                       uint32_t stack_depth,
+                       void* parameters,
+                       UBaseType_t priority,
+                       TaskHandle_t* created_task);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks_to_delay);
+TickType_t xTaskGetTickCount(void);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait);
+
+#if __cplusplus
+}
+#endif
+#endif
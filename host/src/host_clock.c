@@ -0,0 +1,10 @@
+#include <host_clock.h>
+
+#include <time.h>
+
+/* FUNCTIONS */
+double host_wall_time_s() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
@@ -0,0 +1,73 @@
+#include <host_device.h>
+
+#include <calibration.h>
+#include <csi_stream.h>
+#include <esp_log.h>
+#include <host_radar.h>
+#include <host_rtos.h>
+#include <mqtt_handler.h>
+#include <nvs.h>
+#include <pipeline_metrics.h>
+#include <ping_handler.h>
+#include <telemetry.h>
+#include <wifi_radar.h>
+
+/* PRIVATE CONSTANTS */
+#define RADAR_NVS_NAMESPACE "wifi_radar"  // Same as in wifi_radar.c
+
+/* PRIVATE PROTOTYPES */
+static void start(float jitter_threshold, host_mqtt_publish_cb_t sink, void* ctx);
+static void feed(const wifi_radar_info_t* info);
+static void advance_to_ms(uint64_t time_ms);
+static uint32_t get_ping_interval_ms();
+
+/* GLOBAL VARIABLES */
+static const HostDeviceApi g_api = {
+    .start = start,
+    .feed = feed,
+    .advance_to_ms = advance_to_ms,
+    .now_ms = host_rtos_now_ms,
+    .get_ping_interval_ms = get_ping_interval_ms,
+};
+
+/* FUNCTIONS */
+__attribute__((visibility("default"))) const HostDeviceApi* host_device_api() {
+  return &g_api;
+}
+
+/* Like radar_replay, without the trace recorder, whose flash would cost every device 768 KiB */
+static void start(float jitter_threshold, host_mqtt_publish_cb_t sink, void* ctx) {
+  esp_log_level_set("*", ESP_LOG_WARN);
+  if (jitter_threshold > 0) {
+    nvs_handle_t handle;
+    ESP_ERROR_CHECK(nvs_open(RADAR_NVS_NAMESPACE, NVS_READWRITE, &handle));
+    CalibrationRecord record;
+    calibration_record_begin(&record);
+    record.threshold.waveform_jitter = jitter_threshold;
+    save_calibration(handle, CALIBRATION_DEFAULT_PROFILE, &record);
+    nvs_close(handle);
+  }
+  host_mqtt_set_publish_sink(sink, ctx);
+  init_mqtt_client();
+  init_pipeline_metrics();
+  init_telemetry();
+  init_csi_stream();
+  init_wifi_radar();
+  init_gateway_ping();
+  start_mqtt_client();
+  host_rtos_run_ready();
+}
+
+static void feed(const wifi_radar_info_t* info) {
+  host_radar_feed_csi(&(wifi_csi_filtered_info_t){0});
+  host_radar_feed(info);
+  host_rtos_run_ready();
+}
+
+static void advance_to_ms(uint64_t time_ms) {
+  host_rtos_advance_to(pdMS_TO_TICKS(time_ms));
+}
+
+static uint32_t get_ping_interval_ms() {
+  return get_gateway_ping_interval();
+}
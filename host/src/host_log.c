@@ -0,0 +1,63 @@
+#include <esp_log.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+/* PRIVATE CONSTANTS */
+#define MAX_TAG_LEVELS 32
+
+/* PRIVATE TYPES */
+typedef struct {
+  const char* tag;
+  esp_log_level_t level;
+} TagLevel;
+
+/* GLOBAL VARIABLES */
+static esp_log_level_t g_default_level = ESP_LOG_INFO;
+static TagLevel g_tag_levels[MAX_TAG_LEVELS] = {0};
+static size_t g_tag_levels_count = 0;
+
+static const char g_level_letters[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+
+/* PRIVATE PROTOTYPES */
+static esp_log_level_t get_tag_level(const char* tag);
+
+/* FUNCTIONS */
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+  if (strcmp(tag, "*") == 0) {
+    g_default_level = level;
+    g_tag_levels_count = 0;
+    return;
+  }
+  for (size_t i = 0; i < g_tag_levels_count; i++) {
+    if (strcmp(g_tag_levels[i].tag, tag) == 0) {
+      g_tag_levels[i].level = level;
+      return;
+    }
+  }
+  if (g_tag_levels_count < MAX_TAG_LEVELS) {
+    g_tag_levels[g_tag_levels_count++] = (TagLevel){.tag = tag, .level = level};
+  }
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+  if (level > get_tag_level(tag)) {
+    return;
+  }
+  fprintf(stderr, "%c (%s) ", g_level_letters[level], tag);
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+static esp_log_level_t get_tag_level(const char* tag) {
+  for (size_t i = 0; i < g_tag_levels_count; i++) {
+    if (strcmp(g_tag_levels[i].tag, tag) == 0) {
+      return g_tag_levels[i].level;
+    }
+  }
+  return g_default_level;
+}
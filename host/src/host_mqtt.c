@@ -0,0 +1,108 @@
+#include <host_mqtt.h>
+
+#include <mqtt_client.h>
+#include <stdlib.h>
+
+/* Broker-less esp-mqtt stand-in. The client is connected as soon as it's
+ * started and publishes go straight to the sink set by the host program.
+ * While the host program takes the connection down, publishes fail like with
+ * CONFIG_MQTT_SKIP_PUBLISH_IF_DISCONNECTED. */
+
+/* PRIVATE TYPES */
+struct host_mqtt_client {
+  esp_event_handler_t handler;
+  void* handler_arg;
+  bool started;
+  bool connected;
+  int next_msg_id;
+};
+
+/* GLOBAL VARIABLES */
+static struct host_mqtt_client g_client = {0};
+static host_mqtt_publish_cb_t g_publish_sink = NULL;
+static void* g_publish_sink_ctx = NULL;
+
+/* PRIVATE PROTOTYPES */
+static void dispatch_event(esp_mqtt_event_t* event);
+
+/* FUNCTIONS */
+void host_mqtt_set_publish_sink(host_mqtt_publish_cb_t callback, void* ctx) {
+  g_publish_sink = callback;
+  g_publish_sink_ctx = ctx;
+}
+
+void host_mqtt_deliver(const char* topic, const char* data, int len) {
+  if (!g_client.connected) {
+    return;
+  }
+  esp_mqtt_event_t event = {
+      .event_id = MQTT_EVENT_DATA,
+      .topic = (char*)topic,
+      .topic_len = strlen(topic),
+      .data = (char*)data,
+      .data_len = len,
+      .total_data_len = len,
+  };
+  dispatch_event(&event);
+}
+
+void host_mqtt_set_connected(bool connected) {
+  if (!g_client.started || g_client.connected == connected) {
+    return;
+  }
+  g_client.connected = connected;
+  esp_mqtt_event_t event = {.event_id = connected ? MQTT_EVENT_CONNECTED : MQTT_EVENT_DISCONNECTED};
+  dispatch_event(&event);
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* config) {
+  g_client = (struct host_mqtt_client){0};
+  return &g_client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client,
+                                         esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler,
+                                         void* event_handler_arg) {
+  client->handler = event_handler;
+  client->handler_arg = event_handler_arg;
+  return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client) {
+  client->started = true;
+  client->connected = true;
+  esp_mqtt_event_t event = {.event_id = MQTT_EVENT_CONNECTED};
+  dispatch_event(&event);
+  return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client) {
+  client->started = false;
+  client->connected = false;
+  esp_mqtt_event_t event = {.event_id = MQTT_EVENT_DISCONNECTED};
+  dispatch_event(&event);
+  return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char* topic, int qos) {
+  return ++client->next_msg_id;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len, int qos, int retain) {
+  if (!client->connected) {
+    return -1;
+  }
+  if (g_publish_sink) {
+    g_publish_sink(topic, data, len, g_publish_sink_ctx);
+  }
+  return qos > 0 ? ++client->next_msg_id : 0;
+}
+
+static void dispatch_event(esp_mqtt_event_t* event) {
+  if (!g_client.handler) {
+    return;
+  }
+  event->client = &g_client;
+  g_client.handler(g_client.handler_arg, "MQTT_EVENTS", event->event_id, event);
+}
@@ -0,0 +1,134 @@
+#include <nvs.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/* In-memory NVS. Values are visible to nvs_get_* right away, as on the device. */
+
+/* PRIVATE CONSTANTS */
+#define MAX_NAMESPACES   16
+#define NVS_KEY_NAME_MAX 16
+
+/* PRIVATE TYPES */
+typedef struct nvs_entry {
+  char key[NVS_KEY_NAME_MAX];
+  void* value;
+  size_t length;
+  struct nvs_entry* next;
+} NvsEntry;
+
+typedef struct {
+  char name[NVS_KEY_NAME_MAX];
+  NvsEntry* entries;
+} NvsNamespace;
+
+/* GLOBAL VARIABLES */
+static NvsNamespace g_namespaces[MAX_NAMESPACES] = {0};
+static size_t g_namespaces_count = 0;
+
+/* PRIVATE PROTOTYPES */
+static NvsNamespace* get_namespace(nvs_handle_t handle);
+static NvsEntry* find_entry(NvsNamespace* ns, const char* key);
+
+/* FUNCTIONS */
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+  if (strlen(name) >= NVS_KEY_NAME_MAX) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (size_t i = 0; i < g_namespaces_count; i++) {
+    if (strcmp(g_namespaces[i].name, name) == 0) {
+      *out_handle = i + 1;
+      return ESP_OK;
+    }
+  }
+  if (g_namespaces_count == MAX_NAMESPACES) {
+    return ESP_ERR_NO_MEM;
+  }
+  strcpy(g_namespaces[g_namespaces_count].name, name);
+  *out_handle = ++g_namespaces_count;
+  return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length) {
+  NvsNamespace* ns = get_namespace(handle);
+  if (!ns) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  NvsEntry* entry = find_entry(ns, key);
+  if (!entry) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  if (!out_value) {
+    *length = entry->length;
+    return ESP_OK;
+  }
+  if (*length < entry->length) {
+    *length = entry->length;
+    return ESP_ERR_NVS_INVALID_LENGTH;
+  }
+  memcpy(out_value, entry->value, entry->length);
+  *length = entry->length;
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+  NvsNamespace* ns = get_namespace(handle);
+  if (!ns) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  if (strlen(key) >= NVS_KEY_NAME_MAX) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  NvsEntry* entry = find_entry(ns, key);
+  if (!entry) {
+    entry = calloc(1, sizeof(NvsEntry));
+    strcpy(entry->key, key);
+    entry->next = ns->entries;
+    ns->entries = entry;
+  }
+  free(entry->value);
+  entry->value = malloc(length);
+  memcpy(entry->value, value, length);
+  entry->length = length;
+  return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+  NvsNamespace* ns = get_namespace(handle);
+  if (!ns) {
+    return ESP_ERR_NVS_INVALID_HANDLE;
+  }
+  for (NvsEntry** link = &ns->entries; *link; link = &(*link)->next) {
+    if (strcmp((*link)->key, key) == 0) {
+      NvsEntry* entry = *link;
+      *link = entry->next;
+      free(entry->value);
+      free(entry);
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+  return get_namespace(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+static NvsNamespace* get_namespace(nvs_handle_t handle) {
+  if (handle == 0 || handle > g_namespaces_count) {
+    return NULL;
+  }
+  return &g_namespaces[handle - 1];
+}
+
+static NvsEntry* find_entry(NvsNamespace* ns, const char* key) {
+  for (NvsEntry* entry = ns->entries; entry; entry = entry->next) {
+    if (strcmp(entry->key, key) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,94 @@
+#include <esp_partition.h>
+#include <host_partition.h>
+
+#include <stdio.h>
+#include <string.h>
+
+/* In-memory flash with the trace partition of partitions.csv. Like NOR flash,
+ * writes only clear bits and erases work on whole sectors. */
+
+/* PRIVATE CONSTANTS */
+#define FLASH_SECTOR_SIZE    4096
+#define TRACE_PARTITION_SIZE 0xC0000
+
+/* GLOBAL VARIABLES */
+static const esp_partition_t g_trace_partition = {
+    .type = ESP_PARTITION_TYPE_DATA,
+    .subtype = (esp_partition_subtype_t)0x40,
+    .address = 0x140000,
+    .size = TRACE_PARTITION_SIZE,
+    .label = "trace",
+};
+static uint8_t g_flash[TRACE_PARTITION_SIZE];
+static bool g_flash_initialized = false;
+
+/* PRIVATE PROTOTYPES */
+static void init_flash();
+static bool is_in_range(const esp_partition_t* partition, size_t offset, size_t size);
+
+/* FUNCTIONS */
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char* label) {
+  if (type != g_trace_partition.type || (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != g_trace_partition.subtype) ||
+      (label && strcmp(label, g_trace_partition.label) != 0)) {
+    return NULL;
+  }
+  init_flash();
+  return &g_trace_partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+  if (!is_in_range(partition, src_offset, size)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  memcpy(dst, g_flash + src_offset, size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size) {
+  if (!is_in_range(partition, dst_offset, size)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  const uint8_t* bytes = src;
+  for (size_t i = 0; i < size; i++) {
+    g_flash[dst_offset + i] &= bytes[i];
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+  if (!is_in_range(partition, offset, size)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  if (offset % FLASH_SECTOR_SIZE != 0 || size % FLASH_SECTOR_SIZE != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memset(g_flash + offset, 0xFF, size);
+  return ESP_OK;
+}
+
+bool host_partition_save(const char* path) {
+  init_flash();
+  FILE* file = fopen(path, "wb");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  const bool written = fwrite(g_flash, 1, sizeof(g_flash), file) == sizeof(g_flash);
+  if (fclose(file) != 0 || !written) {
+    perror(path);
+    return false;
+  }
+  return true;
+}
+
+/* Erased, as a new device */
+static void init_flash() {
+  if (!g_flash_initialized) {
+    memset(g_flash, 0xFF, sizeof(g_flash));
+    g_flash_initialized = true;
+  }
+}
+
+static bool is_in_range(const esp_partition_t* partition, size_t offset, size_t size) {
+  return partition == &g_trace_partition && offset <= partition->size && size <= partition->size - offset;
+}
@@ -0,0 +1,34 @@
+#include <ping_handler.h>
+
+#include <esp_log.h>
+#include <proj_conf.h>
+
+/* PRIVATE CONSTANTS */
+#define TAG "ping_handler"
+
+/* GLOBAL VARIABLES */
+static uint32_t g_ping_interval_ms = GATEWAY_PING_INTERVAL_MS;
+static bool g_ping_started = false;
+
+/* FUNCTIONS */
+/* On host the samples come from the trace, so there's nothing to ping. The
+ * interval is kept for the replay, which skips samples to follow it. */
+void init_gateway_ping() {
+  g_ping_started = true;
+  ESP_LOGI(TAG, "Gateway ping is not used on host");
+}
+
+void set_gateway_ping_interval(uint32_t interval_ms) {
+  if (interval_ms != g_ping_interval_ms) {
+    g_ping_interval_ms = interval_ms;
+    ESP_LOGI(TAG, "Gateway ping interval is %u ms", interval_ms);
+  }
+}
+
+uint32_t get_gateway_ping_interval() {
+  return g_ping_interval_ms;
+}
+
+bool is_gateway_ping_started() {
+  return g_ping_started;
+}
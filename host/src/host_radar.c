@@ -0,0 +1,91 @@
+#include <host_radar.h>
+
+/* Stand-in for libesp-csi. It doesn't look at CSI at all: samples come from
+ * host_radar_feed(). Training reports the largest values seen while it ran. */
+
+/* GLOBAL VARIABLES */
+static wifi_radar_config_t g_config = {0};
+static bool g_started = false;
+
+static bool g_training = false;
+static wifi_radar_info_t g_training_max = {0};
+
+/* FUNCTIONS */
+esp_err_t esp_radar_init(void) {
+  return ESP_OK;
+}
+
+esp_err_t esp_radar_deinit(void) {
+  g_started = false;
+  return ESP_OK;
+}
+
+esp_err_t esp_radar_set_config(const wifi_radar_config_t* config) {
+  if (!config) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  g_config = *config;
+  return ESP_OK;
+}
+
+esp_err_t esp_radar_get_config(wifi_radar_config_t* config) {
+  if (!config) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  *config = g_config;
+  return ESP_OK;
+}
+
+esp_err_t esp_radar_start(void) {
+  g_started = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_radar_stop(void) {
+  g_started = false;
+  return ESP_OK;
+}
+
+esp_err_t esp_radar_csi_start() {
+  return ESP_OK;
+}
+
+esp_err_t esp_radar_csi_stop() {
+  return ESP_OK;
+}
+
+esp_err_t esp_radar_train_start(void) {
+  g_training = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_radar_train_remove(void) {
+  g_training_max = (wifi_radar_info_t){0};
+  return ESP_OK;
+}
+
+esp_err_t esp_radar_train_stop(float* wander_threshold, float* jitter_threshold) {
+  g_training = false;
+  *wander_threshold = g_training_max.waveform_wander;
+  *jitter_threshold = g_training_max.waveform_jitter;
+  return ESP_OK;
+}
+
+void host_radar_feed(const wifi_radar_info_t* info) {
+  if (!g_started) {
+    return;
+  }
+  if (g_training) {
+    g_training_max.waveform_jitter = fmaxf(g_training_max.waveform_jitter, info->waveform_jitter);
+    g_training_max.waveform_wander = fmaxf(g_training_max.waveform_wander, info->waveform_wander);
+  }
+  if (g_config.wifi_radar_cb) {
+    g_config.wifi_radar_cb(info, g_config.wifi_radar_cb_ctx);
+  }
+}
+
+void host_radar_feed_csi(const wifi_csi_filtered_info_t* info) {
+  if (g_started && g_config.wifi_csi_filtered_cb) {
+    g_config.wifi_csi_filtered_cb(info, g_config.wifi_csi_cb_ctx);
+  }
+}
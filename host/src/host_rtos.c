@@ -0,0 +1,368 @@
+#include <host_rtos.h>
+
+#include <assert.h>
+#include <esp_timer.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+/* Deterministic single-threaded FreeRTOS stand-in. Every task is a coroutine
+ * that runs until it blocks, and time only moves when the host asks for it,
+ * so a trace can be pushed through the firmware as fast as the CPU allows. */
+
+/* PRIVATE CONSTANTS */
+#define TASK_MIN_STACK_SIZE (64 * 1024)
+#define NEVER               UINT64_MAX
+
+/* PRIVATE ENUMS */
+typedef enum {
+  TASK_READY,
+  TASK_BLOCKED,
+  TASK_DELETED,
+} TaskState;
+
+/* PRIVATE TYPES */
+struct host_task {
+  ucontext_t context;
+  void* stack;
+  TaskFunction_t function;
+  void* arg;
+  const char* name;
+  TaskState state;
+  uint64_t wake_tick;
+  const void* waiting_on;
+  uint32_t notification_value;
+  struct host_task* next;
+};
+
+struct host_queue {
+  uint8_t* items;
+  UBaseType_t length;
+  UBaseType_t item_size;
+  UBaseType_t head;
+  UBaseType_t count;
+};
+
+struct host_timer {
+  const char* name;
+  uint64_t period;
+  bool auto_reload;
+  void* id;
+  TimerCallbackFunction_t callback;
+  bool active;
+  uint64_t expiry_tick;
+  struct host_timer* next;
+};
+
+/* GLOBAL VARIABLES */
+static ucontext_t g_scheduler_context;
+static struct host_task* g_tasks = NULL;
+static struct host_task* g_current_task = NULL;
+static struct host_timer* g_timers = NULL;
+static uint64_t g_tick = 0;
+
+/* PRIVATE PROTOTYPES */
+static void task_entry();
+static void switch_to(struct host_task* task);
+static uint64_t deadline_after(TickType_t ticks_to_wait);
+static bool block_current_task(const void* object, uint64_t deadline);
+static void wake_waiting_tasks(const void* object);
+static void wake_timed_out_tasks();
+static uint64_t next_event_tick();
+static void fire_expired_timers();
+
+/* FUNCTIONS */
+void host_rtos_run_ready() {
+  assert(g_current_task == NULL);
+  bool any_ran;
+  do {
+    any_ran = false;
+    for (struct host_task* task = g_tasks; task; task = task->next) {
+      if (task->state == TASK_READY) {
+        switch_to(task);
+        any_ran = true;
+      }
+    }
+  } while (any_ran);
+}
+
+void host_rtos_advance_to(uint64_t tick) {
+  host_rtos_run_ready();
+  uint64_t next_tick;
+  while ((next_tick = next_event_tick()) <= tick) {
+    if (next_tick > g_tick) {
+      g_tick = next_tick;
+    }
+    fire_expired_timers();
+    wake_timed_out_tasks();
+    host_rtos_run_ready();
+  }
+  if (tick > g_tick) {
+    g_tick = tick;
+  }
+}
+
+uint64_t host_rtos_now_ticks() {
+  return g_tick;
+}
+
+uint64_t host_rtos_now_ms() {
+  return g_tick * portTICK_PERIOD_MS;
+}
+
+int64_t esp_timer_get_time(void) {
+  return (int64_t)host_rtos_now_ms() * 1000;
+}
+
+/* Tasks */
+BaseType_t xTaskCreate(TaskFunction_t task_code,
+                       const char* name,
+                       uint32_t stack_depth,
+                       void* parameters,
+                       UBaseType_t priority,
+                       TaskHandle_t* created_task) {
+  struct host_task* task = calloc(1, sizeof(struct host_task));
+  size_t stack_size = stack_depth < TASK_MIN_STACK_SIZE ? TASK_MIN_STACK_SIZE : stack_depth;
+  task->stack = malloc(stack_size);
+  if (!task->stack) {
+    free(task);
+    return pdFAIL;
+  }
+  task->function = task_code;
+  task->arg = parameters;
+  task->name = name;
+  task->state = TASK_READY;
+  task->wake_tick = NEVER;
+
+  getcontext(&task->context);
+  task->context.uc_stack.ss_sp = task->stack;
+  task->context.uc_stack.ss_size = stack_size;
+  task->context.uc_link = NULL;
+  makecontext(&task->context, task_entry, 0);
+
+  // Append to keep the round-robin order equal to creation order
+  struct host_task** tail = &g_tasks;
+  while (*tail) {
+    tail = &(*tail)->next;
+  }
+  *tail = task;
+
+  if (created_task) {
+    *created_task = task;
+  }
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (!task) {
+    task = g_current_task;
+  }
+  task->state = TASK_DELETED;
+  if (task == g_current_task) {
+    swapcontext(&task->context, &g_scheduler_context);
+  }
+}
+
+void vTaskDelay(TickType_t ticks_to_delay) {
+  if (!g_current_task) {
+    return;
+  }
+  uint64_t deadline = deadline_after(ticks_to_delay);
+  while (block_current_task(NULL, deadline)) {
+  }
+}
+
+TickType_t xTaskGetTickCount(void) {
+  return (TickType_t)g_tick;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  task->notification_value++;
+  wake_waiting_tasks(task);
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait) {
+  struct host_task* task = g_current_task;
+  uint64_t deadline = deadline_after(ticks_to_wait);
+  while (task->notification_value == 0) {
+    if (ticks_to_wait == 0 || !block_current_task(task, deadline)) {
+      return 0;
+    }
+  }
+  const uint32_t value = task->notification_value;
+  task->notification_value = clear_count_on_exit ? 0 : value - 1;
+  return value;
+}
+
+/* Queues */
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  struct host_queue* queue = calloc(1, sizeof(struct host_queue));
+  queue->items = calloc(length, item_size);
+  queue->length = length;
+  queue->item_size = item_size;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  free(queue->items);
+  free(queue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+  uint64_t deadline = deadline_after(ticks_to_wait);
+  while (queue->count == queue->length) {
+    if (!g_current_task || ticks_to_wait == 0 || !block_current_task(queue, deadline)) {
+      return errQUEUE_FULL;
+    }
+  }
+  UBaseType_t tail = (queue->head + queue->count) % queue->length;
+  memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+  queue->count++;
+  wake_waiting_tasks(queue);
+  return pdPASS;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void* item) {
+  memcpy(queue->items + queue->head * queue->item_size, item, queue->item_size);
+  queue->count = 1;
+  wake_waiting_tasks(queue);
+  return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait) {
+  uint64_t deadline = deadline_after(ticks_to_wait);
+  while (queue->count == 0) {
+    if (!g_current_task || ticks_to_wait == 0 || !block_current_task(queue, deadline)) {
+      return errQUEUE_EMPTY;
+    }
+  }
+  memcpy(buffer, queue->items + queue->head * queue->item_size, queue->item_size);
+  queue->head = (queue->head + 1) % queue->length;
+  queue->count--;
+  wake_waiting_tasks(queue);
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return queue->count;
+}
+
+/* Timers */
+TimerHandle_t xTimerCreate(const char* name,
+                           TickType_t period,
+                           UBaseType_t auto_reload,
+                           void* timer_id,
+                           TimerCallbackFunction_t callback) {
+  struct host_timer* timer = calloc(1, sizeof(struct host_timer));
+  timer->name = name;
+  timer->period = period;
+  timer->auto_reload = auto_reload;
+  timer->id = timer_id;
+  timer->callback = callback;
+  timer->next = g_timers;
+  g_timers = timer;
+  return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks_to_wait) {
+  timer->active = true;
+  timer->expiry_tick = g_tick + timer->period;
+  return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks_to_wait) {
+  timer->active = false;
+  return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks_to_wait) {
+  return xTimerStart(timer, ticks_to_wait);
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t new_period, TickType_t ticks_to_wait) {
+  timer->period = new_period;
+  return xTimerStart(timer, ticks_to_wait);
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer) {
+  return timer->active ? pdTRUE : pdFALSE;
+}
+
+void* pvTimerGetTimerID(TimerHandle_t timer) {
+  return timer->id;
+}
+
+/* Scheduler internals */
+static void task_entry() {
+  struct host_task* task = g_current_task;
+  task->function(task->arg);
+  vTaskDelete(NULL);
+}
+
+static void switch_to(struct host_task* task) {
+  g_current_task = task;
+  swapcontext(&g_scheduler_context, &task->context);
+  g_current_task = NULL;
+}
+
+static uint64_t deadline_after(TickType_t ticks_to_wait) {
+  return ticks_to_wait == portMAX_DELAY ? NEVER : g_tick + ticks_to_wait;
+}
+
+/* Returns false if the wait ended because the deadline passed. A wake-up only
+ * means that the object changed, so callers re-check their condition. */
+static bool block_current_task(const void* object, uint64_t deadline) {
+  struct host_task* task = g_current_task;
+  task->state = TASK_BLOCKED;
+  task->waiting_on = object;
+  task->wake_tick = deadline;
+  swapcontext(&task->context, &g_scheduler_context);
+  task->waiting_on = NULL;
+  return g_tick < deadline;
+}
+
+static void wake_waiting_tasks(const void* object) {
+  for (struct host_task* task = g_tasks; task; task = task->next) {
+    if (task->state == TASK_BLOCKED && task->waiting_on == object) {
+      task->state = TASK_READY;
+    }
+  }
+}
+
+static void wake_timed_out_tasks() {
+  for (struct host_task* task = g_tasks; task; task = task->next) {
+    if (task->state == TASK_BLOCKED && task->wake_tick <= g_tick) {
+      task->state = TASK_READY;
+    }
+  }
+}
+
+static uint64_t next_event_tick() {
+  uint64_t next_tick = NEVER;
+  for (struct host_timer* timer = g_timers; timer; timer = timer->next) {
+    if (timer->active && timer->expiry_tick < next_tick) {
+      next_tick = timer->expiry_tick;
+    }
+  }
+  for (struct host_task* task = g_tasks; task; task = task->next) {
+    if (task->state == TASK_BLOCKED && task->wake_tick < next_tick) {
+      next_tick = task->wake_tick;
+    }
+  }
+  return next_tick;
+}
+
+static void fire_expired_timers() {
+  for (struct host_timer* timer = g_timers; timer; timer = timer->next) {
+    if (!timer->active || timer->expiry_tick > g_tick) {
+      continue;
+    }
+    if (timer->auto_reload) {
+      timer->expiry_tick += timer->period;
+    } else {
+      timer->active = false;
+    }
+    timer->callback(timer);
+  }
+}
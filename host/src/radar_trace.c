@@ -0,0 +1,130 @@
+#include <radar_trace.h>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <trace_file.h>
+
+/* PRIVATE CONSTANTS */
+#define LINE_MAX_LENGTH  256
+#define INITIAL_CAPACITY 4096
+#define BOOT_GAP_MS      1000  // Between the last sample before a boot and the first after
+
+/* PRIVATE PROTOTYPES */
+static int parse_line(const char* line, double values[4]);
+static void load_trace_file(const TraceFile* file, RadarTrace* trace);
+
+/* FUNCTIONS */
+bool radar_trace_load_csv(const char* path, uint32_t default_interval_ms, RadarTrace* trace) {
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+
+  size_t capacity = INITIAL_CAPACITY;
+  trace->samples = malloc(capacity * sizeof(RadarTraceSample));
+  trace->count = 0;
+
+  char line[LINE_MAX_LENGTH];
+  size_t line_number = 0;
+  while (fgets(line, sizeof(line), file)) {
+    line_number++;
+    const char* start = line;
+    while (isspace((unsigned char)*start)) {
+      start++;
+    }
+    if (*start == '\0' || *start == '#' || isalpha((unsigned char)*start)) {
+      continue;
+    }
+
+    double values[4];
+    int values_count = parse_line(start, values);
+    if (values_count < 2) {
+      fprintf(stderr, "%s:%zu: expected 2 to 4 comma separated values\n", path, line_number);
+      radar_trace_free(trace);
+      fclose(file);
+      return false;
+    }
+
+    if (trace->count == capacity) {
+      capacity *= 2;
+      trace->samples = realloc(trace->samples, capacity * sizeof(RadarTraceSample));
+    }
+    RadarTraceSample* sample = &trace->samples[trace->count];
+    sample->occupied = values_count == 4 ? values[3] != 0 : RADAR_TRACE_UNLABELED;
+    if (values_count >= 3) {
+      sample->timestamp_ms = (uint32_t)values[0];
+      sample->info.waveform_jitter = (float)values[1];
+      sample->info.waveform_wander = (float)values[2];
+    } else {
+      sample->timestamp_ms = trace->count * default_interval_ms;
+      sample->info.waveform_jitter = (float)values[0];
+      sample->info.waveform_wander = (float)values[1];
+    }
+    trace->count++;
+  }
+
+  fclose(file);
+  return true;
+}
+
+bool radar_trace_load(const char* path, uint32_t default_interval_ms, RadarTrace* trace) {
+  TraceFile file;
+  if (!trace_file_open(path, &file)) {
+    return radar_trace_load_csv(path, default_interval_ms, trace);
+  }
+  load_trace_file(&file, trace);
+  trace_file_close(&file);
+  return true;
+}
+
+void radar_trace_free(RadarTrace* trace) {
+  free(trace->samples);
+  trace->samples = NULL;
+  trace->count = 0;
+}
+
+static int parse_line(const char* line, double values[4]) {
+  int count = 0;
+  const char* cursor = line;
+  while (count < 4) {
+    char* end;
+    values[count] = strtod(cursor, &end);
+    if (end == cursor) {
+      break;
+    }
+    count++;
+    while (isspace((unsigned char)*end)) {
+      end++;
+    }
+    if (*end != ',') {
+      break;
+    }
+    cursor = end + 1;
+  }
+  return count;
+}
+
+static void load_trace_file(const TraceFile* file, RadarTrace* trace) {
+  trace->samples = malloc((file->records_count ? file->records_count : 1) * sizeof(RadarTraceSample));
+  trace->count = 0;
+
+  uint32_t boot_offset_ms = 0;
+  uint32_t last_ms = 0;
+  for (size_t i = 0; i < file->sectors_count; i++) {
+    const TraceSector* sector = &file->sectors[i];
+    if (sector->header->flags & TRACE_FLAG_BOOT && trace->count > 0) {
+      boot_offset_ms = last_ms + BOOT_GAP_MS - sector->header->base_ms;
+    }
+    for (size_t j = 0; j < sector->count; j++) {
+      const TraceRecord* record = &sector->records[j];
+      RadarTraceSample* sample = &trace->samples[trace->count++];
+      sample->timestamp_ms = trace_record_time_ms(sector, record) + boot_offset_ms;
+      sample->info.waveform_jitter = trace_decode_value(record->jitter);
+      sample->info.waveform_wander = trace_decode_value(record->wander);
+      sample->occupied = RADAR_TRACE_UNLABELED;
+      last_ms = sample->timestamp_ms;
+    }
+  }
+}
@@ -0,0 +1,81 @@
+#include <trace_file.h>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* PRIVATE PROTOTYPES */
+static size_t count_records(const TraceRecord* records);
+static int compare_sequences(const void* a, const void* b);
+
+/* FUNCTIONS */
+bool trace_file_open(const char* path, TraceFile* file) {
+  *file = (TraceFile){0};
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size < TRACE_SECTOR_SIZE) {
+    close(fd);
+    return false;
+  }
+  file->size = status.st_size;
+  const void* map = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  file->map = map;
+
+  const size_t max_sectors = file->size / TRACE_SECTOR_SIZE;
+  file->sectors = malloc(max_sectors * sizeof(TraceSector));
+  for (size_t i = 0; i < max_sectors; i++) {
+    const uint8_t* sector = file->map + i * TRACE_SECTOR_SIZE;
+    const TraceSectorHeader* header = (const TraceSectorHeader*)sector;
+    if (header->magic != TRACE_MAGIC || header->version != TRACE_VERSION || header->record_size != TRACE_RECORD_SIZE) {
+      continue;
+    }
+    const TraceRecord* records = (const TraceRecord*)(sector + TRACE_HEADER_SIZE);
+    const size_t count = count_records(records);
+    file->sectors[file->sectors_count++] = (TraceSector){.header = header, .records = records, .count = count};
+    file->records_count += count;
+  }
+  if (file->sectors_count == 0) {
+    trace_file_close(file);
+    return false;
+  }
+  qsort(file->sectors, file->sectors_count, sizeof(TraceSector), compare_sequences);
+  return true;
+}
+
+void trace_file_close(TraceFile* file) {
+  if (file->map) {
+    munmap((void*)file->map, file->size);
+  }
+  free(file->sectors);
+  *file = (TraceFile){0};
+}
+
+/* Records are written in order, so the erased ones are all at the end */
+static size_t count_records(const TraceRecord* records) {
+  size_t low = 0;
+  size_t high = TRACE_RECORDS_PER_SECTOR;
+  while (low < high) {
+    const size_t middle = (low + high) / 2;
+    if (records[middle].state & TRACE_STATE_UNWRITTEN) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+  return low;
+}
+
+static int compare_sequences(const void* a, const void* b) {
+  const uint32_t sequence_a = ((const TraceSector*)a)->header->sequence;
+  const uint32_t sequence_b = ((const TraceSector*)b)->header->sequence;
+  return sequence_a < sequence_b ? -1 : sequence_a > sequence_b;
+}
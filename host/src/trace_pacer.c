@@ -0,0 +1,16 @@
+#include <trace_pacer.h>
+
+/* FUNCTIONS */
+void trace_pacer_init(TracePacer* pacer, uint32_t interval_ms) {
+  *pacer = (TracePacer){.interval_ms = interval_ms};
+}
+
+/* Half a trace interval of slack, so jitter in the timestamps doesn't skip twice as many */
+bool trace_pacer_take(TracePacer* pacer, uint64_t time_ms, uint32_t ping_interval_ms) {
+  if (pacer->fed_count > 0 && time_ms - pacer->fed_at_ms + pacer->interval_ms / 2 < ping_interval_ms) {
+    return false;
+  }
+  pacer->fed_at_ms = time_ms;
+  pacer->fed_count++;
+  return true;
+}
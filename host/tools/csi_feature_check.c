@@ -0,0 +1,286 @@
+#include <csi_codec.h>
+#include <csi_features.h>
+#include <ctype.h>
+#include <getopt.h>
+#include <math.h>
+#include <mqtt_frame.h>
+#include <mqtt_handler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Runs the in-tree CSI features over a recorded CSI stream and compares the
+ * fixed-point kernel with the float one and both with the jitter/wander that
+ * esp-csi reported on the device. esp-csi reports a window with the frame after
+ * it, so every frame is compared with the latest window before it. The PCA
+ * kernel runs alongside and is only correlated with the library, its values
+ * are on their own scale. Reads the same input as radar_frame_decode and prints
+ * one CSV row per window. Exits with failure if the kernels disagree or, with
+ * -l, if the float one differs from the library by more than the given amount. */
+
+/* PRIVATE CONSTANTS */
+#define LINE_MAX_LENGTH (2 * MQTT_FRAME_MAX_SIZE + 256)
+
+#define DEFAULT_TOLERANCE 0.01
+
+/* PRIVATE TYPES */
+typedef struct {
+  double count;
+  double sum_x;
+  double sum_y;
+  double sum_xx;
+  double sum_yy;
+  double sum_xy;
+} Correlation;
+
+typedef struct {
+  CsiFeaturesFixed fixed;
+  CsiFeaturesFloat floating;
+  CsiFeaturesPca pca;
+  uint32_t train_start_ms;
+  uint32_t train_stop_ms;
+  bool training_started;
+  bool training_stopped;
+  wifi_radar_info_t latest_fixed;  // Latest window of each kernel
+  wifi_radar_info_t latest_float;
+  wifi_radar_info_t latest_pca;
+  bool row_pending;  // The row of the latest window waits for the library value of the next frame
+  uint32_t row_timestamp_ms;
+  uint64_t frames;
+  uint64_t windows;
+  double fixed_ns;
+  double float_ns;
+  double pca_ns;
+  double max_jitter_error;
+  double max_wander_error;
+  double max_jitter_library_error;
+  double max_wander_library_error;
+  double max_float_library_error;
+  Correlation pca_jitter_correlation;
+  Correlation pca_wander_correlation;
+} CheckState;
+
+/* PRIVATE PROTOTYPES */
+static void print_usage(const char* program);
+static size_t parse_hex(const char* hex, uint8_t* bytes, size_t max_size);
+static bool parse_interval(const char* text, uint32_t* start_ms, uint32_t* stop_ms);
+static void check_frame(CheckState* state, const CsiFrame* frame);
+static void add_correlation(Correlation* correlation, double x, double y);
+static double get_correlation(const Correlation* correlation);
+static double get_time_ns();
+
+/* MAIN */
+int main(int argc, char** argv) {
+  static char line[LINE_MAX_LENGTH];
+  static uint8_t bytes[MQTT_FRAME_MAX_SIZE];
+  static CsiFrame frames[UINT8_MAX];
+  static CheckState state;
+
+  uint16_t window_frames = CSI_WINDOW_FRAMES;
+  uint8_t components_count = CSI_PCA_COMPONENTS;
+  double tolerance = DEFAULT_TOLERANCE;
+  double library_tolerance = INFINITY;
+  state.train_start_ms = UINT32_MAX;
+  state.train_stop_ms = UINT32_MAX;
+
+  int option;
+  while ((option = getopt(argc, argv, "w:k:e:l:t:h")) != -1) {
+    switch (option) {
+      case 'w':
+        window_frames = strtoul(optarg, NULL, 10);
+        break;
+      case 'k':
+        components_count = strtoul(optarg, NULL, 10);
+        break;
+      case 'e':
+        tolerance = strtod(optarg, NULL);
+        break;
+      case 'l':
+        library_tolerance = strtod(optarg, NULL);
+        break;
+      case 't':
+        if (!parse_interval(optarg, &state.train_start_ms, &state.train_stop_ms)) {
+          fprintf(stderr, "Invalid training interval: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      default:
+        print_usage(argv[0]);
+        return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (optind < argc - 1 || (optind == argc - 1 && !freopen(argv[optind], "r", stdin))) {
+    if (optind == argc - 1) {
+      perror(argv[optind]);
+    } else {
+      print_usage(argv[0]);
+    }
+    return EXIT_FAILURE;
+  }
+
+  csi_features_init_fixed(&state.fixed, window_frames);
+  csi_features_init_float(&state.floating, window_frames);
+  csi_features_init_pca(&state.pca, window_frames, components_count);
+  printf("timestamp_ms,jitter_fixed,jitter_float,jitter_pca,jitter_library,wander_fixed,wander_float,wander_pca,wander_library\n");
+  while (fgets(line, sizeof(line), stdin)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    const char* hex = strrchr(line, ' ');
+    hex = hex ? hex + 1 : line;
+
+    MqttFrame frame;
+    const size_t size = parse_hex(hex, bytes, sizeof(bytes));
+    if (size == 0 || !mqtt_frame_decode(bytes, size, &frame) || frame.msg_id != MQTT_TX_MSG_CSI) {
+      continue;
+    }
+    const int count = csi_batch_decode(frame.payload, frame.payload_size, frames, UINT8_MAX);
+    for (int i = 0; i < count; i++) {
+      check_frame(&state, &frames[i]);
+    }
+  }
+
+  if (state.windows == 0) {
+    fprintf(stderr, "Not enough CSI frames for a window\n");
+    return EXIT_FAILURE;
+  }
+  fprintf(stderr, "Frames: %llu; windows: %llu\n", (unsigned long long)state.frames, (unsigned long long)state.windows);
+  fprintf(stderr, "Time per frame: fixed %.0f ns, float %.0f ns, PCA %.0f ns\n", state.fixed_ns / state.frames,
+          state.float_ns / state.frames, state.pca_ns / state.frames);
+  fprintf(stderr, "Largest fixed/float difference: jitter %.6f, wander %.6f\n", state.max_jitter_error, state.max_wander_error);
+  fprintf(stderr, "Largest fixed difference from the library: jitter %.6f, wander %.6f\n", state.max_jitter_library_error,
+          state.max_wander_library_error);
+  fprintf(stderr, "Largest float difference from the library: %.2g\n", state.max_float_library_error);
+  fprintf(stderr, "PCA correlation with the library: jitter %.3f, wander %.3f\n",
+          get_correlation(&state.pca_jitter_correlation), get_correlation(&state.pca_wander_correlation));
+
+  bool passed = true;
+  if (state.max_jitter_error > tolerance || state.max_wander_error > tolerance) {
+    fprintf(stderr, "FAIL: fixed and float kernels differ by more than %g\n", tolerance);
+    passed = false;
+  }
+  if (state.max_float_library_error > library_tolerance) {
+    fprintf(stderr, "FAIL: the float kernel differs from the library by more than %g\n", library_tolerance);
+    passed = false;
+  }
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* FUNCTIONS */
+static void print_usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options] [frames.txt]\n"
+          "  -w <frames>      frames per window (default %d)\n"
+          "  -k <components>  principal components of the PCA kernel (default %d)\n"
+          "  -e <difference>  largest allowed fixed/float difference (default %g)\n"
+          "  -l <difference>  largest allowed float difference from the library\n"
+          "  -t <start:stop>  train from start_ms to stop_ms of the stream timestamps, like the device calibration\n",
+          program, CSI_WINDOW_FRAMES, CSI_PCA_COMPONENTS, DEFAULT_TOLERANCE);
+}
+
+static size_t parse_hex(const char* hex, uint8_t* bytes, size_t max_size) {
+  const size_t length = strlen(hex);
+  if (length % 2 != 0 || length / 2 > max_size) {
+    return 0;
+  }
+  for (size_t i = 0; i < length / 2; i++) {
+    if (!isxdigit((unsigned char)hex[2 * i]) || !isxdigit((unsigned char)hex[2 * i + 1])) {
+      return 0;
+    }
+    const char byte_hex[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+    bytes[i] = strtoul(byte_hex, NULL, 16);
+  }
+  return length / 2;
+}
+
+static bool parse_interval(const char* text, uint32_t* start_ms, uint32_t* stop_ms) {
+  char* end;
+  *start_ms = strtoul(text, &end, 10);
+  if (end == text || *end != ':') {
+    return false;
+  }
+  const char* stop = end + 1;
+  *stop_ms = strtoul(stop, &end, 10);
+  return end != stop && *end == '\0' && *stop_ms >= *start_ms;
+}
+
+static void check_frame(CheckState* state, const CsiFrame* frame) {
+  if (state->row_pending) {
+    printf("%u,%g,%g,%g,%g,%g,%g,%g,%g\n", state->row_timestamp_ms, state->latest_fixed.waveform_jitter,
+           state->latest_float.waveform_jitter, state->latest_pca.waveform_jitter, frame->waveform_jitter,
+           state->latest_fixed.waveform_wander, state->latest_float.waveform_wander, state->latest_pca.waveform_wander,
+           frame->waveform_wander);
+    add_correlation(&state->pca_jitter_correlation, state->latest_pca.waveform_jitter, frame->waveform_jitter);
+    add_correlation(&state->pca_wander_correlation, state->latest_pca.waveform_wander, frame->waveform_wander);
+    state->row_pending = false;
+  }
+  state->max_jitter_library_error = fmax(state->max_jitter_library_error, fabs(state->latest_fixed.waveform_jitter - frame->waveform_jitter));
+  state->max_wander_library_error = fmax(state->max_wander_library_error, fabs(state->latest_fixed.waveform_wander - frame->waveform_wander));
+  state->max_float_library_error = fmax(state->max_float_library_error, fmax(fabs(state->latest_float.waveform_jitter - frame->waveform_jitter),
+                                                                             fabs(state->latest_float.waveform_wander - frame->waveform_wander)));
+
+  if (!state->training_started && frame->timestamp_ms >= state->train_start_ms) {
+    csi_features_train_start_fixed(&state->fixed);
+    csi_features_train_start_float(&state->floating);
+    state->training_started = true;
+  }
+  if (!state->training_stopped && frame->timestamp_ms >= state->train_stop_ms) {
+    csi_features_train_stop_fixed(&state->fixed);
+    csi_features_train_stop_float(&state->floating);
+    state->training_stopped = true;
+  }
+
+  wifi_radar_info_t fixed;
+  wifi_radar_info_t floating;
+  wifi_radar_info_t pca;
+  double start_ns = get_time_ns();
+  const bool fixed_ready = csi_features_push_fixed(&state->fixed, frame->values, frame->values_count, frame->timestamp_ms, &fixed);
+  state->fixed_ns += get_time_ns() - start_ns;
+  start_ns = get_time_ns();
+  const bool float_ready = csi_features_push_float(&state->floating, frame->values, frame->values_count, frame->timestamp_ms, &floating);
+  state->float_ns += get_time_ns() - start_ns;
+  start_ns = get_time_ns();
+  const bool pca_ready = csi_features_push_pca(&state->pca, frame->values, frame->values_count, frame->timestamp_ms, &pca);
+  state->pca_ns += get_time_ns() - start_ns;
+  state->frames++;
+
+  if (pca_ready) {
+    state->latest_pca = pca;
+  }
+  if (!fixed_ready || !float_ready) {
+    if (fixed_ready != float_ready) {
+      // Both kernels window the same frames, so this counts as a difference of a whole window
+      state->max_jitter_error = INFINITY;
+    }
+    return;
+  }
+  state->windows++;
+  state->max_jitter_error = fmax(state->max_jitter_error, fabs(fixed.waveform_jitter - floating.waveform_jitter));
+  state->max_wander_error = fmax(state->max_wander_error, fabs(fixed.waveform_wander - floating.waveform_wander));
+  state->latest_fixed = fixed;
+  state->latest_float = floating;
+  state->row_pending = true;
+  state->row_timestamp_ms = frame->timestamp_ms;
+}
+
+static void add_correlation(Correlation* correlation, double x, double y) {
+  correlation->count++;
+  correlation->sum_x += x;
+  correlation->sum_y += y;
+  correlation->sum_xx += x * x;
+  correlation->sum_yy += y * y;
+  correlation->sum_xy += x * y;
+}
+
+static double get_correlation(const Correlation* correlation) {
+  const double n = correlation->count;
+  const double covariance = n * correlation->sum_xy - correlation->sum_x * correlation->sum_y;
+  const double variance_x = n * correlation->sum_xx - correlation->sum_x * correlation->sum_x;
+  const double variance_y = n * correlation->sum_yy - correlation->sum_y * correlation->sum_y;
+  return variance_x > 0 && variance_y > 0 ? covariance / sqrt(variance_x * variance_y) : 0;
+}
+
+static double get_time_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
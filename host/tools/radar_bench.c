@@ -0,0 +1,490 @@
+#include <csi_codec.h>
+#include <csi_features.h>
+#include <detector_core.h>
+#include <esp_log.h>
+#include <getopt.h>
+#include <link_detectors.h>
+#include <math.h>
+#include <motion_classifier.h>
+#include <mqtt_frame.h>
+#include <mqtt_handler.h>
+#include <proj_conf.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sample_ring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Micro-benchmarks of the firmware hot paths on synthetic data: detection,
+ * the motion models, CSI features, MQTT payload encoding and the sample hand-off between the
+ * radar callback and the processing task.
+ *
+ * Prints one CSV row per benchmark with the fastest time per operation of all
+ * repeats. With -b, the rows are compared with an earlier output and the
+ * program fails if any benchmark got slower by more than the tolerance. Host
+ * times don't predict ESP32-C3 times, but a regression here is a regression
+ * there too. */
+
+/* PRIVATE CONSTANTS */
+#define DEFAULT_REPEATS   5
+#define DEFAULT_TOLERANCE 0.25
+#define LINE_MAX_LENGTH   256
+
+#define BENCH_SUBCARRIERS       64  // LLTF of a HT20 packet
+#define BENCH_LINKS             8
+#define BENCH_WINDOW_SIZE       10
+#define BENCH_NEEDED_DETECTIONS 2
+#define BENCH_TELEMETRY_BATCH   32  // Same as in telemetry.c
+#define BENCH_SAMPLES           1000  // Synthetic samples, the second half with movement
+#define BENCH_FRAMES            100   // Synthetic CSI frames, the second half with movement
+
+/* PRIVATE TYPES */
+typedef struct {
+  const char* name;
+  uint32_t iterations;  // Operations per repeat at scale 1
+  void (*run)(uint32_t iterations);
+} Benchmark;
+
+typedef struct {
+  const char* name;
+  double ns_per_op;
+} BaselineRow;
+
+typedef struct {
+  SampleRing ring;
+  uint32_t count;
+  uint32_t checksum;
+} HandOff;
+
+/* PRIVATE PROTOTYPES */
+static void print_usage(const char* program);
+static double run_benchmark(const Benchmark* benchmark, uint32_t iterations, int repeats);
+static size_t load_baseline(const char* path, BaselineRow* rows, size_t max_rows);
+static uint32_t next_random();
+static float random_unit();
+static void generate_data();
+static void generate_info(wifi_radar_info_t* info, bool moving);
+static void generate_csi(int8_t* data, bool moving);
+static void bench_detector_push(uint32_t iterations);
+static void bench_detector_links(uint32_t iterations);
+static void bench_detector_variant(uint32_t iterations);
+static void bench_motion_logistic(uint32_t iterations);
+static void bench_motion_tree(uint32_t iterations);
+static void bench_csi_features_fixed(uint32_t iterations);
+static void bench_csi_features_float(uint32_t iterations);
+static void bench_csi_features_pca(uint32_t iterations);
+static void bench_frame_encode(uint32_t iterations);
+static void bench_telemetry_encode(uint32_t iterations);
+static void bench_csi_batch_append(uint32_t iterations);
+static void bench_metrics_encode(uint32_t iterations);
+static void bench_sample_ring(uint32_t iterations);
+static void bench_sample_ring_threads(uint32_t iterations);
+static void* consume_samples(void* arg);
+static double get_time_ns();
+
+/* GLOBAL VARIABLES */
+static const Benchmark g_benchmarks[] = {
+    {"detector_push", 1000000, bench_detector_push},
+    {"detector_links", 1000000, bench_detector_links},
+    {"detector_variant", 1000000, bench_detector_variant},
+    {"motion_logistic", 1000000, bench_motion_logistic},
+    {"motion_tree", 1000000, bench_motion_tree},
+    {"csi_features_fixed", 100000, bench_csi_features_fixed},
+    {"csi_features_float", 100000, bench_csi_features_float},
+    {"csi_features_pca", 100000, bench_csi_features_pca},
+    {"frame_encode", 10000000, bench_frame_encode},
+    {"telemetry_encode", 1000000, bench_telemetry_encode},
+    {"csi_batch_append", 200000, bench_csi_batch_append},
+    {"metrics_encode", 100000, bench_metrics_encode},
+    {"sample_ring", 10000000, bench_sample_ring},
+    {"sample_ring_threads", 2000000, bench_sample_ring_threads},
+};
+#define BENCHMARKS_COUNT (sizeof(g_benchmarks) / sizeof(g_benchmarks[0]))
+
+static uint32_t g_random_state = 1;
+static volatile uint32_t g_sink = 0;  // Keeps the compiler from dropping results
+
+// Generated up front, so the benchmarks don't measure the generators
+static wifi_radar_info_t g_samples[BENCH_SAMPLES];
+static int8_t g_frames[BENCH_FRAMES][2 * BENCH_SUBCARRIERS];
+
+/* MAIN */
+int main(int argc, char** argv) {
+  static BaselineRow baseline[BENCHMARKS_COUNT * 4];
+  double scale = 1;
+  int repeats = DEFAULT_REPEATS;
+  double tolerance = DEFAULT_TOLERANCE;
+  const char* filter = NULL;
+  const char* baseline_path = NULL;
+
+  int option;
+  while ((option = getopt(argc, argv, "s:r:f:b:t:h")) != -1) {
+    switch (option) {
+      case 's':
+        scale = strtod(optarg, NULL);
+        break;
+      case 'r':
+        repeats = atoi(optarg);
+        break;
+      case 'f':
+        filter = optarg;
+        break;
+      case 'b':
+        baseline_path = optarg;
+        break;
+      case 't':
+        tolerance = strtod(optarg, NULL);
+        break;
+      default:
+        print_usage(argv[0]);
+        return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (optind != argc || scale <= 0 || repeats < 1) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  size_t baseline_count = 0;
+  if (baseline_path && !(baseline_count = load_baseline(baseline_path, baseline, sizeof(baseline) / sizeof(baseline[0])))) {
+    return EXIT_FAILURE;
+  }
+
+  esp_log_level_set("*", ESP_LOG_WARN);
+  generate_data();
+  bool passed = true;
+  printf("benchmark,iterations,ns_per_op\n");
+  for (size_t i = 0; i < BENCHMARKS_COUNT; i++) {
+    const Benchmark* benchmark = &g_benchmarks[i];
+    if (filter && !strstr(benchmark->name, filter)) {
+      continue;
+    }
+    const uint32_t iterations = fmax(1, benchmark->iterations * scale);
+    const double ns_per_op = run_benchmark(benchmark, iterations, repeats);
+    printf("%s,%u,%.2f\n", benchmark->name, iterations, ns_per_op);
+    fflush(stdout);
+
+    for (size_t j = 0; j < baseline_count; j++) {
+      if (strcmp(baseline[j].name, benchmark->name) == 0 && ns_per_op > baseline[j].ns_per_op * (1 + tolerance)) {
+        fprintf(stderr, "REGRESSION: %s takes %.2f ns, baseline %.2f ns\n", benchmark->name, ns_per_op, baseline[j].ns_per_op);
+        passed = false;
+      }
+    }
+  }
+  for (size_t i = 0; i < baseline_count; i++) {
+    free((char*)baseline[i].name);
+  }
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* FUNCTIONS */
+static void print_usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -s <factor>     iterations scale (default 1)\n"
+          "  -r <count>      repeats, the fastest one is reported (default %d)\n"
+          "  -f <text>       only benchmarks with this in the name\n"
+          "  -b <file.csv>   earlier output to compare with\n"
+          "  -t <fraction>   allowed slowdown against the baseline (default %g)\n",
+          program, DEFAULT_REPEATS, DEFAULT_TOLERANCE);
+}
+
+/* The fastest repeat is the one least disturbed by the rest of the machine */
+static double run_benchmark(const Benchmark* benchmark, uint32_t iterations, int repeats) {
+  benchmark->run(iterations / 10 + 1);  // Warm up caches and branch predictors
+  double best_ns = INFINITY;
+  for (int i = 0; i < repeats; i++) {
+    const double start_ns = get_time_ns();
+    benchmark->run(iterations);
+    best_ns = fmin(best_ns, get_time_ns() - start_ns);
+  }
+  return best_ns / iterations;
+}
+
+static size_t load_baseline(const char* path, BaselineRow* rows, size_t max_rows) {
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    perror(path);
+    return 0;
+  }
+  char line[LINE_MAX_LENGTH];
+  char name[LINE_MAX_LENGTH];
+  size_t count = 0;
+  double ns_per_op;
+  while (count < max_rows && fgets(line, sizeof(line), file)) {
+    if (sscanf(line, "%255[^,],%*u,%lf", name, &ns_per_op) == 2) {
+      rows[count++] = (BaselineRow){.name = strdup(name), .ns_per_op = ns_per_op};
+    }
+  }
+  fclose(file);
+  if (count == 0) {
+    fprintf(stderr, "%s: no benchmark rows\n", path);
+  }
+  return count;
+}
+
+/* xorshift32, so that every run sees the same data */
+static uint32_t next_random() {
+  g_random_state ^= g_random_state << 13;
+  g_random_state ^= g_random_state >> 17;
+  g_random_state ^= g_random_state << 5;
+  return g_random_state;
+}
+
+static float random_unit() {
+  return (next_random() >> 8) / (float)(1 << 24);
+}
+
+static void generate_data() {
+  for (int i = 0; i < BENCH_SAMPLES; i++) {
+    generate_info(&g_samples[i], i >= BENCH_SAMPLES / 2);
+  }
+  for (int i = 0; i < BENCH_FRAMES; i++) {
+    generate_csi(g_frames[i], i >= BENCH_FRAMES / 2);
+  }
+}
+
+/* Jitter of an empty room around 0.01 and of movement around 0.08, so the
+ * detector takes both branches */
+static void generate_info(wifi_radar_info_t* info, bool moving) {
+  const float level = moving ? 0.08f : 0.01f;
+  info->waveform_jitter = level * (0.7f + 0.6f * random_unit());
+  info->waveform_wander = 2 * info->waveform_jitter;
+}
+
+/* Amplitudes of a fixed channel shape, disturbed per subcarrier while moving */
+static void generate_csi(int8_t* data, bool moving) {
+  for (int i = 0; i < BENCH_SUBCARRIERS; i++) {
+    const float amplitude = 40 + 20 * sinf(i * 0.3f) + (moving ? 15 * (random_unit() - 0.5f) : 0) + 2 * (random_unit() - 0.5f);
+    data[2 * i] = (int8_t)(amplitude * sinf(i * 0.7f));
+    data[2 * i + 1] = (int8_t)(amplitude * cosf(i * 0.7f));
+  }
+}
+
+static void bench_detector_push(uint32_t iterations) {
+  static LinkDetectors detectors;
+  static const uint8_t mac[LINK_MAC_SIZE] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+  link_detectors_init(&detectors, BENCH_WINDOW_SIZE, BENCH_NEEDED_DETECTIONS, CALIBRATION_THRESHOLD_MARGIN);
+  link_detectors_reset(&detectors, &(wifi_radar_info_t){.waveform_jitter = 0.03f, .waveform_wander = 0.06f});
+
+  uint32_t detecting = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    LinkDetector* link = link_detectors_get(&detectors, mac, i * 10);
+    link_detector_push(&detectors, link, &g_samples[i % BENCH_SAMPLES], !detecting);
+    detecting = link_detectors_count_detecting(&detectors, i * 10, 2000);
+  }
+  g_sink += detecting;
+}
+
+static void bench_detector_links(uint32_t iterations) {
+  static LinkDetectors detectors;
+  link_detectors_init(&detectors, BENCH_WINDOW_SIZE, BENCH_NEEDED_DETECTIONS, CALIBRATION_THRESHOLD_MARGIN);
+  link_detectors_reset(&detectors, &(wifi_radar_info_t){.waveform_jitter = 0.03f, .waveform_wander = 0.06f});
+
+  uint8_t mac[LINK_MAC_SIZE] = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x00};
+  uint32_t detecting = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    // Only the first link sees movement
+    mac[5] = i % BENCH_LINKS;
+    const wifi_radar_info_t* info = &g_samples[mac[5] == 0 ? i % BENCH_SAMPLES : i % (BENCH_SAMPLES / 2)];
+    LinkDetector* link = link_detectors_get(&detectors, mac, i * 10);
+    link_detector_push(&detectors, link, info, !detecting);
+    detecting = link_detectors_count_detecting(&detectors, i * 10, 2000);
+  }
+  g_sink += detecting;
+}
+
+/* The loop of detector_push, judged by the office variant instead of the motion model */
+static void bench_detector_variant(uint32_t iterations) {
+  static LinkDetectors detectors;
+  static const uint8_t mac[LINK_MAC_SIZE] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+  link_detectors_init(&detectors, BENCH_WINDOW_SIZE, BENCH_NEEDED_DETECTIONS, CALIBRATION_THRESHOLD_MARGIN);
+  link_detectors_reset(&detectors, &(wifi_radar_info_t){.waveform_jitter = 0.03f, .waveform_wander = 0.06f});
+  link_detectors_set_variant(&detectors, find_detector_variant("office", strlen("office")));
+
+  uint32_t detecting = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    LinkDetector* link = link_detectors_get(&detectors, mac, i * 10);
+    link_detector_push(&detectors, link, &g_samples[i % BENCH_SAMPLES], !detecting);
+    detecting = link_detectors_count_detecting(&detectors, i * 10, 2000);
+  }
+  g_sink += detecting;
+}
+
+static void bench_motion_logistic(uint32_t iterations) {
+  static MotionClassifier classifier;
+  const wifi_radar_info_t threshold = {.waveform_jitter = 0.03f, .waveform_wander = 0.06f};
+  motion_classifier_init(&classifier);
+  uint32_t detections = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    detections += motion_classifier_push(&classifier, get_default_motion_model(), &g_samples[i % BENCH_SAMPLES], &threshold);
+  }
+  g_sink += detections;
+}
+
+/* A full tree, so every sample takes the longest walk */
+static void bench_motion_tree(uint32_t iterations) {
+  static MotionClassifier classifier;
+  static MotionModel model = {.type = MOTION_MODEL_TREE, .tree.nodes_count = MOTION_TREE_MAX_NODES};
+  for (int i = 0; i < MOTION_TREE_MAX_NODES; i++) {
+    model.tree.nodes[i] = i < MOTION_TREE_MAX_NODES / 2
+                              ? (MotionTreeNode){.feature = i % MOTION_FEATURES_COUNT, .threshold = MOTION_FEATURE_ONE,
+                                                 .left = 2 * i + 1, .right = 2 * i + 2}
+                              : (MotionTreeNode){.feature = MOTION_TREE_LEAF, .threshold = i % 2};
+  }
+  const wifi_radar_info_t threshold = {.waveform_jitter = 0.03f, .waveform_wander = 0.06f};
+  motion_classifier_init(&classifier);
+  uint32_t detections = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    detections += motion_classifier_push(&classifier, &model, &g_samples[i % BENCH_SAMPLES], &threshold);
+  }
+  g_sink += detections;
+}
+
+static void bench_csi_features_fixed(uint32_t iterations) {
+  static CsiFeaturesFixed features;
+  wifi_radar_info_t info = {0};
+  csi_features_init_fixed(&features, CSI_WINDOW_FRAMES);
+  for (uint32_t i = 0; i < iterations; i++) {
+    csi_features_push_fixed(&features, g_frames[i % BENCH_FRAMES], 2 * BENCH_SUBCARRIERS, i * CSI_FRAME_INTERVAL_MS, &info);
+  }
+  g_sink += info.waveform_jitter > 0;
+}
+
+static void bench_csi_features_float(uint32_t iterations) {
+  static CsiFeaturesFloat features;
+  wifi_radar_info_t info = {0};
+  csi_features_init_float(&features, CSI_WINDOW_FRAMES);
+  for (uint32_t i = 0; i < iterations; i++) {
+    csi_features_push_float(&features, g_frames[i % BENCH_FRAMES], 2 * BENCH_SUBCARRIERS, i * CSI_FRAME_INTERVAL_MS, &info);
+  }
+  g_sink += info.waveform_jitter > 0;
+}
+
+static void bench_csi_features_pca(uint32_t iterations) {
+  static CsiFeaturesPca features;
+  wifi_radar_info_t info = {0};
+  csi_features_init_pca(&features, CSI_WINDOW_FRAMES, CSI_PCA_COMPONENTS);
+  for (uint32_t i = 0; i < iterations; i++) {
+    csi_features_push_pca(&features, g_frames[i % BENCH_FRAMES], 2 * BENCH_SUBCARRIERS, i * CSI_FRAME_INTERVAL_MS, &info);
+  }
+  g_sink += info.waveform_jitter > 0;
+}
+
+/* What send_mqtt_msg() does before publishing a room status */
+static void bench_frame_encode(uint32_t iterations) {
+  uint8_t buffer[MQTT_FRAME_HEADER_SIZE + 1];
+  size_t size = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    const char room_status = i & 3;
+    size += mqtt_frame_encode(buffer, sizeof(buffer), MQTT_TX_MSG_ROOM_STATUS, &room_status, 1);
+  }
+  g_sink += size;
+}
+
+/* Per sample, in batches as sent by telemetry.c */
+static void bench_telemetry_encode(uint32_t iterations) {
+  static TelemetrySample samples[BENCH_TELEMETRY_BATCH];
+  static uint8_t payload[MQTT_FRAME_PAYLOAD_MAX_SIZE];
+  for (int i = 0; i < BENCH_TELEMETRY_BATCH; i++) {
+    samples[i] = (TelemetrySample){
+        .timestamp_ms = i * 10,
+        .waveform_jitter = g_samples[i].waveform_jitter,
+        .waveform_wander = g_samples[i].waveform_wander,
+        .rssi = -50,
+        .room_status = i % 2 + 1,
+    };
+  }
+  size_t size = 0;
+  for (uint32_t i = 0; i < iterations; i += BENCH_TELEMETRY_BATCH) {
+    samples[0].timestamp_ms = i * 10;
+    size += mqtt_frame_encode_telemetry(payload, sizeof(payload), samples, BENCH_TELEMETRY_BATCH);
+  }
+  g_sink += size;
+}
+
+static void bench_csi_batch_append(uint32_t iterations) {
+  static uint8_t payload[MQTT_FRAME_PAYLOAD_MAX_SIZE];
+  CsiBatchWriter writer;
+  CsiFrame frame = {.rssi = -50, .values_count = 2 * BENCH_SUBCARRIERS};
+  uint32_t batches = 0;
+  csi_batch_begin(&writer, payload, sizeof(payload), CSI_STREAM_QUANTIZATION_SHIFT);
+  for (uint32_t i = 0; i < iterations; i++) {
+    frame.timestamp_ms = i * 10;
+    memcpy(frame.values, g_frames[i % BENCH_FRAMES], sizeof(g_frames[0]));
+    if (!csi_batch_append(&writer, &frame)) {
+      csi_batch_begin(&writer, payload, sizeof(payload), CSI_STREAM_QUANTIZATION_SHIFT);
+      csi_batch_append(&writer, &frame);
+      batches++;
+    }
+  }
+  g_sink += batches;
+}
+
+static void bench_metrics_encode(uint32_t iterations) {
+  static MetricsReport report;
+  static uint8_t payload[METRICS_REPORT_SIZE];
+  size_t size = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    report.uptime_ms = i;
+    report.histograms[i % METRICS_HISTOGRAMS_COUNT].buckets[i % METRICS_BUCKETS_COUNT]++;
+    size += mqtt_frame_encode_metrics(payload, sizeof(payload), &report);
+  }
+  g_sink += size;
+}
+
+/* Both sides on one thread, which is the cost of the code itself */
+static void bench_sample_ring(uint32_t iterations) {
+  static SampleRing ring;
+  memset(&ring, 0, sizeof(ring));
+  RadarSample sample = {.rssi = -50};
+  uint32_t popped = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    sample.timestamp_ms = i;
+    sample_ring_push(&ring, &sample);
+    popped += sample_ring_pop(&ring, &sample);
+  }
+  g_sink += popped;
+}
+
+/* Producer and consumer on their own threads, which adds the atomics and
+ * cache line transfers between cores, or on one core the switches between
+ * them. The producer retries when the ring is full, where the firmware would
+ * drop the sample. */
+static void bench_sample_ring_threads(uint32_t iterations) {
+  static HandOff hand_off;
+  memset(&hand_off, 0, sizeof(hand_off));
+  hand_off.count = iterations;
+  pthread_t consumer;
+  pthread_create(&consumer, NULL, consume_samples, &hand_off);
+  RadarSample sample = {.rssi = -50};
+  for (uint32_t i = 0; i < iterations; i++) {
+    sample.timestamp_ms = i;
+    while (!sample_ring_push(&hand_off.ring, &sample)) {
+      sched_yield();
+    }
+  }
+  pthread_join(consumer, NULL);
+  g_sink += hand_off.checksum;
+}
+
+static void* consume_samples(void* arg) {
+  HandOff* hand_off = arg;
+  RadarSample sample;
+  for (uint32_t popped = 0; popped < hand_off->count;) {
+    if (sample_ring_pop(&hand_off->ring, &sample)) {
+      hand_off->checksum += sample.timestamp_ms;
+      popped++;
+    } else {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static double get_time_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
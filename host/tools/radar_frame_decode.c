@@ -0,0 +1,196 @@
+#include <csi_codec.h>
+#include <ctype.h>
+#include <frame_bytes.h>
+#include <mqtt_frame.h>
+#include <mqtt_handler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <trace_recorder.h>
+#include <wifi_radar.h>
+
+/* Decodes device frames given as hex, one per line, optionally prefixed with
+ * the topic, e.g. the output of: mosquitto_sub -t 'radar/+/from' -v -F '%t %x'
+ * Prints one CSV row per room status, telemetry sample, CSI frame, sample rate
+ * report, metrics histogram and trace chunk. The CSI values of a frame are in
+ * the last column, separated by spaces, and so are the ping interval, CSI rate
+ * and sample rate of a report, the buckets and the max of a histogram, the
+ * counters of the metrics and the offset, size and partition size of a chunk.
+ * A boot timeline has a row per stage with the ms since boot, 0 if the stage
+ * wasn't reached. Use trace_assemble to put the chunks together. */
+
+/* PRIVATE CONSTANTS */
+#define LINE_MAX_LENGTH (2 * MQTT_FRAME_MAX_SIZE + 256)
+
+#define SAMPLE_RATE_REPORT_SIZE 12  // Same as in wifi_radar.c
+
+/* PRIVATE PROTOTYPES */
+static size_t parse_hex(const char* hex, uint8_t* bytes, size_t max_size);
+static void print_frame(const char* topic, const MqttFrame* frame);
+static void print_metrics(const char* topic, const MqttFrame* frame);
+static void print_boot_timeline(const char* topic, const MqttFrame* frame);
+
+/* GLOBAL VARIABLES */
+static const char* g_histogram_names[METRICS_HISTOGRAMS_COUNT] = {
+    [METRICS_CSI_TO_SAMPLE] = "csi_to_sample",
+    [METRICS_QUEUE] = "queue",
+    [METRICS_DETECT] = "detect",
+    [METRICS_PUBLISH] = "publish",
+    [METRICS_END_TO_END] = "end_to_end",
+};
+static const char* g_boot_stage_names[BOOT_STAGES_COUNT] = {
+    [BOOT_STAGE_STORAGE] = "storage",
+    [BOOT_STAGE_WIFI_STARTED] = "wifi_started",
+    [BOOT_STAGE_RADAR_STARTED] = "radar_started",
+    [BOOT_STAGE_WIFI_CONNECTED] = "wifi_connected",
+    [BOOT_STAGE_GOT_IP] = "got_ip",
+    [BOOT_STAGE_MQTT_CONNECTED] = "mqtt_connected",
+    [BOOT_STAGE_FIRST_SAMPLE] = "first_sample",
+    [BOOT_STAGE_FIRST_STATUS] = "first_status",
+};
+
+/* MAIN */
+int main(int argc, char** argv) {
+  static char line[LINE_MAX_LENGTH];
+  static uint8_t bytes[MQTT_FRAME_MAX_SIZE];
+  size_t line_number = 0;
+
+  printf("topic,type,timestamp_ms,waveform_jitter,waveform_wander,rssi,room_status,csi\n");
+  while (fgets(line, sizeof(line), stdin)) {
+    line_number++;
+    line[strcspn(line, "\r\n")] = '\0';
+    char* hex = strrchr(line, ' ');
+    const char* topic = "";
+    if (hex) {
+      *hex++ = '\0';
+      topic = line;
+    } else {
+      hex = line;
+    }
+
+    const size_t size = parse_hex(hex, bytes, sizeof(bytes));
+    MqttFrame frame;
+    if (size == 0 || !mqtt_frame_decode(bytes, size, &frame)) {
+      fprintf(stderr, "Line %zu: not a valid frame\n", line_number);
+      continue;
+    }
+    print_frame(topic, &frame);
+  }
+  return EXIT_SUCCESS;
+}
+
+/* FUNCTIONS */
+static size_t parse_hex(const char* hex, uint8_t* bytes, size_t max_size) {
+  const size_t length = strlen(hex);
+  if (length % 2 != 0 || length / 2 > max_size) {
+    return 0;
+  }
+  for (size_t i = 0; i < length / 2; i++) {
+    if (!isxdigit((unsigned char)hex[2 * i]) || !isxdigit((unsigned char)hex[2 * i + 1])) {
+      return 0;
+    }
+    const char byte_hex[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+    bytes[i] = strtoul(byte_hex, NULL, 16);
+  }
+  return length / 2;
+}
+
+static void print_frame(const char* topic, const MqttFrame* frame) {
+  static TelemetrySample samples[TELEMETRY_MAX_SAMPLES];
+  static CsiFrame csi_frames[UINT8_MAX];
+
+  switch (frame->msg_id) {
+    case MQTT_TX_MSG_ROOM_STATUS:
+      printf("%s,status,,,,,%u,\n", topic, frame->payload_size ? frame->payload[0] : ROOM_UNDEFINED);
+      break;
+
+    case MQTT_TX_MSG_TELEMETRY: {
+      const int count = mqtt_frame_decode_telemetry(frame->payload, frame->payload_size, samples, TELEMETRY_MAX_SAMPLES);
+      if (count < 0) {
+        fprintf(stderr, "Malformed telemetry frame\n");
+        return;
+      }
+      for (int i = 0; i < count; i++) {
+        printf("%s,telemetry,%u,%g,%g,%d,%u,\n", topic, samples[i].timestamp_ms, samples[i].waveform_jitter,
+               samples[i].waveform_wander, samples[i].rssi, samples[i].room_status);
+      }
+      break;
+    }
+
+    case MQTT_TX_MSG_CSI: {
+      const int count = csi_batch_decode(frame->payload, frame->payload_size, csi_frames, UINT8_MAX);
+      if (count < 0) {
+        fprintf(stderr, "Malformed CSI frame\n");
+        return;
+      }
+      for (int i = 0; i < count; i++) {
+        printf("%s,csi,%u,%g,%g,%d,,", topic, csi_frames[i].timestamp_ms, csi_frames[i].waveform_jitter,
+               csi_frames[i].waveform_wander, csi_frames[i].rssi);
+        for (int j = 0; j < csi_frames[i].values_count; j++) {
+          printf(j ? " %d" : "%d", csi_frames[i].values[j]);
+        }
+        putchar('\n');
+      }
+      break;
+    }
+
+    case MQTT_TX_MSG_SAMPLE_RATE:
+      if (frame->payload_size != SAMPLE_RATE_REPORT_SIZE) {
+        fprintf(stderr, "Malformed sample rate frame\n");
+        return;
+      }
+      printf("%s,sample_rate,,,,,,%u %g %g\n", topic, get_u32(frame->payload), get_f32(frame->payload + 4),
+             get_f32(frame->payload + 8));
+      break;
+
+    case MQTT_TX_MSG_METRICS:
+      print_metrics(topic, frame);
+      break;
+
+    case MQTT_TX_MSG_TRACE_CHUNK:
+      if (frame->payload_size < TRACE_CHUNK_HEADER_SIZE) {
+        fprintf(stderr, "Malformed trace chunk frame\n");
+        return;
+      }
+      printf("%s,trace_chunk,,,,,,%u %u %u\n", topic, get_u32(frame->payload), (unsigned)(frame->payload_size - TRACE_CHUNK_HEADER_SIZE),
+             get_u32(frame->payload + 4));
+      break;
+
+    case MQTT_TX_MSG_BOOT_TIMELINE:
+      print_boot_timeline(topic, frame);
+      break;
+
+    default:
+      fprintf(stderr, "Unknown message ID %u (frame version %u)\n", frame->msg_id, frame->version);
+      break;
+  }
+}
+
+static void print_boot_timeline(const char* topic, const MqttFrame* frame) {
+  BootTimeline timeline;
+  if (!mqtt_frame_decode_boot_timeline(frame->payload, frame->payload_size, &timeline)) {
+    fprintf(stderr, "Malformed boot timeline frame\n");
+    return;
+  }
+  for (int i = 0; i < BOOT_STAGES_COUNT; i++) {
+    printf("%s,boot_%s,%.3f,,,,,\n", topic, g_boot_stage_names[i], timeline.stage_us[i] / 1000.0);
+  }
+}
+
+static void print_metrics(const char* topic, const MqttFrame* frame) {
+  MetricsReport report;
+  if (!mqtt_frame_decode_metrics(frame->payload, frame->payload_size, &report)) {
+    fprintf(stderr, "Malformed metrics frame\n");
+    return;
+  }
+  for (int i = 0; i < METRICS_HISTOGRAMS_COUNT; i++) {
+    printf("%s,latency_%s,%u,,,,,", topic, g_histogram_names[i], report.uptime_ms);
+    for (int j = 0; j < METRICS_BUCKETS_COUNT; j++) {
+      printf("%u ", report.histograms[i].buckets[j]);
+    }
+    printf("%u\n", report.histograms[i].max_us);
+  }
+  printf("%s,counters,%u,,,,,%u %u %u %u %u\n", topic, report.uptime_ms, report.counters[METRICS_RING_DROPS],
+         report.counters[METRICS_RING_HIGH_WATER], report.counters[METRICS_PING_TIMEOUTS],
+         report.counters[METRICS_OUTBOX_EVICTIONS], report.counters[METRICS_OUTBOX_COALESCED]);
+}
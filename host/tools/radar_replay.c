@@ -0,0 +1,325 @@
+#include <calibration.h>
+#include <csi_stream.h>
+#include <detector_core.h>
+#include <esp_log.h>
+#include <getopt.h>
+#include <host_clock.h>
+#include <host_mqtt.h>
+#include <host_partition.h>
+#include <host_radar.h>
+#include <host_rtos.h>
+#include <mqtt_frame.h>
+#include <motion_classifier.h>
+#include <mqtt_handler.h>
+#include <nvs.h>
+#include <pipeline_metrics.h>
+#include <ping_handler.h>
+#include <proj_conf.h>
+#include <radar_trace.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <telemetry.h>
+#include <trace_pacer.h>
+#include <trace_recorder.h>
+#include <wifi_radar.h>
+
+/* Replays a recorded wifi_radar_info_t trace, a CSV file or an image of the
+ * trace partition, through the firmware detection
+ * pipeline on a virtual clock and prints every room status change. Like on the
+ * device, samples only arrive as often as the gateway is pinged, so trace
+ * samples are skipped while the firmware slows the pings down. */
+
+/* PRIVATE CONSTANTS */
+#define RADAR_NVS_NAMESPACE "wifi_radar"  // Same as in wifi_radar.c
+
+#define ROOM_STATUS_COUNT 5
+#define TRAILING_TIME_MS  5000
+
+/* PRIVATE TYPES */
+typedef struct {
+  FILE* frames_file;
+  int status;
+  uint64_t status_since_ms;
+  uint64_t status_time_ms[ROOM_STATUS_COUNT];
+  uint32_t status_changes;
+  uint32_t publishes;
+} ReplayState;
+
+/* GLOBAL VARIABLES */
+static const char* g_room_status_names[ROOM_STATUS_COUNT] = {
+    [ROOM_UNDEFINED] = "ROOM_UNDEFINED",
+    [NO_MOVEMENT] = "NO_MOVEMENT",
+    [MOVEMENT_DETECTED] = "MOVEMENT_DETECTED",
+    [ROOM_CALIBRATION_ACTIVE] = "ROOM_CALIBRATION_ACTIVE",
+    [STATIONARY_PRESENCE] = "STATIONARY_PRESENCE",
+};
+
+/* PRIVATE PROTOTYPES */
+static void print_usage(const char* program);
+static void preload_threshold(float jitter_threshold);
+static bool preload_model(const char* path);
+static bool preload_detector(const char* name);
+static void handle_publish(const char* topic, const char* data, int len, void* ctx);
+static void send_command(MqttRxMessageId command);
+
+/* MAIN */
+int main(int argc, char** argv) {
+  float jitter_threshold = 0;
+  uint32_t calibration_ms = 0;
+  uint32_t outage_start_ms = 0;
+  uint32_t outage_end_ms = 0;
+  uint32_t interval_ms = GATEWAY_PING_INTERVAL_MS;
+  const char* frames_path = NULL;
+  const char* image_path = NULL;
+  const char* model_path = NULL;
+  const char* detector_name = NULL;
+  bool telemetry = false;
+  bool download = false;
+  bool verbose = false;
+
+  int option;
+  while ((option = getopt(argc, argv, "j:c:i:m:D:o:f:r:dtvh")) != -1) {
+    switch (option) {
+      case 'j':
+        jitter_threshold = strtof(optarg, NULL);
+        break;
+      case 'c':
+        calibration_ms = (uint32_t)(strtod(optarg, NULL) * 1000);
+        break;
+      case 'i':
+        interval_ms = strtoul(optarg, NULL, 10);
+        break;
+      case 'm':
+        model_path = optarg;
+        break;
+      case 'D':
+        detector_name = optarg;
+        break;
+      case 'o': {
+        char* end;
+        outage_start_ms = (uint32_t)(strtod(optarg, &end) * 1000);
+        outage_end_ms = outage_start_ms + (uint32_t)(strtod(*end == ':' ? end + 1 : end, NULL) * 1000);
+        break;
+      }
+      case 'f':
+        frames_path = optarg;
+        break;
+      case 'r':
+        image_path = optarg;
+        break;
+      case 'd':
+        download = true;
+        break;
+      case 't':
+        telemetry = true;
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        print_usage(argv[0]);
+        return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (optind != argc - 1) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  RadarTrace trace;
+  if (!radar_trace_load(argv[optind], interval_ms, &trace)) {
+    return EXIT_FAILURE;
+  }
+  if (trace.count == 0) {
+    fprintf(stderr, "Trace is empty\n");
+    return EXIT_FAILURE;
+  }
+
+  esp_log_level_set("*", verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+  if (jitter_threshold > 0) {
+    preload_threshold(jitter_threshold);
+  }
+  if (model_path && !preload_model(model_path)) {
+    return EXIT_FAILURE;
+  }
+  if (detector_name && !preload_detector(detector_name)) {
+    return EXIT_FAILURE;
+  }
+
+  ReplayState state = {.status = -1};
+  if (frames_path && !(state.frames_file = fopen(frames_path, "w"))) {
+    perror(frames_path);
+    return EXIT_FAILURE;
+  }
+  host_mqtt_set_publish_sink(handle_publish, &state);
+  init_mqtt_client();
+  init_pipeline_metrics();
+  init_telemetry();
+  init_trace_recorder();
+  init_csi_stream();
+  init_wifi_radar();
+  init_gateway_ping();
+  start_mqtt_client();
+
+  printf("time_ms,room_status\n");
+  const double start_time_s = host_wall_time_s();
+  const uint32_t first_timestamp_ms = trace.samples[0].timestamp_ms;
+  bool calibrating = false;
+  if (calibration_ms > 0) {
+    send_command(MQTT_RX_MSG_START_CALIBRATION);
+    calibrating = true;
+  }
+  if (telemetry) {
+    send_command(MQTT_RX_MSG_START_TELEMETRY);
+  }
+
+  TracePacer pacer;
+  trace_pacer_init(&pacer, interval_ms);
+  for (size_t i = 0; i < trace.count; i++) {
+    const uint32_t time_ms = trace.samples[i].timestamp_ms - first_timestamp_ms;
+    host_rtos_advance_to(pdMS_TO_TICKS(time_ms));
+    if (calibrating && time_ms >= calibration_ms) {
+      send_command(MQTT_RX_MSG_STOP_CALIBRATION);
+      calibrating = false;
+    }
+    host_mqtt_set_connected(time_ms < outage_start_ms || time_ms >= outage_end_ms);
+    if (!trace_pacer_take(&pacer, time_ms, get_gateway_ping_interval())) {
+      continue;
+    }
+    // The CSI packet behind the sample, without data, so the firmware counts and times it like on the device
+    host_radar_feed_csi(&(wifi_csi_filtered_info_t){0});
+    host_radar_feed(&trace.samples[i].info);
+    host_rtos_run_ready();
+  }
+  if (download) {
+    send_command(MQTT_RX_MSG_SEND_TRACE);
+  }
+  const uint64_t end_ms = host_rtos_now_ms() + TRAILING_TIME_MS;
+  host_rtos_advance_to(pdMS_TO_TICKS(end_ms));
+  if (state.status >= 0) {
+    state.status_time_ms[state.status] += end_ms - state.status_since_ms;
+  }
+  const double elapsed_s = host_wall_time_s() - start_time_s;
+
+  fprintf(stderr, "Samples: %zu, %llu fed; trace time: %.1f s; wall time: %.3f s; speed-up: %.0fx\n",
+          trace.count, (unsigned long long)pacer.fed_count, end_ms / 1000.0, elapsed_s, end_ms / 1000.0 / elapsed_s);
+  fprintf(stderr, "Status publishes: %u; status changes: %u\n", state.publishes, state.status_changes);
+  for (int i = 0; i < ROOM_STATUS_COUNT; i++) {
+    fprintf(stderr, "  %-24s %10.1f s\n", g_room_status_names[i], state.status_time_ms[i] / 1000.0);
+  }
+
+  if (state.frames_file) {
+    fclose(state.frames_file);
+  }
+  if (image_path && !host_partition_save(image_path)) {
+    perror(image_path);
+    return EXIT_FAILURE;
+  }
+  radar_trace_free(&trace);
+  return EXIT_SUCCESS;
+}
+
+/* FUNCTIONS */
+static void print_usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options] <trace.csv|trace.bin>\n"
+          "  -j <threshold>  jitter detection threshold stored in NVS before start\n"
+          "  -c <seconds>    calibrate on the first seconds of the trace\n"
+          "  -i <ms>         sample interval for traces without timestamps (default %d)\n"
+          "  -m <file>       motion model stored in NVS before start, see motion_classifier.h\n"
+          "  -D <variant>    detector variant stored in NVS before start, see detector_core.h\n"
+          "  -o <s>:<s>      take the broker connection down from the first time for the second length\n"
+          "  -t              enable telemetry\n"
+          "  -f <file>       write every published frame as \"topic hex\" lines\n"
+          "  -d              download the trace partition over MQTT at the end, see -f\n"
+          "  -r <file>       write the trace partition, as recorded on the way, to an image\n"
+          "  -v              show firmware info logs\n",
+          program, GATEWAY_PING_INTERVAL_MS);
+}
+
+static void preload_threshold(float jitter_threshold) {
+  nvs_handle_t handle;
+  ESP_ERROR_CHECK(nvs_open(RADAR_NVS_NAMESPACE, NVS_READWRITE, &handle));
+  CalibrationRecord record;
+  calibration_record_begin(&record);
+  record.threshold.waveform_jitter = jitter_threshold;
+  save_calibration(handle, CALIBRATION_DEFAULT_PROFILE, &record);
+  nvs_close(handle);
+}
+
+static bool preload_model(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    perror(path);
+    return false;
+  }
+  uint8_t bytes[MOTION_MODEL_MAX_SIZE + 1];
+  const size_t size = fread(bytes, 1, sizeof(bytes), file);
+  fclose(file);
+  MotionModel model;
+  if (!motion_model_decode(bytes, size, &model)) {
+    fprintf(stderr, "%s: not a valid motion model\n", path);
+    return false;
+  }
+
+  nvs_handle_t handle;
+  ESP_ERROR_CHECK(nvs_open(RADAR_NVS_NAMESPACE, NVS_READWRITE, &handle));
+  save_motion_model(handle, &model);
+  nvs_close(handle);
+  return true;
+}
+
+static bool preload_detector(const char* name) {
+  const DetectorVariant* variant = find_detector_variant(name, strlen(name));
+  if (!variant) {
+    fprintf(stderr, "%s: unknown detector variant, known are:", name);
+    for (size_t i = 0; i < get_detector_variants_count(); i++) {
+      fprintf(stderr, " %s", get_detector_variant(i)->name);
+    }
+    fprintf(stderr, "\n");
+    return false;
+  }
+
+  nvs_handle_t handle;
+  ESP_ERROR_CHECK(nvs_open(RADAR_NVS_NAMESPACE, NVS_READWRITE, &handle));
+  save_detector_variant(handle, variant);
+  nvs_close(handle);
+  return true;
+}
+
+static void handle_publish(const char* topic, const char* data, int len, void* ctx) {
+  ReplayState* state = ctx;
+  if (state->frames_file) {
+    fprintf(state->frames_file, "%s ", topic);
+    for (int i = 0; i < len; i++) {
+      fprintf(state->frames_file, "%02x", (uint8_t)data[i]);
+    }
+    fputc('\n', state->frames_file);
+  }
+
+  MqttFrame frame;
+  if (strcmp(topic, MQTT_TX_TOPIC) != 0 || !mqtt_frame_decode((const uint8_t*)data, len, &frame) ||
+      frame.msg_id != MQTT_TX_MSG_ROOM_STATUS || frame.payload_size < 1) {
+    return;
+  }
+  state->publishes++;
+
+  const int status = frame.payload[0];
+  if (status == state->status || status < 0 || status >= ROOM_STATUS_COUNT) {
+    return;
+  }
+  const uint64_t now_ms = host_rtos_now_ms();
+  if (state->status >= 0) {
+    state->status_time_ms[state->status] += now_ms - state->status_since_ms;
+    state->status_changes++;
+  }
+  state->status = status;
+  state->status_since_ms = now_ms;
+  printf("%llu,%s\n", (unsigned long long)now_ms, g_room_status_names[status]);
+}
+
+static void send_command(MqttRxMessageId command) {
+  const char message = command;
+  host_mqtt_deliver(MQTT_RX_TOPIC, &message, 1);
+}
@@ -0,0 +1,127 @@
+#include <ctype.h>
+#include <frame_bytes.h>
+#include <mqtt_frame.h>
+#include <mqtt_handler.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <trace_recorder.h>
+
+/* Puts the trace chunks sent after MQTT_RX_MSG_SEND_TRACE back together into
+ * an image of the trace partition, which trace_dump and radar_replay read.
+ * Frames are read from stdin like by radar_frame_decode, other frames are
+ * skipped. Bytes no chunk covered stay erased, their ranges are listed as
+ * "offset length" lines, so they can be requested again. */
+
+/* PRIVATE CONSTANTS */
+#define LINE_MAX_LENGTH (2 * MQTT_FRAME_MAX_SIZE + 256)
+
+/* PRIVATE PROTOTYPES */
+static size_t parse_hex(const char* hex, uint8_t* bytes, size_t max_size);
+static size_t print_missing_ranges(const bool* covered, uint32_t size);
+
+/* MAIN */
+int main(int argc, char** argv) {
+  static char line[LINE_MAX_LENGTH];
+  static uint8_t bytes[MQTT_FRAME_MAX_SIZE];
+
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s image.bin < frames.txt\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  uint8_t* image = NULL;
+  bool* covered = NULL;
+  uint32_t partition_size = 0;
+  size_t chunks_count = 0;
+  size_t line_number = 0;
+  while (fgets(line, sizeof(line), stdin)) {
+    line_number++;
+    line[strcspn(line, "\r\n")] = '\0';
+    const char* hex = strrchr(line, ' ');
+    hex = hex ? hex + 1 : line;
+
+    const size_t size = parse_hex(hex, bytes, sizeof(bytes));
+    MqttFrame frame;
+    if (size == 0 || !mqtt_frame_decode(bytes, size, &frame) || frame.msg_id != MQTT_TX_MSG_TRACE_CHUNK) {
+      continue;
+    }
+    if (frame.payload_size < TRACE_CHUNK_HEADER_SIZE) {
+      fprintf(stderr, "Line %zu: malformed trace chunk\n", line_number);
+      continue;
+    }
+
+    const uint32_t offset = get_u32(frame.payload);
+    const uint32_t chunk_partition_size = get_u32(frame.payload + 4);
+    const uint32_t data_size = frame.payload_size - TRACE_CHUNK_HEADER_SIZE;
+    if (!image) {
+      partition_size = chunk_partition_size;
+      image = malloc(partition_size);
+      covered = calloc(partition_size, sizeof(bool));
+      memset(image, 0xFF, partition_size);
+    }
+    if (chunk_partition_size != partition_size || offset > partition_size || data_size > partition_size - offset) {
+      fprintf(stderr, "Line %zu: chunk at %u doesn't fit a partition of %u bytes\n", line_number, offset, partition_size);
+      continue;
+    }
+    memcpy(image + offset, frame.payload + TRACE_CHUNK_HEADER_SIZE, data_size);
+    memset(covered + offset, true, data_size);
+    chunks_count++;
+  }
+  if (!image) {
+    fprintf(stderr, "No trace chunks\n");
+    return EXIT_FAILURE;
+  }
+
+  FILE* file = fopen(argv[1], "wb");
+  if (!file) {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+  const bool written = fwrite(image, 1, partition_size, file) == partition_size;
+  if (fclose(file) != 0 || !written) {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  const size_t missing_count = print_missing_ranges(covered, partition_size);
+  fprintf(stderr, "Chunks: %zu; partition: %u bytes; missing: %zu bytes\n", chunks_count, partition_size, missing_count);
+  free(covered);
+  free(image);
+  return missing_count ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* FUNCTIONS */
+static size_t parse_hex(const char* hex, uint8_t* bytes, size_t max_size) {
+  const size_t length = strlen(hex);
+  if (length % 2 != 0 || length / 2 > max_size) {
+    return 0;
+  }
+  for (size_t i = 0; i < length / 2; i++) {
+    if (!isxdigit((unsigned char)hex[2 * i]) || !isxdigit((unsigned char)hex[2 * i + 1])) {
+      return 0;
+    }
+    const char byte_hex[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+    bytes[i] = strtoul(byte_hex, NULL, 16);
+  }
+  return length / 2;
+}
+
+static size_t print_missing_ranges(const bool* covered, uint32_t size) {
+  size_t missing_count = 0;
+  uint32_t offset = 0;
+  while (offset < size) {
+    if (covered[offset]) {
+      offset++;
+      continue;
+    }
+    const uint32_t start = offset;
+    while (offset < size && !covered[offset]) {
+      offset++;
+    }
+    printf("%u %u\n", start, offset - start);
+    missing_count += offset - start;
+  }
+  return missing_count;
+}
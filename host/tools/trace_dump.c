@@ -0,0 +1,38 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <trace_file.h>
+
+/* Prints the records of a trace partition image, oldest first, as CSV. The
+ * first three columns are what radar_replay reads, timestamps count from the
+ * boot they were recorded in. */
+
+/* MAIN */
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s image.bin\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  TraceFile file;
+  if (!trace_file_open(argv[1], &file)) {
+    fprintf(stderr, "%s: not a trace partition image\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  printf("time_ms,waveform_jitter,waveform_wander,rssi,room_status,link,motion,detecting\n");
+  for (size_t i = 0; i < file.sectors_count; i++) {
+    const TraceSector* sector = &file.sectors[i];
+    if (sector->header->flags & TRACE_FLAG_BOOT) {
+      printf("# boot, sector %u\n", sector->header->sequence);
+    }
+    for (size_t j = 0; j < sector->count; j++) {
+      const TraceRecord* record = &sector->records[j];
+      printf("%u,%g,%g,%d,%u,%u,%u,%u\n", trace_record_time_ms(sector, record), trace_decode_value(record->jitter),
+             trace_decode_value(record->wander), record->rssi, record->state & TRACE_STATE_ROOM_STATUS_MASK,
+             (record->state & TRACE_STATE_LINK_MASK) >> TRACE_STATE_LINK_SHIFT, !!(record->state & TRACE_STATE_MOTION),
+             !!(record->state & TRACE_STATE_DETECTING));
+    }
+  }
+  fprintf(stderr, "Sectors: %zu; records: %zu\n", file.sectors_count, file.records_count);
+  trace_file_close(&file);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,510 @@
+#include "work_pool.h"
+
+#include <algorithm>
+#include <detector_core.h>
+#include <esp_log.h>
+#include <getopt.h>
+#include <host_clock.h>
+#include <math.h>
+#include <proj_conf.h>
+#include <radar_trace.h>
+#include <room_detector.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Sweeps the detection parameters over labeled traces and recommends a
+ * configuration.
+ *
+ * Every trace is a room; traces with the same file name, e.g. from several
+ * days, count as the same room. The labels are the fourth CSV column. Each run
+ * calibrates a room detector, the one the firmware detects with, on the start
+ * of a trace, then replays the rest and compares the decisions with the
+ * labels. Runs are independent, so a work-stealing pool spreads all
+ * configurations of all traces over the cores.
+ *
+ * Every configuration gets a CSV row per room and one for all rooms on
+ * stdout: time-weighted precision and recall of the occupied decision, and
+ * the delay from the labeled arrival of somebody to the decision. Rows that
+ * no other configuration beats on all three are marked, they make up the
+ * trade-off curve of the room. The firmware defaults and the recommended
+ * configuration, the highest recall at the wanted precision over all rooms,
+ * go to stderr, followed by the scores of the detector variants the firmware
+ * ships, see detector_core.h. */
+
+/* PRIVATE CONSTANTS */
+constexpr double DEFAULT_CALIBRATION_S = 30;
+constexpr double DEFAULT_MIN_PRECISION = 0.95;
+constexpr uint32_t MAX_SAMPLE_WEIGHT_MS = 1000;  // A sample stands for the time until the next one, gaps don't count
+constexpr uint8_t BROADCAST_MAC[LINK_MAC_SIZE] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+/* PRIVATE ENUMS */
+enum ParameterId {
+  PARAMETER_WINDOW,
+  PARAMETER_DETECTIONS,
+  PARAMETER_MARGIN,
+  PARAMETER_ENTER_COUNT,
+  PARAMETER_ENTER_HOLD,
+  PARAMETER_EXIT_COUNT,
+  PARAMETER_EXIT_HOLD,
+  PARAMETERS_COUNT,
+};
+
+/* PRIVATE TYPES */
+struct Parameter {
+  const char* name;
+  const char* constant;  // Where the firmware sets it
+  double first;          // Default sweep
+  double last;
+  double step;
+  std::vector<double> values;
+};
+
+struct Trace {
+  std::string room;
+  RadarTrace samples;
+  size_t first_scored;  // First sample after the calibration
+};
+
+struct RunResult {
+  uint64_t true_positive_ms = 0;
+  uint64_t false_positive_ms = 0;
+  uint64_t false_negative_ms = 0;
+  uint32_t arrivals = 0;
+  std::vector<uint32_t> delays_ms;  // Of the detected arrivals
+};
+
+struct Score {
+  double precision;
+  double recall;
+  double delay_p50_s;  // NAN without detected arrivals
+  double delay_p90_s;
+  uint32_t arrivals;
+  uint32_t missed;
+};
+
+/* GLOBAL VARIABLES */
+static Parameter g_parameters[PARAMETERS_COUNT] = {
+    {"window", "WINDOW_SIZE in main/src/room_detector.c", 5, 20, 5},
+    {"detections", "NEEDED_DETECTIONS in main/src/room_detector.c", 1, 4, 1},
+    {"margin", "CALIBRATION_THRESHOLD_MARGIN in main/include/calibration.h", 1.0, 1.5, 0.1},
+    {"enter_count", "PRESENCE_ENTER_COUNT in main/proj_conf.in.h", 1, 3, 1},
+    {"enter_hold_ms", "PRESENCE_ENTER_HOLD_MS in main/proj_conf.in.h", 0, 0, 1},
+    {"exit_count", "PRESENCE_EXIT_COUNT in main/proj_conf.in.h", 1, 1, 1},
+    {"exit_hold_ms", "PRESENCE_EXIT_HOLD_MS in main/proj_conf.in.h", 1000, 6000, 1000},
+};
+
+/* PRIVATE PROTOTYPES */
+static void print_usage(const char* program);
+static bool parse_sweep(const char* spec);
+static std::vector<double> get_sweep_values(double first, double last, double step);
+static std::vector<RoomDetectorConfig> get_configs();
+static void get_parameter_values(const RoomDetectorConfig& config, double values[PARAMETERS_COUNT]);
+static bool load_trace(const char* path, uint32_t interval_ms, uint32_t calibration_ms, Trace* trace);
+static void run_trace(const Trace& trace, const RoomDetectorConfig& config, RunResult* result);
+static Score get_score(const std::vector<const RunResult*>& results);
+static bool dominates(const Score& score, const Score& other);
+static double get_comparable_delay_s(double delay_s);
+static void print_row(const std::string& room, const RoomDetectorConfig& config, const Score& score, bool pareto);
+static void print_score(const char* name, const Score& score);
+
+/* MAIN */
+int main(int argc, char** argv) {
+  unsigned workers_count = std::thread::hardware_concurrency();
+  double calibration_s = DEFAULT_CALIBRATION_S;
+  double min_precision = DEFAULT_MIN_PRECISION;
+  uint32_t interval_ms = GATEWAY_PING_INTERVAL_MS;
+
+  int option;
+  while ((option = getopt(argc, argv, "w:c:p:i:s:h")) != -1) {
+    switch (option) {
+      case 'w':
+        workers_count = strtoul(optarg, nullptr, 10);
+        break;
+      case 'c':
+        calibration_s = strtod(optarg, nullptr);
+        break;
+      case 'p':
+        min_precision = strtod(optarg, nullptr);
+        break;
+      case 'i':
+        interval_ms = strtoul(optarg, nullptr, 10);
+        break;
+      case 's':
+        if (!parse_sweep(optarg)) {
+          return EXIT_FAILURE;
+        }
+        break;
+      default:
+        print_usage(argv[0]);
+        return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+  if (optind == argc || interval_ms == 0) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  esp_log_level_set("*", ESP_LOG_WARN);
+
+  std::vector<Trace> traces(argc - optind);
+  std::vector<std::string> rooms;
+  for (size_t i = 0; i < traces.size(); i++) {
+    if (!load_trace(argv[optind + i], interval_ms, (uint32_t)(calibration_s * 1000), &traces[i])) {
+      return EXIT_FAILURE;
+    }
+    if (std::find(rooms.begin(), rooms.end(), traces[i].room) == rooms.end()) {
+      rooms.push_back(traces[i].room);
+    }
+  }
+
+  // The firmware defaults come first, so they are scored even if the sweep misses them
+  std::vector<RoomDetectorConfig> configs = get_configs();
+  RoomDetectorConfig default_config;
+  room_detector_get_default_config(&default_config);
+  configs.insert(configs.begin(), default_config);
+  // The shipped variants run with the default calibration and links, only their scores are printed
+  const size_t sweep_count = configs.size();
+  for (size_t i = 0; i < get_detector_variants_count(); i++) {
+    RoomDetectorConfig config = default_config;
+    config.variant = get_detector_variant(i);
+    configs.push_back(config);
+  }
+
+  WorkPool pool(workers_count);
+  std::vector<RunResult> results(configs.size() * traces.size());
+  const double start_s = host_wall_time_s();
+  pool.run(results.size(), [&](size_t index, unsigned worker) {
+    run_trace(traces[index % traces.size()], configs[index / traces.size()], &results[index]);
+  });
+  const double elapsed_s = host_wall_time_s() - start_s;
+
+  // Scores per room, and of all rooms in the last column
+  std::vector<Score> scores(configs.size() * (rooms.size() + 1));
+  for (size_t config = 0; config < configs.size(); config++) {
+    std::vector<const RunResult*> all;
+    for (size_t room = 0; room < rooms.size(); room++) {
+      std::vector<const RunResult*> room_results;
+      for (size_t trace = 0; trace < traces.size(); trace++) {
+        if (traces[trace].room == rooms[room]) {
+          room_results.push_back(&results[config * traces.size() + trace]);
+        }
+      }
+      all.insert(all.end(), room_results.begin(), room_results.end());
+      scores[config * (rooms.size() + 1) + room] = get_score(room_results);
+    }
+    scores[config * (rooms.size() + 1) + rooms.size()] = get_score(all);
+  }
+
+  printf("room");
+  for (const Parameter& parameter : g_parameters) {
+    printf(",%s", parameter.name);
+  }
+  printf(",precision,recall,delay_p50_s,delay_p90_s,arrivals,missed,pareto\n");
+  for (size_t room = 0; room <= rooms.size(); room++) {
+    const std::string name = room < rooms.size() ? rooms[room] : "all";
+    for (size_t config = 0; config < sweep_count; config++) {
+      const Score& score = scores[config * (rooms.size() + 1) + room];
+      bool pareto = true;
+      for (size_t other = 0; other < sweep_count && pareto; other++) {
+        pareto = !dominates(scores[other * (rooms.size() + 1) + room], score);
+      }
+      print_row(name, configs[config], score, pareto);
+    }
+  }
+
+  // Highest recall at the wanted precision, then the shortest delay
+  const Score* best = nullptr;
+  size_t best_config = 0;
+  for (size_t config = 0; config < sweep_count; config++) {
+    const Score& score = scores[config * (rooms.size() + 1) + rooms.size()];
+    if (score.precision < min_precision) {
+      continue;
+    }
+    if (!best || score.recall > best->recall ||
+        (score.recall == best->recall &&
+         get_comparable_delay_s(score.delay_p90_s) < get_comparable_delay_s(best->delay_p90_s))) {
+      best = &score;
+      best_config = config;
+    }
+  }
+
+  uint64_t samples_count = 0;
+  double labeled_s = 0;
+  for (const Trace& trace : traces) {
+    samples_count += trace.samples.count - trace.first_scored;
+    labeled_s += (trace.samples.samples[trace.samples.count - 1].timestamp_ms -
+                  trace.samples.samples[trace.first_scored].timestamp_ms) / 1000.0;
+  }
+  fprintf(stderr, "Traces: %zu of %zu rooms, %.1f h after calibration; configurations: %zu\n", traces.size(),
+          rooms.size(), labeled_s / 3600, configs.size());
+  fprintf(stderr, "Runs: %zu on %u workers in %.2f s, %.1fM samples/s; steals: %llu\n", results.size(), pool.size(),
+          elapsed_s, samples_count * configs.size() / elapsed_s / 1e6, (unsigned long long)pool.steals());
+  print_score("Firmware defaults", scores[rooms.size()]);
+  char name[64];
+  for (size_t config = sweep_count; config < configs.size(); config++) {
+    snprintf(name, sizeof(name), "Variant %s", configs[config].variant->name);
+    print_score(name, scores[config * (rooms.size() + 1) + rooms.size()]);
+  }
+  if (!best) {
+    fprintf(stderr, "No configuration reaches precision %.3f over all rooms\n", min_precision);
+    return EXIT_SUCCESS;
+  }
+  snprintf(name, sizeof(name), "Recommended for precision >= %.3f", min_precision);
+  print_score(name, *best);
+  for (size_t room = 0; room < rooms.size(); room++) {
+    snprintf(name, sizeof(name), "  %s", rooms[room].c_str());
+    print_score(name, scores[best_config * (rooms.size() + 1) + room]);
+  }
+  double values[PARAMETERS_COUNT];
+  get_parameter_values(configs[best_config], values);
+  for (int i = 0; i < PARAMETERS_COUNT; i++) {
+    fprintf(stderr, "  %-14s %-6g %s\n", g_parameters[i].name, values[i], g_parameters[i].constant);
+  }
+  fprintf(stderr,
+          "  The margin is tuned on the largest calibration sample of every transmitter, which is what builds with\n"
+          "  RADAR_IN_TREE_FEATURES 1 scale. With 0 it scales the training thresholds of esp-csi, one minus the\n"
+          "  lowest correlation seen, which only come close to that.\n");
+
+  for (Trace& trace : traces) {
+    radar_trace_free(&trace.samples);
+  }
+  return EXIT_SUCCESS;
+}
+
+/* FUNCTIONS */
+static void print_usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options] trace.csv...\n"
+          "  -w <count>               worker threads (default: one per CPU)\n"
+          "  -c <s>                   calibrate on the first seconds of every trace, which must be empty (default %g)\n"
+          "  -p <precision>           precision over all rooms the recommendation must reach (default %g)\n"
+          "  -i <ms>                  sample interval for traces without timestamps (default %d)\n"
+          "  -s <name>=<first>[:<last>:<step>]\n"
+          "                           values of a parameter, the defaults are:\n",
+          program, DEFAULT_CALIBRATION_S, DEFAULT_MIN_PRECISION, GATEWAY_PING_INTERVAL_MS);
+  for (const Parameter& parameter : g_parameters) {
+    fprintf(stderr, "                             %s=%g:%g:%g\n", parameter.name, parameter.first, parameter.last,
+            parameter.step);
+  }
+  fprintf(stderr,
+          "Traces are CSV files of timestamp_ms,waveform_jitter,waveform_wander,occupied lines. Every sample is\n"
+          "detected, like at the fastest ping interval, and traces with the same file name are the same room.\n");
+}
+
+static bool parse_sweep(const char* spec) {
+  const char* equals = strchr(spec, '=');
+  for (Parameter& parameter : g_parameters) {
+    if (!equals || strncmp(spec, parameter.name, equals - spec) != 0 || parameter.name[equals - spec] != '\0') {
+      continue;
+    }
+    double first;
+    double last;
+    double step;
+    const int count = sscanf(equals + 1, "%lf:%lf:%lf", &first, &last, &step);
+    if (count == 1) {
+      parameter.values = {first};
+      return true;
+    }
+    if (count == 3 && step > 0 && last >= first) {
+      parameter.values = get_sweep_values(first, last, step);
+      return true;
+    }
+    break;
+  }
+  fprintf(stderr, "Invalid sweep %s, expected <name>=<first>[:<last>:<step>] of a known parameter\n", spec);
+  return false;
+}
+
+static std::vector<double> get_sweep_values(double first, double last, double step) {
+  std::vector<double> values;
+  const size_t count = (size_t)floor((last - first) / step + 1e-9) + 1;
+  for (size_t i = 0; i < count; i++) {
+    values.push_back(first + i * step);
+  }
+  return values;
+}
+
+/* Every combination of the parameter values, except windows too short for the detections */
+static std::vector<RoomDetectorConfig> get_configs() {
+  size_t count = 1;
+  for (Parameter& parameter : g_parameters) {
+    if (parameter.values.empty()) {
+      parameter.values = get_sweep_values(parameter.first, parameter.last, parameter.step);
+    }
+    count *= parameter.values.size();
+  }
+
+  std::vector<RoomDetectorConfig> configs;
+  RoomDetectorConfig config;
+  room_detector_get_default_config(&config);
+  for (size_t index = 0; index < count; index++) {
+    double values[PARAMETERS_COUNT];
+    size_t rest = index;
+    for (int i = 0; i < PARAMETERS_COUNT; i++) {
+      values[i] = g_parameters[i].values[rest % g_parameters[i].values.size()];
+      rest /= g_parameters[i].values.size();
+    }
+    config.window_size = (uint16_t)lround(values[PARAMETER_WINDOW]);
+    config.needed_detections = (uint16_t)lround(values[PARAMETER_DETECTIONS]);
+    config.threshold_margin = (float)values[PARAMETER_MARGIN];
+    config.enter_count = (uint8_t)lround(values[PARAMETER_ENTER_COUNT]);
+    config.enter_hold_ms = (uint32_t)lround(values[PARAMETER_ENTER_HOLD]);
+    config.exit_count = (uint8_t)lround(values[PARAMETER_EXIT_COUNT]);
+    config.exit_hold_ms = (uint32_t)lround(values[PARAMETER_EXIT_HOLD]);
+    if (config.needed_detections <= config.window_size && config.window_size <= MOTION_WINDOW_MAX_SIZE) {
+      configs.push_back(config);
+    }
+  }
+  return configs;
+}
+
+static void get_parameter_values(const RoomDetectorConfig& config, double values[PARAMETERS_COUNT]) {
+  values[PARAMETER_WINDOW] = config.window_size;
+  values[PARAMETER_DETECTIONS] = config.needed_detections;
+  values[PARAMETER_MARGIN] = config.threshold_margin;
+  values[PARAMETER_ENTER_COUNT] = config.enter_count;
+  values[PARAMETER_ENTER_HOLD] = config.enter_hold_ms;
+  values[PARAMETER_EXIT_COUNT] = config.exit_count;
+  values[PARAMETER_EXIT_HOLD] = config.exit_hold_ms;
+}
+
+static bool load_trace(const char* path, uint32_t interval_ms, uint32_t calibration_ms, Trace* trace) {
+  if (!radar_trace_load(path, interval_ms, &trace->samples)) {
+    return false;
+  }
+  const RadarTraceSample* samples = trace->samples.samples;
+  const size_t count = trace->samples.count;
+  size_t first_scored = 0;
+  bool occupied_in_calibration = false;
+  while (first_scored < count && samples[first_scored].timestamp_ms - samples[0].timestamp_ms < calibration_ms) {
+    occupied_in_calibration = occupied_in_calibration || samples[first_scored].occupied == 1;
+    first_scored++;
+  }
+  bool labeled = false;
+  for (size_t i = first_scored; i < count && !labeled; i++) {
+    labeled = samples[i].occupied != RADAR_TRACE_UNLABELED;
+  }
+  if (!labeled) {
+    fprintf(stderr, "%s: no labeled samples after the calibration\n", path);
+    return false;
+  }
+  if (occupied_in_calibration) {
+    fprintf(stderr, "%s: the room is occupied during the calibration\n", path);
+  }
+
+  const char* name = strrchr(path, '/');
+  name = name ? name + 1 : path;
+  trace->room = std::string(name, strcspn(name, "."));
+  trace->first_scored = first_scored;
+  return true;
+}
+
+/* Calibrates like the device on MQTT commands and decides like its processing task. The thresholds are the
+ * calibration maximum times the margin, as with the in-tree features; esp-csi only approximates the maximum. */
+static void run_trace(const Trace& trace, const RoomDetectorConfig& config, RunResult* result) {
+  RoomDetector detector;
+  room_detector_init(&detector, &config);
+  const RadarTraceSample* samples = trace.samples.samples;
+  room_detector_begin_calibration(&detector);
+  for (size_t i = 0; i < trace.first_scored; i++) {
+    room_detector_push(&detector, &samples[i].info, BROADCAST_MAC, samples[i].timestamp_ms);
+  }
+  wifi_radar_info_t threshold;
+  LinkThreshold links[LINK_TABLE_CAPACITY];
+  const size_t links_count = room_detector_finish_calibration(&detector, &threshold, links);
+  room_detector_set_thresholds(&detector, &threshold, links, links_count, samples[trace.first_scored].timestamp_ms);
+
+  bool arrival_pending = false;
+  uint32_t arrived_at_ms = 0;
+  int8_t occupied = 0;
+  for (size_t i = trace.first_scored; i < trace.samples.count; i++) {
+    const RadarTraceSample& sample = samples[i];
+    room_detector_push(&detector, &sample.info, BROADCAST_MAC, sample.timestamp_ms);
+    // Somebody keeping still counts as occupied, like STATIONARY_PRESENCE on the device
+    const bool detected = room_detector_update(&detector, sample.timestamp_ms) || detector.breathing.present;
+    if (sample.occupied == RADAR_TRACE_UNLABELED) {
+      continue;
+    }
+
+    if (sample.occupied && !occupied) {
+      result->arrivals++;
+      arrival_pending = true;
+      arrived_at_ms = sample.timestamp_ms;
+    }
+    occupied = sample.occupied;
+    if (arrival_pending && detected) {
+      result->delays_ms.push_back(sample.timestamp_ms - arrived_at_ms);
+      arrival_pending = false;
+    }
+    arrival_pending = arrival_pending && occupied;
+
+    const uint32_t weight_ms =
+        i + 1 < trace.samples.count ? std::min(samples[i + 1].timestamp_ms - sample.timestamp_ms, MAX_SAMPLE_WEIGHT_MS) : 0;
+    if (detected) {
+      (occupied ? result->true_positive_ms : result->false_positive_ms) += weight_ms;
+    } else if (occupied) {
+      result->false_negative_ms += weight_ms;
+    }
+  }
+}
+
+/* A room that is never detected has precision 1, one that is never occupied recall 1 */
+static Score get_score(const std::vector<const RunResult*>& results) {
+  RunResult total;
+  for (const RunResult* result : results) {
+    total.true_positive_ms += result->true_positive_ms;
+    total.false_positive_ms += result->false_positive_ms;
+    total.false_negative_ms += result->false_negative_ms;
+    total.arrivals += result->arrivals;
+    total.delays_ms.insert(total.delays_ms.end(), result->delays_ms.begin(), result->delays_ms.end());
+  }
+  std::sort(total.delays_ms.begin(), total.delays_ms.end());
+  const uint64_t detected_ms = total.true_positive_ms + total.false_positive_ms;
+  const uint64_t occupied_ms = total.true_positive_ms + total.false_negative_ms;
+  const size_t delays_count = total.delays_ms.size();
+  Score score;
+  score.precision = detected_ms ? (double)total.true_positive_ms / detected_ms : 1;
+  score.recall = occupied_ms ? (double)total.true_positive_ms / occupied_ms : 1;
+  score.delay_p50_s = delays_count ? total.delays_ms[delays_count / 2] / 1000.0 : NAN;
+  score.delay_p90_s = delays_count ? total.delays_ms[delays_count * 9 / 10] / 1000.0 : NAN;
+  score.arrivals = total.arrivals;
+  score.missed = total.arrivals - delays_count;
+  return score;
+}
+
+/* At least as good in precision, recall and median delay, and better in one of them */
+static bool dominates(const Score& score, const Score& other) {
+  const double delay_s = get_comparable_delay_s(score.delay_p50_s);
+  const double other_delay_s = get_comparable_delay_s(other.delay_p50_s);
+  return score.precision >= other.precision && score.recall >= other.recall && delay_s <= other_delay_s &&
+         (score.precision > other.precision || score.recall > other.recall || delay_s < other_delay_s);
+}
+
+/* Without detected arrivals the delay is unknown, which is worse than any */
+static double get_comparable_delay_s(double delay_s) {
+  return isnan(delay_s) ? INFINITY : delay_s;
+}
+
+static void print_row(const std::string& room, const RoomDetectorConfig& config, const Score& score, bool pareto) {
+  double values[PARAMETERS_COUNT];
+  get_parameter_values(config, values);
+  printf("%s", room.c_str());
+  for (double value : values) {
+    printf(",%g", value);
+  }
+  printf(",%.4f,%.4f,", score.precision, score.recall);
+  if (!isnan(score.delay_p50_s)) {
+    printf("%.2f,%.2f", score.delay_p50_s, score.delay_p90_s);
+  } else {
+    printf(",");
+  }
+  printf(",%u,%u,%d\n", score.arrivals, score.missed, pareto);
+}
+
+static void print_score(const char* name, const Score& score) {
+  fprintf(stderr, "%s: precision %.4f, recall %.4f, detection delay p50 %.2f s, p90 %.2f s, %u of %u arrivals missed\n",
+          name, score.precision, score.recall, score.delay_p50_s, score.delay_p90_s, score.missed, score.arrivals);
+}
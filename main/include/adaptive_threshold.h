@@ -0,0 +1,62 @@
+#ifndef ADAPTIVE_THRESHOLD_H
+#define ADAPTIVE_THRESHOLD_H
+
+#include <esp_radar.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Follows the detection threshold to the empty room baseline between
+ * calibrations.
+ *
+ * A high quantile of the samples of an empty room is estimated with the P²
+ * algorithm, which keeps five markers instead of the samples, so memory and
+ * the cost per sample are constant. At the end of every period the estimate
+ * moves the threshold a fraction of the way towards it. The threshold stays
+ * within a range around the calibrated one, so a person who sits still for a
+ * long time can't drag it arbitrarily far. */
+
+/* PUBLIC CONSTANTS */
+#define ADAPTIVE_THRESHOLD_PERIOD_SAMPLES 30000  // About 5 minutes of empty room
+#define ADAPTIVE_THRESHOLD_WEIGHT         0.25f  // Share of a period estimate in the threshold
+#define ADAPTIVE_THRESHOLD_MIN_RATIO      0.5f   // Limits relative to the calibrated threshold
+#define ADAPTIVE_THRESHOLD_MAX_RATIO      2.0f
+
+#define QUANTILE_MARKERS_COUNT 5
+
+/* PUBLIC TYPES */
+typedef struct {
+  float quantile;
+  uint32_t count;
+  float heights[QUANTILE_MARKERS_COUNT];
+  int32_t positions[QUANTILE_MARKERS_COUNT];
+  float desired_positions[QUANTILE_MARKERS_COUNT];
+} QuantileEstimator;
+
+typedef struct {
+  float margin;
+  wifi_radar_info_t calibrated;
+  wifi_radar_info_t threshold;
+  QuantileEstimator jitter;
+  QuantileEstimator wander;
+} AdaptiveThreshold;
+
+/* PUBLIC PROTOTYPES */
+void quantile_estimator_init(QuantileEstimator* estimator, float quantile);
+void quantile_estimator_add(QuantileEstimator* estimator, float value);
+/* Exact until five samples have been seen, 0 without samples */
+float quantile_estimator_get(const QuantileEstimator* estimator);
+
+/* The threshold follows the quantile times margin, like a calibration does */
+void adaptive_threshold_init(AdaptiveThreshold* adaptive, const wifi_radar_info_t* calibrated, float quantile, float margin);
+/* Takes a sample of the empty room. Returns true and updates threshold at the
+ * end of a period. */
+bool adaptive_threshold_add(AdaptiveThreshold* adaptive, const wifi_radar_info_t* sample, wifi_radar_info_t* threshold);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,27 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <mqtt_frame.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Time since boot of every BootStage, logged as the stages are reached and
+ * published once with MQTT_TX_MSG_BOOT_TIMELINE after the first room status,
+ * so time-to-first-status can be measured on every power-up.
+ *
+ * Every stage has a single writer, the task that reaches it, and only its
+ * first time counts. Reconnects later on don't move the boot stages. */
+
+/* PUBLIC PROTOTYPES */
+void mark_boot_stage(BootStage stage);
+bool is_boot_stage_reached(BootStage stage);
+void get_boot_timeline(BootTimeline* timeline);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,72 @@
+#ifndef BREATHING_DETECTOR_H
+#define BREATHING_DETECTOR_H
+
+#include <esp_radar.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Detects somebody sitting or lying still from their breathing. It moves the
+ * channel too little for the thresholds, but shows up as a slow oscillation
+ * of the jitter and wander, 6 to 30 breaths a minute.
+ *
+ * Samples are turned into ratios to their thresholds in Q8 and averaged into
+ * blocks of BREATHING_BLOCK_MS, which gives a steady rate whatever the ping
+ * interval; blocks without samples repeat the last one. A sliding DFT over the
+ * last BREATHING_WINDOW_SIZE blocks keeps the bins of 0.125 to 0.5 Hz. A bin is
+ * the sum of the window values times the twiddle of their position, so each
+ * block adds its products and subtracts the products of the block leaving the
+ * window. That is O(bins) integer operations per block, and exact, without the
+ * drift of the recursive form. The sum and the sum of squares of the window
+ * slide along and give the energy of the window without its mean.
+ *
+ * Breathing is seen while the band holds share_percent of that energy, in the
+ * jitter or the wander, for BREATHING_HOLD_BLOCKS blocks in a row. The window
+ * has to fill first, so the decision comes BREATHING_WINDOW_SIZE blocks after
+ * a reset at the earliest. */
+
+/* PUBLIC CONSTANTS */
+#define BREATHING_BLOCK_MS       250  // 4 Hz
+#define BREATHING_WINDOW_SIZE    64   // 16 s, bins are 0.0625 Hz apart
+#define BREATHING_FIRST_BIN      2    // 0.125 Hz
+#define BREATHING_LAST_BIN       8    // 0.5 Hz
+#define BREATHING_BINS_COUNT     (BREATHING_LAST_BIN - BREATHING_FIRST_BIN + 1)
+#define BREATHING_HOLD_BLOCKS    8
+#define BREATHING_CHANNELS_COUNT 2  // Jitter and wander
+
+/* PUBLIC TYPES */
+typedef struct {
+  int16_t values[BREATHING_WINDOW_SIZE];  // Block means, Q8 of the threshold
+  int32_t sum;
+  int32_t sum_squares;
+  int32_t re[BREATHING_BINS_COUNT];
+  int32_t im[BREATHING_BINS_COUNT];
+  uint32_t block_sum;  // Of the samples in the current block
+} BreathingChannel;
+
+typedef struct {
+  BreathingChannel channels[BREATHING_CHANNELS_COUNT];
+  uint8_t share_percent;
+  uint32_t block_index;  // Timestamp / BREATHING_BLOCK_MS of the current block
+  uint16_t block_samples;
+  uint8_t position;  // Of the next block in the window
+  uint8_t filled;
+  uint8_t pending_count;  // Blocks in a row against the current decision
+  bool present;
+} BreathingDetector;
+
+/* PUBLIC PROTOTYPES */
+void breathing_detector_init(BreathingDetector* detector, uint8_t share_percent);
+/* Forgets the window and the decision, e.g. for new thresholds */
+void breathing_detector_reset(BreathingDetector* detector);
+/* Adds a sample, returns whether breathing is seen after it */
+bool breathing_detector_push(BreathingDetector* detector, const wifi_radar_info_t* info,
+                             const wifi_radar_info_t* threshold, uint32_t timestamp_ms);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,70 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <esp_radar.h>
+#include <link_table.h>
+#include <nvs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Calibration records and their storage in NVS. Every named profile, e.g. day
+ * and night, has its own record, and the name of the active profile is stored
+ * too, so the device starts detecting right after boot.
+ *
+ * Record (version 1): [version, u8] [threshold jitter, f32] [threshold wander, f32]
+ *                     [mean jitter, f32] [mean wander, f32] [variance jitter, f32]
+ *                     [variance wander, f32] [sample count, u32] [calibrated at s, u32]
+ *
+ * Links (version 1): [version, u8] [count, u8]
+ *                    ([MAC, 6 bytes] [threshold jitter, f32] [threshold wander, f32])...
+ *
+ * Multi-byte values are little endian. */
+
+/* PUBLIC CONSTANTS */
+#define CALIBRATION_RECORD_VERSION   1
+#define CALIBRATION_RECORD_SIZE      33
+#define CALIBRATION_LINKS_VERSION    1
+#define CALIBRATION_PROFILE_MAX_SIZE 12  // Including the terminator, NVS keys are short
+#define CALIBRATION_DEFAULT_PROFILE  "default"
+#define CALIBRATION_THRESHOLD_MARGIN 1.1f  // Thresholds are this much above the empty room
+
+/* PUBLIC TYPES */
+typedef struct {
+  wifi_radar_info_t threshold;
+  wifi_radar_info_t mean;
+  wifi_radar_info_t variance;  // Sum of squared differences until calibration_record_finish()
+  uint32_t samples_count;
+  uint32_t calibrated_at_s;  // time() at the end, which counts from boot if the clock isn't set
+} CalibrationRecord;
+
+typedef struct {
+  uint8_t mac[LINK_MAC_SIZE];
+  wifi_radar_info_t threshold;
+} LinkThreshold;
+
+/* PUBLIC PROTOTYPES */
+void calibration_record_begin(CalibrationRecord* record);
+void calibration_record_add(CalibrationRecord* record, const wifi_radar_info_t* info);
+void calibration_record_finish(CalibrationRecord* record, const wifi_radar_info_t* threshold);
+
+bool is_calibration_profile_name_valid(const char* name, size_t length);
+/* Falls back to CALIBRATION_DEFAULT_PROFILE. Name must hold CALIBRATION_PROFILE_MAX_SIZE bytes. */
+void load_calibration_profile(nvs_handle_t handle, char* name);
+void save_calibration_profile(nvs_handle_t handle, const char* name);
+/* Returns false if the profile has no calibration. The default profile takes
+ * over the jitter threshold of firmware that only stored that. */
+bool load_calibration(nvs_handle_t handle, const char* profile, CalibrationRecord* record);
+void save_calibration(nvs_handle_t handle, const char* profile, const CalibrationRecord* record);
+/* Thresholds of the individual transmitters. Returns their count. */
+size_t load_link_thresholds(nvs_handle_t handle, const char* profile, LinkThreshold* links, size_t max_links);
+void save_link_thresholds(nvs_handle_t handle, const char* profile, const LinkThreshold* links, size_t count);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,66 @@
+#ifndef CSI_CODEC_H
+#define CSI_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Compact encoding of a batch of CSI frames for MQTT. Only depends on the C
+ * library so that host tools can decode it.
+ *
+ * Values are quantized by an arithmetic right shift. The first frame of a
+ * batch is stored as is, the following ones as the difference to the previous
+ * frame, two per byte when it fits into [-7, 7]. Otherwise a 0x8 nibble is
+ * followed by the value itself in two nibbles. Every batch can be decoded on its own, so a lost
+ * MQTT message only loses its own frames.
+ *
+ * Batch: [frame count, u8] [quantization shift, u8] [base timestamp ms, u32] [frame]...
+ * Frame: [ms since previous frame, varint] [RSSI, i8] [value count, u8]
+ *        [radar jitter, f32] [radar wander, f32] [values]
+ *
+ * Multi-byte values are little endian. The radar jitter and wander are the
+ * latest output of the CSI library, so recordings can be compared with it. */
+
+/* PUBLIC CONSTANTS */
+#define CSI_MAX_VALUES         128
+#define CSI_BATCH_HEADER_SIZE  6
+#define CSI_FRAME_MAX_SIZE     (5 + 2 + 8 + 2 * CSI_MAX_VALUES)
+
+/* PUBLIC TYPES */
+typedef struct {
+  uint32_t timestamp_ms;
+  int8_t rssi;
+  uint8_t values_count;
+  float waveform_jitter;
+  float waveform_wander;
+  int8_t values[CSI_MAX_VALUES];
+} CsiFrame;
+
+typedef struct {
+  uint8_t* buffer;
+  size_t capacity;
+  size_t size;
+  uint8_t frames_count;
+  uint8_t quantization_shift;
+  uint32_t previous_timestamp_ms;
+  uint8_t previous_count;
+  int8_t previous[CSI_MAX_VALUES];
+} CsiBatchWriter;
+
+/* PUBLIC PROTOTYPES */
+void csi_batch_begin(CsiBatchWriter* writer, uint8_t* buffer, size_t capacity, uint8_t quantization_shift);
+/* Returns false and leaves the batch untouched if the frame doesn't fit */
+bool csi_batch_append(CsiBatchWriter* writer, const CsiFrame* frame);
+/* Returns the number of decoded frames or -1 if the payload is malformed.
+ * Decoded values are scaled back, so they differ from the originals by the
+ * quantization error only. */
+int csi_batch_decode(const uint8_t* payload, size_t payload_size, CsiFrame* frames, size_t max_frames);
+
+#if __cplusplus
+}
+#endif
+#endif
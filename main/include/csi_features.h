@@ -0,0 +1,199 @@
+#ifndef CSI_FEATURES_H
+#define CSI_FEATURES_H
+
+#include <esp_radar.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* In-tree replacement for the jitter and wander of esp-csi, computed from the
+ * filtered CSI of every frame the way libesp-csi.a v0.0.7 computes them.
+ *
+ * The amplitudes of ten subcarriers, every fifth one of the valid data, go
+ * through a spike filter that drops frames in which more than four of them
+ * jump by over 8 against both neighbouring frames, so frames arrive two frames
+ * late. A window holds window_frames frames or spans as many frame intervals,
+ * whichever fills first, and the next one starts halfway into it. A gap of
+ * more than a quarter of that time closes the window early, frames less than
+ * a quarter interval apart are dropped. Each window is reduced to the
+ * principal vector of its amplitudes, the top eigenvector of the 10 x 10
+ * matrix of their products, without centering, found by power iteration.
+ * Jitter is one minus the largest absolute Pearson correlation of that vector
+ * with the ones of the three windows before, 0 for the first three windows.
+ * Wander is 0 until training: the windows during training keep their vector as
+ * a reference when none of the references correlates with it by 0.99 yet, up
+ * to CSI_REFERENCE_VECTORS of them, and wander is then one minus the largest
+ * correlation with a reference. Like esp-csi, it starts with the third jitter
+ * after training started and is 0 for the window after one whose jitter
+ * correlation dipped by over 0.01 against both neighbours.
+ *
+ * esp-csi finds the same vector on the window_frames x window_frames matrix of
+ * the products between frames and reports it after at most 29 iterations, the
+ * small matrix gives it at a fraction of the work. The float kernel tracks the
+ * library to a few 1e-7 and is the reference on host. The fixed-point one is
+ * for the ESP32-C3, which has no FPU: Q4 amplitudes, 32-bit products, Q14
+ * vectors and Q30 correlations, within a few 1e-5 of the library.
+ * csi_feature_check compares both with the library on host/tests/csi_stream.txt.
+ *
+ * The PCA kernel works on the few directions in which the subcarriers
+ * actually vary, since neighbouring subcarriers mostly move together. It takes
+ * the power of the subcarriers, which saves the square root per subcarrier
+ * that dominates the other kernels. Every frame is centered on a moving
+ * average like the wander reference, minus the offset common to all
+ * subcarriers, and projected onto the top components of those deviations.
+ * Jitter is the energy of the change of the projection since the previous
+ * frame and wander the energy of the projection itself, both relative to twice
+ * the variance of the frame across its subcarriers, which is about what one
+ * minus the correlations measures. Both are averaged over window_frames frames
+ * and don't follow the scale of esp-csi. The components are learned in
+ * integers with Sanger's rule, Oja's rule extended to several components, every
+ * CSI_PCA_UPDATE_FRAMES frames, so the per-frame work is components_count dot
+ * products. The basis spans the subcarriers of the first frame, later frames
+ * are cut to them or padded with the average. It ignores timestamps and
+ * training, and detects worse than the other kernels in radar_tune, so it's
+ * opt-in: CSI_FEATURES_PCA puts it behind the csi_features_* names, with
+ * CSI_PCA_COMPONENTS components, otherwise CSI_FEATURES_FIXED_POINT picks one
+ * of the other two. */
+
+/* PUBLIC CONSTANTS */
+#ifndef CSI_FEATURES_FIXED_POINT
+#define CSI_FEATURES_FIXED_POINT 1
+#endif
+#ifndef CSI_FEATURES_PCA
+#define CSI_FEATURES_PCA 0
+#endif
+#ifndef CSI_PCA_COMPONENTS
+#define CSI_PCA_COMPONENTS 3
+#endif
+
+#define CSI_MAX_SUBCARRIERS         128
+#define CSI_FEATURE_SUBCARRIERS     10         // Subcarriers esp-csi looks at
+#define CSI_SUBCARRIER_STRIDE       10         // Bytes of valid data between them, also the offset of the first one
+#define CSI_WINDOW_FRAMES           50         // esp-csi default, twice its 250 ms handle time at 10 ms per frame
+#define CSI_WINDOW_CAPACITY         60         // Frames buffered for the windows, 10 more than the largest
+#define CSI_FRAME_INTERVAL_MS       10         // Expected time between frames, csi_recv_interval of esp-csi
+#define CSI_SPIKE_FRAMES            4          // Frames the spike filter looks at
+#define CSI_JITTER_WINDOWS          3          // Earlier windows jitter compares with
+#define CSI_REFERENCE_VECTORS       10         // Most vectors kept while training
+#define CSI_AMPLITUDE_FRACTION_BITS 4          // Fixed-point amplitudes are Q4
+#define CSI_VECTOR_ONE              (1 << 14)  // Fixed-point principal vectors are Q14, the largest element is one
+#define CSI_CORRELATION_ONE         (1 << 30)  // Fixed-point correlations are Q30
+#define CSI_PCA_SHARE_ONE           (1 << 15)  // Jitter and wander of the PCA kernel are Q15
+#define CSI_REFERENCE_SHIFT         5          // The PCA average moves 1/32 of the way to every frame
+#define CSI_PCA_MAX_COMPONENTS      4
+#define CSI_PCA_ONE                 (1 << 14)  // Basis vectors are Q14 unit vectors
+#define CSI_PCA_UPDATE_FRAMES       8          // Frames between updates of the basis
+
+/* PUBLIC TYPES */
+typedef enum {
+  CSI_UNTRAINED,
+  CSI_TRAINING,
+  CSI_TRAINED,
+} CsiTrainingStatus;
+
+/* Bookkeeping of the frames in the windows, shared by the fixed-point and float kernels */
+typedef struct {
+  uint16_t window_frames;
+  uint32_t begin;            // Frames before the oldest one of the window, its slot is begin % CSI_WINDOW_CAPACITY
+  uint32_t end;              // Frames before the next one
+  uint32_t filtered_count;   // Frames that went through the spike filter
+  uint32_t previous_ms;      // Timestamp the next frame is compared with
+  uint32_t vectors_count;    // Windows since the start or since training started
+  uint8_t training_status;   // CsiTrainingStatus
+  uint8_t references_count;
+  uint32_t stability_count;  // Jitter correlations kept since training started
+  uint32_t timestamps_ms[CSI_WINDOW_CAPACITY];
+} CsiWindowRing;
+
+typedef struct {
+  CsiWindowRing ring;
+  int32_t stability[CSI_JITTER_WINDOWS];  // Latest Q30 jitter correlations since training started
+  uint16_t recent[CSI_SPIKE_FRAMES][CSI_FEATURE_SUBCARRIERS];  // Q4 amplitudes for the spike filter
+  uint16_t amplitudes[CSI_WINDOW_CAPACITY][CSI_FEATURE_SUBCARRIERS];
+  uint16_t vectors[CSI_JITTER_WINDOWS + 1][CSI_FEATURE_SUBCARRIERS];
+  uint16_t references[CSI_REFERENCE_VECTORS][CSI_FEATURE_SUBCARRIERS];
+} CsiFeaturesFixed;
+
+typedef struct {
+  CsiWindowRing ring;
+  float stability[CSI_JITTER_WINDOWS];
+  float recent[CSI_SPIKE_FRAMES][CSI_FEATURE_SUBCARRIERS];
+  float amplitudes[CSI_WINDOW_CAPACITY][CSI_FEATURE_SUBCARRIERS];
+  float vectors[CSI_JITTER_WINDOWS + 1][CSI_FEATURE_SUBCARRIERS];
+  float references[CSI_REFERENCE_VECTORS][CSI_FEATURE_SUBCARRIERS];
+} CsiFeaturesFloat;
+
+/* Q15 jitter and wander of the PCA kernel, averaged over a window */
+typedef struct {
+  uint16_t window_frames;
+  uint16_t frames_count;
+  uint32_t jitter_sum;
+  uint32_t wander_sum;
+} CsiFeatureWindow;
+
+typedef struct {
+  CsiFeatureWindow window;
+  uint8_t components_count;
+  uint8_t update_count;  // Frames since the last update of the basis
+  uint16_t dimension;    // Subcarriers spanned by the basis, 0 before the first frame
+  int32_t scores[CSI_PCA_MAX_COMPONENTS];   // Projection of the previous frame
+  uint32_t energy[CSI_PCA_MAX_COMPONENTS];  // Moving average of the squared scores, scales the learning rate
+  uint16_t reference[CSI_MAX_SUBCARRIERS];  // Powers >> 3, << 4
+  int16_t basis[CSI_PCA_MAX_COMPONENTS][CSI_MAX_SUBCARRIERS];
+} CsiFeaturesPca;
+
+/* PUBLIC PROTOTYPES */
+/* Kernels. Data is the valid_data of wifi_csi_filtered_info_t, an imaginary and
+ * a real byte per subcarrier. Return CSI_FEATURE_SUBCARRIERS, or 0 if the data
+ * is too short for them. */
+uint16_t csi_amplitudes_fixed(const int8_t* data, uint16_t length, uint16_t* amplitudes);
+uint16_t csi_amplitudes_float(const int8_t* data, uint16_t length, float* amplitudes);
+/* Pearson correlation, 0 if either input is constant. The fixed-point one takes
+ * at most CSI_FEATURE_SUBCARRIERS values of at most CSI_VECTOR_ONE. */
+int32_t csi_correlation_fixed(const uint16_t* a, const uint16_t* b, uint16_t count);
+float csi_correlation_float(const float* a, const float* b, uint16_t count);
+
+/* Feature extraction. Push returns true and fills info when a window closes,
+ * every window_frames / 2 frames at the expected rate. Frames with too little
+ * data are ignored. Window_frames is clamped to 2..CSI_WINDOW_CAPACITY - 10.
+ * Training start drops the references of an earlier training. */
+void csi_features_init_fixed(CsiFeaturesFixed* features, uint16_t window_frames);
+bool csi_features_push_fixed(CsiFeaturesFixed* features, const int8_t* data, uint16_t length, uint32_t timestamp_ms, wifi_radar_info_t* info);
+void csi_features_train_start_fixed(CsiFeaturesFixed* features);
+void csi_features_train_stop_fixed(CsiFeaturesFixed* features);
+void csi_features_init_float(CsiFeaturesFloat* features, uint16_t window_frames);
+bool csi_features_push_float(CsiFeaturesFloat* features, const int8_t* data, uint16_t length, uint32_t timestamp_ms, wifi_radar_info_t* info);
+void csi_features_train_start_float(CsiFeaturesFloat* features);
+void csi_features_train_stop_float(CsiFeaturesFloat* features);
+/* Components_count is clamped to 1..CSI_PCA_MAX_COMPONENTS. Push returns true
+ * once every window_frames frames. */
+void csi_features_init_pca(CsiFeaturesPca* features, uint16_t window_frames, uint8_t components_count);
+bool csi_features_push_pca(CsiFeaturesPca* features, const int8_t* data, uint16_t length, uint32_t timestamp_ms, wifi_radar_info_t* info);
+
+#if CSI_FEATURES_PCA
+typedef CsiFeaturesPca CsiFeatures;
+#define csi_features_init(features, window_frames) csi_features_init_pca(features, window_frames, CSI_PCA_COMPONENTS)
+#define csi_features_push                          csi_features_push_pca
+#define csi_features_train_start(features)         ((void)(features))
+#define csi_features_train_stop(features)          ((void)(features))
+#elif CSI_FEATURES_FIXED_POINT
+typedef CsiFeaturesFixed CsiFeatures;
+#define csi_features_init        csi_features_init_fixed
+#define csi_features_push        csi_features_push_fixed
+#define csi_features_train_start csi_features_train_start_fixed
+#define csi_features_train_stop  csi_features_train_stop_fixed
+#else
+typedef CsiFeaturesFloat CsiFeatures;
+#define csi_features_init        csi_features_init_float
+#define csi_features_push        csi_features_push_float
+#define csi_features_train_start csi_features_train_start_float
+#define csi_features_train_stop  csi_features_train_stop_float
+#endif
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,23 @@
+#ifndef CSI_STREAM_H
+#define CSI_STREAM_H
+
+#include <esp_radar.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC PROTOTYPES */
+void init_csi_stream();
+void start_csi_stream();
+void stop_csi_stream();
+/* Called from the CSI callback of the radar. Only copies the frame when
+ * streaming and never blocks. */
+void add_csi_stream_frame(const wifi_csi_filtered_info_t* info);
+/* Latest radar output, recorded alongside the CSI frames */
+void set_csi_stream_radar_info(const wifi_radar_info_t* info);
+
+#if __cplusplus
+}
+#endif
+#endif
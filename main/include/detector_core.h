@@ -0,0 +1,65 @@
+#ifndef DETECTOR_CORE_H
+#define DETECTOR_CORE_H
+
+#include <esp_radar.h>
+#include <nvs.h>
+#include <presence_hysteresis.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Detector variants specialized at compile time.
+ *
+ * A variant fixes the window length, the detections needed in the window,
+ * the features compared with the thresholds (jitter, or jitter and wander)
+ * and the presence hysteresis as template parameters of detector_core.cpp.
+ * Each compiles to its own straight-line code with constants folded in, so a
+ * tuned variant costs less per sample than the run-time configured detector.
+ * The firmware ships a variant per room type and picks one at run time; the
+ * per-sample path then only makes two indirect calls into it. */
+
+/* PUBLIC CONSTANTS */
+#define DETECTOR_VARIANT_NAME_MAX_SIZE 12  // Including the terminator
+#define DETECTOR_WINDOW_MAX_SIZE       64  // Bits of DetectorWindow.bits
+
+/* PUBLIC TYPES */
+/* Same storage for every variant, so a link can switch variants */
+typedef struct {
+  uint64_t bits;  // Judgements of the last samples, the newest in bit 0
+  uint8_t detections;
+  uint8_t filled;
+} DetectorWindow;
+
+typedef struct {
+  const char* name;
+  uint16_t window_size;
+  uint16_t needed_detections;
+  bool uses_wander;
+  /* Judges a sample against the thresholds of its link and votes over the
+   * window. Returns false until the window has filled, like link_detector_push(). */
+  bool (*push_link)(DetectorWindow* window, const wifi_radar_info_t* info, const wifi_radar_info_t* threshold,
+                    bool* motion_detected, bool* detecting);
+  /* Same as presence_hysteresis_push() and presence_hysteresis_update(), but
+   * with the settings of the variant instead of the ones in the struct */
+  bool (*push_presence)(PresenceHysteresis* presence, bool movement, uint32_t timestamp_ms);
+  bool (*update_presence)(PresenceHysteresis* presence, uint32_t now_ms);
+} DetectorVariant;
+
+/* PUBLIC PROTOTYPES */
+size_t get_detector_variants_count();
+const DetectorVariant* get_detector_variant(size_t index);
+/* Returns NULL if no variant has the name */
+const DetectorVariant* find_detector_variant(const char* name, size_t length);
+/* Returns NULL if NVS has no variant, or one this firmware doesn't ship */
+const DetectorVariant* load_detector_variant(nvs_handle_t handle);
+/* NULL stores that the run-time configured detector is used */
+void save_detector_variant(nvs_handle_t handle, const DetectorVariant* variant);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,70 @@
+#ifndef FRAME_BYTES_H
+#define FRAME_BYTES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Little endian and varint helpers shared by the MQTT payload codecs */
+
+/* PUBLIC CONSTANTS */
+#define VARINT_MAX_SIZE 5
+
+/* PUBLIC FUNCTIONS */
+static inline uint8_t* put_u16(uint8_t* cursor, uint16_t value) {
+  *cursor++ = value;
+  *cursor++ = value >> 8;
+  return cursor;
+}
+
+static inline uint8_t* put_u32(uint8_t* cursor, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    *cursor++ = value >> (8 * i);
+  }
+  return cursor;
+}
+
+static inline uint8_t* put_f32(uint8_t* cursor, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return put_u32(cursor, bits);
+}
+
+static inline uint8_t* put_varint(uint8_t* cursor, uint32_t value) {
+  while (value >= 0x80) {
+    *cursor++ = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  *cursor++ = value;
+  return cursor;
+}
+
+static inline uint16_t get_u16(const uint8_t* cursor) {
+  return (uint16_t)(cursor[0] | cursor[1] << 8);
+}
+
+static inline uint32_t get_u32(const uint8_t* cursor) {
+  return (uint32_t)cursor[0] | (uint32_t)cursor[1] << 8 | (uint32_t)cursor[2] << 16 | (uint32_t)cursor[3] << 24;
+}
+
+static inline float get_f32(const uint8_t* cursor) {
+  const uint32_t bits = get_u32(cursor);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/* Returns NULL if the varint is longer than VARINT_MAX_SIZE or runs past the end */
+static inline const uint8_t* get_varint(const uint8_t* cursor, const uint8_t* end, uint32_t* value) {
+  *value = 0;
+  for (int i = 0; i < VARINT_MAX_SIZE && cursor < end; i++) {
+    const uint8_t byte = *cursor++;
+    *value |= (uint32_t)(byte & 0x7F) << (7 * i);
+    if (!(byte & 0x80)) {
+      return cursor;
+    }
+  }
+  return NULL;
+}
+
+#endif
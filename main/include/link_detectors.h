@@ -0,0 +1,72 @@
+#ifndef LINK_DETECTORS_H
+#define LINK_DETECTORS_H
+
+#include <adaptive_threshold.h>
+#include <calibration.h>
+#include <detector_core.h>
+#include <esp_radar.h>
+#include <link_table.h>
+#include <motion_classifier.h>
+#include <motion_window.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* A motion detector per transmitter. Every link has its own thresholds,
+ * calibration and window of detections, and the room decision is made by
+ * counting the links that currently detect motion. Links without a stored
+ * threshold start from the default one and adapt from there. */
+
+/* PUBLIC TYPES */
+typedef struct {
+  wifi_radar_info_t threshold;
+  wifi_radar_info_t calibration_max;
+  AdaptiveThreshold adaptive;
+  MotionWindow motion_window;
+  MotionClassifier classifier;
+  DetectorWindow core;  // Window of the detector variant
+  bool motion_detected;  // The last sample was over the threshold, or judged as motion by the model
+  bool detecting;
+} LinkDetector;
+
+typedef struct {
+  LinkTable table;
+  LinkDetector links[LINK_TABLE_CAPACITY];
+  uint16_t window_size;
+  uint16_t needed_detections;
+  float threshold_margin;  // Of the calibration, adapted thresholds keep it too
+  wifi_radar_info_t default_threshold;
+  const MotionModel* model;  // Used with MOTION_CLASSIFIER_ENABLED
+  const DetectorVariant* variant;  // Judges the samples instead of the model and window if set
+} LinkDetectors;
+
+/* PUBLIC PROTOTYPES */
+/* Detectors start with the compiled-in motion model and no variant */
+void link_detectors_init(LinkDetectors* detectors, uint16_t window_size, uint16_t needed_detections, float threshold_margin);
+/* Forgets all links, new links start with the default threshold */
+void link_detectors_reset(LinkDetectors* detectors, const wifi_radar_info_t* default_threshold);
+/* Model must stay valid while the detectors use it */
+void link_detectors_set_model(LinkDetectors* detectors, const MotionModel* model);
+/* Links keep their thresholds, but their windows start over */
+void link_detectors_set_variant(LinkDetectors* detectors, const DetectorVariant* variant);
+void link_detectors_set_threshold(LinkDetectors* detectors, const LinkThreshold* link, uint32_t now_ms);
+LinkDetector* link_detectors_get(LinkDetectors* detectors, const uint8_t* mac, uint32_t now_ms);
+/* Number of links seen within max_age_ms that detect motion */
+uint8_t link_detectors_count_detecting(const LinkDetectors* detectors, uint32_t now_ms, uint32_t max_age_ms);
+void link_detectors_begin_calibration(LinkDetectors* detectors);
+/* Thresholds are the calibration maxima times margin. Returns the number of links. */
+size_t link_detectors_finish_calibration(const LinkDetectors* detectors, float margin, LinkThreshold* thresholds);
+
+void link_detector_calibrate(LinkDetector* link, const wifi_radar_info_t* info);
+/* Judges a sample, and adapts the threshold if the room is empty. Returns
+ * false until the window of the link has filled. */
+bool link_detector_push(LinkDetectors* detectors, LinkDetector* link, const wifi_radar_info_t* info, bool room_empty);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,46 @@
+#ifndef LINK_TABLE_H
+#define LINK_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Fixed-capacity, open-addressed table of transmitters keyed by MAC. It only
+ * maps a MAC to a slot, and the owner keeps the per-link state in an array
+ * indexed by slot.
+ *
+ * Links are never removed one by one. When the table is full, a new link takes
+ * over the slot of the link seen least recently. A full table stays full, so a
+ * lookup probes until it finds the MAC or an empty slot, or has seen every slot. */
+
+/* PUBLIC CONSTANTS */
+#define LINK_TABLE_CAPACITY 8
+#define LINK_MAC_SIZE       6
+
+/* PUBLIC TYPES */
+typedef struct {
+  uint8_t mac[LINK_MAC_SIZE];
+  bool used;
+  uint32_t last_seen_ms;
+} LinkSlot;
+
+typedef struct {
+  LinkSlot slots[LINK_TABLE_CAPACITY];
+  uint8_t count;
+} LinkTable;
+
+/* PUBLIC PROTOTYPES */
+void link_table_init(LinkTable* table);
+/* Returns the slot of the MAC, -1 if it isn't in the table */
+int link_table_find(const LinkTable* table, const uint8_t* mac);
+/* Returns the slot of the MAC and marks it seen. Adds the MAC if needed, in
+ * which case inserted is set and the state of the slot must be reset. */
+int link_table_get(LinkTable* table, const uint8_t* mac, uint32_t now_ms, bool* inserted);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,112 @@
+#ifndef MOTION_CLASSIFIER_H
+#define MOTION_CLASSIFIER_H
+
+#include <esp_radar.h>
+#include <nvs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Judges whether a sample shows motion with a small quantized model instead of
+ * comparing the jitter with its threshold alone.
+ *
+ * Every link keeps a short window of its samples. Each sample and window is
+ * turned into int8 features, which are ratios to the thresholds of the link in
+ * Q4, so 16 is at the threshold and the same model fits any room and
+ * calibration. Inputs are converted from float once, everything after that is
+ * integer. A push costs one pass over the window plus the model, a logistic
+ * regression or a tree of at most MOTION_TREE_MAX_NODES nodes, so the cost per
+ * sample is bounded whatever the model.
+ *
+ * Model (version 1): [version, u8] [type, u8] followed by
+ *   logistic: [bias, i16] [weight, i8] * MOTION_FEATURES_COUNT
+ *             motion if bias + sum(weight * feature) > 0
+ *   tree:     [nodes count, u8] ([feature, u8] [threshold, i8] [left, u8] [right, u8])...
+ *             a node goes left if its feature <= threshold, children come
+ *             after their parent, a leaf has feature MOTION_TREE_LEAF and its
+ *             threshold is 1 for motion
+ *
+ * Multi-byte values are little endian. */
+
+/* PUBLIC CONSTANTS */
+#define MOTION_MODEL_VERSION      1
+#define MOTION_MODEL_MAX_SIZE     (3 + 4 * 15)
+#define MOTION_FEATURE_ONE        16  // Feature of a value at its threshold
+#define MOTION_CLASSIFIER_WINDOW  16  // Samples in the window features
+#define MOTION_TREE_MAX_NODES     15  // Depth 3 when full
+#define MOTION_TREE_LEAF          0xFF
+
+/* PUBLIC ENUMS */
+typedef enum {
+  MOTION_FEATURE_JITTER = 0,
+  MOTION_FEATURE_WANDER,
+  MOTION_FEATURE_JITTER_MEAN,    // Of the window
+  MOTION_FEATURE_JITTER_MAX,     // Of the window
+  MOTION_FEATURE_WANDER_MEAN,    // Of the window
+  MOTION_FEATURE_JITTER_CHANGE,  // Mean absolute change between samples of the window
+  MOTION_FEATURES_COUNT,
+} MotionFeatureId;
+
+typedef enum {
+  MOTION_MODEL_LOGISTIC = 0x01,
+  MOTION_MODEL_TREE = 0x02,
+} MotionModelType;
+
+/* PUBLIC TYPES */
+typedef struct {
+  uint8_t feature;
+  int8_t threshold;
+  uint8_t left;
+  uint8_t right;
+} MotionTreeNode;
+
+typedef struct {
+  MotionModelType type;
+  union {
+    struct {
+      int16_t bias;
+      int8_t weights[MOTION_FEATURES_COUNT];
+    } logistic;
+    struct {
+      uint8_t nodes_count;
+      MotionTreeNode nodes[MOTION_TREE_MAX_NODES];
+    } tree;
+  };
+} MotionModel;
+
+typedef struct {
+  uint8_t jitter[MOTION_CLASSIFIER_WINDOW];
+  uint8_t wander[MOTION_CLASSIFIER_WINDOW];
+  uint8_t change[MOTION_CLASSIFIER_WINDOW];
+  uint16_t jitter_sum;
+  uint16_t wander_sum;
+  uint16_t change_sum;
+  uint8_t position;
+  uint8_t filled;
+  int8_t features[MOTION_FEATURES_COUNT];  // Of the last sample
+} MotionClassifier;
+
+/* PUBLIC PROTOTYPES */
+/* The compiled-in model, used until one is stored in NVS */
+const MotionModel* get_default_motion_model();
+/* Checks the model fully, so judging never needs to. Returns false if it's invalid. */
+bool motion_model_decode(const uint8_t* bytes, size_t size, MotionModel* model);
+size_t motion_model_encode(const MotionModel* model, uint8_t* bytes);
+/* Returns false if NVS has no valid model */
+bool load_motion_model(nvs_handle_t handle, MotionModel* model);
+void save_motion_model(nvs_handle_t handle, const MotionModel* model);
+void erase_motion_model(nvs_handle_t handle);
+
+void motion_classifier_init(MotionClassifier* classifier);
+/* Adds the sample to the window and judges it. Thresholds of 0 turn their features off. */
+bool motion_classifier_push(MotionClassifier* classifier, const MotionModel* model, const wifi_radar_info_t* info,
+                            const wifi_radar_info_t* threshold);
+
+#if __cplusplus
+}
+#endif
+#endif
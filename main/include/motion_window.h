@@ -0,0 +1,36 @@
+#ifndef MOTION_WINDOW_H
+#define MOTION_WINDOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC CONSTANTS */
+#define MOTION_WINDOW_MAX_SIZE 4096
+
+/* PUBLIC TYPES */
+/* Sliding window over the last `size` threshold comparisons. Each sample is
+ * kept as one bit and the number of set bits is updated on insert and evict,
+ * so a push costs the same for any window size. */
+typedef struct {
+  uint32_t bits[MOTION_WINDOW_MAX_SIZE / 32];
+  uint16_t size;
+  uint16_t position;
+  uint16_t filled;
+  uint16_t detections;
+} MotionWindow;
+
+/* PUBLIC PROTOTYPES */
+void motion_window_init(MotionWindow* window, uint16_t size);
+void motion_window_reset(MotionWindow* window);
+/* Returns the number of motion detections in the window after the push */
+uint16_t motion_window_push(MotionWindow* window, bool motion_detected);
+bool motion_window_is_full(const MotionWindow* window);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,127 @@
+#ifndef MQTT_FRAME_H
+#define MQTT_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Binary frame of the messages sent by the device. Shared by the firmware and
+ * host tools, so it only depends on the C library.
+ *
+ * Frame:     [0xA0 | version] [message ID] [payload, 0..MQTT_FRAME_PAYLOAD_MAX_SIZE bytes]
+ * Telemetry: [base timestamp ms, u32] [sample count, u8] [sample]...
+ * Sample:    [ms since previous sample, varint] [jitter, f32] [wander, f32] [RSSI, i8] [room status, u8]
+ * Metrics:   [uptime ms, u32] [histogram count, u8] [bucket count, u8] [counter count, u8]
+ *            ([bucket, u32]... [max us, u32])... [counter, u32]...
+ * Boot:      [stage count, u8] [us since boot, u32, 0 if not reached]...
+ *
+ * Multi-byte values are little endian. The payload length is the MQTT message
+ * length minus the header. Legacy frames were always 10 bytes and started
+ * directly with the message ID, which never has the high bit set. */
+
+/* PUBLIC CONSTANTS */
+#define MQTT_FRAME_VERSION          1
+#define MQTT_FRAME_MARKER           0xA0
+#define MQTT_FRAME_HEADER_SIZE      2
+#define MQTT_FRAME_PAYLOAD_MAX_SIZE 1024
+#define MQTT_FRAME_MAX_SIZE         (MQTT_FRAME_HEADER_SIZE + MQTT_FRAME_PAYLOAD_MAX_SIZE)
+#define MQTT_FRAME_LEGACY_SIZE      10
+
+#define TELEMETRY_HEADER_SIZE     5
+#define TELEMETRY_SAMPLE_MAX_SIZE 15  // 5 byte varint + 10 bytes of values
+#define TELEMETRY_MAX_SAMPLES     ((MQTT_FRAME_PAYLOAD_MAX_SIZE - TELEMETRY_HEADER_SIZE) / TELEMETRY_SAMPLE_MAX_SIZE)
+
+#define METRICS_HEADER_SIZE   7
+#define METRICS_BUCKETS_COUNT 16  // Bucket 0 counts latencies under 16 us, bucket i under 16 << i us, the last one all longer
+#define METRICS_REPORT_SIZE   (METRICS_HEADER_SIZE + METRICS_HISTOGRAMS_COUNT * (METRICS_BUCKETS_COUNT + 1) * 4 + METRICS_COUNTERS_COUNT * 4)
+
+#define BOOT_TIMELINE_SIZE (1 + BOOT_STAGES_COUNT * 4)
+
+/* PUBLIC ENUMS */
+typedef enum {
+  METRICS_CSI_TO_SAMPLE,  // CSI frame received until its radar sample is queued
+  METRICS_QUEUE,          // Sample queued until the processing task takes it
+  METRICS_DETECT,         // Detection of one sample
+  METRICS_PUBLISH,        // Room status changed until it's handed to MQTT
+  METRICS_END_TO_END,     // CSI frame received until the movement it showed is handed to MQTT
+  METRICS_HISTOGRAMS_COUNT,
+} MetricsHistogramId;
+
+typedef enum {
+  METRICS_RING_DROPS,       // Samples lost to a full sample ring
+  METRICS_RING_HIGH_WATER,  // Most samples ever waiting in the ring
+  METRICS_PING_TIMEOUTS,
+  METRICS_OUTBOX_EVICTIONS,  // Frames dropped from the full MQTT outbox while the broker was unreachable
+  METRICS_OUTBOX_COALESCED,  // Waiting state frames replaced by newer ones
+  METRICS_COUNTERS_COUNT,
+} MetricsCounterId;
+
+/* In the order of a boot with nothing in the way, but association, the radar
+ * setup and the broker connection overlap */
+typedef enum {
+  BOOT_STAGE_STORAGE,         // NVS is ready
+  BOOT_STAGE_WIFI_STARTED,    // Association goes on in the background
+  BOOT_STAGE_RADAR_STARTED,   // Calibration loaded, tasks and esp-radar started
+  BOOT_STAGE_WIFI_CONNECTED,  // Associated with the AP
+  BOOT_STAGE_GOT_IP,
+  BOOT_STAGE_MQTT_CONNECTED,
+  BOOT_STAGE_FIRST_SAMPLE,  // First radar sample detected
+  BOOT_STAGE_FIRST_STATUS,  // First room status handed to MQTT, the end of the boot
+  BOOT_STAGES_COUNT,
+} BootStage;
+
+/* PUBLIC TYPES */
+typedef struct {
+  uint8_t version;  // 0 for legacy frames
+  uint8_t msg_id;
+  const uint8_t* payload;
+  size_t payload_size;
+} MqttFrame;
+
+typedef struct {
+  uint32_t timestamp_ms;
+  float waveform_jitter;
+  float waveform_wander;
+  int8_t rssi;
+  uint8_t room_status;
+} TelemetrySample;
+
+typedef struct {
+  uint32_t buckets[METRICS_BUCKETS_COUNT];
+  uint32_t max_us;
+} LatencyHistogram;
+
+/* Everything counts from boot, rates come from the difference of two reports */
+typedef struct {
+  uint32_t uptime_ms;
+  LatencyHistogram histograms[METRICS_HISTOGRAMS_COUNT];
+  uint32_t counters[METRICS_COUNTERS_COUNT];
+} MetricsReport;
+
+typedef struct {
+  uint32_t stage_us[BOOT_STAGES_COUNT];  // 0 for stages not reached
+} BootTimeline;
+
+/* PUBLIC PROTOTYPES */
+/* Return the number of bytes written or 0 if the buffer is too small */
+size_t mqtt_frame_encode(uint8_t* buffer, size_t buffer_size, uint8_t msg_id, const void* payload, size_t payload_size);
+size_t mqtt_frame_encode_telemetry(uint8_t* buffer, size_t buffer_size, const TelemetrySample* samples, size_t samples_count);
+size_t mqtt_frame_encode_metrics(uint8_t* buffer, size_t buffer_size, const MetricsReport* report);
+size_t mqtt_frame_encode_boot_timeline(uint8_t* buffer, size_t buffer_size, const BootTimeline* timeline);
+
+bool mqtt_frame_decode(const uint8_t* data, size_t size, MqttFrame* frame);
+/* Returns the number of decoded samples or -1 if the payload is malformed */
+int mqtt_frame_decode_telemetry(const uint8_t* payload, size_t payload_size, TelemetrySample* samples, size_t max_samples);
+/* Fails on reports with other histograms or counters than these */
+bool mqtt_frame_decode_metrics(const uint8_t* payload, size_t payload_size, MetricsReport* report);
+/* Fails on timelines with other stages than these */
+bool mqtt_frame_decode_boot_timeline(const uint8_t* payload, size_t payload_size, BootTimeline* timeline);
+
+#if __cplusplus
+}
+#endif
+#endif
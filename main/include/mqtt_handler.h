@@ -1,25 +1,46 @@
 #ifndef MQTT_HANDLER_H
 #define MQTT_HANDLER_H
 
+#include <mqtt_frame.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #if __cplusplus
 extern "C" {
 #endif
 
-/* PUBLIC CONSTANTS */
-#define MQTT_MSG_SIZE         10
-#define MQTT_PAYLOAD_MAX_SIZE 9
-
 /* PUBLIC ENUMS */
 typedef enum {
   MQTT_TX_MSG_ROOM_STATUS = 0x01,
-  MQTT_TX_MSG_DETECTION_THRESHOLD = 0x02
+  MQTT_TX_MSG_DETECTION_THRESHOLD = 0x02,
+  MQTT_TX_MSG_TELEMETRY = 0x03,
+  MQTT_TX_MSG_CSI = 0x04,
+  MQTT_TX_MSG_SAMPLE_RATE = 0x05,    // [ping interval ms, u32] [CSI frames/s, f32] [samples/s, f32]
+  MQTT_TX_MSG_METRICS = 0x06,        // On MQTT_METRICS_TOPIC, see mqtt_frame.h
+  MQTT_TX_MSG_TRACE_CHUNK = 0x07,    // See trace_recorder.h
+  MQTT_TX_MSG_BOOT_TIMELINE = 0x08,  // Once per boot, after the first room status, see mqtt_frame.h
 } MqttTxMessageId;
 
+typedef enum {
+  MQTT_RX_MSG_START_CALIBRATION = 0x01,
+  MQTT_RX_MSG_STOP_CALIBRATION = 0x02,
+  MQTT_RX_MSG_START_TELEMETRY = 0x03,
+  MQTT_RX_MSG_STOP_TELEMETRY = 0x04,
+  MQTT_RX_MSG_START_CSI_STREAM = 0x05,
+  MQTT_RX_MSG_STOP_CSI_STREAM = 0x06,
+  MQTT_RX_MSG_SELECT_PROFILE = 0x07,   // Followed by the name of the calibration profile
+  MQTT_RX_MSG_SEND_TRACE = 0x08,       // Optionally followed by [offset, u32] [length, u32]
+  MQTT_RX_MSG_LOAD_MODEL = 0x09,       // Followed by a motion model, see motion_classifier.h, none for the default
+  MQTT_RX_MSG_SELECT_DETECTOR = 0x0A,  // Followed by the name of a detector variant, see detector_core.h, none for the configured one
+} MqttRxMessageId;
+
 /* PUBLIC PROTOTYPES */
+/* Frames sent before start_mqtt_client() wait in the outbox */
 void init_mqtt_client();
-void send_mqtt_msg(MqttTxMessageId msg_id, const char* payload, uint8_t payload_size);
+/* Connects to the broker, needs the network */
+void start_mqtt_client();
+void send_mqtt_msg(MqttTxMessageId msg_id, const char* payload, size_t payload_size);
+void send_mqtt_metrics(const char* payload, size_t payload_size);
 
 #if __cplusplus
 }
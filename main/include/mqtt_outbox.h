@@ -0,0 +1,65 @@
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#include <mqtt_frame.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Frames that couldn't be published yet, in fixed buffers, so an outage of
+ * the broker costs no heap however long it lasts.
+ *
+ * Frames of messages that carry a state, like the room status, each have a
+ * slot that a newer frame of the same message overwrites, so reconnecting
+ * sends the latest state once instead of its history, and a flood of other
+ * frames can't push it out. They are sent first.
+ *
+ * Other frames go into a byte ring as [frame size, u16] [message ID, u8]
+ * [flags, u8] [frame] records, padded to 4 bytes. Records never wrap: one
+ * that doesn't fit before the end of the ring goes to its start and the rest
+ * of the ring is padding. When a frame doesn't fit, the oldest records are
+ * evicted until it does.
+ *
+ * Not thread-safe, the caller locks. */
+
+/* PUBLIC CONSTANTS */
+#define MQTT_OUTBOX_SIZE           4096  // Bytes of the ring, must fit the biggest frame
+#define MQTT_OUTBOX_STATE_SLOTS    4
+#define MQTT_OUTBOX_STATE_MAX_SIZE (MQTT_FRAME_HEADER_SIZE + METRICS_REPORT_SIZE)  // Bigger states go into the ring
+
+/* PUBLIC TYPES */
+typedef struct {
+  uint8_t msg_id;
+  uint16_t size;  // 0 if the slot is free
+  uint8_t frame[MQTT_OUTBOX_STATE_MAX_SIZE];
+} MqttOutboxState;
+
+typedef struct {
+  MqttOutboxState states[MQTT_OUTBOX_STATE_SLOTS];
+  uint8_t bytes[MQTT_OUTBOX_SIZE];
+  uint16_t head;            // Oldest record
+  uint16_t tail;            // Where the next one goes
+  uint16_t used;            // Bytes of records and padding, tells a full ring from an empty one
+  uint32_t evicted_count;   // Frames dropped for newer ones
+  uint32_t coalesced_count; // States replaced by a newer one
+} MqttOutbox;
+
+/* PUBLIC PROTOTYPES */
+void mqtt_outbox_init(MqttOutbox* outbox);
+/* Returns false if the frame is bigger than the whole ring */
+bool mqtt_outbox_push(MqttOutbox* outbox, uint8_t msg_id, const uint8_t* frame, size_t frame_size);
+/* Replaces the waiting frame of the same message, if any */
+bool mqtt_outbox_push_state(MqttOutbox* outbox, uint8_t msg_id, const uint8_t* frame, size_t frame_size);
+/* Next frame to send, valid until the next push or pop. Returns 0 if the outbox is empty. */
+size_t mqtt_outbox_peek(const MqttOutbox* outbox, uint8_t* msg_id, const uint8_t** frame);
+/* Drops the frame of the last peek */
+void mqtt_outbox_pop(MqttOutbox* outbox);
+
+#if __cplusplus
+}
+#endif
+#endif
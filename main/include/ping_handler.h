@@ -1,12 +1,20 @@
 #ifndef PING_HANDLER_H
 #define PING_HANDLER_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #if __cplusplus
 extern "C" {
 #endif
 
 /* PUBLIC PROTOTYPES */
 void init_gateway_ping();
+/* esp_ping can't change the interval of a session, so this starts a new one.
+ * Before init_gateway_ping the interval is kept for the first session. */
+void set_gateway_ping_interval(uint32_t interval_ms);
+bool is_gateway_ping_started();
+uint32_t get_gateway_ping_interval();
 
 #if __cplusplus
 }
@@ -0,0 +1,45 @@
+#ifndef PIPELINE_METRICS_H
+#define PIPELINE_METRICS_H
+
+#include <mqtt_frame.h>
+#include <proj_conf.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Latency histograms and counters of the detection pipeline from the CSI
+ * callback to send_mqtt_msg(), published on MQTT_METRICS_TOPIC every
+ * PIPELINE_METRICS_INTERVAL_MS.
+ *
+ * Every histogram and counter has a single writer, the task of its pipeline
+ * stage, so recording needs no locks. Timestamps are the low 32 bits of
+ * esp_timer in microseconds, which is enough for latencies under an hour.
+ *
+ * With PIPELINE_METRICS_ENABLED 0 the functions are empty and the compiler
+ * removes them together with the timestamps. */
+
+/* PUBLIC PROTOTYPES */
+#if PIPELINE_METRICS_ENABLED
+void init_pipeline_metrics();
+uint32_t get_pipeline_time_us();
+/* Adds the time from started_us until now */
+void add_pipeline_latency(MetricsHistogramId histogram, uint32_t started_us);
+void count_pipeline_event(MetricsCounterId counter);
+/* For counters kept elsewhere, e.g. by the sample ring */
+void set_pipeline_counter(MetricsCounterId counter, uint32_t value);
+#else
+static inline void init_pipeline_metrics() {}
+static inline uint32_t get_pipeline_time_us() {
+  return 0;
+}
+static inline void add_pipeline_latency(MetricsHistogramId histogram, uint32_t started_us) {}
+static inline void count_pipeline_event(MetricsCounterId counter) {}
+static inline void set_pipeline_counter(MetricsCounterId counter, uint32_t value) {}
+#endif
+
+#if __cplusplus
+}
+#endif
+#endif
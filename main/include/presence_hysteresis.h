@@ -0,0 +1,41 @@
+#ifndef PRESENCE_HYSTERESIS_H
+#define PRESENCE_HYSTERESIS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Turns the fused per-sample decisions into the presence of the room.
+ *
+ * The room turns occupied after enter_count decisions in a row saw movement
+ * and enter_hold_ms passed since the first of them, and turns empty the same
+ * way with the exit settings. A decision for the current state cancels a
+ * pending change. Everything runs on sample timestamps, so a replay decides
+ * like the device did. */
+
+/* PUBLIC TYPES */
+typedef struct {
+  uint32_t enter_hold_ms;
+  uint32_t exit_hold_ms;
+  uint8_t enter_count;
+  uint8_t exit_count;
+  bool present;
+  uint8_t pending_count;      // Decisions in a row against the current state
+  uint32_t pending_since_ms;  // Timestamp of the first of them
+} PresenceHysteresis;
+
+/* PUBLIC PROTOTYPES */
+void presence_hysteresis_init(PresenceHysteresis* hysteresis, uint32_t enter_hold_ms, uint8_t enter_count,
+                              uint32_t exit_hold_ms, uint8_t exit_count);
+/* Adds a decision, returns whether the room is occupied after it */
+bool presence_hysteresis_push(PresenceHysteresis* hysteresis, bool movement, uint32_t timestamp_ms);
+/* Completes a pending change whose hold time passed without new decisions, returns whether the room is occupied */
+bool presence_hysteresis_update(PresenceHysteresis* hysteresis, uint32_t now_ms);
+
+#if __cplusplus
+}
+#endif
+#endif
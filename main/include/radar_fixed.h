@@ -0,0 +1,22 @@
+#ifndef RADAR_FIXED_H
+#define RADAR_FIXED_H
+
+#include <stdint.h>
+
+/* Q15 form of the jitter and wander for the detectors that only do integer
+ * math, the C3 has no FPU */
+
+/* PUBLIC CONSTANTS */
+#define RADAR_VALUE_ONE 32768  // Q15 of the converted inputs
+#define RADAR_VALUE_MAX UINT16_MAX
+
+/* PUBLIC FUNCTIONS */
+/* The only float operations of the detectors, once per input. Saturates at
+ * RADAR_VALUE_MAX, about 2, which is far over any threshold. */
+static inline uint32_t radar_value_to_fixed(float value) {
+  return value <= 0                                         ? 0
+         : value >= (float)RADAR_VALUE_MAX / RADAR_VALUE_ONE ? RADAR_VALUE_MAX
+                                                            : (uint32_t)(value * RADAR_VALUE_ONE);
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef RADAR_MAILBOX_H
+#define RADAR_MAILBOX_H
+
+#include <motion_classifier.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC CONSTANTS */
+#define RADAR_MAILBOX_CAPACITY  8  // Must be a power of 2
+#define RADAR_COMMAND_DATA_SIZE MOTION_MODEL_MAX_SIZE
+
+/* PUBLIC ENUMS */
+typedef enum {
+  RADAR_COMMAND_START_CALIBRATION = 0,
+  RADAR_COMMAND_STOP_CALIBRATION,
+  RADAR_COMMAND_SELECT_PROFILE,   // Data is the profile name, without terminator
+  RADAR_COMMAND_LOAD_MODEL,       // Data is the encoded model, empty for the compiled-in one
+  RADAR_COMMAND_SELECT_DETECTOR,  // Data is the variant name, without terminator, empty for the configured detector
+} RadarCommandType;
+
+/* PUBLIC TYPES */
+typedef struct {
+  RadarCommandType type;
+  uint8_t size;
+  uint8_t data[RADAR_COMMAND_DATA_SIZE];
+} RadarCommand;
+
+/* Single-producer/single-consumer ring of commands for the processing task,
+ * which owns the radar state and is the consumer. The MQTT event task is the producer.
+ * Only the producer writes head and dropped_count, only the consumer writes tail. */
+typedef struct {
+  RadarCommand commands[RADAR_MAILBOX_CAPACITY];
+  atomic_uint_least32_t head;
+  atomic_uint_least32_t tail;
+  atomic_uint_least32_t dropped_count;
+} RadarMailbox;
+
+/* PUBLIC PROTOTYPES */
+/* Returns false and counts the command as dropped if the mailbox is full or the data doesn't fit */
+bool radar_mailbox_push(RadarMailbox* mailbox, RadarCommandType type, const void* data, size_t size);
+bool radar_mailbox_pop(RadarMailbox* mailbox, RadarCommand* command);
+uint32_t radar_mailbox_dropped_count(const RadarMailbox* mailbox);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,82 @@
+#ifndef ROOM_DETECTOR_H
+#define ROOM_DETECTOR_H
+
+#include <breathing_detector.h>
+#include <calibration.h>
+#include <detector_core.h>
+#include <esp_radar.h>
+#include <link_detectors.h>
+#include <presence_hysteresis.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Decides whether the room has movement from the radar samples of all
+ * transmitters: every link judges its samples, the links that detect are
+ * counted and the count goes through the presence hysteresis.
+ *
+ * The detector has no tasks or storage of its own and takes its parameters
+ * at run time, so host tools run the detection of the firmware with other
+ * parameters, many detectors at once. With a variant of detector_core.h the
+ * variant decides instead, and only the link and calibration settings of the
+ * configuration are used.
+ *
+ * Next to the movement, the breathing detector looks for somebody keeping
+ * still in the samples of all links. Thresholds don't adapt while either of
+ * them sees somebody. */
+
+/* PUBLIC TYPES */
+typedef struct {
+  uint16_t window_size;        // Samples in the detection window of a link
+  uint16_t needed_detections;  // Motion samples in the window for the link to detect
+  float threshold_margin;      // Calibrated thresholds are this much above the empty room
+  uint32_t link_max_age_ms;    // Links that went quiet don't take part in the decision
+  uint8_t min_links;           // Detecting links needed for movement
+  uint32_t enter_hold_ms;
+  uint8_t enter_count;
+  uint32_t exit_hold_ms;
+  uint8_t exit_count;
+  uint8_t breathing_share_percent;  // Of the energy in the breathing band, 0 turns the breathing detector off
+  const DetectorVariant* variant;  // NULL for the detector configured by the fields above
+} RoomDetectorConfig;
+
+typedef struct {
+  RoomDetectorConfig config;
+  LinkDetectors links;
+  PresenceHysteresis presence;  // present is the decision of the room
+  BreathingDetector breathing;  // present while somebody keeps still
+  wifi_radar_info_t threshold;  // Of the room, nothing is detected while its jitter is 0
+  bool calibrating;
+} RoomDetector;
+
+/* PUBLIC PROTOTYPES */
+/* The configuration the firmware is built with */
+void room_detector_get_default_config(RoomDetectorConfig* config);
+void room_detector_init(RoomDetector* detector, const RoomDetectorConfig* config);
+/* Switches to a variant, or back to the configured detector with NULL.
+ * Thresholds are kept, the windows and the pending decision start over. */
+void room_detector_set_variant(RoomDetector* detector, const DetectorVariant* variant);
+/* Links start over with the new thresholds, the listed links with their own */
+void room_detector_set_thresholds(RoomDetector* detector, const wifi_radar_info_t* threshold, const LinkThreshold* links,
+                                  size_t links_count, uint32_t now_ms);
+void room_detector_begin_calibration(RoomDetector* detector);
+/* Ends the calibration with the thresholds of every link seen, their maxima
+ * times the margin, and the largest of them as the room threshold. They are
+ * only applied by room_detector_set_thresholds(). Returns the number of links. */
+size_t room_detector_finish_calibration(RoomDetector* detector, wifi_radar_info_t* threshold, LinkThreshold* links);
+/* Calibrates with the sample or judges it and updates the decision. Returns
+ * whether the sample was motion for its link. */
+bool room_detector_push(RoomDetector* detector, const wifi_radar_info_t* info, const uint8_t* mac, uint32_t timestamp_ms);
+/* Completes a change of the decision that was held long enough without new samples, returns the decision */
+bool room_detector_update(RoomDetector* detector, uint32_t now_ms);
+/* Breathing without movement, i.e. somebody in the room keeps still */
+bool room_detector_is_stationary(const RoomDetector* detector);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,48 @@
+#ifndef SAMPLE_RATE_H
+#define SAMPLE_RATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Chooses the gateway ping interval, which sets how often CSI arrives.
+ *
+ * Pings are fast while the room has movement, is being calibrated or samples
+ * go over the threshold now and then. Every stable_ms of a stable
+ * room doubles the interval up to the maximum, and any doubt makes it fast
+ * again at once. The interval is never shorter than the one at which CSI
+ * actually arrived, as the AP doesn't answer any faster. */
+
+/* PUBLIC CONSTANTS */
+#define SAMPLE_RATE_PERIOD_MS             1000  // How often rates are measured and the interval chosen
+#define SAMPLE_RATE_UNCERTAIN_DETECTIONS  2     // Over-threshold samples in a period that make the room uncertain
+
+/* PUBLIC TYPES */
+typedef struct {
+  uint32_t min_interval_ms;
+  uint32_t max_interval_ms;
+  uint32_t stable_ms;
+  uint32_t interval_ms;
+  uint32_t period_started_ms;
+  uint32_t stable_since_ms;
+  uint32_t period_csi_frames;
+  uint32_t period_samples;
+  uint32_t period_detections;
+  float csi_rate_hz;     // Of the last period
+  float sample_rate_hz;  // Of the last period
+} SampleRateController;
+
+/* PUBLIC PROTOTYPES */
+void sample_rate_init(SampleRateController* controller, uint32_t min_interval_ms, uint32_t max_interval_ms, uint32_t stable_ms, uint32_t now_ms);
+void sample_rate_add_csi_frames(SampleRateController* controller, uint32_t count);
+void sample_rate_add_sample(SampleRateController* controller, bool motion_detected);
+/* Returns true at the end of a period, with the rates measured and interval_ms chosen */
+bool sample_rate_update(SampleRateController* controller, uint32_t now_ms, bool room_stable);
+
+#if __cplusplus
+}
+#endif
+#endif
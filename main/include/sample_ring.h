@@ -0,0 +1,46 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <esp_radar.h>
+#include <link_table.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC CONSTANTS */
+#define SAMPLE_RING_CAPACITY 128  // Must be a power of 2
+
+/* PUBLIC TYPES */
+typedef struct {
+  wifi_radar_info_t info;
+  uint32_t timestamp_ms;       // When the sample was handed over by the radar
+  int8_t rssi;                 // Of the latest CSI packet
+  uint8_t mac[LINK_MAC_SIZE];  // Transmitter, broadcast if esp-csi mixed all of them
+  uint32_t csi_received_us;    // Pipeline metrics time of the latest CSI packet
+  uint32_t queued_us;          // Pipeline metrics time of the push
+} RadarSample;
+
+/* Single-producer/single-consumer ring of radar samples stored by value.
+ * Only the producer writes head, overflow_count and high_water, only the consumer writes tail. */
+typedef struct {
+  RadarSample samples[SAMPLE_RING_CAPACITY];
+  atomic_uint_least32_t head;
+  atomic_uint_least32_t tail;
+  atomic_uint_least32_t overflow_count;
+  atomic_uint_least32_t high_water;  // Most samples ever in the ring
+} SampleRing;
+
+/* PUBLIC PROTOTYPES */
+bool sample_ring_push(SampleRing* ring, const RadarSample* sample);
+bool sample_ring_pop(SampleRing* ring, RadarSample* sample);
+uint32_t sample_ring_overflow_count(const SampleRing* ring);
+uint32_t sample_ring_high_water(const SampleRing* ring);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,29 @@
+#ifndef SINGLE_WRITER_H
+#define SINGLE_WRITER_H
+
+/* Counters that only one task or callback changes while others read them.
+ *
+ * The ESP32-C3 has no atomic read-modify-write instructions, so an atomic
+ * fetch-add would be emulated with interrupts masked. With one writer no
+ * update can be lost between its relaxed load and store, and readers still
+ * never see a torn value, so that is all single_writer_add() does. */
+
+#if __cplusplus
+#include <atomic>
+
+/* PUBLIC FUNCTIONS */
+template <typename T>
+inline void single_writer_add(std::atomic<T>& counter, T value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+#else
+#include <stdatomic.h>
+#include <stdint.h>
+
+/* PUBLIC FUNCTIONS */
+static inline void single_writer_add(atomic_uint_least32_t* counter, uint32_t value) {
+  atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+#endif
+
+#endif
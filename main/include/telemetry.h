@@ -0,0 +1,20 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <mqtt_frame.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* PUBLIC PROTOTYPES */
+void init_telemetry();
+void start_telemetry();
+void stop_telemetry();
+/* Called by the radar processing task for every sample. Never blocks. */
+void add_telemetry_sample(const TelemetrySample* sample);
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,80 @@
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <stdint.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Flash layout of the trace recorder, shared by the firmware and host tools,
+ * so it only depends on the C library.
+ *
+ * The partition is a ring of 4 KiB sectors, erased one at a time. A sector
+ * starts with a header and is followed by up to TRACE_RECORDS_PER_SECTOR
+ * records. Sequence numbers grow by one per sector, so the oldest sector is
+ * the one with the lowest number and erased sectors (all 0xFF) have no valid
+ * magic. Records left erased have state 0xFF, which a written one never has.
+ *
+ * Header: [magic, u32] [sequence, u32] [base timestamp ms, u32]
+ *         [version, u8] [record size, u8] [flags, u8] [reserved, u8]
+ * Record: [ms since base, u16] [jitter, u16] [wander, u16] [RSSI, i8] [state, u8]
+ *
+ * Jitter and wander are unsigned Q15, so values from 0 to 2 fit. Timestamps
+ * count from boot, a sector with TRACE_FLAG_BOOT is the first after a boot.
+ * Multi-byte values are little endian, like both the ESP32-C3 and the hosts,
+ * so host tools map an image and use the structs in place. */
+
+/* PUBLIC CONSTANTS */
+#define TRACE_MAGIC              0x43525452  // "RTRC"
+#define TRACE_VERSION            1
+#define TRACE_SECTOR_SIZE        4096
+#define TRACE_HEADER_SIZE        16
+#define TRACE_RECORD_SIZE        8
+#define TRACE_RECORDS_PER_SECTOR ((TRACE_SECTOR_SIZE - TRACE_HEADER_SIZE) / TRACE_RECORD_SIZE)
+#define TRACE_VALUE_ONE          32768
+#define TRACE_FLAG_BOOT          0x01
+
+// Record state bits
+#define TRACE_STATE_ROOM_STATUS_MASK 0x03  // RoomStatus, STATIONARY_PRESENCE is recorded as MOVEMENT_DETECTED
+#define TRACE_STATE_MOTION           0x04  // Sample over the threshold of its link
+#define TRACE_STATE_LINK_SHIFT       3     // Slot of the transmitter in the link table
+#define TRACE_STATE_LINK_MASK        0x38
+#define TRACE_STATE_DETECTING        0x40  // The link detects movement
+#define TRACE_STATE_UNWRITTEN        0x80  // Only set in erased flash
+
+/* PUBLIC TYPES */
+typedef struct {
+  uint32_t magic;
+  uint32_t sequence;
+  uint32_t base_ms;
+  uint8_t version;
+  uint8_t record_size;
+  uint8_t flags;
+  uint8_t reserved;
+} TraceSectorHeader;
+
+typedef struct {
+  uint16_t offset_ms;
+  uint16_t jitter;
+  uint16_t wander;
+  int8_t rssi;
+  uint8_t state;
+} TraceRecord;
+
+_Static_assert(sizeof(TraceSectorHeader) == TRACE_HEADER_SIZE, "TraceSectorHeader must match the flash layout");
+_Static_assert(sizeof(TraceRecord) == TRACE_RECORD_SIZE, "TraceRecord must match the flash layout");
+
+/* PUBLIC FUNCTIONS */
+static inline uint16_t trace_encode_value(float value) {
+  return value <= 0 ? 0 : value >= 65535.0f / TRACE_VALUE_ONE ? 65535 : (uint16_t)(value * TRACE_VALUE_ONE + 0.5f);
+}
+
+static inline float trace_decode_value(uint16_t value) {
+  return (float)value / TRACE_VALUE_ONE;
+}
+
+#if __cplusplus
+}
+#endif
+#endif
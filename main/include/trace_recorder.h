@@ -0,0 +1,53 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <esp_radar.h>
+#include <proj_conf.h>
+#include <stdint.h>
+#include <trace_format.h>
+
+#if __cplusplus
+extern "C" {
+#endif
+
+/* Records every radar sample into the "trace" flash partition, laid out as
+ * described in trace_format.h. The processing task hands records over in
+ * batches and the recorder task writes them, so sector erases never stall
+ * detection. On request the same task sends the partition over MQTT.
+ *
+ * Chunk: [partition offset, u32] [partition size, u32] [data, up to TRACE_CHUNK_DATA_SIZE bytes]
+ *
+ * Every sector is erased once per pass over the partition. The 768 KiB of
+ * partitions.csv hold about 98000 records. Samples whose state is the same as
+ * the last record are skipped for TRACE_RECORD_INTERVAL_MS, so by default a
+ * room records its state changes and a sample a second, and a pass takes more
+ * than a day. With the interval at 0 every sample is recorded: a pass is 16
+ * minutes at the fastest ping interval of 10 ms, and a room with movement all
+ * day long reaches the 100000 erase cycles of the flash after about 3 years.
+ * Keep that for debugging.
+ *
+ * Without a trace partition the recorder stays off, and with
+ * TRACE_RECORDER_ENABLED 0 it's compiled out. */
+
+/* PUBLIC CONSTANTS */
+#define TRACE_CHUNK_HEADER_SIZE 8
+#define TRACE_CHUNK_DATA_SIZE   512
+
+/* PUBLIC PROTOTYPES */
+#if TRACE_RECORDER_ENABLED
+void init_trace_recorder();
+/* Called by the radar processing task for every sample. Never blocks. State is
+ * made of the TRACE_STATE_* bits. */
+void add_trace_record(uint32_t timestamp_ms, const wifi_radar_info_t* info, int8_t rssi, uint8_t state);
+/* Sends length bytes from offset, everything if length is 0 */
+void send_trace(uint32_t offset, uint32_t length);
+#else
+static inline void init_trace_recorder() {}
+static inline void add_trace_record(uint32_t timestamp_ms, const wifi_radar_info_t* info, int8_t rssi, uint8_t state) {}
+static inline void send_trace(uint32_t offset, uint32_t length) {}
+#endif
+
+#if __cplusplus
+}
+#endif
+#endif
@@ -8,7 +8,10 @@ extern "C" {
 #endif
 
 /* PUBLIC PROTOTYPES */
+/* Starts the station without waiting for the AP */
 void init_wifi_station();
+/* Blocks until the station has an IP */
+void wait_for_wifi_station();
 esp_ip4_addr_t get_gateway_ip();
 
 #if __cplusplus
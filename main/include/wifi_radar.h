@@ -1,14 +1,33 @@
 #ifndef WIFI_RADAR_H
 #define WIFI_RADAR_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #if __cplusplus
 extern "C" {
 #endif
 
+/* PUBLIC ENUMS */
+typedef enum {
+  ROOM_UNDEFINED = 0x00,
+  NO_MOVEMENT = 0x01,
+  MOVEMENT_DETECTED = 0x02,
+  ROOM_CALIBRATION_ACTIVE = 0x03,
+  STATIONARY_PRESENCE = 0x04,  // Somebody breathes but doesn't move
+} RoomStatus;
+
 /* PUBLIC PROTOTYPES */
 void init_wifi_radar();
 void start_wifi_radar_calibration();
 void stop_wifi_radar_calibration();
+/* Switches to the calibration of the named profile, which is kept across reboots */
+void select_wifi_radar_profile(const char* name, size_t length);
+/* Stores the motion model and detects with it, an empty one brings back the compiled-in model */
+void load_wifi_radar_model(const uint8_t* bytes, size_t size);
+/* Detects with the named variant of detector_core.h, which is kept across
+ * reboots. An empty name brings back the configured detector. */
+void select_wifi_radar_detector(const char* name, size_t length);
 
 #if __cplusplus
 }
@@ -8,10 +8,44 @@
 #define WIFI_AP_SSID     "@WIFI_AP_SSID@"      // Replaced by CMake using env var
 #define WIFI_AP_PASSWORD "@WIFI_AP_PASSWORD@"  // Replaced by CMake using env var
 
-#define GATEWAY_PING_INTERVAL_MS 10
+#define WIFI_CACHED_AP_ENABLED  1  // Reconnects to the BSSID and channel of the last boot without a full scan
+#define WIFI_CACHED_AP_ATTEMPTS 2  // Failed attempts with the cached AP before scanning for the SSID again
+
+#define GATEWAY_PING_INTERVAL_MS     10     // While the room has movement or is uncertain
+#define GATEWAY_PING_MAX_INTERVAL_MS 100    // Reached by a stable room, same as above for a fixed rate
+#define GATEWAY_PING_STABLE_MS       60000  // Stable time that doubles the interval
+
+#define ROOM_STATUS_HEARTBEAT_INTERVAL_MS 60000  // Status is also sent right away when it changes
+#define TELEMETRY_FLUSH_INTERVAL_MS       1000   // Longest time a telemetry sample waits for its batch
+
+#define CSI_STREAM_BUDGET_BYTES_PER_S 8000  // Frames over the budget are dropped
+#define CSI_STREAM_QUANTIZATION_SHIFT 1     // CSI values lose this many low bits
+
+#define ADAPTIVE_THRESHOLD_ENABLED  1       // Follows the empty room baseline between calibrations
+#define ADAPTIVE_THRESHOLD_QUANTILE 0.999f  // Share of empty room samples below threshold / margin
+
+#define RADAR_IN_TREE_FEATURES @RADAR_IN_TREE_FEATURES@  // Replaced by CMake, 1 detects per transmitter with csi_features.c
+#define LINK_FUSION_MIN_LINKS  1  // Transmitters that must see movement, the features of esp-csi count as one
+
+#define PRESENCE_ENTER_HOLD_MS 0     // Movement must go on this long before the room is occupied
+#define PRESENCE_ENTER_COUNT   1     // and be seen in this many decisions in a row
+#define PRESENCE_EXIT_HOLD_MS  3000  // Same for the quiet that empties the room
+#define PRESENCE_EXIT_COUNT    1
+
+#define BREATHING_DETECTION_ENABLED  1   // Reports STATIONARY_PRESENCE while the room breathes without moving
+#define BREATHING_BAND_SHARE_PERCENT 50  // Share of the jitter or wander energy in 0.125-0.5 Hz that is breathing
+
+#define MOTION_CLASSIFIER_ENABLED 1  // 1 judges samples with the model of motion_classifier.h, 0 with the jitter threshold
+
+#define PIPELINE_METRICS_ENABLED     1      // 0 compiles the latency histograms and counters out
+#define PIPELINE_METRICS_INTERVAL_MS 10000  // How often they are published
+
+#define TRACE_RECORDER_ENABLED   1     // Records samples into the trace partition of partitions.csv, see trace_recorder.h for the flash wear
+#define TRACE_RECORD_INTERVAL_MS 1000  // Records state changes and a sample this often between them, 0 records every sample to debug
 
 #define MQTT_RX_TOPIC "radar/" DEVICE_ID "/to"
 #define MQTT_TX_TOPIC "radar/" DEVICE_ID "/from"
+#define MQTT_METRICS_TOPIC "radar/" DEVICE_ID "/metrics"
 
 #define MQTT_HOST      "193.40.245.72"
 #define MQTT_PORT      1883
@@ -0,0 +1,143 @@
+#include <adaptive_threshold.h>
+
+#include <string.h>
+
+/* PRIVATE PROTOTYPES */
+static float adapt(float threshold, float calibrated, float estimate);
+static float parabolic_height(const QuantileEstimator* estimator, int marker, int direction);
+static float linear_height(const QuantileEstimator* estimator, int marker, int direction);
+static void sort_heights(float* heights, uint32_t count);
+
+/* FUNCTIONS */
+void quantile_estimator_init(QuantileEstimator* estimator, float quantile) {
+  memset(estimator, 0, sizeof(QuantileEstimator));
+  estimator->quantile = quantile;
+  for (int i = 0; i < QUANTILE_MARKERS_COUNT; i++) {
+    estimator->positions[i] = i;
+  }
+  estimator->desired_positions[0] = 0;
+  estimator->desired_positions[1] = 2 * quantile;
+  estimator->desired_positions[2] = 4 * quantile;
+  estimator->desired_positions[3] = 2 + 2 * quantile;
+  estimator->desired_positions[4] = 4;
+}
+
+/* P² algorithm by Jain and Chlamtac. The markers are the minimum, the
+ * quantile, the maximum and two quantiles halfway between them. */
+void quantile_estimator_add(QuantileEstimator* estimator, float value) {
+  float* heights = estimator->heights;
+  int32_t* positions = estimator->positions;
+
+  if (estimator->count < QUANTILE_MARKERS_COUNT) {
+    heights[estimator->count++] = value;
+    if (estimator->count == QUANTILE_MARKERS_COUNT) {
+      sort_heights(heights, QUANTILE_MARKERS_COUNT);
+    }
+    return;
+  }
+  estimator->count++;
+
+  int cell;
+  if (value < heights[0]) {
+    heights[0] = value;
+    cell = 0;
+  } else if (value >= heights[QUANTILE_MARKERS_COUNT - 1]) {
+    heights[QUANTILE_MARKERS_COUNT - 1] = value;
+    cell = QUANTILE_MARKERS_COUNT - 2;
+  } else {
+    cell = 0;
+    while (value >= heights[cell + 1]) {
+      cell++;
+    }
+  }
+
+  const float quantile = estimator->quantile;
+  const float increments[QUANTILE_MARKERS_COUNT] = {0, quantile / 2, quantile, (1 + quantile) / 2, 1};
+  for (int i = 0; i < QUANTILE_MARKERS_COUNT; i++) {
+    if (i > cell) {
+      positions[i]++;
+    }
+    estimator->desired_positions[i] += increments[i];
+  }
+
+  for (int i = 1; i < QUANTILE_MARKERS_COUNT - 1; i++) {
+    const float offset = estimator->desired_positions[i] - positions[i];
+    if ((offset >= 1 && positions[i + 1] - positions[i] > 1) || (offset <= -1 && positions[i - 1] - positions[i] < -1)) {
+      const int direction = offset > 0 ? 1 : -1;
+      const float height = parabolic_height(estimator, i, direction);
+      heights[i] = heights[i - 1] < height && height < heights[i + 1] ? height : linear_height(estimator, i, direction);
+      positions[i] += direction;
+    }
+  }
+}
+
+float quantile_estimator_get(const QuantileEstimator* estimator) {
+  if (estimator->count >= QUANTILE_MARKERS_COUNT) {
+    return estimator->heights[2];
+  }
+  if (estimator->count == 0) {
+    return 0;
+  }
+  float heights[QUANTILE_MARKERS_COUNT];
+  memcpy(heights, estimator->heights, estimator->count * sizeof(float));
+  sort_heights(heights, estimator->count);
+  return heights[(uint32_t)(estimator->quantile * (estimator->count - 1) + 0.5f)];
+}
+
+void adaptive_threshold_init(AdaptiveThreshold* adaptive, const wifi_radar_info_t* calibrated, float quantile, float margin) {
+  adaptive->margin = margin;
+  adaptive->calibrated = *calibrated;
+  adaptive->threshold = *calibrated;
+  quantile_estimator_init(&adaptive->jitter, quantile);
+  quantile_estimator_init(&adaptive->wander, quantile);
+}
+
+bool adaptive_threshold_add(AdaptiveThreshold* adaptive, const wifi_radar_info_t* sample, wifi_radar_info_t* threshold) {
+  quantile_estimator_add(&adaptive->jitter, sample->waveform_jitter);
+  quantile_estimator_add(&adaptive->wander, sample->waveform_wander);
+  if (adaptive->jitter.count < ADAPTIVE_THRESHOLD_PERIOD_SAMPLES) {
+    return false;
+  }
+
+  adaptive->threshold.waveform_jitter = adapt(adaptive->threshold.waveform_jitter, adaptive->calibrated.waveform_jitter,
+                                              quantile_estimator_get(&adaptive->jitter) * adaptive->margin);
+  adaptive->threshold.waveform_wander = adapt(adaptive->threshold.waveform_wander, adaptive->calibrated.waveform_wander,
+                                              quantile_estimator_get(&adaptive->wander) * adaptive->margin);
+  quantile_estimator_init(&adaptive->jitter, adaptive->jitter.quantile);
+  quantile_estimator_init(&adaptive->wander, adaptive->wander.quantile);
+  *threshold = adaptive->threshold;
+  return true;
+}
+
+static float adapt(float threshold, float calibrated, float estimate) {
+  const float adapted = threshold + (estimate - threshold) * ADAPTIVE_THRESHOLD_WEIGHT;
+  const float min = calibrated * ADAPTIVE_THRESHOLD_MIN_RATIO;
+  const float max = calibrated * ADAPTIVE_THRESHOLD_MAX_RATIO;
+  return adapted < min ? min : adapted > max ? max : adapted;
+}
+
+static float parabolic_height(const QuantileEstimator* estimator, int marker, int direction) {
+  const float* q = estimator->heights;
+  const int32_t* n = estimator->positions;
+  const int i = marker;
+  return q[i] + (float)direction / (n[i + 1] - n[i - 1]) *
+                    ((n[i] - n[i - 1] + direction) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                     (n[i + 1] - n[i] - direction) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+}
+
+static float linear_height(const QuantileEstimator* estimator, int marker, int direction) {
+  const float* q = estimator->heights;
+  const int32_t* n = estimator->positions;
+  return q[marker] + direction * (q[marker + direction] - q[marker]) / (n[marker + direction] - n[marker]);
+}
+
+static void sort_heights(float* heights, uint32_t count) {
+  for (uint32_t i = 1; i < count; i++) {
+    const float height = heights[i];
+    uint32_t j = i;
+    for (; j > 0 && heights[j - 1] > height; j--) {
+      heights[j] = heights[j - 1];
+    }
+    heights[j] = height;
+  }
+}
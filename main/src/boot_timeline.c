@@ -0,0 +1,43 @@
+#include <boot_timeline.h>
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <stdatomic.h>
+
+/* PRIVATE CONSTANTS */
+#define TAG "boot_timeline"
+
+/* GLOBAL VARIABLES */
+static atomic_uint_least32_t g_stage_us[BOOT_STAGES_COUNT] = {0};
+static const char* g_stage_names[BOOT_STAGES_COUNT] = {
+    [BOOT_STAGE_STORAGE] = "storage",
+    [BOOT_STAGE_WIFI_STARTED] = "wifi_started",
+    [BOOT_STAGE_RADAR_STARTED] = "radar_started",
+    [BOOT_STAGE_WIFI_CONNECTED] = "wifi_connected",
+    [BOOT_STAGE_GOT_IP] = "got_ip",
+    [BOOT_STAGE_MQTT_CONNECTED] = "mqtt_connected",
+    [BOOT_STAGE_FIRST_SAMPLE] = "first_sample",
+    [BOOT_STAGE_FIRST_STATUS] = "first_status",
+};
+
+/* FUNCTIONS */
+/* The only writer of a stage is the task that reaches it, so the check can't race the store. 0 means not
+ * reached, a stage at 0 us, which only happens on the virtual clock of the host, counts as 1 us. */
+void mark_boot_stage(BootStage stage) {
+  if (atomic_load_explicit(&g_stage_us[stage], memory_order_relaxed) != 0) {
+    return;
+  }
+  const uint32_t now_us = esp_timer_get_time();
+  atomic_store_explicit(&g_stage_us[stage], now_us ? now_us : 1, memory_order_relaxed);
+  ESP_LOGI(TAG, "Boot stage %s at %u.%03u ms", g_stage_names[stage], now_us / 1000, now_us % 1000);
+}
+
+bool is_boot_stage_reached(BootStage stage) {
+  return atomic_load_explicit(&g_stage_us[stage], memory_order_relaxed) != 0;
+}
+
+void get_boot_timeline(BootTimeline* timeline) {
+  for (int i = 0; i < BOOT_STAGES_COUNT; i++) {
+    timeline->stage_us[i] = atomic_load_explicit(&g_stage_us[i], memory_order_relaxed);
+  }
+}
@@ -0,0 +1,142 @@
+#include <breathing_detector.h>
+
+#include <radar_fixed.h>
+#include <string.h>
+
+/* PRIVATE CONSTANTS */
+#define LEVEL_ONE      256  // Q8 level of a value at its threshold
+#define LEVEL_MAX      4095
+#define MIN_LEVEL      (LEVEL_ONE / 32)  // RMS of the band below which a room is too quiet to tell
+#define TWIDDLE_SHIFT  8                 // Products keep Q14 - 8 bits, so a bin is 64 times the DFT
+#define BIN_SCALE      4096              // Square of that factor
+#define QUARTER_PERIOD (BREATHING_WINDOW_SIZE / 4)
+
+/* GLOBAL VARIABLES */
+/* cos(2 * pi * i / BREATHING_WINDOW_SIZE) in Q14, sin is a quarter period later */
+static const int16_t g_cos[BREATHING_WINDOW_SIZE] = {
+    16384,  16305,  16069,  15679,  15137,  14449,  13623,  12665,  11585,  10394,  9102,   7723,   6270,
+    4756,   3196,   1606,   0,      -1606,  -3196,  -4756,  -6270,  -7723,  -9102,  -10394, -11585, -12665,
+    -13623, -14449, -15137, -15679, -16069, -16305, -16384, -16305, -16069, -15679, -15137, -14449, -13623,
+    -12665, -11585, -10394, -9102,  -7723,  -6270,  -4756,  -3196,  -1606,  0,      1606,   3196,   4756,
+    6270,   7723,   9102,   10394,  11585,  12665,  13623,  14449,  15137,  15679,  16069,  16305,
+};
+
+/* PRIVATE PROTOTYPES */
+static int16_t get_level(uint32_t value, uint32_t threshold);
+static void end_block(BreathingDetector* detector, uint32_t blocks_count);
+static void add_block(BreathingDetector* detector, const int16_t* levels);
+static bool is_breathing(const BreathingChannel* channel, uint8_t share_percent);
+static void decide(BreathingDetector* detector);
+
+/* FUNCTIONS */
+void breathing_detector_init(BreathingDetector* detector, uint8_t share_percent) {
+  detector->share_percent = share_percent;
+  breathing_detector_reset(detector);
+}
+
+void breathing_detector_reset(BreathingDetector* detector) {
+  memset(detector->channels, 0, sizeof(detector->channels));
+  detector->block_index = 0;
+  detector->block_samples = 0;
+  detector->position = 0;
+  detector->filled = 0;
+  detector->pending_count = 0;
+  detector->present = false;
+}
+
+bool breathing_detector_push(BreathingDetector* detector, const wifi_radar_info_t* info,
+                             const wifi_radar_info_t* threshold, uint32_t timestamp_ms) {
+  const uint32_t block_index = timestamp_ms / BREATHING_BLOCK_MS;
+  if (detector->block_samples > 0 && block_index != detector->block_index) {
+    // A gap repeats the last block, and a window of repeats is as good as a longer gap
+    const uint32_t blocks_count = block_index - detector->block_index;
+    end_block(detector, blocks_count > BREATHING_WINDOW_SIZE ? BREATHING_WINDOW_SIZE : blocks_count);
+  }
+  if (detector->block_samples == 0) {
+    detector->block_index = block_index;
+  }
+  detector->channels[0].block_sum +=
+      get_level(radar_value_to_fixed(info->waveform_jitter), radar_value_to_fixed(threshold->waveform_jitter));
+  detector->channels[1].block_sum +=
+      get_level(radar_value_to_fixed(info->waveform_wander), radar_value_to_fixed(threshold->waveform_wander));
+  detector->block_samples++;
+  return detector->present;
+}
+
+/* A threshold of 0, e.g. the wander of calibrations that only stored the jitter, leaves the channel flat */
+static int16_t get_level(uint32_t value, uint32_t threshold) {
+  if (threshold == 0) {
+    return 0;
+  }
+  const uint32_t level = (value * LEVEL_ONE + threshold / 2) / threshold;
+  return level > LEVEL_MAX ? LEVEL_MAX : level;
+}
+
+static void end_block(BreathingDetector* detector, uint32_t blocks_count) {
+  int16_t levels[BREATHING_CHANNELS_COUNT];
+  for (int i = 0; i < BREATHING_CHANNELS_COUNT; i++) {
+    levels[i] = detector->channels[i].block_sum / detector->block_samples;
+    detector->channels[i].block_sum = 0;
+  }
+  detector->block_samples = 0;
+  for (uint32_t i = 0; i < blocks_count; i++) {
+    add_block(detector, levels);
+    decide(detector);
+  }
+}
+
+/* Every product is shifted on its own, so the block leaving the window takes
+ * out exactly what it added and the bins don't drift. */
+static void add_block(BreathingDetector* detector, const int16_t* levels) {
+  const uint8_t position = detector->position;
+  for (int i = 0; i < BREATHING_CHANNELS_COUNT; i++) {
+    BreathingChannel* channel = &detector->channels[i];
+    const int32_t value = levels[i];
+    const int32_t evicted = channel->values[position];
+    channel->values[position] = value;
+    channel->sum += value - evicted;
+    channel->sum_squares += value * value - evicted * evicted;
+    for (int bin = 0; bin < BREATHING_BINS_COUNT; bin++) {
+      const uint8_t angle = ((BREATHING_FIRST_BIN + bin) * position) % BREATHING_WINDOW_SIZE;
+      const int32_t cosine = g_cos[angle];
+      const int32_t sine = g_cos[(angle + BREATHING_WINDOW_SIZE - QUARTER_PERIOD) % BREATHING_WINDOW_SIZE];
+      channel->re[bin] += ((value * cosine) >> TWIDDLE_SHIFT) - ((evicted * cosine) >> TWIDDLE_SHIFT);
+      channel->im[bin] += ((value * sine) >> TWIDDLE_SHIFT) - ((evicted * sine) >> TWIDDLE_SHIFT);
+    }
+  }
+  detector->position = (position + 1) % BREATHING_WINDOW_SIZE;
+  detector->filled += detector->filled < BREATHING_WINDOW_SIZE;
+}
+
+/* By Parseval the window holds N * sum(x^2) of energy over all bins, and
+ * sum(x)^2 of it is the mean in bin 0. The band is counted twice for the
+ * mirrored bins of the negative frequencies. */
+static bool is_breathing(const BreathingChannel* channel, uint8_t share_percent) {
+  const int64_t ac_energy = (int64_t)BREATHING_WINDOW_SIZE * channel->sum_squares - (int64_t)channel->sum * channel->sum;
+  if (ac_energy <= 0) {
+    return false;
+  }
+  int64_t band_energy = 0;
+  for (int bin = 0; bin < BREATHING_BINS_COUNT; bin++) {
+    band_energy += (int64_t)channel->re[bin] * channel->re[bin] + (int64_t)channel->im[bin] * channel->im[bin];
+  }
+  band_energy *= 2;
+  const int64_t min_energy =
+      (int64_t)MIN_LEVEL * MIN_LEVEL * BIN_SCALE * BREATHING_WINDOW_SIZE * BREATHING_WINDOW_SIZE;
+  return band_energy >= min_energy && band_energy * 100 >= (int64_t)share_percent * BIN_SCALE * ac_energy;
+}
+
+static void decide(BreathingDetector* detector) {
+  bool breathing = false;
+  if (detector->filled == BREATHING_WINDOW_SIZE) {
+    for (int i = 0; i < BREATHING_CHANNELS_COUNT; i++) {
+      breathing |= is_breathing(&detector->channels[i], detector->share_percent);
+    }
+  }
+  if (breathing == detector->present) {
+    detector->pending_count = 0;
+  } else if (++detector->pending_count >= BREATHING_HOLD_BLOCKS) {
+    detector->present = breathing;
+    detector->pending_count = 0;
+  }
+}
@@ -0,0 +1,200 @@
+#include <calibration.h>
+
+#include <ctype.h>
+#include <esp_log.h>
+#include <frame_bytes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* PRIVATE CONSTANTS */
+#define TAG "calibration"
+
+#define PROFILE_KEY          "profile"
+#define RECORD_KEY_PREFIX    "cal."
+#define LINKS_KEY_PREFIX     "lnk."
+#define LEGACY_THRESHOLD_KEY "threshold"  // Jitter threshold only, written by older firmware
+#define RECORD_KEY_MAX_SIZE  (sizeof(RECORD_KEY_PREFIX) - 1 + CALIBRATION_PROFILE_MAX_SIZE)
+#define LINKS_HEADER_SIZE    2
+#define LINK_RECORD_SIZE     (LINK_MAC_SIZE + 8)
+#define LINKS_MAX_SIZE       (LINKS_HEADER_SIZE + LINK_TABLE_CAPACITY * LINK_RECORD_SIZE)
+
+/* PRIVATE PROTOTYPES */
+static void get_record_key(const char* prefix, const char* profile, char* key);
+static bool load_legacy_threshold(nvs_handle_t handle, CalibrationRecord* record);
+static void add_sample(float value, uint32_t count, float* mean, float* squared_differences);
+
+/* FUNCTIONS */
+void calibration_record_begin(CalibrationRecord* record) {
+  memset(record, 0, sizeof(CalibrationRecord));
+}
+
+/* Welford's algorithm, so a long calibration needs no sample buffer */
+void calibration_record_add(CalibrationRecord* record, const wifi_radar_info_t* info) {
+  record->samples_count++;
+  add_sample(info->waveform_jitter, record->samples_count, &record->mean.waveform_jitter, &record->variance.waveform_jitter);
+  add_sample(info->waveform_wander, record->samples_count, &record->mean.waveform_wander, &record->variance.waveform_wander);
+}
+
+void calibration_record_finish(CalibrationRecord* record, const wifi_radar_info_t* threshold) {
+  if (record->samples_count > 1) {
+    record->variance.waveform_jitter /= record->samples_count - 1;
+    record->variance.waveform_wander /= record->samples_count - 1;
+  } else {
+    record->variance = (wifi_radar_info_t){0};
+  }
+  record->threshold = *threshold;
+  record->calibrated_at_s = time(NULL);
+}
+
+bool is_calibration_profile_name_valid(const char* name, size_t length) {
+  if (length == 0 || length >= CALIBRATION_PROFILE_MAX_SIZE) {
+    return false;
+  }
+  for (size_t i = 0; i < length; i++) {
+    if (!isalnum((unsigned char)name[i]) && name[i] != '_' && name[i] != '-') {
+      return false;
+    }
+  }
+  return true;
+}
+
+void load_calibration_profile(nvs_handle_t handle, char* name) {
+  size_t length = CALIBRATION_PROFILE_MAX_SIZE;
+  const esp_err_t res = nvs_get_blob(handle, PROFILE_KEY, name, &length);
+  if (res != ESP_OK || !is_calibration_profile_name_valid(name, length)) {
+    if (res != ESP_ERR_NVS_NOT_FOUND) {
+      ESP_LOGW(TAG, "Stored calibration profile is invalid (0x%x)", res);
+    }
+    length = strlen(CALIBRATION_DEFAULT_PROFILE);
+    memcpy(name, CALIBRATION_DEFAULT_PROFILE, length);
+  }
+  name[length] = '\0';
+}
+
+void save_calibration_profile(nvs_handle_t handle, const char* name) {
+  ESP_ERROR_CHECK(nvs_set_blob(handle, PROFILE_KEY, name, strlen(name)));
+  ESP_ERROR_CHECK(nvs_commit(handle));
+}
+
+bool load_calibration(nvs_handle_t handle, const char* profile, CalibrationRecord* record) {
+  char key[RECORD_KEY_MAX_SIZE];
+  get_record_key(RECORD_KEY_PREFIX, profile, key);
+
+  uint8_t bytes[CALIBRATION_RECORD_SIZE];
+  size_t bytes_count = sizeof(bytes);
+  const esp_err_t res = nvs_get_blob(handle, key, bytes, &bytes_count);
+  if (res == ESP_ERR_NVS_NOT_FOUND) {
+    if (strcmp(profile, CALIBRATION_DEFAULT_PROFILE) == 0 && load_legacy_threshold(handle, record)) {
+      save_calibration(handle, profile, record);
+      nvs_erase_key(handle, LEGACY_THRESHOLD_KEY);
+      ESP_ERROR_CHECK(nvs_commit(handle));
+      ESP_LOGI(TAG, "Converted the old threshold into a calibration record");
+      return true;
+    }
+    return false;
+  }
+  if (res != ESP_OK || bytes_count != CALIBRATION_RECORD_SIZE || bytes[0] != CALIBRATION_RECORD_VERSION) {
+    ESP_LOGW(TAG, "Ignoring calibration of profile %s, unknown record (0x%x, %u bytes, version %u)", profile, res,
+             (unsigned)bytes_count, bytes[0]);
+    return false;
+  }
+
+  const uint8_t* cursor = bytes + 1;
+  record->threshold.waveform_jitter = get_f32(cursor);
+  record->threshold.waveform_wander = get_f32(cursor + 4);
+  record->mean.waveform_jitter = get_f32(cursor + 8);
+  record->mean.waveform_wander = get_f32(cursor + 12);
+  record->variance.waveform_jitter = get_f32(cursor + 16);
+  record->variance.waveform_wander = get_f32(cursor + 20);
+  record->samples_count = get_u32(cursor + 24);
+  record->calibrated_at_s = get_u32(cursor + 28);
+  return true;
+}
+
+/* Committed right away, so a reboot can't lose the calibration */
+void save_calibration(nvs_handle_t handle, const char* profile, const CalibrationRecord* record) {
+  char key[RECORD_KEY_MAX_SIZE];
+  get_record_key(RECORD_KEY_PREFIX, profile, key);
+
+  uint8_t bytes[CALIBRATION_RECORD_SIZE];
+  uint8_t* cursor = bytes;
+  *cursor++ = CALIBRATION_RECORD_VERSION;
+  cursor = put_f32(cursor, record->threshold.waveform_jitter);
+  cursor = put_f32(cursor, record->threshold.waveform_wander);
+  cursor = put_f32(cursor, record->mean.waveform_jitter);
+  cursor = put_f32(cursor, record->mean.waveform_wander);
+  cursor = put_f32(cursor, record->variance.waveform_jitter);
+  cursor = put_f32(cursor, record->variance.waveform_wander);
+  cursor = put_u32(cursor, record->samples_count);
+  put_u32(cursor, record->calibrated_at_s);
+
+  ESP_ERROR_CHECK(nvs_set_blob(handle, key, bytes, sizeof(bytes)));
+  ESP_ERROR_CHECK(nvs_commit(handle));
+}
+
+size_t load_link_thresholds(nvs_handle_t handle, const char* profile, LinkThreshold* links, size_t max_links) {
+  char key[RECORD_KEY_MAX_SIZE];
+  get_record_key(LINKS_KEY_PREFIX, profile, key);
+
+  uint8_t bytes[LINKS_MAX_SIZE];
+  size_t bytes_count = sizeof(bytes);
+  const esp_err_t res = nvs_get_blob(handle, key, bytes, &bytes_count);
+  if (res == ESP_ERR_NVS_NOT_FOUND) {
+    return 0;
+  }
+  if (res != ESP_OK || bytes_count < LINKS_HEADER_SIZE || bytes[0] != CALIBRATION_LINKS_VERSION ||
+      bytes_count != LINKS_HEADER_SIZE + bytes[1] * LINK_RECORD_SIZE) {
+    ESP_LOGW(TAG, "Ignoring link thresholds of profile %s, unknown record (0x%x, %u bytes)", profile, res, (unsigned)bytes_count);
+    return 0;
+  }
+
+  const size_t count = bytes[1] < max_links ? bytes[1] : max_links;
+  const uint8_t* cursor = bytes + LINKS_HEADER_SIZE;
+  for (size_t i = 0; i < count; i++, cursor += LINK_RECORD_SIZE) {
+    memcpy(links[i].mac, cursor, LINK_MAC_SIZE);
+    links[i].threshold.waveform_jitter = get_f32(cursor + LINK_MAC_SIZE);
+    links[i].threshold.waveform_wander = get_f32(cursor + LINK_MAC_SIZE + 4);
+  }
+  return count;
+}
+
+void save_link_thresholds(nvs_handle_t handle, const char* profile, const LinkThreshold* links, size_t count) {
+  char key[RECORD_KEY_MAX_SIZE];
+  get_record_key(LINKS_KEY_PREFIX, profile, key);
+
+  uint8_t bytes[LINKS_MAX_SIZE];
+  count = count < LINK_TABLE_CAPACITY ? count : LINK_TABLE_CAPACITY;
+  bytes[0] = CALIBRATION_LINKS_VERSION;
+  bytes[1] = count;
+  uint8_t* cursor = bytes + LINKS_HEADER_SIZE;
+  for (size_t i = 0; i < count; i++) {
+    memcpy(cursor, links[i].mac, LINK_MAC_SIZE);
+    cursor = put_f32(cursor + LINK_MAC_SIZE, links[i].threshold.waveform_jitter);
+    cursor = put_f32(cursor, links[i].threshold.waveform_wander);
+  }
+
+  ESP_ERROR_CHECK(nvs_set_blob(handle, key, bytes, cursor - bytes));
+  ESP_ERROR_CHECK(nvs_commit(handle));
+}
+
+static void get_record_key(const char* prefix, const char* profile, char* key) {
+  snprintf(key, RECORD_KEY_MAX_SIZE, "%s%s", prefix, profile);
+}
+
+static bool load_legacy_threshold(nvs_handle_t handle, CalibrationRecord* record) {
+  float threshold;
+  size_t bytes_count = sizeof(threshold);
+  if (nvs_get_blob(handle, LEGACY_THRESHOLD_KEY, &threshold, &bytes_count) != ESP_OK || bytes_count != sizeof(threshold)) {
+    return false;
+  }
+  calibration_record_begin(record);
+  record->threshold.waveform_jitter = threshold;
+  return true;
+}
+
+static void add_sample(float value, uint32_t count, float* mean, float* squared_differences) {
+  const float difference = value - *mean;
+  *mean += difference / count;
+  *squared_differences += difference * (value - *mean);
+}
@@ -0,0 +1,174 @@
+#include <csi_codec.h>
+
+#include <frame_bytes.h>
+#include <string.h>
+
+/* PRIVATE CONSTANTS */
+#define DELTA_ESCAPE    0x8
+#define FRAME_HEAD_SIZE 10  // RSSI, value count, jitter and wander
+
+/* PRIVATE TYPES */
+typedef struct {
+  uint8_t* cursor;
+  bool high_nibble_free;
+} NibbleWriter;
+
+typedef struct {
+  const uint8_t* cursor;
+  const uint8_t* end;
+  bool high_nibble_next;
+} NibbleReader;
+
+/* PRIVATE PROTOTYPES */
+static void put_nibble(NibbleWriter* writer, uint8_t nibble);
+static bool get_nibble(NibbleReader* reader, uint8_t* nibble);
+
+/* FUNCTIONS */
+void csi_batch_begin(CsiBatchWriter* writer, uint8_t* buffer, size_t capacity, uint8_t quantization_shift) {
+  writer->buffer = buffer;
+  writer->capacity = capacity;
+  writer->size = CSI_BATCH_HEADER_SIZE;
+  writer->frames_count = 0;
+  writer->quantization_shift = quantization_shift;
+  writer->previous_count = 0;
+  buffer[0] = 0;
+  buffer[1] = quantization_shift;
+}
+
+bool csi_batch_append(CsiBatchWriter* writer, const CsiFrame* frame) {
+  if (writer->frames_count == UINT8_MAX || writer->size + CSI_FRAME_MAX_SIZE > writer->capacity) {
+    return false;
+  }
+  if (writer->frames_count == 0) {
+    put_u32(writer->buffer + 2, frame->timestamp_ms);
+    writer->previous_timestamp_ms = frame->timestamp_ms;
+  }
+
+  uint8_t* cursor = writer->buffer + writer->size;
+  cursor = put_varint(cursor, frame->timestamp_ms - writer->previous_timestamp_ms);
+  *cursor++ = (uint8_t)frame->rssi;
+  *cursor++ = frame->values_count;
+  cursor = put_f32(cursor, frame->waveform_jitter);
+  cursor = put_f32(cursor, frame->waveform_wander);
+
+  // Deltas need the previous frame to have the same layout
+  const bool key_frame = writer->frames_count == 0 || frame->values_count != writer->previous_count;
+  if (key_frame) {
+    for (uint8_t i = 0; i < frame->values_count; i++) {
+      writer->previous[i] = frame->values[i] >> writer->quantization_shift;
+      *cursor++ = (uint8_t)writer->previous[i];
+    }
+  } else {
+    NibbleWriter nibbles = {.cursor = cursor, .high_nibble_free = true};
+    for (uint8_t i = 0; i < frame->values_count; i++) {
+      const int8_t value = frame->values[i] >> writer->quantization_shift;
+      const int delta = value - writer->previous[i];
+      if (delta >= -7 && delta <= 7) {
+        put_nibble(&nibbles, delta & 0xF);
+      } else {
+        put_nibble(&nibbles, DELTA_ESCAPE);
+        put_nibble(&nibbles, (uint8_t)value >> 4);
+        put_nibble(&nibbles, (uint8_t)value & 0xF);
+      }
+      writer->previous[i] = value;
+    }
+    cursor = nibbles.high_nibble_free ? nibbles.cursor : nibbles.cursor + 1;
+  }
+
+  writer->previous_count = frame->values_count;
+  writer->previous_timestamp_ms = frame->timestamp_ms;
+  writer->size = cursor - writer->buffer;
+  writer->buffer[0] = ++writer->frames_count;
+  return true;
+}
+
+int csi_batch_decode(const uint8_t* payload, size_t payload_size, CsiFrame* frames, size_t max_frames) {
+  if (payload_size < CSI_BATCH_HEADER_SIZE) {
+    return -1;
+  }
+  const uint8_t frames_count = payload[0];
+  const uint8_t shift = payload[1];
+  uint32_t timestamp_ms = get_u32(payload + 2);
+  if (frames_count > max_frames || shift > 7) {
+    return -1;
+  }
+
+  const uint8_t* cursor = payload + CSI_BATCH_HEADER_SIZE;
+  const uint8_t* end = payload + payload_size;
+  int8_t previous[CSI_MAX_VALUES];
+  uint8_t previous_count = 0;
+
+  for (uint8_t i = 0; i < frames_count; i++) {
+    CsiFrame* frame = &frames[i];
+    uint32_t delta_ms;
+    cursor = get_varint(cursor, end, &delta_ms);
+    if (!cursor || end - cursor < FRAME_HEAD_SIZE) {
+      return -1;
+    }
+    timestamp_ms += delta_ms;
+    frame->timestamp_ms = timestamp_ms;
+    frame->rssi = (int8_t)cursor[0];
+    frame->values_count = cursor[1];
+    frame->waveform_jitter = get_f32(cursor + 2);
+    frame->waveform_wander = get_f32(cursor + 6);
+    cursor += FRAME_HEAD_SIZE;
+    if (frame->values_count > CSI_MAX_VALUES) {
+      return -1;
+    }
+
+    if (i == 0 || frame->values_count != previous_count) {
+      if (end - cursor < frame->values_count) {
+        return -1;
+      }
+      memcpy(previous, cursor, frame->values_count);
+      cursor += frame->values_count;
+    } else {
+      NibbleReader nibbles = {.cursor = cursor, .end = end, .high_nibble_next = true};
+      for (uint8_t j = 0; j < frame->values_count; j++) {
+        uint8_t nibble;
+        if (!get_nibble(&nibbles, &nibble)) {
+          return -1;
+        }
+        if (nibble == DELTA_ESCAPE) {
+          uint8_t high;
+          uint8_t low;
+          if (!get_nibble(&nibbles, &high) || !get_nibble(&nibbles, &low)) {
+            return -1;
+          }
+          previous[j] = (int8_t)(high << 4 | low);
+        } else {
+          previous[j] += (int8_t)(nibble << 4) >> 4;  // Sign extend
+        }
+      }
+      cursor = nibbles.high_nibble_next ? nibbles.cursor : nibbles.cursor + 1;
+    }
+
+    for (uint8_t j = 0; j < frame->values_count; j++) {
+      frame->values[j] = (int8_t)(previous[j] * (1 << shift));
+    }
+    previous_count = frame->values_count;
+  }
+  return cursor == end ? frames_count : -1;
+}
+
+static void put_nibble(NibbleWriter* writer, uint8_t nibble) {
+  if (writer->high_nibble_free) {
+    *writer->cursor = nibble << 4;
+  } else {
+    *writer->cursor++ |= nibble;
+  }
+  writer->high_nibble_free = !writer->high_nibble_free;
+}
+
+static bool get_nibble(NibbleReader* reader, uint8_t* nibble) {
+  if (reader->cursor >= reader->end) {
+    return false;
+  }
+  if (reader->high_nibble_next) {
+    *nibble = *reader->cursor >> 4;
+  } else {
+    *nibble = *reader->cursor++ & 0xF;
+  }
+  reader->high_nibble_next = !reader->high_nibble_next;
+  return true;
+}
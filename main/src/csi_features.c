@@ -0,0 +1,715 @@
+#include <csi_features.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* PRIVATE CONSTANTS */
+#define FLOAT_LANES 4
+
+#define SPIKE_AMPLITUDE     8     // Change of an amplitude against both neighbouring frames that counts as a spike
+#define SPIKE_SUBCARRIERS   4     // Spiking subcarriers a frame may have
+#define POWER_ITERATIONS    30    // Most power iterations per window
+#define REFERENCE_MIN_CORRELATION 0.99  // A training window that correlates less with every reference becomes one
+#define STABILITY_DIP       0.01  // Dip of the jitter correlation that makes the next window unstable
+
+#define PCA_POWER_SHIFT  3     // Powers lose 3 bits, so that deviations fit into 16 bits
+#define PCA_POWER_MAX    4095  // and their moving average with 4 fraction bits too
+#define PCA_ENERGY_SHIFT 4     // The energy of a component averages over 16 updates
+#define PCA_RATE_SHIFT   6     // A basis update moves about 1/64 of the way
+#define PCA_MIN_ENERGY   64    // Squared score below which the frames are too quiet to learn from
+#define PCA_MAX_GAIN     (1 << 12)
+
+/* PRIVATE TYPES */
+typedef float FloatVector __attribute__((vector_size(FLOAT_LANES * sizeof(float))));
+
+typedef enum {
+  WINDOW_NONE,     // The frame goes on filling the window
+  WINDOW_DROPPED,  // Too soon after the previous frame
+  WINDOW_READY,    // The frames from begin up to the frame before are a window
+} WindowEvent;
+
+/* PRIVATE PROTOTYPES */
+static void init_window_ring(CsiWindowRing* ring, uint16_t window_frames);
+static WindowEvent add_window_frame(CsiWindowRing* ring, uint32_t timestamp_ms, uint32_t* window_begin, uint16_t* window_count);
+static void get_vector_fixed(const CsiFeaturesFixed* features, uint32_t begin, uint16_t count, uint16_t* vector);
+static void get_vector_float(const CsiFeaturesFloat* features, uint32_t begin, uint16_t count, float* vector);
+static bool finish_window_fixed(CsiFeaturesFixed* features, uint32_t begin, uint16_t count, wifi_radar_info_t* info);
+static bool finish_window_float(CsiFeaturesFloat* features, uint32_t begin, uint16_t count, wifi_radar_info_t* info);
+static uint16_t subcarriers_count(uint16_t length);
+static uint16_t isqrt32(uint32_t value);
+static uint32_t isqrt64(uint64_t value);
+static float sum_float(const float* values, uint16_t count);
+static bool finish_frame_pca(CsiFeatureWindow* window, int32_t jitter, int32_t wander, wifi_radar_info_t* info);
+static uint16_t csi_powers_pca(const int8_t* data, uint16_t length, uint16_t* powers);
+static void init_pca_basis(CsiFeaturesPca* features, const uint16_t* powers, uint16_t count);
+static void update_pca_basis(CsiFeaturesPca* features, const int16_t* deviations);
+static void normalize_pca_vector(int16_t* vector, uint16_t dimension);
+static int32_t get_energy_share(uint64_t energy, int64_t variance, uint16_t dimension);
+
+/* FUNCTIONS */
+uint16_t csi_amplitudes_fixed(const int8_t* data, uint16_t length, uint16_t* amplitudes) {
+  if (length < CSI_FEATURE_SUBCARRIERS * CSI_SUBCARRIER_STRIDE + 2) {
+    return 0;
+  }
+  for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+    const int32_t imaginary = data[(i + 1) * CSI_SUBCARRIER_STRIDE];
+    const int32_t real = data[(i + 1) * CSI_SUBCARRIER_STRIDE + 1];
+    const uint32_t power = imaginary * imaginary + real * real;
+    amplitudes[i] = isqrt32(power << (2 * CSI_AMPLITUDE_FRACTION_BITS));
+  }
+  return CSI_FEATURE_SUBCARRIERS;
+}
+
+uint16_t csi_amplitudes_float(const int8_t* data, uint16_t length, float* amplitudes) {
+  if (length < CSI_FEATURE_SUBCARRIERS * CSI_SUBCARRIER_STRIDE + 2) {
+    return 0;
+  }
+  for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+    const float imaginary = data[(i + 1) * CSI_SUBCARRIER_STRIDE];
+    const float real = data[(i + 1) * CSI_SUBCARRIER_STRIDE + 1];
+    amplitudes[i] = sqrtf(imaginary * imaginary + real * real);
+  }
+  return CSI_FEATURE_SUBCARRIERS;
+}
+
+/* With ten values of at most 2^14 the variances stay below 2^35, so that the
+ * product of them with 3 bits dropped each and the scaled covariance fit into
+ * 64 bits. */
+int32_t csi_correlation_fixed(const uint16_t* a, const uint16_t* b, uint16_t count) {
+  uint64_t sum_a = 0;
+  uint64_t sum_b = 0;
+  uint64_t sum_aa = 0;
+  uint64_t sum_bb = 0;
+  uint64_t sum_ab = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    const uint32_t value_a = a[i];
+    const uint32_t value_b = b[i];
+    sum_a += value_a;
+    sum_b += value_b;
+    sum_aa += value_a * value_a;
+    sum_bb += value_b * value_b;
+    sum_ab += value_a * value_b;
+  }
+
+  const int64_t covariance = (int64_t)(count * sum_ab) - (int64_t)(sum_a * sum_b);
+  const uint64_t variance_a = count * sum_aa - sum_a * sum_a;
+  const uint64_t variance_b = count * sum_bb - sum_b * sum_b;
+  const uint64_t divisor = isqrt64((variance_a >> 3) * (variance_b >> 3));
+  if (divisor == 0) {
+    return 0;
+  }
+  const int64_t correlation = (covariance >> 3) * CSI_CORRELATION_ONE / (int64_t)divisor;
+  return correlation > CSI_CORRELATION_ONE ? CSI_CORRELATION_ONE : correlation < -CSI_CORRELATION_ONE ? -CSI_CORRELATION_ONE : correlation;
+}
+
+/* Two passes over centered values, so that float cancellation doesn't matter.
+ * The lanes keep separate sums, which lets the compiler use SIMD for them. */
+float csi_correlation_float(const float* a, const float* b, uint16_t count) {
+  if (count == 0) {
+    return 0;
+  }
+  const float mean_a = sum_float(a, count) / count;
+  const float mean_b = sum_float(b, count) / count;
+
+  FloatVector sum_aa = {0};
+  FloatVector sum_bb = {0};
+  FloatVector sum_ab = {0};
+  uint16_t i = 0;
+  for (; i + FLOAT_LANES <= count; i += FLOAT_LANES) {
+    FloatVector value_a;
+    FloatVector value_b;
+    memcpy(&value_a, &a[i], sizeof(value_a));
+    memcpy(&value_b, &b[i], sizeof(value_b));
+    value_a -= mean_a;
+    value_b -= mean_b;
+    sum_aa += value_a * value_a;
+    sum_bb += value_b * value_b;
+    sum_ab += value_a * value_b;
+  }
+
+  float variance_a = 0;
+  float variance_b = 0;
+  float covariance = 0;
+  for (int lane = 0; lane < FLOAT_LANES; lane++) {
+    variance_a += sum_aa[lane];
+    variance_b += sum_bb[lane];
+    covariance += sum_ab[lane];
+  }
+  for (; i < count; i++) {
+    const float value_a = a[i] - mean_a;
+    const float value_b = b[i] - mean_b;
+    variance_a += value_a * value_a;
+    variance_b += value_b * value_b;
+    covariance += value_a * value_b;
+  }
+
+  const float divisor = sqrtf(variance_a * variance_b);
+  if (divisor == 0) {
+    return 0;
+  }
+  const float correlation = covariance / divisor;
+  return correlation > 1 ? 1 : correlation < -1 ? -1 : correlation;
+}
+
+void csi_features_init_fixed(CsiFeaturesFixed* features, uint16_t window_frames) {
+  memset(features, 0, sizeof(CsiFeaturesFixed));
+  init_window_ring(&features->ring, window_frames);
+}
+
+bool csi_features_push_fixed(CsiFeaturesFixed* features, const int8_t* data, uint16_t length, uint32_t timestamp_ms, wifi_radar_info_t* info) {
+  CsiWindowRing* ring = &features->ring;
+  const uint32_t index = ring->filtered_count;
+  uint16_t* amplitudes = features->recent[index % CSI_SPIKE_FRAMES];
+  if (csi_amplitudes_fixed(data, length, amplitudes) == 0) {
+    return false;
+  }
+  ring->filtered_count = index + 1;
+  if (index < CSI_SPIKE_FRAMES - 1) {
+    return false;
+  }
+
+  // The frame two before is checked against its neighbours, a spike is replaced by the frames after it
+  uint16_t* before = features->recent[(index - 3) % CSI_SPIKE_FRAMES];
+  uint16_t* middle = features->recent[(index - 2) % CSI_SPIKE_FRAMES];
+  uint16_t* after = features->recent[(index - 1) % CSI_SPIKE_FRAMES];
+  const int32_t threshold = SPIKE_AMPLITUDE << CSI_AMPLITUDE_FRACTION_BITS;
+  uint16_t spikes = 0;
+  for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+    const int32_t rise = middle[i] - before[i];
+    const int32_t fall = middle[i] - after[i];
+    spikes += (rise > threshold && (fall > threshold || middle[i] - amplitudes[i] > threshold)) || (rise < -threshold && fall < -threshold);
+  }
+  if (spikes > SPIKE_SUBCARRIERS) {
+    memcpy(middle, after, sizeof(features->recent[0]));
+    memcpy(after, amplitudes, sizeof(features->recent[0]));
+    ring->filtered_count = index;
+    return false;
+  }
+
+  memcpy(features->amplitudes[ring->end % CSI_WINDOW_CAPACITY], middle, sizeof(features->recent[0]));
+  uint32_t window_begin;
+  uint16_t window_count;
+  if (add_window_frame(ring, timestamp_ms, &window_begin, &window_count) != WINDOW_READY) {
+    return false;
+  }
+  return finish_window_fixed(features, window_begin, window_count, info);
+}
+
+void csi_features_train_start_fixed(CsiFeaturesFixed* features) {
+  features->ring.training_status = CSI_TRAINING;
+  features->ring.references_count = 0;
+  features->ring.stability_count = 0;
+  features->ring.vectors_count = 0;
+}
+
+void csi_features_train_stop_fixed(CsiFeaturesFixed* features) {
+  features->ring.training_status = CSI_TRAINED;
+}
+
+void csi_features_init_float(CsiFeaturesFloat* features, uint16_t window_frames) {
+  memset(features, 0, sizeof(CsiFeaturesFloat));
+  init_window_ring(&features->ring, window_frames);
+}
+
+bool csi_features_push_float(CsiFeaturesFloat* features, const int8_t* data, uint16_t length, uint32_t timestamp_ms, wifi_radar_info_t* info) {
+  CsiWindowRing* ring = &features->ring;
+  const uint32_t index = ring->filtered_count;
+  float* amplitudes = features->recent[index % CSI_SPIKE_FRAMES];
+  if (csi_amplitudes_float(data, length, amplitudes) == 0) {
+    return false;
+  }
+  ring->filtered_count = index + 1;
+  if (index < CSI_SPIKE_FRAMES - 1) {
+    return false;
+  }
+
+  float* before = features->recent[(index - 3) % CSI_SPIKE_FRAMES];
+  float* middle = features->recent[(index - 2) % CSI_SPIKE_FRAMES];
+  float* after = features->recent[(index - 1) % CSI_SPIKE_FRAMES];
+  uint16_t spikes = 0;
+  for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+    const float rise = middle[i] - before[i];
+    const float fall = middle[i] - after[i];
+    spikes += (rise > SPIKE_AMPLITUDE && (fall > SPIKE_AMPLITUDE || middle[i] - amplitudes[i] > SPIKE_AMPLITUDE)) ||
+              (rise < -SPIKE_AMPLITUDE && fall < -SPIKE_AMPLITUDE);
+  }
+  if (spikes > SPIKE_SUBCARRIERS) {
+    memcpy(middle, after, sizeof(features->recent[0]));
+    memcpy(after, amplitudes, sizeof(features->recent[0]));
+    ring->filtered_count = index;
+    return false;
+  }
+
+  memcpy(features->amplitudes[ring->end % CSI_WINDOW_CAPACITY], middle, sizeof(features->recent[0]));
+  uint32_t window_begin;
+  uint16_t window_count;
+  if (add_window_frame(ring, timestamp_ms, &window_begin, &window_count) != WINDOW_READY) {
+    return false;
+  }
+  return finish_window_float(features, window_begin, window_count, info);
+}
+
+void csi_features_train_start_float(CsiFeaturesFloat* features) {
+  features->ring.training_status = CSI_TRAINING;
+  features->ring.references_count = 0;
+  features->ring.stability_count = 0;
+  features->ring.vectors_count = 0;
+}
+
+void csi_features_train_stop_float(CsiFeaturesFloat* features) {
+  features->ring.training_status = CSI_TRAINED;
+}
+
+void csi_features_init_pca(CsiFeaturesPca* features, uint16_t window_frames, uint8_t components_count) {
+  memset(features, 0, sizeof(CsiFeaturesPca));
+  features->window.window_frames = window_frames ? window_frames : 1;
+  features->components_count = components_count < 1                        ? 1
+                               : components_count > CSI_PCA_MAX_COMPONENTS ? CSI_PCA_MAX_COMPONENTS
+                                                                           : components_count;
+}
+
+bool csi_features_push_pca(CsiFeaturesPca* features, const int8_t* data, uint16_t length, uint32_t timestamp_ms, wifi_radar_info_t* info) {
+  uint16_t powers[CSI_MAX_SUBCARRIERS];
+  const uint16_t count = csi_powers_pca(data, length, powers);
+  if (count < 2) {
+    return false;
+  }
+  if (features->dimension == 0) {
+    init_pca_basis(features, powers, count);
+    return false;
+  }
+
+  const uint16_t dimension = features->dimension;
+  uint32_t sum = 0;
+  uint32_t sum_squares = 0;
+  uint32_t reference_sum = 0;
+  for (uint16_t i = 0; i < dimension; i++) {
+    const uint32_t reference = (features->reference[i] + 8) >> 4;
+    powers[i] = i < count ? powers[i] : reference;
+    sum += powers[i];
+    sum_squares += (uint32_t)powers[i] * powers[i];
+    reference_sum += reference;
+  }
+  // The correlations don't see an offset common to all subcarriers either
+  const int32_t offset = ((int32_t)sum - (int32_t)reference_sum) / dimension;
+  int16_t deviations[CSI_MAX_SUBCARRIERS];
+  for (uint16_t i = 0; i < dimension; i++) {
+    const int32_t reference = features->reference[i];
+    deviations[i] = powers[i] - ((reference + 8) >> 4) - offset;
+    features->reference[i] = reference + ((((int32_t)powers[i] << 4) - reference) >> CSI_REFERENCE_SHIFT);
+  }
+
+  // Cauchy-Schwarz bounds every dot product by 8190 * sqrt(128) * CSI_PCA_ONE, so 32 bits are enough
+  uint64_t jitter_energy = 0;
+  uint64_t wander_energy = 0;
+  for (uint8_t j = 0; j < features->components_count; j++) {
+    const int16_t* vector = features->basis[j];
+    int32_t score = 0;
+    for (uint16_t i = 0; i < dimension; i++) {
+      score += (int32_t)deviations[i] * vector[i];
+    }
+    score >>= 14;
+    const int64_t change = score - features->scores[j];
+    jitter_energy += change * change;
+    wander_energy += (int64_t)score * score;
+    features->scores[j] = score;
+  }
+  if (++features->update_count >= CSI_PCA_UPDATE_FRAMES) {
+    update_pca_basis(features, deviations);
+    features->update_count = 0;
+  }
+
+  const int64_t variance = (int64_t)dimension * sum_squares - (int64_t)sum * sum;
+  return finish_frame_pca(&features->window, get_energy_share(jitter_energy, variance, dimension),
+                          get_energy_share(wander_energy, variance, dimension), info);
+}
+
+static void init_window_ring(CsiWindowRing* ring, uint16_t window_frames) {
+  ring->window_frames = window_frames < 2                             ? 2
+                        : window_frames > CSI_WINDOW_CAPACITY - 10 ? CSI_WINDOW_CAPACITY - 10
+                                                                   : window_frames;
+}
+
+/* Adds the frame at ring->end, whose amplitudes are in place already. A window
+ * closes when it holds window_frames frames or spans their expected time, and
+ * the next one starts halfway into it. A gap of over a quarter of that time
+ * closes it early, and like esp-csi without the last frame before the gap,
+ * which the next frame is then timed against too. Shorter windows are
+ * dropped. */
+static WindowEvent add_window_frame(CsiWindowRing* ring, uint32_t timestamp_ms, uint32_t* window_begin, uint16_t* window_count) {
+  const uint32_t slot = ring->end % CSI_WINDOW_CAPACITY;
+  const uint16_t count = ring->end - ring->begin;
+  const uint32_t span_ms = (uint32_t)ring->window_frames * CSI_FRAME_INTERVAL_MS;
+  const int32_t elapsed_ms = timestamp_ms - ring->previous_ms;
+  ring->timestamps_ms[slot] = timestamp_ms;
+  if (elapsed_ms <= CSI_FRAME_INTERVAL_MS / 4) {
+    return WINDOW_DROPPED;
+  }
+
+  WindowEvent event = WINDOW_NONE;
+  uint32_t last_slot = slot;
+  if (elapsed_ms > (int32_t)span_ms / 4) {
+    if (count > ring->window_frames / 2) {
+      *window_begin = ring->begin;
+      *window_count = count - 1;
+      event = WINDOW_READY;
+      last_slot = (ring->end - 1) % CSI_WINDOW_CAPACITY;
+    }
+    ring->begin = ring->end;
+  } else if ((int32_t)(timestamp_ms - ring->timestamps_ms[ring->begin % CSI_WINDOW_CAPACITY]) >= (int32_t)span_ms ||
+             count >= ring->window_frames) {
+    if (count < ring->window_frames / 2) {
+      ring->begin = ring->end;
+    } else {
+      *window_begin = ring->begin;
+      *window_count = count;
+      event = WINDOW_READY;
+      ring->begin += count / 2;
+    }
+  }
+  ring->previous_ms = ring->timestamps_ms[last_slot];
+  ring->end++;
+  return event;
+}
+
+/* Power iteration on the products of the amplitudes, from their sums, which
+ * point close to the principal vector already. Scaled to a largest element of
+ * CSI_VECTOR_ONE after every step, it usually stops changing after one. */
+static void get_vector_fixed(const CsiFeaturesFixed* features, uint32_t begin, uint16_t count, uint16_t* vector) {
+  uint32_t sums[CSI_FEATURE_SUBCARRIERS] = {0};
+  uint32_t products[CSI_FEATURE_SUBCARRIERS][CSI_FEATURE_SUBCARRIERS] = {{0}};
+  for (uint16_t t = 0; t < count; t++) {
+    const uint16_t* amplitudes = features->amplitudes[(begin + t) % CSI_WINDOW_CAPACITY];
+    for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+      sums[i] += amplitudes[i];
+      for (uint16_t j = 0; j <= i; j++) {
+        products[i][j] += (uint32_t)amplitudes[i] * amplitudes[j];
+      }
+    }
+  }
+  uint32_t largest_sum = 0;
+  for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+    largest_sum = sums[i] > largest_sum ? sums[i] : largest_sum;
+    for (uint16_t j = i + 1; j < CSI_FEATURE_SUBCARRIERS; j++) {
+      products[i][j] = products[j][i];
+    }
+  }
+  if (largest_sum == 0) {
+    memset(vector, 0, CSI_FEATURE_SUBCARRIERS * sizeof(vector[0]));
+    return;
+  }
+  for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+    vector[i] = ((uint64_t)sums[i] * CSI_VECTOR_ONE) / largest_sum;
+  }
+
+  for (int iteration = 0; iteration < POWER_ITERATIONS; iteration++) {
+    uint64_t next[CSI_FEATURE_SUBCARRIERS];
+    uint64_t largest = 0;
+    for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+      next[i] = 0;
+      for (uint16_t j = 0; j < CSI_FEATURE_SUBCARRIERS; j++) {
+        next[i] += (uint64_t)products[i][j] * vector[j];
+      }
+      largest = next[i] > largest ? next[i] : largest;
+    }
+    bool changed = false;
+    for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+      const uint16_t value = next[i] * CSI_VECTOR_ONE / largest;
+      changed |= value != vector[i];
+      vector[i] = value;
+    }
+    if (!changed) {
+      break;
+    }
+  }
+}
+
+static void get_vector_float(const CsiFeaturesFloat* features, uint32_t begin, uint16_t count, float* vector) {
+  float sums[CSI_FEATURE_SUBCARRIERS] = {0};
+  float products[CSI_FEATURE_SUBCARRIERS][CSI_FEATURE_SUBCARRIERS] = {{0}};
+  for (uint16_t t = 0; t < count; t++) {
+    const float* amplitudes = features->amplitudes[(begin + t) % CSI_WINDOW_CAPACITY];
+    for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+      sums[i] += amplitudes[i];
+      for (uint16_t j = 0; j <= i; j++) {
+        products[i][j] += amplitudes[i] * amplitudes[j];
+      }
+    }
+  }
+  float largest_sum = 0;
+  for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+    largest_sum = sums[i] > largest_sum ? sums[i] : largest_sum;
+    for (uint16_t j = i + 1; j < CSI_FEATURE_SUBCARRIERS; j++) {
+      products[i][j] = products[j][i];
+    }
+  }
+  if (largest_sum == 0) {
+    memset(vector, 0, CSI_FEATURE_SUBCARRIERS * sizeof(vector[0]));
+    return;
+  }
+  for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+    vector[i] = sums[i] / largest_sum;
+  }
+
+  for (int iteration = 0; iteration < POWER_ITERATIONS; iteration++) {
+    float next[CSI_FEATURE_SUBCARRIERS];
+    float largest = 0;
+    for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+      next[i] = 0;
+      for (uint16_t j = 0; j < CSI_FEATURE_SUBCARRIERS; j++) {
+        next[i] += products[i][j] * vector[j];
+      }
+      largest = next[i] > largest ? next[i] : largest;
+    }
+    bool changed = false;
+    for (uint16_t i = 0; i < CSI_FEATURE_SUBCARRIERS; i++) {
+      const float value = next[i] / largest;
+      changed |= value != vector[i];
+      vector[i] = value;
+    }
+    if (!changed) {
+      break;
+    }
+  }
+}
+
+/* Jitter against the vectors of the windows before, wander against the
+ * references of the training, which also collects them. The correlations are
+ * Q30, the only float operations are once per window. */
+static bool finish_window_fixed(CsiFeaturesFixed* features, uint32_t begin, uint16_t count, wifi_radar_info_t* info) {
+  CsiWindowRing* ring = &features->ring;
+  uint16_t* vector = features->vectors[ring->vectors_count % (CSI_JITTER_WINDOWS + 1)];
+  get_vector_fixed(features, begin, count, vector);
+  ring->vectors_count++;
+
+  int32_t jitter_correlation = CSI_CORRELATION_ONE;
+  if (ring->vectors_count > CSI_JITTER_WINDOWS) {
+    jitter_correlation = 0;
+    for (uint32_t k = 1; k <= CSI_JITTER_WINDOWS; k++) {
+      const int32_t correlation = abs(csi_correlation_fixed(vector, features->vectors[(ring->vectors_count - 1 - k) % (CSI_JITTER_WINDOWS + 1)], CSI_FEATURE_SUBCARRIERS));
+      jitter_correlation = correlation > jitter_correlation ? correlation : jitter_correlation;
+    }
+  }
+
+  int32_t wander_correlation = CSI_CORRELATION_ONE;
+  if (ring->training_status != CSI_UNTRAINED && ring->vectors_count > CSI_JITTER_WINDOWS) {
+    // Wander starts with the third jitter, and a window after a dip of the jitter correlation gets none
+    const uint32_t index = ring->stability_count++;
+    const int32_t dip = STABILITY_DIP * CSI_CORRELATION_ONE;
+    features->stability[index % CSI_JITTER_WINDOWS] = jitter_correlation;
+    const int32_t previous = features->stability[(index + CSI_JITTER_WINDOWS - 1) % CSI_JITTER_WINDOWS];
+    if (index >= 2 && (features->stability[(index + CSI_JITTER_WINDOWS - 2) % CSI_JITTER_WINDOWS] - previous <= dip || jitter_correlation - previous <= dip)) {
+      wander_correlation = 0;
+      for (uint8_t i = 0; i < ring->references_count; i++) {
+        const int32_t correlation = abs(csi_correlation_fixed(features->references[i], vector, CSI_FEATURE_SUBCARRIERS));
+        wander_correlation = correlation > wander_correlation ? correlation : wander_correlation;
+      }
+      if (ring->training_status == CSI_TRAINING && wander_correlation < (int32_t)(REFERENCE_MIN_CORRELATION * CSI_CORRELATION_ONE) &&
+          ring->references_count < CSI_REFERENCE_VECTORS) {
+        memcpy(features->references[ring->references_count++], vector, sizeof(features->references[0]));
+      }
+    }
+  }
+
+  info->waveform_jitter = (float)(CSI_CORRELATION_ONE - jitter_correlation) / CSI_CORRELATION_ONE;
+  info->waveform_wander = (float)(CSI_CORRELATION_ONE - wander_correlation) / CSI_CORRELATION_ONE;
+  return true;
+}
+
+static bool finish_window_float(CsiFeaturesFloat* features, uint32_t begin, uint16_t count, wifi_radar_info_t* info) {
+  CsiWindowRing* ring = &features->ring;
+  float* vector = features->vectors[ring->vectors_count % (CSI_JITTER_WINDOWS + 1)];
+  get_vector_float(features, begin, count, vector);
+  ring->vectors_count++;
+
+  float jitter_correlation = 1;
+  if (ring->vectors_count > CSI_JITTER_WINDOWS) {
+    jitter_correlation = 0;
+    for (uint32_t k = 1; k <= CSI_JITTER_WINDOWS; k++) {
+      jitter_correlation = fmaxf(jitter_correlation, fabsf(csi_correlation_float(vector, features->vectors[(ring->vectors_count - 1 - k) % (CSI_JITTER_WINDOWS + 1)], CSI_FEATURE_SUBCARRIERS)));
+    }
+  }
+
+  float wander_correlation = 1;
+  if (ring->training_status != CSI_UNTRAINED && ring->vectors_count > CSI_JITTER_WINDOWS) {
+    const uint32_t index = ring->stability_count++;
+    features->stability[index % CSI_JITTER_WINDOWS] = jitter_correlation;
+    const float previous = features->stability[(index + CSI_JITTER_WINDOWS - 1) % CSI_JITTER_WINDOWS];
+    if (index >= 2 && (features->stability[(index + CSI_JITTER_WINDOWS - 2) % CSI_JITTER_WINDOWS] - previous <= STABILITY_DIP ||
+                       jitter_correlation - previous <= STABILITY_DIP)) {
+      wander_correlation = 0;
+      for (uint8_t i = 0; i < ring->references_count; i++) {
+        wander_correlation = fmaxf(wander_correlation, fabsf(csi_correlation_float(features->references[i], vector, CSI_FEATURE_SUBCARRIERS)));
+      }
+      if (ring->training_status == CSI_TRAINING && wander_correlation < REFERENCE_MIN_CORRELATION && ring->references_count < CSI_REFERENCE_VECTORS) {
+        memcpy(features->references[ring->references_count++], vector, sizeof(features->references[0]));
+      }
+    }
+  }
+
+  info->waveform_jitter = 1 - jitter_correlation;
+  info->waveform_wander = 1 - wander_correlation;
+  return true;
+}
+
+/* Subcarrier powers, the components don't need the square roots of the amplitudes */
+static uint16_t csi_powers_pca(const int8_t* data, uint16_t length, uint16_t* powers) {
+  const uint16_t count = subcarriers_count(length);
+  for (uint16_t i = 0; i < count; i++) {
+    const int32_t imaginary = data[2 * i];
+    const int32_t real = data[2 * i + 1];
+    const uint32_t power = (uint32_t)(imaginary * imaginary + real * real) >> PCA_POWER_SHIFT;
+    powers[i] = power > PCA_POWER_MAX ? PCA_POWER_MAX : power;
+  }
+  return count;
+}
+
+static uint16_t subcarriers_count(uint16_t length) {
+  return length / 2 < CSI_MAX_SUBCARRIERS ? length / 2 : CSI_MAX_SUBCARRIERS;
+}
+
+/* Bit by bit square roots, rounded down. They need no multiplication, and the
+ * 32-bit one is cheap enough for every subcarrier. */
+static uint16_t isqrt32(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = (uint32_t)1 << 30;
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+static uint32_t isqrt64(uint64_t value) {
+  uint64_t root = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+static float sum_float(const float* values, uint16_t count) {
+  FloatVector sum = {0};
+  uint16_t i = 0;
+  for (; i + FLOAT_LANES <= count; i += FLOAT_LANES) {
+    FloatVector value;
+    memcpy(&value, &values[i], sizeof(value));
+    sum += value;
+  }
+  float total = 0;
+  for (int lane = 0; lane < FLOAT_LANES; lane++) {
+    total += sum[lane];
+  }
+  for (; i < count; i++) {
+    total += values[i];
+  }
+  return total;
+}
+
+/* Jitter and wander are Q15 */
+static bool finish_frame_pca(CsiFeatureWindow* window, int32_t jitter, int32_t wander, wifi_radar_info_t* info) {
+  window->jitter_sum += jitter;
+  window->wander_sum += wander;
+  if (++window->frames_count < window->window_frames) {
+    return false;
+  }
+  // The only float operations, once per window
+  info->waveform_jitter = (float)window->jitter_sum / window->frames_count / CSI_PCA_SHARE_ONE;
+  info->waveform_wander = (float)window->wander_sum / window->frames_count / CSI_PCA_SHARE_ONE;
+  window->jitter_sum = 0;
+  window->wander_sum = 0;
+  window->frames_count = 0;
+  return true;
+}
+
+/* Square waves of one to components_count half periods, a rough start for
+ * the smooth shapes across the band that the components take. */
+static void init_pca_basis(CsiFeaturesPca* features, const uint16_t* powers, uint16_t count) {
+  features->dimension = count;
+  for (uint16_t i = 0; i < count; i++) {
+    features->reference[i] = powers[i] << 4;
+  }
+  for (uint8_t j = 0; j < features->components_count; j++) {
+    for (uint16_t i = 0; i < count; i++) {
+      const bool negative = ((uint32_t)(j + 1) * (2 * i + 1) / (2 * count)) & 1;
+      features->basis[j][i] = negative ? -CSI_PCA_ONE / 8 : CSI_PCA_ONE / 8;
+    }
+    normalize_pca_vector(features->basis[j], count);
+  }
+}
+
+/* Sanger's rule: every component learns from what the components before it
+ * and itself leave of the frame, so the basis turns orthogonal and sorted by
+ * variance. The rate is divided by the average energy of the component, which
+ * makes the step independent of the signal level. */
+static void update_pca_basis(CsiFeaturesPca* features, const int16_t* deviations) {
+  const uint16_t dimension = features->dimension;
+  int32_t residuals[CSI_MAX_SUBCARRIERS];
+  for (uint16_t i = 0; i < dimension; i++) {
+    residuals[i] = deviations[i];
+  }
+  for (uint8_t j = 0; j < features->components_count; j++) {
+    int16_t* vector = features->basis[j];
+    const int32_t score = features->scores[j];
+    const uint64_t score_squared = (int64_t)score * score;
+    const int64_t energy = features->energy[j];
+    features->energy[j] = energy + (((int64_t)(score_squared > UINT32_MAX ? UINT32_MAX : score_squared) - energy) >> PCA_ENERGY_SHIFT);
+
+    // Q8 of score / energy / 2^PCA_RATE_SHIFT in Q14 steps
+    const int64_t divisor = features->energy[j] > PCA_MIN_ENERGY ? features->energy[j] : PCA_MIN_ENERGY;
+    const int64_t gain = (int64_t)score * (1 << (14 + 8 - PCA_RATE_SHIFT)) / divisor;
+    const int32_t clamped_gain = gain > PCA_MAX_GAIN ? PCA_MAX_GAIN : gain < -PCA_MAX_GAIN ? -PCA_MAX_GAIN : gain;
+    for (uint16_t i = 0; i < dimension; i++) {
+      residuals[i] -= (score * vector[i]) >> 14;
+      const int32_t value = vector[i] + ((clamped_gain * residuals[i]) >> 8);
+      vector[i] = value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : value;
+    }
+    normalize_pca_vector(vector, dimension);
+  }
+}
+
+/* Fixed-point steps shrink or grow the vectors a little, so they are scaled back to unit length */
+static void normalize_pca_vector(int16_t* vector, uint16_t dimension) {
+  uint64_t norm_squared = 0;
+  for (uint16_t i = 0; i < dimension; i++) {
+    norm_squared += (int32_t)vector[i] * vector[i];
+  }
+  const uint32_t norm = isqrt64(norm_squared);
+  if (norm == 0) {
+    return;
+  }
+  const int64_t scale = ((int64_t)CSI_PCA_ONE << 14) / norm;
+  for (uint16_t i = 0; i < dimension; i++) {
+    vector[i] = (vector[i] * scale) >> 14;
+  }
+}
+
+/* The energy relative to twice the variance across the subcarriers, which is
+ * about one minus the correlation of the frames it's the difference of. A flat
+ * frame counts like a correlation of 0. */
+static int32_t get_energy_share(uint64_t energy, int64_t variance, uint16_t dimension) {
+  if (variance <= 0) {
+    return CSI_PCA_SHARE_ONE;
+  }
+  const int64_t share = (int64_t)energy * dimension * CSI_PCA_SHARE_ONE / (2 * variance);
+  return share > CSI_PCA_SHARE_ONE ? CSI_PCA_SHARE_ONE : share;
+}
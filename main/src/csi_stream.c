@@ -0,0 +1,164 @@
+#include <csi_stream.h>
+
+#include <csi_codec.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <mqtt_handler.h>
+#include <proj_conf.h>
+#include <single_writer.h>
+#include <stdatomic.h>
+
+/* Streams the filtered CSI frames off the device. The CSI callback only copies
+ * frames into a static ring, while encoding, the bandwidth budget and MQTT
+ * publishing happen in a separate task. Frames over the budget are dropped,
+ * which decimates the stream instead of delaying it. */
+
+/* PRIVATE CONSTANTS */
+#define TAG "csi_stream"
+
+#define TASK_SEND_CSI_STREAM_STACK_SIZE 4096
+#define CSI_RING_CAPACITY               16  // Must be a power of 2
+#define CSI_STREAM_FLUSH_INTERVAL_MS    500
+
+_Static_assert((CSI_RING_CAPACITY & (CSI_RING_CAPACITY - 1)) == 0, "CSI_RING_CAPACITY must be a power of 2");
+
+/* GLOBAL VARIABLES */
+static CsiFrame g_ring[CSI_RING_CAPACITY] = {0};
+static atomic_uint_least32_t g_ring_head = 0;
+static atomic_uint_least32_t g_ring_tail = 0;
+static atomic_uint_least32_t g_ring_overflow_count = 0;
+static atomic_uint_least32_t g_truncated_count = 0;
+
+static atomic_bool g_streaming = false;
+static atomic_uint_least32_t g_radar_jitter_bits = 0;
+static atomic_uint_least32_t g_radar_wander_bits = 0;
+
+static TaskHandle_t g_send_csi_stream_task = NULL;
+static uint8_t g_payload[MQTT_FRAME_PAYLOAD_MAX_SIZE];
+
+/* PRIVATE PROTOTYPES */
+static void send_csi_stream(void* arg);
+static bool pop_frame(CsiFrame* frame);
+static void publish_batch(CsiBatchWriter* batch);
+
+/* FUNCTIONS */
+void init_csi_stream() {
+  if (DEBUG_LOG_ENABLED) {
+    esp_log_level_set(TAG, ESP_LOG_DEBUG);
+  }
+  xTaskCreate(send_csi_stream, "send_csi_stream", TASK_SEND_CSI_STREAM_STACK_SIZE, NULL, 0, &g_send_csi_stream_task);
+}
+
+void start_csi_stream() {
+  atomic_store(&g_streaming, true);
+  ESP_LOGI(TAG, "Started CSI stream");
+}
+
+void stop_csi_stream() {
+  atomic_store(&g_streaming, false);
+  ESP_LOGI(TAG, "Stopped CSI stream");
+}
+
+void add_csi_stream_frame(const wifi_csi_filtered_info_t* info) {
+  if (!atomic_load_explicit(&g_streaming, memory_order_relaxed)) {
+    return;
+  }
+
+  const uint32_t head = atomic_load_explicit(&g_ring_head, memory_order_relaxed);
+  const uint32_t tail = atomic_load_explicit(&g_ring_tail, memory_order_acquire);
+  if (head - tail == CSI_RING_CAPACITY) {
+    single_writer_add(&g_ring_overflow_count, 1);
+    return;
+  }
+
+  CsiFrame* frame = &g_ring[head & (CSI_RING_CAPACITY - 1)];
+  frame->timestamp_ms = esp_timer_get_time() / 1000;
+  frame->rssi = info->rx_ctrl.rssi;
+  // The length is signed, a negative one is an empty frame
+  const uint16_t valid_len = info->valid_len > 0 ? info->valid_len : 0;
+  frame->values_count = valid_len < CSI_MAX_VALUES ? valid_len : CSI_MAX_VALUES;
+  if (valid_len > CSI_MAX_VALUES) {
+    single_writer_add(&g_truncated_count, 1);
+  }
+  const uint32_t jitter_bits = atomic_load_explicit(&g_radar_jitter_bits, memory_order_relaxed);
+  const uint32_t wander_bits = atomic_load_explicit(&g_radar_wander_bits, memory_order_relaxed);
+  memcpy(&frame->waveform_jitter, &jitter_bits, sizeof(float));
+  memcpy(&frame->waveform_wander, &wander_bits, sizeof(float));
+  memcpy(frame->values, info->valid_data, frame->values_count);
+
+  atomic_store_explicit(&g_ring_head, head + 1, memory_order_release);
+  xTaskNotifyGive(g_send_csi_stream_task);
+}
+
+void set_csi_stream_radar_info(const wifi_radar_info_t* info) {
+  uint32_t bits;
+  memcpy(&bits, &info->waveform_jitter, sizeof(bits));
+  atomic_store_explicit(&g_radar_jitter_bits, bits, memory_order_relaxed);
+  memcpy(&bits, &info->waveform_wander, sizeof(bits));
+  atomic_store_explicit(&g_radar_wander_bits, bits, memory_order_relaxed);
+}
+
+static void send_csi_stream(void* arg) {
+  static CsiFrame frame;
+  CsiBatchWriter batch;
+  csi_batch_begin(&batch, g_payload, sizeof(g_payload), CSI_STREAM_QUANTIZATION_SHIFT);
+
+  // Token bucket in bytes, holding at most one second worth of budget
+  uint32_t budget_bytes = CSI_STREAM_BUDGET_BYTES_PER_S;
+  TickType_t budget_updated_at = xTaskGetTickCount();
+  TickType_t batch_started_at = budget_updated_at;
+  size_t last_frame_size = CSI_FRAME_MAX_SIZE / 2;
+  uint32_t over_budget_count = 0;
+
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CSI_STREAM_FLUSH_INTERVAL_MS));
+
+    const TickType_t now = xTaskGetTickCount();
+    const uint64_t refill_bytes = (uint64_t)(now - budget_updated_at) * portTICK_PERIOD_MS * CSI_STREAM_BUDGET_BYTES_PER_S / 1000;
+    budget_bytes = budget_bytes + refill_bytes < CSI_STREAM_BUDGET_BYTES_PER_S ? budget_bytes + refill_bytes : CSI_STREAM_BUDGET_BYTES_PER_S;
+    budget_updated_at = now;
+
+    while (pop_frame(&frame)) {
+      if (budget_bytes < last_frame_size) {
+        over_budget_count++;
+        continue;
+      }
+      if (batch.frames_count == 0) {
+        batch_started_at = now;
+      }
+      const size_t size_before = batch.size;
+      if (!csi_batch_append(&batch, &frame)) {
+        publish_batch(&batch);
+        batch_started_at = now;
+        csi_batch_append(&batch, &frame);  // Starts with a key frame, so it's bigger than usual
+      }
+      last_frame_size = batch.size > size_before ? batch.size - size_before : batch.size;
+      budget_bytes -= last_frame_size < budget_bytes ? last_frame_size : budget_bytes;
+    }
+
+    if (batch.frames_count > 0 && now - batch_started_at >= pdMS_TO_TICKS(CSI_STREAM_FLUSH_INTERVAL_MS)) {
+      publish_batch(&batch);
+      ESP_LOGD(TAG, "Frames dropped: %u over budget, %u ring full, %u truncated", over_budget_count,
+               atomic_load(&g_ring_overflow_count), atomic_load(&g_truncated_count));
+    }
+  }
+}
+
+static bool pop_frame(CsiFrame* frame) {
+  const uint32_t tail = atomic_load_explicit(&g_ring_tail, memory_order_relaxed);
+  const uint32_t head = atomic_load_explicit(&g_ring_head, memory_order_acquire);
+  if (head == tail) {
+    return false;
+  }
+  *frame = g_ring[tail & (CSI_RING_CAPACITY - 1)];
+  atomic_store_explicit(&g_ring_tail, tail + 1, memory_order_release);
+  return true;
+}
+
+
+static void publish_batch(CsiBatchWriter* batch) {
+  send_mqtt_msg(MQTT_TX_MSG_CSI, (const char*)batch->buffer, batch->size);
+  csi_batch_begin(batch, batch->buffer, batch->capacity, batch->quantization_shift);
+}
@@ -0,0 +1,143 @@
+#include <detector_core.h>
+
+#include <esp_log.h>
+#include <string.h>
+
+/* PRIVATE CONSTANTS */
+#define TAG "detector_core"
+
+#define VARIANT_KEY "detector"
+
+/* PRIVATE TYPES */
+struct JitterFeatures {
+  static constexpr bool USES_WANDER = false;
+
+  static bool judge(const wifi_radar_info_t& info, const wifi_radar_info_t& threshold) {
+    return info.waveform_jitter > threshold.waveform_jitter;
+  }
+};
+
+/* A wander threshold of 0, from calibrations that only stored the jitter, leaves the wander out */
+struct JitterWanderFeatures {
+  static constexpr bool USES_WANDER = true;
+
+  static bool judge(const wifi_radar_info_t& info, const wifi_radar_info_t& threshold) {
+    return (info.waveform_jitter > threshold.waveform_jitter) |
+           ((threshold.waveform_wander > 0) & (info.waveform_wander > threshold.waveform_wander));
+  }
+};
+
+/* Decides like presence_hysteresis.c, with selects instead of branches */
+template <uint32_t ENTER_HOLD_MS, uint8_t ENTER_COUNT, uint32_t EXIT_HOLD_MS, uint8_t EXIT_COUNT>
+struct TimedHysteresis {
+  static bool push(PresenceHysteresis* presence, bool movement, uint32_t timestamp_ms) {
+    const bool against = movement != presence->present;
+    const uint8_t pending_count = presence->pending_count;
+    presence->pending_since_ms = (against & (pending_count == 0)) ? timestamp_ms : presence->pending_since_ms;
+    presence->pending_count = against ? pending_count + (pending_count < UINT8_MAX) : 0;
+    return update(presence, timestamp_ms);
+  }
+
+  static bool update(PresenceHysteresis* presence, uint32_t now_ms) {
+    const bool present = presence->present;
+    const uint8_t count = present ? EXIT_COUNT : ENTER_COUNT;
+    const int32_t hold_ms = present ? EXIT_HOLD_MS : ENTER_HOLD_MS;
+    const bool change = (presence->pending_count != 0) & (presence->pending_count >= count) &
+                        ((int32_t)(now_ms - presence->pending_since_ms) >= hold_ms);
+    presence->present = present ^ change;
+    presence->pending_count = change ? 0 : presence->pending_count;
+    return presence->present;
+  }
+};
+
+/* Decides on the number of samples alone */
+template <uint8_t ENTER_COUNT, uint8_t EXIT_COUNT>
+using CountedHysteresis = TimedHysteresis<0, ENTER_COUNT, 0, EXIT_COUNT>;
+
+/* The window is a shift register with a running count of its set bits. The
+ * bit that falls out is 0 until the window has filled, so filling needs no
+ * special case either. */
+template <uint8_t WINDOW_SIZE, uint8_t NEEDED_DETECTIONS, typename Features, typename Hysteresis>
+struct Variant {
+  static_assert(WINDOW_SIZE > 0 && WINDOW_SIZE <= DETECTOR_WINDOW_MAX_SIZE, "Window must fit into DetectorWindow");
+  static_assert(NEEDED_DETECTIONS > 0 && NEEDED_DETECTIONS <= WINDOW_SIZE, "Detections must fit into the window");
+  static constexpr uint64_t MASK = WINDOW_SIZE == 64 ? ~0ull : (1ull << WINDOW_SIZE) - 1;
+
+  static bool push_link(DetectorWindow* window, const wifi_radar_info_t* info, const wifi_radar_info_t* threshold,
+                        bool* motion_detected, bool* detecting) {
+    const uint8_t motion = Features::judge(*info, *threshold);
+    const uint8_t evicted = (window->bits >> (WINDOW_SIZE - 1)) & 1;
+    window->bits = ((window->bits << 1) | motion) & MASK;
+    window->detections += motion - evicted;
+    window->filled += window->filled < WINDOW_SIZE;
+    const bool full = window->filled == WINDOW_SIZE;
+    *motion_detected = motion;
+    *detecting = full & (window->detections >= NEEDED_DETECTIONS);
+    return full;
+  }
+
+  static constexpr DetectorVariant make(const char* name) {
+    return DetectorVariant{name,      WINDOW_SIZE,      NEEDED_DETECTIONS, Features::USES_WANDER,
+                           push_link, Hysteresis::push, Hysteresis::update};
+  }
+};
+
+/* GLOBAL VARIABLES */
+/* Starting points per room type, radar_tune scores them on labeled traces.
+ * Names must be shorter than DETECTOR_VARIANT_NAME_MAX_SIZE. */
+static constexpr DetectorVariant g_variants[] = {
+    // The defaults of the run-time configured detector, judged by the thresholds only
+    Variant<10, 2, JitterFeatures, TimedHysteresis<0, 1, 3000, 1>>::make("office"),
+    // People pass through, so decide fast and let go fast
+    Variant<5, 1, JitterFeatures, TimedHysteresis<0, 1, 1000, 1>>::make("hallway"),
+    // Several people, some of them sitting still
+    Variant<16, 3, JitterWanderFeatures, TimedHysteresis<0, 1, 5000, 1>>::make("living"),
+    // Little movement while occupied, and a moving curtain shouldn't wake anybody up
+    Variant<32, 4, JitterWanderFeatures, TimedHysteresis<500, 2, 10000, 2>>::make("bedroom"),
+    // Noisy links, a decision needs three samples in a row
+    Variant<10, 3, JitterWanderFeatures, CountedHysteresis<3, 3>>::make("noisy"),
+};
+
+/* FUNCTIONS */
+size_t get_detector_variants_count() {
+  return sizeof(g_variants) / sizeof(g_variants[0]);
+}
+
+const DetectorVariant* get_detector_variant(size_t index) {
+  return index < get_detector_variants_count() ? &g_variants[index] : NULL;
+}
+
+const DetectorVariant* find_detector_variant(const char* name, size_t length) {
+  for (const DetectorVariant& variant : g_variants) {
+    if (strlen(variant.name) == length && memcmp(variant.name, name, length) == 0) {
+      return &variant;
+    }
+  }
+  return NULL;
+}
+
+const DetectorVariant* load_detector_variant(nvs_handle_t handle) {
+  char name[DETECTOR_VARIANT_NAME_MAX_SIZE];
+  size_t length = sizeof(name);
+  const esp_err_t res = nvs_get_blob(handle, VARIANT_KEY, name, &length);
+  if (res == ESP_ERR_NVS_NOT_FOUND) {
+    return NULL;
+  }
+  const DetectorVariant* variant = res == ESP_OK ? find_detector_variant(name, length) : NULL;
+  if (!variant) {
+    ESP_LOGW(TAG, "Ignoring stored detector variant, unknown (0x%x, %u bytes)", res, (unsigned)length);
+  }
+  return variant;
+}
+
+void save_detector_variant(nvs_handle_t handle, const DetectorVariant* variant) {
+  if (variant) {
+    ESP_ERROR_CHECK(nvs_set_blob(handle, VARIANT_KEY, variant->name, strlen(variant->name)));
+  } else {
+    const esp_err_t res = nvs_erase_key(handle, VARIANT_KEY);
+    if (res != ESP_ERR_NVS_NOT_FOUND) {
+      ESP_ERROR_CHECK(res);
+    }
+  }
+  ESP_ERROR_CHECK(nvs_commit(handle));
+}
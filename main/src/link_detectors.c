@@ -0,0 +1,134 @@
+#include <link_detectors.h>
+
+#include <esp_log.h>
+#include <math.h>
+#include <proj_conf.h>
+#include <string.h>
+
+/* PRIVATE CONSTANTS */
+#define TAG "link_detectors"
+
+/* PRIVATE PROTOTYPES */
+static void init_link(LinkDetectors* detectors, LinkDetector* link, const wifi_radar_info_t* threshold);
+
+/* FUNCTIONS */
+void link_detectors_init(LinkDetectors* detectors, uint16_t window_size, uint16_t needed_detections, float threshold_margin) {
+  if (DEBUG_LOG_ENABLED) {
+    esp_log_level_set(TAG, ESP_LOG_DEBUG);
+  }
+  detectors->window_size = window_size;
+  detectors->needed_detections = needed_detections;
+  detectors->threshold_margin = threshold_margin;
+  detectors->model = get_default_motion_model();
+  detectors->variant = NULL;
+  link_detectors_reset(detectors, &(wifi_radar_info_t){0});
+}
+
+void link_detectors_reset(LinkDetectors* detectors, const wifi_radar_info_t* default_threshold) {
+  link_table_init(&detectors->table);
+  detectors->default_threshold = *default_threshold;
+}
+
+void link_detectors_set_model(LinkDetectors* detectors, const MotionModel* model) {
+  detectors->model = model;
+}
+
+void link_detectors_set_variant(LinkDetectors* detectors, const DetectorVariant* variant) {
+  detectors->variant = variant;
+  for (int i = 0; i < LINK_TABLE_CAPACITY; i++) {
+    LinkDetector* link = &detectors->links[i];
+    link->core = (DetectorWindow){0};
+    link->motion_detected = false;
+    link->detecting = false;
+    motion_window_init(&link->motion_window, detectors->window_size);
+    motion_classifier_init(&link->classifier);
+  }
+}
+
+void link_detectors_set_threshold(LinkDetectors* detectors, const LinkThreshold* link, uint32_t now_ms) {
+  bool inserted;
+  const int slot = link_table_get(&detectors->table, link->mac, now_ms, &inserted);
+  init_link(detectors, &detectors->links[slot], &link->threshold);
+}
+
+LinkDetector* link_detectors_get(LinkDetectors* detectors, const uint8_t* mac, uint32_t now_ms) {
+  bool inserted;
+  const int slot = link_table_get(&detectors->table, mac, now_ms, &inserted);
+  LinkDetector* link = &detectors->links[slot];
+  if (inserted) {
+    init_link(detectors, link, &detectors->default_threshold);
+    ESP_LOGI(TAG, "New link %02x:%02x:%02x:%02x:%02x:%02x in slot %d, %u links", mac[0], mac[1], mac[2], mac[3],
+             mac[4], mac[5], slot, detectors->table.count);
+  }
+  return link;
+}
+
+uint8_t link_detectors_count_detecting(const LinkDetectors* detectors, uint32_t now_ms, uint32_t max_age_ms) {
+  uint8_t count = 0;
+  for (int i = 0; i < LINK_TABLE_CAPACITY; i++) {
+    const LinkSlot* slot = &detectors->table.slots[i];
+    if (slot->used && now_ms - slot->last_seen_ms <= max_age_ms && detectors->links[i].detecting) {
+      count++;
+    }
+  }
+  return count;
+}
+
+void link_detectors_begin_calibration(LinkDetectors* detectors) {
+  for (int i = 0; i < LINK_TABLE_CAPACITY; i++) {
+    detectors->links[i].calibration_max = (wifi_radar_info_t){0};
+  }
+}
+
+size_t link_detectors_finish_calibration(const LinkDetectors* detectors, float margin, LinkThreshold* thresholds) {
+  size_t count = 0;
+  for (int i = 0; i < LINK_TABLE_CAPACITY; i++) {
+    const LinkDetector* link = &detectors->links[i];
+    if (!detectors->table.slots[i].used || link->calibration_max.waveform_jitter == 0) {
+      continue;
+    }
+    memcpy(thresholds[count].mac, detectors->table.slots[i].mac, LINK_MAC_SIZE);
+    thresholds[count].threshold.waveform_jitter = link->calibration_max.waveform_jitter * margin;
+    thresholds[count].threshold.waveform_wander = link->calibration_max.waveform_wander * margin;
+    count++;
+  }
+  return count;
+}
+
+void link_detector_calibrate(LinkDetector* link, const wifi_radar_info_t* info) {
+  link->calibration_max.waveform_jitter = fmaxf(link->calibration_max.waveform_jitter, info->waveform_jitter);
+  link->calibration_max.waveform_wander = fmaxf(link->calibration_max.waveform_wander, info->waveform_wander);
+}
+
+bool link_detector_push(LinkDetectors* detectors, LinkDetector* link, const wifi_radar_info_t* info, bool room_empty) {
+  if (ADAPTIVE_THRESHOLD_ENABLED && room_empty && adaptive_threshold_add(&link->adaptive, info, &link->threshold)) {
+    ESP_LOGI(TAG, "Adapted thresholds of link %d: jitter %f, wander %f", (int)(link - detectors->links),
+             link->threshold.waveform_jitter, link->threshold.waveform_wander);
+  }
+
+  if (detectors->variant) {
+    return detectors->variant->push_link(&link->core, info, &link->threshold, &link->motion_detected, &link->detecting);
+  }
+  if (MOTION_CLASSIFIER_ENABLED) {
+    link->motion_detected = motion_classifier_push(&link->classifier, detectors->model, info, &link->threshold);
+  } else {
+    link->motion_detected = info->waveform_jitter > link->threshold.waveform_jitter;
+  }
+  const uint16_t motion_detection_count = motion_window_push(&link->motion_window, link->motion_detected);
+  if (!motion_window_is_full(&link->motion_window)) {
+    return false;
+  }
+  link->detecting = motion_detection_count >= detectors->needed_detections;
+  return true;
+}
+
+static void init_link(LinkDetectors* detectors, LinkDetector* link, const wifi_radar_info_t* threshold) {
+  link->threshold = *threshold;
+  link->calibration_max = (wifi_radar_info_t){0};
+  link->motion_detected = false;
+  link->detecting = false;
+  motion_window_init(&link->motion_window, detectors->window_size);
+  motion_classifier_init(&link->classifier);
+  link->core = (DetectorWindow){0};
+  adaptive_threshold_init(&link->adaptive, threshold, ADAPTIVE_THRESHOLD_QUANTILE, detectors->threshold_margin);
+}
@@ -0,0 +1,69 @@
+#include <link_table.h>
+
+#include <string.h>
+
+/* PRIVATE PROTOTYPES */
+static uint32_t hash_mac(const uint8_t* mac);
+static int probe(const LinkTable* table, const uint8_t* mac, int* empty_slot);
+
+/* FUNCTIONS */
+void link_table_init(LinkTable* table) {
+  memset(table, 0, sizeof(LinkTable));
+}
+
+int link_table_find(const LinkTable* table, const uint8_t* mac) {
+  int empty_slot;
+  return probe(table, mac, &empty_slot);
+}
+
+int link_table_get(LinkTable* table, const uint8_t* mac, uint32_t now_ms, bool* inserted) {
+  int empty_slot;
+  int slot = probe(table, mac, &empty_slot);
+  *inserted = slot < 0;
+
+  if (slot < 0 && empty_slot >= 0) {
+    slot = empty_slot;
+    table->count++;
+  } else if (slot < 0) {
+    slot = 0;
+    for (int i = 1; i < LINK_TABLE_CAPACITY; i++) {
+      if ((int32_t)(table->slots[i].last_seen_ms - table->slots[slot].last_seen_ms) < 0) {
+        slot = i;
+      }
+    }
+  }
+
+  LinkSlot* link = &table->slots[slot];
+  if (*inserted) {
+    memcpy(link->mac, mac, LINK_MAC_SIZE);
+    link->used = true;
+  }
+  link->last_seen_ms = now_ms;
+  return slot;
+}
+
+/* FNV-1a, the low bits of which are good enough for a handful of slots */
+static uint32_t hash_mac(const uint8_t* mac) {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < LINK_MAC_SIZE; i++) {
+    hash = (hash ^ mac[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static int probe(const LinkTable* table, const uint8_t* mac, int* empty_slot) {
+  *empty_slot = -1;
+  const uint32_t start = hash_mac(mac);
+  for (uint32_t i = 0; i < LINK_TABLE_CAPACITY; i++) {
+    const int slot = (start + i) % LINK_TABLE_CAPACITY;
+    const LinkSlot* link = &table->slots[slot];
+    if (!link->used) {
+      *empty_slot = slot;
+      return -1;
+    }
+    if (memcmp(link->mac, mac, LINK_MAC_SIZE) == 0) {
+      return slot;
+    }
+  }
+  return -1;
+}
@@ -1,9 +1,15 @@
+#include <boot_timeline.h>
+#include <csi_stream.h>
 #include <esp_event.h>
 #include <esp_log.h>
 #include <mqtt_handler.h>
 #include <nvs_flash.h>
+#include <ping_handler.h>
+#include <pipeline_metrics.h>
 #include <proj_conf.h>
 #include <string.h>
+#include <telemetry.h>
+#include <trace_recorder.h>
 #include <wifi_handler.h>
 #include <wifi_radar.h>
 
@@ -15,13 +21,25 @@ static void set_logging_settings();
 static void init_storage();
 
 /* MAIN */
+/* The station associates while the rest starts up, a reboot only waits for
+ * the network where it's needed. Frames sent before the broker is connected
+ * wait in the MQTT outbox. */
 void app_main(void) {
   set_logging_settings();
   init_storage();
+  mark_boot_stage(BOOT_STAGE_STORAGE);
   ESP_ERROR_CHECK(esp_event_loop_create_default());
   init_wifi_station();
   init_mqtt_client();
+  init_pipeline_metrics();
+  init_telemetry();
+  init_trace_recorder();
+  init_csi_stream();
   init_wifi_radar();
+
+  wait_for_wifi_station();
+  init_gateway_ping();
+  start_mqtt_client();
 }
 
 /* FUNCTIONS */
@@ -0,0 +1,206 @@
+#include <motion_classifier.h>
+
+#include <esp_log.h>
+#include <frame_bytes.h>
+#include <radar_fixed.h>
+#include <string.h>
+
+/* PRIVATE CONSTANTS */
+#define TAG "motion_classifier"
+
+#define MODEL_KEY           "model"
+#define MODEL_HEADER_SIZE   2
+#define LOGISTIC_SIZE       (MODEL_HEADER_SIZE + 2 + MOTION_FEATURES_COUNT)
+#define TREE_NODE_SIZE      4
+#define FEATURE_MAX         INT8_MAX
+
+/* GLOBAL VARIABLES */
+/* Over the threshold like the plain comparison, but a lone spike needs to be
+ * higher, and a window that keeps moving or wander over its threshold tips a
+ * sample just under it. */
+static const MotionModel g_default_model = {
+    .type = MOTION_MODEL_LOGISTIC,
+    .logistic = {
+        .bias = -17 * MOTION_FEATURE_ONE,
+        .weights = {
+            [MOTION_FEATURE_JITTER] = 12,
+            [MOTION_FEATURE_WANDER] = 1,
+            [MOTION_FEATURE_JITTER_MEAN] = 4,
+        },
+    },
+};
+
+/* PRIVATE PROTOTYPES */
+static int8_t get_ratio(uint32_t value, uint32_t threshold);
+static bool judge_logistic(const MotionModel* model, const int8_t* features);
+static bool judge_tree(const MotionModel* model, const int8_t* features);
+
+/* FUNCTIONS */
+const MotionModel* get_default_motion_model() {
+  return &g_default_model;
+}
+
+bool motion_model_decode(const uint8_t* bytes, size_t size, MotionModel* model) {
+  if (size < MODEL_HEADER_SIZE || bytes[0] != MOTION_MODEL_VERSION) {
+    return false;
+  }
+  memset(model, 0, sizeof(MotionModel));
+  model->type = bytes[1];
+  const uint8_t* cursor = bytes + MODEL_HEADER_SIZE;
+  switch (model->type) {
+    case MOTION_MODEL_LOGISTIC:
+      if (size != LOGISTIC_SIZE) {
+        return false;
+      }
+      model->logistic.bias = (int16_t)get_u16(cursor);
+      memcpy(model->logistic.weights, cursor + 2, MOTION_FEATURES_COUNT);
+      return true;
+
+    case MOTION_MODEL_TREE: {
+      if (size < MODEL_HEADER_SIZE + 1) {
+        return false;
+      }
+      const uint8_t count = *cursor++;
+      if (count == 0 || count > MOTION_TREE_MAX_NODES || size != MODEL_HEADER_SIZE + 1 + count * TREE_NODE_SIZE) {
+        return false;
+      }
+      for (uint8_t i = 0; i < count; i++, cursor += TREE_NODE_SIZE) {
+        const MotionTreeNode node = {.feature = cursor[0], .threshold = (int8_t)cursor[1], .left = cursor[2], .right = cursor[3]};
+        const bool valid = node.feature == MOTION_TREE_LEAF
+                               ? node.threshold == 0 || node.threshold == 1
+                               : node.feature < MOTION_FEATURES_COUNT && node.left > i && node.left < count &&
+                                     node.right > i && node.right < count;
+        if (!valid) {
+          return false;
+        }
+        model->tree.nodes[i] = node;
+      }
+      model->tree.nodes_count = count;
+      return true;
+    }
+
+    default:
+      return false;
+  }
+}
+
+size_t motion_model_encode(const MotionModel* model, uint8_t* bytes) {
+  uint8_t* cursor = bytes;
+  *cursor++ = MOTION_MODEL_VERSION;
+  *cursor++ = model->type;
+  if (model->type == MOTION_MODEL_LOGISTIC) {
+    cursor = put_u16(cursor, (uint16_t)model->logistic.bias);
+    memcpy(cursor, model->logistic.weights, MOTION_FEATURES_COUNT);
+    return cursor + MOTION_FEATURES_COUNT - bytes;
+  }
+  *cursor++ = model->tree.nodes_count;
+  for (uint8_t i = 0; i < model->tree.nodes_count; i++) {
+    const MotionTreeNode* node = &model->tree.nodes[i];
+    *cursor++ = node->feature;
+    *cursor++ = (uint8_t)node->threshold;
+    *cursor++ = node->left;
+    *cursor++ = node->right;
+  }
+  return cursor - bytes;
+}
+
+bool load_motion_model(nvs_handle_t handle, MotionModel* model) {
+  uint8_t bytes[MOTION_MODEL_MAX_SIZE];
+  size_t bytes_count = sizeof(bytes);
+  const esp_err_t res = nvs_get_blob(handle, MODEL_KEY, bytes, &bytes_count);
+  if (res == ESP_ERR_NVS_NOT_FOUND) {
+    return false;
+  }
+  if (res != ESP_OK || !motion_model_decode(bytes, bytes_count, model)) {
+    ESP_LOGW(TAG, "Ignoring stored motion model, unknown record (0x%x, %u bytes)", res, (unsigned)bytes_count);
+    return false;
+  }
+  return true;
+}
+
+void save_motion_model(nvs_handle_t handle, const MotionModel* model) {
+  uint8_t bytes[MOTION_MODEL_MAX_SIZE];
+  const size_t bytes_count = motion_model_encode(model, bytes);
+  ESP_ERROR_CHECK(nvs_set_blob(handle, MODEL_KEY, bytes, bytes_count));
+  ESP_ERROR_CHECK(nvs_commit(handle));
+}
+
+void erase_motion_model(nvs_handle_t handle) {
+  const esp_err_t res = nvs_erase_key(handle, MODEL_KEY);
+  if (res != ESP_ERR_NVS_NOT_FOUND) {
+    ESP_ERROR_CHECK(res);
+  }
+  ESP_ERROR_CHECK(nvs_commit(handle));
+}
+
+void motion_classifier_init(MotionClassifier* classifier) {
+  memset(classifier, 0, sizeof(MotionClassifier));
+}
+
+bool motion_classifier_push(MotionClassifier* classifier, const MotionModel* model, const wifi_radar_info_t* info,
+                            const wifi_radar_info_t* threshold) {
+  const int8_t jitter =
+      get_ratio(radar_value_to_fixed(info->waveform_jitter), radar_value_to_fixed(threshold->waveform_jitter));
+  const int8_t wander =
+      get_ratio(radar_value_to_fixed(info->waveform_wander), radar_value_to_fixed(threshold->waveform_wander));
+
+  const uint8_t position = classifier->position;
+  const uint8_t previous = (position + MOTION_CLASSIFIER_WINDOW - 1) % MOTION_CLASSIFIER_WINDOW;
+  const uint8_t change = classifier->filled ? (jitter > classifier->jitter[previous] ? jitter - classifier->jitter[previous]
+                                                                                     : classifier->jitter[previous] - jitter)
+                                            : 0;
+  if (classifier->filled == MOTION_CLASSIFIER_WINDOW) {
+    classifier->jitter_sum -= classifier->jitter[position];
+    classifier->wander_sum -= classifier->wander[position];
+    classifier->change_sum -= classifier->change[position];
+  } else {
+    classifier->filled++;
+  }
+  classifier->jitter[position] = jitter;
+  classifier->wander[position] = wander;
+  classifier->change[position] = change;
+  classifier->jitter_sum += jitter;
+  classifier->wander_sum += wander;
+  classifier->change_sum += change;
+  classifier->position = (position + 1) % MOTION_CLASSIFIER_WINDOW;
+
+  uint8_t jitter_max = 0;
+  for (uint8_t i = 0; i < classifier->filled; i++) {
+    jitter_max = classifier->jitter[i] > jitter_max ? classifier->jitter[i] : jitter_max;
+  }
+
+  int8_t* features = classifier->features;
+  features[MOTION_FEATURE_JITTER] = jitter;
+  features[MOTION_FEATURE_WANDER] = wander;
+  features[MOTION_FEATURE_JITTER_MEAN] = classifier->jitter_sum / classifier->filled;
+  features[MOTION_FEATURE_JITTER_MAX] = jitter_max;
+  features[MOTION_FEATURE_WANDER_MEAN] = classifier->wander_sum / classifier->filled;
+  features[MOTION_FEATURE_JITTER_CHANGE] = classifier->change_sum / classifier->filled;
+
+  return model->type == MOTION_MODEL_TREE ? judge_tree(model, features) : judge_logistic(model, features);
+}
+
+static int8_t get_ratio(uint32_t value, uint32_t threshold) {
+  if (threshold == 0) {
+    return 0;
+  }
+  const uint32_t ratio = (value * MOTION_FEATURE_ONE + threshold / 2) / threshold;
+  return ratio > FEATURE_MAX ? FEATURE_MAX : ratio;
+}
+
+static bool judge_logistic(const MotionModel* model, const int8_t* features) {
+  int32_t score = model->logistic.bias;
+  for (int i = 0; i < MOTION_FEATURES_COUNT; i++) {
+    score += (int32_t)model->logistic.weights[i] * features[i];
+  }
+  return score > 0;
+}
+
+/* Children come after their parents, so a walk takes at most nodes_count steps */
+static bool judge_tree(const MotionModel* model, const int8_t* features) {
+  const MotionTreeNode* node = &model->tree.nodes[0];
+  while (node->feature != MOTION_TREE_LEAF) {
+    node = &model->tree.nodes[features[node->feature] <= node->threshold ? node->left : node->right];
+  }
+  return node->threshold == 1;
+}
@@ -0,0 +1,43 @@
+#include <motion_window.h>
+
+#include <assert.h>
+#include <string.h>
+
+/* FUNCTIONS */
+void motion_window_init(MotionWindow* window, uint16_t size) {
+  assert(size > 0 && size <= MOTION_WINDOW_MAX_SIZE);
+  window->size = size;
+  motion_window_reset(window);
+}
+
+void motion_window_reset(MotionWindow* window) {
+  memset(window->bits, 0, sizeof(window->bits));
+  window->position = 0;
+  window->filled = 0;
+  window->detections = 0;
+}
+
+uint16_t motion_window_push(MotionWindow* window, bool motion_detected) {
+  uint32_t* word = &window->bits[window->position / 32];
+  const uint32_t mask = 1UL << (window->position % 32);
+
+  if (window->filled == window->size) {
+    window->detections -= (*word & mask) ? 1 : 0;  // Evict the oldest sample
+  } else {
+    window->filled++;
+  }
+
+  if (motion_detected) {
+    *word |= mask;
+    window->detections++;
+  } else {
+    *word &= ~mask;
+  }
+
+  window->position = window->position + 1 == window->size ? 0 : window->position + 1;
+  return window->detections;
+}
+
+bool motion_window_is_full(const MotionWindow* window) {
+  return window->filled == window->size;
+}
@@ -0,0 +1,152 @@
+#include <mqtt_frame.h>
+
+#include <frame_bytes.h>
+#include <string.h>
+
+/* FUNCTIONS */
+size_t mqtt_frame_encode(uint8_t* buffer, size_t buffer_size, uint8_t msg_id, const void* payload, size_t payload_size) {
+  if (payload_size > MQTT_FRAME_PAYLOAD_MAX_SIZE || MQTT_FRAME_HEADER_SIZE + payload_size > buffer_size) {
+    return 0;
+  }
+  buffer[0] = MQTT_FRAME_MARKER | MQTT_FRAME_VERSION;
+  buffer[1] = msg_id;
+  memcpy(buffer + MQTT_FRAME_HEADER_SIZE, payload, payload_size);
+  return MQTT_FRAME_HEADER_SIZE + payload_size;
+}
+
+size_t mqtt_frame_encode_telemetry(uint8_t* buffer, size_t buffer_size, const TelemetrySample* samples, size_t samples_count) {
+  if (samples_count == 0 || samples_count > UINT8_MAX || buffer_size < TELEMETRY_HEADER_SIZE) {
+    return 0;
+  }
+  uint8_t* cursor = put_u32(buffer, samples[0].timestamp_ms);
+  *cursor++ = samples_count;
+
+  uint32_t previous_timestamp_ms = samples[0].timestamp_ms;
+  for (size_t i = 0; i < samples_count; i++) {
+    if ((size_t)(cursor - buffer) + TELEMETRY_SAMPLE_MAX_SIZE > buffer_size) {
+      return 0;
+    }
+    cursor = put_varint(cursor, samples[i].timestamp_ms - previous_timestamp_ms);
+    cursor = put_f32(cursor, samples[i].waveform_jitter);
+    cursor = put_f32(cursor, samples[i].waveform_wander);
+    *cursor++ = (uint8_t)samples[i].rssi;
+    *cursor++ = samples[i].room_status;
+    previous_timestamp_ms = samples[i].timestamp_ms;
+  }
+  return cursor - buffer;
+}
+
+size_t mqtt_frame_encode_metrics(uint8_t* buffer, size_t buffer_size, const MetricsReport* report) {
+  if (buffer_size < METRICS_REPORT_SIZE) {
+    return 0;
+  }
+  uint8_t* cursor = put_u32(buffer, report->uptime_ms);
+  *cursor++ = METRICS_HISTOGRAMS_COUNT;
+  *cursor++ = METRICS_BUCKETS_COUNT;
+  *cursor++ = METRICS_COUNTERS_COUNT;
+  for (int i = 0; i < METRICS_HISTOGRAMS_COUNT; i++) {
+    for (int j = 0; j < METRICS_BUCKETS_COUNT; j++) {
+      cursor = put_u32(cursor, report->histograms[i].buckets[j]);
+    }
+    cursor = put_u32(cursor, report->histograms[i].max_us);
+  }
+  for (int i = 0; i < METRICS_COUNTERS_COUNT; i++) {
+    cursor = put_u32(cursor, report->counters[i]);
+  }
+  return cursor - buffer;
+}
+
+size_t mqtt_frame_encode_boot_timeline(uint8_t* buffer, size_t buffer_size, const BootTimeline* timeline) {
+  if (buffer_size < BOOT_TIMELINE_SIZE) {
+    return 0;
+  }
+  uint8_t* cursor = buffer;
+  *cursor++ = BOOT_STAGES_COUNT;
+  for (int i = 0; i < BOOT_STAGES_COUNT; i++) {
+    cursor = put_u32(cursor, timeline->stage_us[i]);
+  }
+  return cursor - buffer;
+}
+
+bool mqtt_frame_decode(const uint8_t* data, size_t size, MqttFrame* frame) {
+  if (size < MQTT_FRAME_HEADER_SIZE) {
+    return false;
+  }
+  if ((data[0] & 0xF0) == MQTT_FRAME_MARKER) {
+    frame->version = data[0] & 0x0F;
+    if (frame->version == 0 || frame->version > MQTT_FRAME_VERSION) {
+      return false;
+    }
+    frame->msg_id = data[1];
+    frame->payload = data + MQTT_FRAME_HEADER_SIZE;
+    frame->payload_size = size - MQTT_FRAME_HEADER_SIZE;
+    return frame->payload_size <= MQTT_FRAME_PAYLOAD_MAX_SIZE;
+  }
+  if (size == MQTT_FRAME_LEGACY_SIZE && !(data[0] & 0x80)) {
+    frame->version = 0;
+    frame->msg_id = data[0];
+    frame->payload = data + 1;
+    frame->payload_size = size - 1;
+    return true;
+  }
+  return false;
+}
+
+int mqtt_frame_decode_telemetry(const uint8_t* payload, size_t payload_size, TelemetrySample* samples, size_t max_samples) {
+  if (payload_size < TELEMETRY_HEADER_SIZE) {
+    return -1;
+  }
+  const uint8_t* end = payload + payload_size;
+  uint32_t timestamp_ms = get_u32(payload);
+  const size_t samples_count = payload[4];
+  if (samples_count > max_samples) {
+    return -1;
+  }
+
+  const uint8_t* cursor = payload + TELEMETRY_HEADER_SIZE;
+  for (size_t i = 0; i < samples_count; i++) {
+    uint32_t delta_ms;
+    cursor = get_varint(cursor, end, &delta_ms);
+    if (!cursor || end - cursor < 10) {
+      return -1;
+    }
+    timestamp_ms += delta_ms;
+    samples[i].timestamp_ms = timestamp_ms;
+    samples[i].waveform_jitter = get_f32(cursor);
+    samples[i].waveform_wander = get_f32(cursor + 4);
+    samples[i].rssi = (int8_t)cursor[8];
+    samples[i].room_status = cursor[9];
+    cursor += 10;
+  }
+  return cursor == end ? (int)samples_count : -1;
+}
+
+bool mqtt_frame_decode_metrics(const uint8_t* payload, size_t payload_size, MetricsReport* report) {
+  if (payload_size != METRICS_REPORT_SIZE || payload[4] != METRICS_HISTOGRAMS_COUNT || payload[5] != METRICS_BUCKETS_COUNT ||
+      payload[6] != METRICS_COUNTERS_COUNT) {
+    return false;
+  }
+  report->uptime_ms = get_u32(payload);
+  const uint8_t* cursor = payload + METRICS_HEADER_SIZE;
+  for (int i = 0; i < METRICS_HISTOGRAMS_COUNT; i++) {
+    for (int j = 0; j < METRICS_BUCKETS_COUNT; j++, cursor += 4) {
+      report->histograms[i].buckets[j] = get_u32(cursor);
+    }
+    report->histograms[i].max_us = get_u32(cursor);
+    cursor += 4;
+  }
+  for (int i = 0; i < METRICS_COUNTERS_COUNT; i++, cursor += 4) {
+    report->counters[i] = get_u32(cursor);
+  }
+  return true;
+}
+
+bool mqtt_frame_decode_boot_timeline(const uint8_t* payload, size_t payload_size, BootTimeline* timeline) {
+  if (payload_size != BOOT_TIMELINE_SIZE || payload[0] != BOOT_STAGES_COUNT) {
+    return false;
+  }
+  for (int i = 0; i < BOOT_STAGES_COUNT; i++) {
+    timeline->stage_us[i] = get_u32(payload + 1 + 4 * i);
+  }
+  return true;
+}
@@ -1,27 +1,44 @@
 #include <mqtt_handler.h>
 
+#include <boot_timeline.h>
+#include <csi_stream.h>
 #include <esp_event.h>
 #include <esp_log.h>
+#include <frame_bytes.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <mqtt_client.h>
+#include <mqtt_outbox.h>
+#include <pipeline_metrics.h>
 #include <proj_conf.h>
+#include <stdatomic.h>
+#include <telemetry.h>
+#include <trace_recorder.h>
 #include <wifi_radar.h>
 
 /* PRIVATE CONSTANTS */
 #define TAG "mqtt_handler"
 
-/* PRIVATE ENUMS */
-typedef enum {
-  MQTT_RX_MSG_START_CALIBRATION = 0x01,
-  MQTT_RX_MSG_STOP_CALIBRATION = 0x02,
-} MqttRxMessageId;
-
 /* GLOBAL VARIABLES */
 static esp_mqtt_client_handle_t g_mqtt_client = NULL;
+static atomic_bool g_mqtt_connected = false;
+/* Frames wait here while the broker is unreachable, esp-mqtt skips publishes
+ * while disconnected (CONFIG_MQTT_SKIP_PUBLISH_IF_DISCONNECTED) */
+static MqttOutbox g_outbox;
+static SemaphoreHandle_t g_outbox_mutex = NULL;
+static bool g_outbox_overflowing = false;
+static bool g_boot_timeline_sent = false;  // Guarded by g_outbox_mutex
 
 /* PRIVATE PROTOTYPES */
 static void handle_mqtt_events(void* args, esp_event_base_t event_base, int32_t event_id, void* event_data);
 static void log_mqtt_error_if_nonzero(const char* message, int error_code);
 static void handle_rx_data(esp_mqtt_event_handle_t event);
+static void publish_frame(const char* topic, MqttTxMessageId msg_id, const char* payload, size_t payload_size);
+static bool flush_outbox();
+static void publish_boot_timeline();
+static void queue_frame(MqttTxMessageId msg_id, const uint8_t* frame, size_t frame_size);
+static bool is_state_message(MqttTxMessageId msg_id);
+static const char* get_topic(MqttTxMessageId msg_id);
 
 /* FUNCTIONS */
 void init_mqtt_client() {
@@ -29,6 +46,8 @@ void init_mqtt_client() {
     esp_log_level_set(TAG, ESP_LOG_DEBUG);
   }
   ESP_LOGI(TAG, "Initialize MQTT client");
+  mqtt_outbox_init(&g_outbox);
+  g_outbox_mutex = xSemaphoreCreateMutex();
   esp_mqtt_client_config_t mqtt_conf = {
       .host = MQTT_HOST,
       .port = MQTT_PORT,
@@ -39,28 +58,116 @@ void init_mqtt_client() {
   };
   g_mqtt_client = esp_mqtt_client_init(&mqtt_conf);
   ESP_ERROR_CHECK(esp_mqtt_client_register_event(g_mqtt_client, ESP_EVENT_ANY_ID, handle_mqtt_events, NULL));
+}
+
+/* esp-mqtt waits its whole reconnect timeout after a failed first attempt, so it's only started with an IP */
+void start_mqtt_client() {
   ESP_ERROR_CHECK(esp_mqtt_client_start(g_mqtt_client));
   ESP_LOGI(TAG, "Started MQTT client");
 }
 
-void send_mqtt_msg(MqttTxMessageId msg_id, const char* payload, uint8_t payload_size) {
+void send_mqtt_msg(MqttTxMessageId msg_id, const char* payload, size_t payload_size) {
+  publish_frame(MQTT_TX_TOPIC, msg_id, payload, payload_size);
+}
+
+/* Separate topic, so that status subscribers don't wake up for metrics */
+void send_mqtt_metrics(const char* payload, size_t payload_size) {
+  publish_frame(MQTT_METRICS_TOPIC, MQTT_TX_MSG_METRICS, payload, payload_size);
+}
+
+/* Waiting frames go first, so subscribers get them in order */
+static void publish_frame(const char* topic, MqttTxMessageId msg_id, const char* payload, size_t payload_size) {
   if (!g_mqtt_client) {
     ESP_LOGW(TAG, "Can't send MQTT message cause client doesn't exist");
     return;
   }
 
-  if (payload_size > MQTT_PAYLOAD_MAX_SIZE) {
-    ESP_LOGW(TAG, " MQTT message payload size is bigger than expected");
+  if (payload_size > MQTT_FRAME_PAYLOAD_MAX_SIZE) {
+    ESP_LOGW(TAG, "MQTT message payload size is bigger than expected");
     return;
   }
 
-  char buffer[MQTT_MSG_SIZE] = {0};
-  buffer[0] = msg_id;
-  memcpy(buffer + 1, payload, payload_size);
+  uint8_t buffer[MQTT_FRAME_HEADER_SIZE + payload_size];
+  const size_t frame_size = mqtt_frame_encode(buffer, sizeof(buffer), msg_id, payload, payload_size);
+
+  xSemaphoreTake(g_outbox_mutex, portMAX_DELAY);
+  if (!atomic_load(&g_mqtt_connected) || !flush_outbox() ||
+      esp_mqtt_client_publish(g_mqtt_client, topic, (const char*)buffer, frame_size, 0, 0) < 0) {
+    queue_frame(msg_id, buffer, frame_size);
+  } else if (msg_id == MQTT_TX_MSG_ROOM_STATUS) {
+    mark_boot_stage(BOOT_STAGE_FIRST_STATUS);
+  }
+  publish_boot_timeline();
+  xSemaphoreGive(g_outbox_mutex);
+}
+
+/* Returns false if a frame couldn't be published, it stays first in the outbox */
+static bool flush_outbox() {
+  uint8_t msg_id;
+  const uint8_t* frame;
+  size_t frame_size;
+  while ((frame_size = mqtt_outbox_peek(&g_outbox, &msg_id, &frame)) > 0) {
+    if (esp_mqtt_client_publish(g_mqtt_client, get_topic(msg_id), (const char*)frame, frame_size, 0, 0) < 0) {
+      return false;
+    }
+    if (msg_id == MQTT_TX_MSG_ROOM_STATUS) {
+      mark_boot_stage(BOOT_STAGE_FIRST_STATUS);
+    }
+    mqtt_outbox_pop(&g_outbox);
+  }
+  g_outbox_overflowing = false;
+  return true;
+}
 
-  if (esp_mqtt_client_publish(g_mqtt_client, MQTT_TX_TOPIC, buffer, MQTT_MSG_SIZE, 0, 0) < 0) {
-    ESP_LOGW(TAG, "Couldn't publish MQTT message");
+/* Once, as soon as the first room status went out. Called with g_outbox_mutex taken. */
+static void publish_boot_timeline() {
+  if (g_boot_timeline_sent || !is_boot_stage_reached(BOOT_STAGE_FIRST_STATUS)) {
+    return;
   }
+  g_boot_timeline_sent = true;
+  BootTimeline timeline;
+  get_boot_timeline(&timeline);
+  uint8_t payload[BOOT_TIMELINE_SIZE];
+  const size_t payload_size = mqtt_frame_encode_boot_timeline(payload, sizeof(payload), &timeline);
+  uint8_t buffer[MQTT_FRAME_HEADER_SIZE + BOOT_TIMELINE_SIZE];
+  const size_t frame_size = mqtt_frame_encode(buffer, sizeof(buffer), MQTT_TX_MSG_BOOT_TIMELINE, payload, payload_size);
+  if (!atomic_load(&g_mqtt_connected) ||
+      esp_mqtt_client_publish(g_mqtt_client, MQTT_TX_TOPIC, (const char*)buffer, frame_size, 0, 0) < 0) {
+    queue_frame(MQTT_TX_MSG_BOOT_TIMELINE, buffer, frame_size);
+  }
+  ESP_LOGI(TAG, "Boot took %u ms to the first room status", timeline.stage_us[BOOT_STAGE_FIRST_STATUS] / 1000);
+}
+
+static void queue_frame(MqttTxMessageId msg_id, const uint8_t* frame, size_t frame_size) {
+  const uint32_t evicted_count = g_outbox.evicted_count;
+  if (is_state_message(msg_id)) {
+    mqtt_outbox_push_state(&g_outbox, msg_id, frame, frame_size);
+  } else {
+    mqtt_outbox_push(&g_outbox, msg_id, frame, frame_size);
+  }
+  set_pipeline_counter(METRICS_OUTBOX_EVICTIONS, g_outbox.evicted_count);
+  set_pipeline_counter(METRICS_OUTBOX_COALESCED, g_outbox.coalesced_count);
+  if (g_outbox.evicted_count != evicted_count && !g_outbox_overflowing) {
+    ESP_LOGW(TAG, "MQTT outbox is full, dropping the oldest messages");
+    g_outbox_overflowing = true;
+  }
+}
+
+/* Only the latest one matters, the ones in between can go */
+static bool is_state_message(MqttTxMessageId msg_id) {
+  switch (msg_id) {
+    case MQTT_TX_MSG_ROOM_STATUS:
+    case MQTT_TX_MSG_DETECTION_THRESHOLD:
+    case MQTT_TX_MSG_SAMPLE_RATE:
+    case MQTT_TX_MSG_METRICS:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static const char* get_topic(MqttTxMessageId msg_id) {
+  return msg_id == MQTT_TX_MSG_METRICS ? MQTT_METRICS_TOPIC : MQTT_TX_TOPIC;
 }
 
 static void handle_mqtt_events(void* args, esp_event_base_t event_base, int32_t event_id, void* event_data) {
@@ -69,11 +176,22 @@ static void handle_mqtt_events(void* args, esp_event_base_t event_base, int32_t
   switch (event_id) {
     case MQTT_EVENT_CONNECTED:
       ESP_LOGI(TAG, "MQTT connected");
+      mark_boot_stage(BOOT_STAGE_MQTT_CONNECTED);
       esp_mqtt_client_subscribe(client, MQTT_RX_TOPIC, 0);
+      atomic_store(&g_mqtt_connected, true);
+      // The client stays locked while its events are handled, so only try. A publisher holding the
+      // outbox flushes it itself once it gets the client.
+      if (xSemaphoreTake(g_outbox_mutex, 0) == pdTRUE) {
+        if (flush_outbox()) {
+          publish_boot_timeline();
+        }
+        xSemaphoreGive(g_outbox_mutex);
+      }
       break;
 
     case MQTT_EVENT_DISCONNECTED:
       ESP_LOGI(TAG, "MQTT disconnected");
+      atomic_store(&g_mqtt_connected, false);
       break;
 
     case MQTT_EVENT_SUBSCRIBED:
@@ -121,6 +239,34 @@ static void handle_rx_data(esp_mqtt_event_handle_t event) {
     case MQTT_RX_MSG_STOP_CALIBRATION:
       stop_wifi_radar_calibration();
       break;
+    case MQTT_RX_MSG_START_TELEMETRY:
+      start_telemetry();
+      break;
+    case MQTT_RX_MSG_STOP_TELEMETRY:
+      stop_telemetry();
+      break;
+    case MQTT_RX_MSG_START_CSI_STREAM:
+      start_csi_stream();
+      break;
+    case MQTT_RX_MSG_STOP_CSI_STREAM:
+      stop_csi_stream();
+      break;
+    case MQTT_RX_MSG_SELECT_PROFILE:
+      select_wifi_radar_profile(event->data + 1, event->data_len - 1);
+      break;
+    case MQTT_RX_MSG_SEND_TRACE:
+      if (event->data_len >= 9) {
+        send_trace(get_u32((const uint8_t*)event->data + 1), get_u32((const uint8_t*)event->data + 5));
+      } else {
+        send_trace(0, 0);
+      }
+      break;
+    case MQTT_RX_MSG_LOAD_MODEL:
+      load_wifi_radar_model((const uint8_t*)event->data + 1, event->data_len - 1);
+      break;
+    case MQTT_RX_MSG_SELECT_DETECTOR:
+      select_wifi_radar_detector(event->data + 1, event->data_len - 1);
+      break;
     default:
       ESP_LOGW(TAG, "Received unexpected MQTT message: %.*s; Message ID = %d", event->data_len, event->data, rx_message_id);
       break;
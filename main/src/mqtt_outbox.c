@@ -0,0 +1,150 @@
+#include <mqtt_outbox.h>
+
+#include <frame_bytes.h>
+#include <string.h>
+
+/* PRIVATE CONSTANTS */
+#define RECORD_HEADER_SIZE 4
+#define RECORD_ALIGNMENT   4
+#define FLAG_PADDING       0x01  // Fills the ring up to its end
+
+_Static_assert(MQTT_OUTBOX_SIZE % RECORD_ALIGNMENT == 0 && MQTT_OUTBOX_SIZE <= UINT16_MAX,
+               "MQTT_OUTBOX_SIZE must be aligned and fit the offsets");
+
+/* PRIVATE PROTOTYPES */
+static MqttOutboxState* find_state(MqttOutbox* outbox, uint8_t msg_id);
+static size_t get_record_size(size_t frame_size);
+static bool reserve(MqttOutbox* outbox, size_t record_size, uint16_t* offset);
+static void pop_record(MqttOutbox* outbox);
+
+/* FUNCTIONS */
+void mqtt_outbox_init(MqttOutbox* outbox) {
+  memset(outbox, 0, sizeof(MqttOutbox));
+}
+
+bool mqtt_outbox_push(MqttOutbox* outbox, uint8_t msg_id, const uint8_t* frame, size_t frame_size) {
+  const size_t record_size = get_record_size(frame_size);
+  if (record_size > MQTT_OUTBOX_SIZE) {
+    return false;
+  }
+  uint16_t offset;
+  while (!reserve(outbox, record_size, &offset)) {
+    if (outbox->bytes[outbox->head + 3] == 0) {
+      outbox->evicted_count++;
+    }
+    pop_record(outbox);
+  }
+  uint8_t* record = outbox->bytes + offset;
+  put_u16(record, frame_size);
+  record[2] = msg_id;
+  record[3] = 0;
+  memcpy(record + RECORD_HEADER_SIZE, frame, frame_size);
+  return true;
+}
+
+bool mqtt_outbox_push_state(MqttOutbox* outbox, uint8_t msg_id, const uint8_t* frame, size_t frame_size) {
+  MqttOutboxState* state = frame_size <= MQTT_OUTBOX_STATE_MAX_SIZE ? find_state(outbox, msg_id) : NULL;
+  if (!state) {
+    return mqtt_outbox_push(outbox, msg_id, frame, frame_size);
+  }
+  if (state->size > 0) {
+    outbox->coalesced_count++;
+  }
+  state->msg_id = msg_id;
+  state->size = frame_size;
+  memcpy(state->frame, frame, frame_size);
+  return true;
+}
+
+size_t mqtt_outbox_peek(const MqttOutbox* outbox, uint8_t* msg_id, const uint8_t** frame) {
+  for (int i = 0; i < MQTT_OUTBOX_STATE_SLOTS; i++) {
+    if (outbox->states[i].size > 0) {
+      *msg_id = outbox->states[i].msg_id;
+      *frame = outbox->states[i].frame;
+      return outbox->states[i].size;
+    }
+  }
+  uint16_t head = outbox->head;
+  for (uint16_t used = outbox->used; used > 0; used -= MQTT_OUTBOX_SIZE - head, head = 0) {
+    const uint8_t* record = outbox->bytes + head;
+    if (!(record[3] & FLAG_PADDING)) {
+      *msg_id = record[2];
+      *frame = record + RECORD_HEADER_SIZE;
+      return get_u16(record);
+    }
+  }
+  return 0;
+}
+
+void mqtt_outbox_pop(MqttOutbox* outbox) {
+  for (int i = 0; i < MQTT_OUTBOX_STATE_SLOTS; i++) {
+    if (outbox->states[i].size > 0) {
+      outbox->states[i].size = 0;
+      return;
+    }
+  }
+  if (outbox->used > 0 && outbox->bytes[outbox->head + 3] & FLAG_PADDING) {
+    pop_record(outbox);
+  }
+  pop_record(outbox);
+}
+
+/* The slot of the message, or else a free one */
+static MqttOutboxState* find_state(MqttOutbox* outbox, uint8_t msg_id) {
+  MqttOutboxState* free_state = NULL;
+  for (int i = 0; i < MQTT_OUTBOX_STATE_SLOTS; i++) {
+    MqttOutboxState* state = &outbox->states[i];
+    if (state->size > 0 && state->msg_id == msg_id) {
+      return state;
+    }
+    if (state->size == 0 && !free_state) {
+      free_state = state;
+    }
+  }
+  return free_state;
+}
+
+static size_t get_record_size(size_t frame_size) {
+  return (RECORD_HEADER_SIZE + frame_size + RECORD_ALIGNMENT - 1) & ~(size_t)(RECORD_ALIGNMENT - 1);
+}
+
+/* Free space is either after the tail up to the end and before the head, or between the tail and the head */
+static bool reserve(MqttOutbox* outbox, size_t record_size, uint16_t* offset) {
+  if (outbox->used == 0) {
+    outbox->head = 0;
+    outbox->tail = 0;
+  } else if (outbox->used == MQTT_OUTBOX_SIZE) {
+    return false;
+  }
+
+  if (outbox->tail >= outbox->head) {
+    if (MQTT_OUTBOX_SIZE - outbox->tail < record_size) {
+      if (outbox->head < record_size) {
+        return false;
+      }
+      uint8_t* padding = outbox->bytes + outbox->tail;
+      put_u16(padding, 0);
+      padding[2] = 0;
+      padding[3] = FLAG_PADDING;
+      outbox->used += MQTT_OUTBOX_SIZE - outbox->tail;
+      outbox->tail = 0;
+    }
+  } else if (outbox->head - outbox->tail < record_size) {
+    return false;
+  }
+
+  *offset = outbox->tail;
+  outbox->used += record_size;
+  outbox->tail = (outbox->tail + record_size) % MQTT_OUTBOX_SIZE;
+  return true;
+}
+
+static void pop_record(MqttOutbox* outbox) {
+  if (outbox->used == 0) {
+    return;
+  }
+  const uint8_t* record = outbox->bytes + outbox->head;
+  const size_t size = record[3] & FLAG_PADDING ? MQTT_OUTBOX_SIZE - outbox->head : get_record_size(get_u16(record));
+  outbox->used -= size;
+  outbox->head = (outbox->head + size) % MQTT_OUTBOX_SIZE;
+}
@@ -2,14 +2,22 @@
 
 #include <esp_log.h>
 #include <lwip/inet.h>
+#include <pipeline_metrics.h>
 #include <ping/ping_sock.h>
 #include <proj_conf.h>
+#include <stdatomic.h>
 #include <wifi_handler.h>
 
 /* PRIVATE CONSTANTS */
 #define TAG "ping_handler"
 
+/* GLOBAL VARIABLES */
+static esp_ping_handle_t g_ping_handle = NULL;
+static uint32_t g_ping_interval_ms = GATEWAY_PING_INTERVAL_MS;
+static atomic_bool g_ping_started = false;  // Read by the radar processing task
+
 /* PRIVATE PROTOTYPES */
+static void start_ping_session();
 static void handle_ping_success(esp_ping_handle_t handle, void* args);
 static void handle_ping_timeout(esp_ping_handle_t handle, void* args);
 static void handle_ping_end(esp_ping_handle_t handle, void* args);
@@ -20,9 +28,36 @@ void init_gateway_ping() {
     esp_log_level_set(TAG, ESP_LOG_DEBUG);
   }
   ESP_LOGI(TAG, "Initialize gateway ping");
+  start_ping_session();
+  atomic_store(&g_ping_started, true);
+  ESP_LOGI(TAG, "Started gateway ping");
+}
+
+void set_gateway_ping_interval(uint32_t interval_ms) {
+  if (interval_ms == g_ping_interval_ms) {
+    return;
+  }
+  g_ping_interval_ms = interval_ms;
+  if (!atomic_load(&g_ping_started)) {
+    return;
+  }
+  ESP_ERROR_CHECK(esp_ping_stop(g_ping_handle));
+  ESP_ERROR_CHECK(esp_ping_delete_session(g_ping_handle));
+  start_ping_session();
+  ESP_LOGI(TAG, "Gateway ping interval is %u ms", interval_ms);
+}
 
+uint32_t get_gateway_ping_interval() {
+  return g_ping_interval_ms;
+}
+
+bool is_gateway_ping_started() {
+  return atomic_load(&g_ping_started);
+}
+
+static void start_ping_session() {
   esp_ping_config_t ping_conf = ESP_PING_DEFAULT_CONFIG();
-  ping_conf.interval_ms = GATEWAY_PING_INTERVAL_MS;
+  ping_conf.interval_ms = g_ping_interval_ms;
   ping_conf.target_addr.u_addr.ip4.addr = get_gateway_ip().addr;
   ping_conf.target_addr.type = IPADDR_TYPE_V4;
   ping_conf.count = ESP_PING_COUNT_INFINITE;
@@ -33,11 +68,8 @@ void init_gateway_ping() {
       .on_ping_end = handle_ping_end,
   };
 
-  esp_ping_handle_t ping_handle;
-  ESP_ERROR_CHECK(esp_ping_new_session(&ping_conf, &callbacks, &ping_handle));
-  ESP_ERROR_CHECK(esp_ping_start(ping_handle));
-
-  ESP_LOGI(TAG, "Started gateway ping");
+  ESP_ERROR_CHECK(esp_ping_new_session(&ping_conf, &callbacks, &g_ping_handle));
+  ESP_ERROR_CHECK(esp_ping_start(g_ping_handle));
 }
 
 static void handle_ping_success(esp_ping_handle_t handle, void* args) {
@@ -49,6 +81,7 @@ static void handle_ping_success(esp_ping_handle_t handle, void* args) {
 static void handle_ping_timeout(esp_ping_handle_t handle, void* args) {
   ip_addr_t target_addr;
   esp_ping_get_profile(handle, ESP_PING_PROF_IPADDR, &target_addr, sizeof(target_addr));
+  count_pipeline_event(METRICS_PING_TIMEOUTS);
   ESP_LOGW(TAG, "Ping timeout: %s", inet_ntoa(target_addr.u_addr.ip4));
 }
 
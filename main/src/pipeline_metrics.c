@@ -0,0 +1,92 @@
+#include <pipeline_metrics.h>
+
+#if PIPELINE_METRICS_ENABLED
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <mqtt_handler.h>
+#include <single_writer.h>
+#include <stdatomic.h>
+
+/* PRIVATE CONSTANTS */
+#define TAG "pipeline_metrics"
+
+#define TASK_SEND_METRICS_STACK_SIZE 4096
+#define FIRST_BUCKET_SHIFT           4  // Bucket 0 ends at 16 us
+
+/* PRIVATE TYPES */
+typedef struct {
+  atomic_uint_least32_t buckets[METRICS_BUCKETS_COUNT];
+  atomic_uint_least32_t max_us;
+} AtomicHistogram;
+
+/* GLOBAL VARIABLES */
+static AtomicHistogram g_histograms[METRICS_HISTOGRAMS_COUNT] = {0};
+static atomic_uint_least32_t g_counters[METRICS_COUNTERS_COUNT] = {0};
+static uint8_t g_payload[METRICS_REPORT_SIZE];
+
+/* PRIVATE PROTOTYPES */
+static void send_pipeline_metrics(void* arg);
+static int get_bucket(uint32_t latency_us);
+
+/* FUNCTIONS */
+void init_pipeline_metrics() {
+  if (DEBUG_LOG_ENABLED) {
+    esp_log_level_set(TAG, ESP_LOG_DEBUG);
+  }
+  xTaskCreate(send_pipeline_metrics, "send_metrics", TASK_SEND_METRICS_STACK_SIZE, NULL, 0, NULL);
+}
+
+uint32_t get_pipeline_time_us() {
+  return esp_timer_get_time();
+}
+
+/* Every histogram has a single writer, so the maximum needs no compare-and-swap either */
+void add_pipeline_latency(MetricsHistogramId histogram, uint32_t started_us) {
+  AtomicHistogram* target = &g_histograms[histogram];
+  const uint32_t latency_us = get_pipeline_time_us() - started_us;
+  single_writer_add(&target->buckets[get_bucket(latency_us)], 1);
+  if (latency_us > atomic_load_explicit(&target->max_us, memory_order_relaxed)) {
+    atomic_store_explicit(&target->max_us, latency_us, memory_order_relaxed);
+  }
+}
+
+void count_pipeline_event(MetricsCounterId counter) {
+  single_writer_add(&g_counters[counter], 1);
+}
+
+void set_pipeline_counter(MetricsCounterId counter, uint32_t value) {
+  atomic_store_explicit(&g_counters[counter], value, memory_order_relaxed);
+}
+
+/* Values are read one by one while the stages go on, so a report may be a
+ * sample or two off between histograms, but never goes back in time */
+static void send_pipeline_metrics(void* arg) {
+  MetricsReport report;
+  while (true) {
+    vTaskDelay(pdMS_TO_TICKS(PIPELINE_METRICS_INTERVAL_MS));
+    report.uptime_ms = esp_timer_get_time() / 1000;
+    for (int i = 0; i < METRICS_HISTOGRAMS_COUNT; i++) {
+      for (int j = 0; j < METRICS_BUCKETS_COUNT; j++) {
+        report.histograms[i].buckets[j] = atomic_load_explicit(&g_histograms[i].buckets[j], memory_order_relaxed);
+      }
+      report.histograms[i].max_us = atomic_load_explicit(&g_histograms[i].max_us, memory_order_relaxed);
+    }
+    for (int i = 0; i < METRICS_COUNTERS_COUNT; i++) {
+      report.counters[i] = atomic_load_explicit(&g_counters[i], memory_order_relaxed);
+    }
+    const size_t payload_size = mqtt_frame_encode_metrics(g_payload, sizeof(g_payload), &report);
+    send_mqtt_metrics((const char*)g_payload, payload_size);
+    ESP_LOGD(TAG, "Sent pipeline metrics, end-to-end max %u us", report.histograms[METRICS_END_TO_END].max_us);
+  }
+}
+
+static int get_bucket(uint32_t latency_us) {
+  const uint32_t scaled = latency_us >> FIRST_BUCKET_SHIFT;
+  const int bucket = scaled ? 32 - __builtin_clz(scaled) : 0;
+  return bucket < METRICS_BUCKETS_COUNT ? bucket : METRICS_BUCKETS_COUNT - 1;
+}
+
+#endif
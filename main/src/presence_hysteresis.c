@@ -0,0 +1,40 @@
+#include <presence_hysteresis.h>
+
+/* FUNCTIONS */
+void presence_hysteresis_init(PresenceHysteresis* hysteresis, uint32_t enter_hold_ms, uint8_t enter_count,
+                              uint32_t exit_hold_ms, uint8_t exit_count) {
+  *hysteresis = (PresenceHysteresis){
+      .enter_hold_ms = enter_hold_ms,
+      .exit_hold_ms = exit_hold_ms,
+      .enter_count = enter_count,
+      .exit_count = exit_count,
+  };
+}
+
+bool presence_hysteresis_push(PresenceHysteresis* hysteresis, bool movement, uint32_t timestamp_ms) {
+  if (movement == hysteresis->present) {
+    hysteresis->pending_count = 0;
+    return hysteresis->present;
+  }
+  if (hysteresis->pending_count == 0) {
+    hysteresis->pending_since_ms = timestamp_ms;
+  }
+  if (hysteresis->pending_count < UINT8_MAX) {
+    hysteresis->pending_count++;
+  }
+  return presence_hysteresis_update(hysteresis, timestamp_ms);
+}
+
+bool presence_hysteresis_update(PresenceHysteresis* hysteresis, uint32_t now_ms) {
+  if (hysteresis->pending_count == 0) {
+    return hysteresis->present;
+  }
+  const uint8_t count = hysteresis->present ? hysteresis->exit_count : hysteresis->enter_count;
+  const uint32_t hold_ms = hysteresis->present ? hysteresis->exit_hold_ms : hysteresis->enter_hold_ms;
+  // Signed, so a time from before the pending change doesn't wrap around
+  if (hysteresis->pending_count >= count && (int32_t)(now_ms - hysteresis->pending_since_ms) >= (int32_t)hold_ms) {
+    hysteresis->present = !hysteresis->present;
+    hysteresis->pending_count = 0;
+  }
+  return hysteresis->present;
+}
@@ -0,0 +1,46 @@
+#include <radar_mailbox.h>
+
+#include <calibration.h>
+#include <single_writer.h>
+#include <string.h>
+
+/* PRIVATE CONSTANTS */
+#define INDEX_MASK (RADAR_MAILBOX_CAPACITY - 1)
+
+_Static_assert((RADAR_MAILBOX_CAPACITY & INDEX_MASK) == 0, "RADAR_MAILBOX_CAPACITY must be a power of 2");
+_Static_assert(RADAR_COMMAND_DATA_SIZE >= CALIBRATION_PROFILE_MAX_SIZE, "A profile name must fit into a command");
+
+/* FUNCTIONS */
+/* Same scheme as the sample ring, but a full mailbox refuses new commands
+ * rather than losing old ones, so they are applied in the order they were sent */
+bool radar_mailbox_push(RadarMailbox* mailbox, RadarCommandType type, const void* data, size_t size) {
+  const uint32_t head = atomic_load_explicit(&mailbox->head, memory_order_relaxed);
+  const uint32_t tail = atomic_load_explicit(&mailbox->tail, memory_order_acquire);
+  if (head - tail == RADAR_MAILBOX_CAPACITY || size > RADAR_COMMAND_DATA_SIZE) {
+    single_writer_add(&mailbox->dropped_count, 1);
+    return false;
+  }
+  RadarCommand* command = &mailbox->commands[head & INDEX_MASK];
+  command->type = type;
+  command->size = size;
+  if (size > 0) {
+    memcpy(command->data, data, size);
+  }
+  atomic_store_explicit(&mailbox->head, head + 1, memory_order_release);
+  return true;
+}
+
+bool radar_mailbox_pop(RadarMailbox* mailbox, RadarCommand* command) {
+  const uint32_t tail = atomic_load_explicit(&mailbox->tail, memory_order_relaxed);
+  const uint32_t head = atomic_load_explicit(&mailbox->head, memory_order_acquire);
+  if (head == tail) {
+    return false;
+  }
+  *command = mailbox->commands[tail & INDEX_MASK];
+  atomic_store_explicit(&mailbox->tail, tail + 1, memory_order_release);
+  return true;
+}
+
+uint32_t radar_mailbox_dropped_count(const RadarMailbox* mailbox) {
+  return atomic_load_explicit(&mailbox->dropped_count, memory_order_relaxed);
+}
@@ -0,0 +1,112 @@
+#include <room_detector.h>
+
+#include <math.h>
+#include <proj_conf.h>
+
+/* PRIVATE CONSTANTS */
+#define WINDOW_SIZE       10
+#define NEEDED_DETECTIONS 2
+#define LINK_MAX_AGE_MS   2000
+
+/* FUNCTIONS */
+void room_detector_get_default_config(RoomDetectorConfig* config) {
+  *config = (RoomDetectorConfig){
+      .window_size = WINDOW_SIZE,
+      .needed_detections = NEEDED_DETECTIONS,
+      .threshold_margin = CALIBRATION_THRESHOLD_MARGIN,
+      .link_max_age_ms = LINK_MAX_AGE_MS,
+      .min_links = LINK_FUSION_MIN_LINKS,
+      .enter_hold_ms = PRESENCE_ENTER_HOLD_MS,
+      .enter_count = PRESENCE_ENTER_COUNT,
+      .exit_hold_ms = PRESENCE_EXIT_HOLD_MS,
+      .exit_count = PRESENCE_EXIT_COUNT,
+      .breathing_share_percent = BREATHING_DETECTION_ENABLED ? BREATHING_BAND_SHARE_PERCENT : 0,
+      .variant = NULL,
+  };
+}
+
+void room_detector_init(RoomDetector* detector, const RoomDetectorConfig* config) {
+  detector->config = *config;
+  detector->threshold = (wifi_radar_info_t){0};
+  detector->calibrating = false;
+  link_detectors_init(&detector->links, config->window_size, config->needed_detections, config->threshold_margin);
+  link_detectors_set_variant(&detector->links, config->variant);
+  presence_hysteresis_init(&detector->presence, config->enter_hold_ms, config->enter_count, config->exit_hold_ms,
+                           config->exit_count);
+  breathing_detector_init(&detector->breathing, config->breathing_share_percent);
+}
+
+void room_detector_set_variant(RoomDetector* detector, const DetectorVariant* variant) {
+  detector->config.variant = variant;
+  link_detectors_set_variant(&detector->links, variant);
+  detector->presence.pending_count = 0;
+}
+
+void room_detector_set_thresholds(RoomDetector* detector, const wifi_radar_info_t* threshold, const LinkThreshold* links,
+                                  size_t links_count, uint32_t now_ms) {
+  detector->threshold = *threshold;
+  link_detectors_reset(&detector->links, threshold);
+  breathing_detector_reset(&detector->breathing);
+  for (size_t i = 0; i < links_count; i++) {
+    link_detectors_set_threshold(&detector->links, &links[i], now_ms);
+  }
+}
+
+void room_detector_begin_calibration(RoomDetector* detector) {
+  link_detectors_begin_calibration(&detector->links);
+  breathing_detector_reset(&detector->breathing);
+  detector->calibrating = true;
+}
+
+size_t room_detector_finish_calibration(RoomDetector* detector, wifi_radar_info_t* threshold, LinkThreshold* links) {
+  detector->calibrating = false;
+  const size_t links_count = link_detectors_finish_calibration(&detector->links, detector->config.threshold_margin, links);
+  *threshold = (wifi_radar_info_t){0};
+  for (size_t i = 0; i < links_count; i++) {
+    threshold->waveform_jitter = fmaxf(threshold->waveform_jitter, links[i].threshold.waveform_jitter);
+    threshold->waveform_wander = fmaxf(threshold->waveform_wander, links[i].threshold.waveform_wander);
+  }
+  return links_count;
+}
+
+bool room_detector_push(RoomDetector* detector, const wifi_radar_info_t* info, const uint8_t* mac, uint32_t timestamp_ms) {
+  LinkDetector* link = link_detectors_get(&detector->links, mac, timestamp_ms);
+  if (detector->calibrating) {
+    link_detector_calibrate(link, info);
+    return false;
+  }
+  if (detector->threshold.waveform_jitter == 0) {
+    return false;
+  }
+  if (detector->presence.present) {
+    // Movement swamps the band, and its end would look like one slow breath
+    breathing_detector_reset(&detector->breathing);
+  } else if (detector->config.breathing_share_percent > 0) {
+    breathing_detector_push(&detector->breathing, info, &link->threshold, timestamp_ms);
+  }
+  const bool room_empty = !detector->presence.present && !detector->breathing.present;
+  if (!link_detector_push(&detector->links, link, info, room_empty)) {
+    return link->motion_detected;
+  }
+
+  const uint8_t detecting_links =
+      link_detectors_count_detecting(&detector->links, timestamp_ms, detector->config.link_max_age_ms);
+  const bool movement = detecting_links >= detector->config.min_links;
+  if (detector->config.variant) {
+    detector->config.variant->push_presence(&detector->presence, movement, timestamp_ms);
+  } else {
+    presence_hysteresis_push(&detector->presence, movement, timestamp_ms);
+  }
+  return link->motion_detected;
+}
+
+bool room_detector_update(RoomDetector* detector, uint32_t now_ms) {
+  if (detector->config.variant) {
+    return detector->config.variant->update_presence(&detector->presence, now_ms);
+  }
+  return presence_hysteresis_update(&detector->presence, now_ms);
+}
+
+bool room_detector_is_stationary(const RoomDetector* detector) {
+  return detector->breathing.present && !detector->presence.present;
+}
@@ -0,0 +1,56 @@
+#include <sample_rate.h>
+
+/* FUNCTIONS */
+void sample_rate_init(SampleRateController* controller, uint32_t min_interval_ms, uint32_t max_interval_ms, uint32_t stable_ms, uint32_t now_ms) {
+  *controller = (SampleRateController){
+      .min_interval_ms = min_interval_ms,
+      .max_interval_ms = max_interval_ms,
+      .stable_ms = stable_ms,
+      .interval_ms = min_interval_ms,
+      .period_started_ms = now_ms,
+      .stable_since_ms = now_ms,
+  };
+}
+
+void sample_rate_add_csi_frames(SampleRateController* controller, uint32_t count) {
+  controller->period_csi_frames += count;
+}
+
+void sample_rate_add_sample(SampleRateController* controller, bool motion_detected) {
+  controller->period_samples++;
+  controller->period_detections += motion_detected;
+}
+
+bool sample_rate_update(SampleRateController* controller, uint32_t now_ms, bool room_stable) {
+  const uint32_t elapsed_ms = now_ms - controller->period_started_ms;
+  if (elapsed_ms < SAMPLE_RATE_PERIOD_MS) {
+    return false;
+  }
+  controller->csi_rate_hz = controller->period_csi_frames * 1000.0f / elapsed_ms;
+  controller->sample_rate_hz = controller->period_samples * 1000.0f / elapsed_ms;
+
+  uint32_t interval_ms = controller->interval_ms;
+  if (!room_stable || controller->period_detections >= SAMPLE_RATE_UNCERTAIN_DETECTIONS) {
+    interval_ms = controller->min_interval_ms;
+    controller->stable_since_ms = now_ms;
+  } else if (now_ms - controller->stable_since_ms >= controller->stable_ms) {
+    interval_ms *= 2;
+    controller->stable_since_ms = now_ms;
+  }
+
+  // Arrivals at less than half of the requested rate mean the AP can't keep up.
+  // Samples count too, for radars that hand over samples without CSI.
+  const uint32_t arrivals = controller->period_csi_frames > controller->period_samples ? controller->period_csi_frames : controller->period_samples;
+  if (arrivals * controller->interval_ms * 2 < elapsed_ms) {
+    const uint32_t arrival_interval_ms = arrivals ? elapsed_ms / arrivals : controller->max_interval_ms;
+    interval_ms = arrival_interval_ms > interval_ms ? arrival_interval_ms : interval_ms;
+  }
+  interval_ms = interval_ms < controller->min_interval_ms ? controller->min_interval_ms : interval_ms;
+  controller->interval_ms = interval_ms > controller->max_interval_ms ? controller->max_interval_ms : interval_ms;
+
+  controller->period_started_ms = now_ms;
+  controller->period_csi_frames = 0;
+  controller->period_samples = 0;
+  controller->period_detections = 0;
+  return true;
+}
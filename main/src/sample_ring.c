@@ -0,0 +1,44 @@
+#include <sample_ring.h>
+
+#include <single_writer.h>
+
+/* PRIVATE CONSTANTS */
+#define INDEX_MASK (SAMPLE_RING_CAPACITY - 1)
+
+_Static_assert((SAMPLE_RING_CAPACITY & INDEX_MASK) == 0, "SAMPLE_RING_CAPACITY must be a power of 2");
+
+/* FUNCTIONS */
+/* Indexes run freely and wrap around, so head - tail is always the fill level */
+bool sample_ring_push(SampleRing* ring, const RadarSample* sample) {
+  const uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head - tail == SAMPLE_RING_CAPACITY) {
+    single_writer_add(&ring->overflow_count, 1);
+    return false;
+  }
+  ring->samples[head & INDEX_MASK] = *sample;
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  if (head + 1 - tail > atomic_load_explicit(&ring->high_water, memory_order_relaxed)) {
+    atomic_store_explicit(&ring->high_water, head + 1 - tail, memory_order_relaxed);
+  }
+  return true;
+}
+
+bool sample_ring_pop(SampleRing* ring, RadarSample* sample) {
+  const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  const uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (head == tail) {
+    return false;
+  }
+  *sample = ring->samples[tail & INDEX_MASK];
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+  return true;
+}
+
+uint32_t sample_ring_overflow_count(const SampleRing* ring) {
+  return atomic_load_explicit(&ring->overflow_count, memory_order_relaxed);
+}
+
+uint32_t sample_ring_high_water(const SampleRing* ring) {
+  return atomic_load_explicit(&ring->high_water, memory_order_relaxed);
+}
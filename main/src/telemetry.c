@@ -0,0 +1,107 @@
+#include <telemetry.h>
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <mqtt_handler.h>
+#include <proj_conf.h>
+#include <stdatomic.h>
+
+/* Samples are collected into one batch while the other one is published by
+ * the telemetry task, so the radar processing task never waits for MQTT. */
+
+/* PRIVATE CONSTANTS */
+#define TAG "telemetry"
+
+#define TASK_SEND_TELEMETRY_STACK_SIZE 4096
+#define TELEMETRY_BATCH_SIZE           32
+
+_Static_assert(TELEMETRY_BATCH_SIZE <= TELEMETRY_MAX_SAMPLES, "Telemetry batch doesn't fit into one MQTT frame");
+
+/* PRIVATE TYPES */
+typedef struct {
+  TelemetrySample samples[TELEMETRY_BATCH_SIZE];
+  size_t count;
+} TelemetryBatch;
+
+/* GLOBAL VARIABLES */
+static TelemetryBatch g_batches[2] = {0};
+static size_t g_filled_batch = 0;
+static atomic_bool g_batch_in_flight = false;
+static atomic_bool g_telemetry_enabled = false;
+static atomic_uint_least32_t g_dropped_batches_count = 0;
+
+static TaskHandle_t g_send_telemetry_task = NULL;
+static uint8_t g_payload[MQTT_FRAME_PAYLOAD_MAX_SIZE];
+
+/* PRIVATE PROTOTYPES */
+static void send_telemetry(void* arg);
+static void hand_over_batch();
+
+/* FUNCTIONS */
+void init_telemetry() {
+  if (DEBUG_LOG_ENABLED) {
+    esp_log_level_set(TAG, ESP_LOG_DEBUG);
+  }
+  xTaskCreate(send_telemetry, "send_telemetry", TASK_SEND_TELEMETRY_STACK_SIZE, NULL, 0, &g_send_telemetry_task);
+}
+
+void start_telemetry() {
+  atomic_store(&g_telemetry_enabled, true);
+  ESP_LOGI(TAG, "Started telemetry");
+}
+
+void stop_telemetry() {
+  atomic_store(&g_telemetry_enabled, false);
+  ESP_LOGI(TAG, "Stopped telemetry");
+}
+
+void add_telemetry_sample(const TelemetrySample* sample) {
+  TelemetryBatch* batch = &g_batches[g_filled_batch];
+  if (!atomic_load_explicit(&g_telemetry_enabled, memory_order_relaxed)) {
+    batch->count = 0;
+    return;
+  }
+
+  batch->samples[batch->count++] = *sample;
+  const uint32_t batch_age_ms = sample->timestamp_ms - batch->samples[0].timestamp_ms;
+  if (batch->count == TELEMETRY_BATCH_SIZE || batch_age_ms >= TELEMETRY_FLUSH_INTERVAL_MS) {
+    hand_over_batch();
+  }
+}
+
+static void hand_over_batch() {
+  if (atomic_load_explicit(&g_batch_in_flight, memory_order_acquire)) {
+    // The previous batch is still being sent, so this one is lost
+    const uint32_t dropped_batches_count = atomic_load_explicit(&g_dropped_batches_count, memory_order_relaxed);
+    atomic_store_explicit(&g_dropped_batches_count, dropped_batches_count + 1, memory_order_relaxed);
+    g_batches[g_filled_batch].count = 0;
+    return;
+  }
+  g_filled_batch ^= 1;
+  g_batches[g_filled_batch].count = 0;
+  atomic_store_explicit(&g_batch_in_flight, true, memory_order_release);
+  xTaskNotifyGive(g_send_telemetry_task);
+}
+
+static void send_telemetry(void* arg) {
+  uint32_t reported_dropped_batches_count = 0;
+
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (!atomic_load_explicit(&g_batch_in_flight, memory_order_acquire)) {
+      continue;
+    }
+
+    const TelemetryBatch* batch = &g_batches[g_filled_batch ^ 1];
+    const size_t payload_size = mqtt_frame_encode_telemetry(g_payload, sizeof(g_payload), batch->samples, batch->count);
+    atomic_store_explicit(&g_batch_in_flight, false, memory_order_release);
+    send_mqtt_msg(MQTT_TX_MSG_TELEMETRY, (const char*)g_payload, payload_size);
+
+    const uint32_t dropped_batches_count = atomic_load_explicit(&g_dropped_batches_count, memory_order_relaxed);
+    if (dropped_batches_count != reported_dropped_batches_count) {
+      ESP_LOGW(TAG, "%u telemetry batches dropped", dropped_batches_count - reported_dropped_batches_count);
+      reported_dropped_batches_count = dropped_batches_count;
+    }
+  }
+}
@@ -0,0 +1,276 @@
+#include <trace_recorder.h>
+
+#if TRACE_RECORDER_ENABLED
+
+#include <esp_log.h>
+#include <esp_partition.h>
+#include <frame_bytes.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <mqtt_handler.h>
+#include <single_writer.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+/* PRIVATE CONSTANTS */
+#define TAG "trace_recorder"
+
+#define TASK_RECORD_TRACE_STACK_SIZE 4096
+#define TRACE_PARTITION_LABEL        "trace"
+#define TRACE_PARTITION_SUBTYPE      0x40  // First custom data subtype
+#define TRACE_BATCH_SIZE             32    // Records per flash write
+#define TRACE_FLUSH_INTERVAL_MS      1000  // Longest time a record waits for its batch
+#define TRACE_MAX_OFFSET_MS          UINT16_MAX
+
+/* PRIVATE TYPES */
+typedef struct {
+  uint32_t timestamp_ms;
+  TraceRecord record;
+} PendingRecord;
+
+typedef struct {
+  PendingRecord records[TRACE_BATCH_SIZE];
+  size_t count;
+} TraceBatch;
+
+/* GLOBAL VARIABLES */
+static const esp_partition_t* g_partition = NULL;
+static TaskHandle_t g_record_trace_task = NULL;
+
+// Hand-over from the processing task, like in telemetry.c
+static TraceBatch g_batches[2] = {0};
+static size_t g_filled_batch = 0;
+static atomic_bool g_batch_in_flight = false;
+static atomic_uint_least32_t g_dropped_batches_count = 0;
+static uint32_t g_recorded_ms = 0;
+static uint8_t g_recorded_state = TRACE_STATE_UNWRITTEN;  // Never recorded, so the first sample is
+
+// Download requests from the MQTT task
+static atomic_bool g_send_requested = false;
+static atomic_uint_least32_t g_send_offset = 0;
+static atomic_uint_least32_t g_send_length = 0;
+
+// Only used by the recorder task
+static uint32_t g_sectors_count = 0;
+static uint32_t g_sector = 0;
+static uint32_t g_sequence = 0;
+static uint32_t g_sector_base_ms = 0;
+static uint32_t g_sector_records = TRACE_RECORDS_PER_SECTOR;  // Full, so the first record opens a sector
+static bool g_booted = true;
+static uint8_t g_chunk[TRACE_CHUNK_HEADER_SIZE + TRACE_CHUNK_DATA_SIZE];
+
+/* PRIVATE PROTOTYPES */
+static void find_next_sector();
+static void hand_over_batch();
+static void record_trace(void* arg);
+static void write_batch(const TraceBatch* batch);
+static bool open_sector(uint32_t base_ms);
+static void send_requested_range();
+
+/* FUNCTIONS */
+void init_trace_recorder() {
+  if (DEBUG_LOG_ENABLED) {
+    esp_log_level_set(TAG, ESP_LOG_DEBUG);
+  }
+  g_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)TRACE_PARTITION_SUBTYPE,
+                                         TRACE_PARTITION_LABEL);
+  if (!g_partition || g_partition->size < 2 * TRACE_SECTOR_SIZE) {
+    ESP_LOGW(TAG, "No trace partition, recorder is off");
+    g_partition = NULL;
+    return;
+  }
+  g_sectors_count = g_partition->size / TRACE_SECTOR_SIZE;
+  find_next_sector();
+  xTaskCreate(record_trace, "record_trace", TASK_RECORD_TRACE_STACK_SIZE, NULL, 0, &g_record_trace_task);
+  ESP_LOGI(TAG, "Recording into %u sectors, continuing at sector %u", g_sectors_count, g_sector);
+}
+
+void add_trace_record(uint32_t timestamp_ms, const wifi_radar_info_t* info, int8_t rssi, uint8_t state) {
+  if (!g_partition) {
+    return;
+  }
+  state &= ~TRACE_STATE_UNWRITTEN;
+  if (TRACE_RECORD_INTERVAL_MS > 0 && state == g_recorded_state && timestamp_ms - g_recorded_ms < TRACE_RECORD_INTERVAL_MS) {
+    return;
+  }
+  g_recorded_ms = timestamp_ms;
+  g_recorded_state = state;
+  TraceBatch* batch = &g_batches[g_filled_batch];
+  batch->records[batch->count++] = (PendingRecord){
+      .timestamp_ms = timestamp_ms,
+      .record = {
+          .jitter = trace_encode_value(info->waveform_jitter),
+          .wander = trace_encode_value(info->waveform_wander),
+          .rssi = rssi,
+          .state = state,
+      },
+  };
+  if (batch->count == TRACE_BATCH_SIZE || timestamp_ms - batch->records[0].timestamp_ms >= TRACE_FLUSH_INTERVAL_MS) {
+    hand_over_batch();
+  }
+}
+
+void send_trace(uint32_t offset, uint32_t length) {
+  if (!g_partition) {
+    ESP_LOGW(TAG, "Can't send trace cause there's no trace partition");
+    return;
+  }
+  atomic_store_explicit(&g_send_offset, offset, memory_order_relaxed);
+  atomic_store_explicit(&g_send_length, length, memory_order_relaxed);
+  atomic_store_explicit(&g_send_requested, true, memory_order_release);
+  xTaskNotifyGive(g_record_trace_task);
+}
+
+/* The sector after the newest one is the oldest, or erased. Every boot starts
+ * a new sector, as timestamps start over. */
+static void find_next_sector() {
+  bool found = false;
+  for (uint32_t i = 0; i < g_sectors_count; i++) {
+    TraceSectorHeader header;
+    if (esp_partition_read(g_partition, i * TRACE_SECTOR_SIZE, &header, sizeof(header)) != ESP_OK ||
+        header.magic != TRACE_MAGIC) {
+      continue;
+    }
+    if (!found || (int32_t)(header.sequence - g_sequence) >= 0) {
+      g_sequence = header.sequence + 1;
+      g_sector = i;
+      found = true;
+    }
+  }
+  // Still pointing at the newest sector, the first record moves on from it
+  if (!found) {
+    g_sector = g_sectors_count - 1;
+  }
+}
+
+static void hand_over_batch() {
+  if (atomic_load_explicit(&g_batch_in_flight, memory_order_acquire)) {
+    // The recorder is still writing or sending, so this batch is lost
+    single_writer_add(&g_dropped_batches_count, 1);
+    g_batches[g_filled_batch].count = 0;
+    return;
+  }
+  g_filled_batch ^= 1;
+  g_batches[g_filled_batch].count = 0;
+  atomic_store_explicit(&g_batch_in_flight, true, memory_order_release);
+  xTaskNotifyGive(g_record_trace_task);
+}
+
+static void record_trace(void* arg) {
+  uint32_t reported_dropped_batches_count = 0;
+
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (atomic_load_explicit(&g_batch_in_flight, memory_order_acquire)) {
+      write_batch(&g_batches[g_filled_batch ^ 1]);
+      atomic_store_explicit(&g_batch_in_flight, false, memory_order_release);
+    }
+    if (atomic_load_explicit(&g_send_requested, memory_order_acquire)) {
+      atomic_store_explicit(&g_send_requested, false, memory_order_relaxed);
+      send_requested_range();
+    }
+
+    const uint32_t dropped_batches_count = atomic_load_explicit(&g_dropped_batches_count, memory_order_relaxed);
+    if (dropped_batches_count != reported_dropped_batches_count) {
+      ESP_LOGW(TAG, "%u trace batches dropped", dropped_batches_count - reported_dropped_batches_count);
+      reported_dropped_batches_count = dropped_batches_count;
+    }
+  }
+}
+
+/* Records that go to the same sector are written at once */
+static void write_batch(const TraceBatch* batch) {
+  TraceRecord records[TRACE_BATCH_SIZE];
+  size_t count = 0;
+  uint32_t first_index = g_sector_records;
+  for (size_t i = 0; i <= batch->count; i++) {
+    const PendingRecord* pending = &batch->records[i];
+    const bool sector_full = i < batch->count && (g_sector_records == TRACE_RECORDS_PER_SECTOR ||
+                                                  pending->timestamp_ms - g_sector_base_ms > TRACE_MAX_OFFSET_MS ||
+                                                  (int32_t)(pending->timestamp_ms - g_sector_base_ms) < 0);
+    if (count > 0 && (i == batch->count || sector_full)) {
+      const size_t offset = g_sector * TRACE_SECTOR_SIZE + TRACE_HEADER_SIZE + first_index * TRACE_RECORD_SIZE;
+      const esp_err_t res = esp_partition_write(g_partition, offset, records, count * TRACE_RECORD_SIZE);
+      if (res != ESP_OK) {
+        ESP_LOGW(TAG, "Couldn't write %u trace records (0x%x)", (unsigned)count, res);
+      }
+      count = 0;
+    }
+    if (i == batch->count) {
+      break;
+    }
+    if (sector_full) {
+      if (!open_sector(pending->timestamp_ms)) {
+        return;
+      }
+      first_index = 0;
+    }
+    records[count] = pending->record;
+    records[count].offset_ms = pending->timestamp_ms - g_sector_base_ms;
+    count++;
+    g_sector_records++;
+  }
+}
+
+static bool open_sector(uint32_t base_ms) {
+  g_sector = (g_sector + 1) % g_sectors_count;
+  g_sector_base_ms = base_ms;
+  g_sector_records = 0;
+  const TraceSectorHeader header = {
+      .magic = TRACE_MAGIC,
+      .sequence = g_sequence++,
+      .base_ms = base_ms,
+      .version = TRACE_VERSION,
+      .record_size = TRACE_RECORD_SIZE,
+      .flags = g_booted ? TRACE_FLAG_BOOT : 0,
+      .reserved = 0xFF,
+  };
+  esp_err_t res = esp_partition_erase_range(g_partition, g_sector * TRACE_SECTOR_SIZE, TRACE_SECTOR_SIZE);
+  if (res == ESP_OK) {
+    res = esp_partition_write(g_partition, g_sector * TRACE_SECTOR_SIZE, &header, sizeof(header));
+  }
+  if (res != ESP_OK) {
+    // Skipped for good, the next batch tries the next sector
+    ESP_LOGW(TAG, "Couldn't open trace sector %u (0x%x)", g_sector, res);
+    g_sector_records = TRACE_RECORDS_PER_SECTOR;
+    return false;
+  }
+  g_booted = false;
+  ESP_LOGD(TAG, "Opened trace sector %u, sequence %u", g_sector, header.sequence);
+  return true;
+}
+
+/* Batches are written between chunks, so recording goes on during a download */
+static void send_requested_range() {
+  const uint32_t size = g_partition->size;
+  uint32_t offset = atomic_load_explicit(&g_send_offset, memory_order_relaxed);
+  uint32_t length = atomic_load_explicit(&g_send_length, memory_order_relaxed);
+  if (offset >= size) {
+    ESP_LOGW(TAG, "Trace offset %u is outside of the partition", offset);
+    return;
+  }
+  if (length == 0 || length > size - offset) {
+    length = size - offset;
+  }
+  ESP_LOGI(TAG, "Sending %u trace bytes from %u", length, offset);
+
+  const uint32_t end = offset + length;
+  while (offset < end) {
+    const uint32_t chunk_size = end - offset < TRACE_CHUNK_DATA_SIZE ? end - offset : TRACE_CHUNK_DATA_SIZE;
+    const esp_err_t res = esp_partition_read(g_partition, offset, g_chunk + TRACE_CHUNK_HEADER_SIZE, chunk_size);
+    if (res != ESP_OK) {
+      ESP_LOGW(TAG, "Couldn't read trace at %u (0x%x)", offset, res);
+      return;
+    }
+    put_u32(put_u32(g_chunk, offset), size);
+    send_mqtt_msg(MQTT_TX_MSG_TRACE_CHUNK, (const char*)g_chunk, TRACE_CHUNK_HEADER_SIZE + chunk_size);
+    offset += chunk_size;
+
+    if (atomic_load_explicit(&g_batch_in_flight, memory_order_acquire)) {
+      write_batch(&g_batches[g_filled_batch ^ 1]);
+      atomic_store_explicit(&g_batch_in_flight, false, memory_order_release);
+    }
+  }
+}
+
+#endif
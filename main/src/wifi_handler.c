@@ -1,5 +1,6 @@
 #include <wifi_handler.h>
 
+#include <boot_timeline.h>
 #include <esp_event.h>
 #include <esp_log.h>
 #include <freertos/FreeRTOS.h>
@@ -8,6 +9,7 @@
 #include <lwip/inet.h>
 #include <lwip/ip_addr.h>
 #include <lwip/sys.h>
+#include <nvs.h>
 #include <proj_conf.h>
 #include <string.h>
 
@@ -16,15 +18,28 @@
 
 #define WIFI_CONNECTED_FLAG BIT0
 
+#define NVS_NAMESPACE  "wifi_handler"
+#define CACHED_AP_KEY  "ap"
+#define CACHED_AP_SIZE 7  // [BSSID, 6 bytes] [channel, u8]
+
 /* GLOBAL VARIABLES */
 static EventGroupHandle_t g_wifi_event_group = NULL;
 static esp_ip4_addr_t g_gateway_ip = {0};
+static nvs_handle_t g_nvs_handle = 0;
+// Only used by the event task once the station is started
+static uint8_t g_cached_ap[CACHED_AP_SIZE] = {0};
+static bool g_cached_ap_used = false;  // The station config has the BSSID and channel of g_cached_ap
+static uint8_t g_cached_ap_failures = 0;
 
 /* PRIVATE PROTOTYPES */
 static void handle_wifi_events(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
 static void set_gateway_ip(esp_ip4_addr_t* ip_address);
+static bool load_cached_ap();
+static void save_cached_ap(const uint8_t* bssid, uint8_t channel);
+static void forget_cached_ap();
 
 /* FUNCTIONS */
+/* Returns once the station is started, association goes on in the background */
 void init_wifi_station() {
   ESP_LOGI(TAG, "Initializing Wifi station");
 
@@ -54,20 +69,32 @@ void init_wifi_station() {
           .threshold.authmode = WIFI_AUTH_WPA2_PSK,
       },
   };
+  ESP_ERROR_CHECK(nvs_open(NVS_NAMESPACE, NVS_READWRITE, &g_nvs_handle));
+  if (WIFI_CACHED_AP_ENABLED && load_cached_ap()) {
+    // The driver then only probes the one channel instead of scanning all of them
+    wifi_conf.sta.bssid_set = true;
+    memcpy(wifi_conf.sta.bssid, g_cached_ap, sizeof(wifi_conf.sta.bssid));
+    wifi_conf.sta.channel = g_cached_ap[6];
+    g_cached_ap_used = true;
+    ESP_LOGI(TAG, "Connecting to cached Wifi AP " MACSTR " on channel %u", MAC2STR(g_cached_ap), g_cached_ap[6]);
+  }
   ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
   ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_conf));
   ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
   ESP_ERROR_CHECK(esp_wifi_set_promiscuous(true));
   ESP_ERROR_CHECK(esp_wifi_start());
+  mark_boot_stage(BOOT_STAGE_WIFI_STARTED);
+  ESP_LOGI(TAG, "Wifi station is initialized");
+}
 
+void wait_for_wifi_station() {
   EventBits_t event_bits = xEventGroupWaitBits(g_wifi_event_group, WIFI_CONNECTED_FLAG, pdFALSE, pdFALSE, portMAX_DELAY);
   if (event_bits & WIFI_CONNECTED_FLAG) {
     ESP_LOGI(TAG, "Connected to Wifi AP. SSID: %s. Password: %s", WIFI_AP_SSID, WIFI_AP_PASSWORD);
     xEventGroupClearBits(g_wifi_event_group, WIFI_CONNECTED_FLAG);
   } else {
-    ESP_LOGE("Failed to connect to Wifi AP. SSID: %s. Password: %s", WIFI_AP_SSID, WIFI_AP_PASSWORD);
+    ESP_LOGE(TAG, "Failed to connect to Wifi AP. SSID: %s. Password: %s", WIFI_AP_SSID, WIFI_AP_PASSWORD);
   }
-  ESP_LOGI(TAG, "Wifi station is initialized");
 }
 
 esp_ip4_addr_t get_gateway_ip() {
@@ -81,16 +108,32 @@ static void handle_wifi_events(void* arg, esp_event_base_t event_base, int32_t e
         ESP_ERROR_CHECK(esp_wifi_connect());
         break;
 
-      case WIFI_EVENT_STA_DISCONNECTED:
-        ESP_LOGW(TAG, "Wifi disconnected");
+      case WIFI_EVENT_STA_CONNECTED: {
+        const wifi_event_sta_connected_t* event = (wifi_event_sta_connected_t*)event_data;
+        mark_boot_stage(BOOT_STAGE_WIFI_CONNECTED);
+        g_cached_ap_failures = 0;
+        if (WIFI_CACHED_AP_ENABLED) {
+          save_cached_ap(event->bssid, event->channel);
+        }
+        break;
+      }
+
+      case WIFI_EVENT_STA_DISCONNECTED: {
+        const wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*)event_data;
+        ESP_LOGW(TAG, "Wifi disconnected, reason %u", event->reason);
+        if (g_cached_ap_used && ++g_cached_ap_failures >= WIFI_CACHED_AP_ATTEMPTS) {
+          forget_cached_ap();
+        }
         ESP_LOGI(TAG, "Reconnecting to Wifi AP. SSID: %s. Password: %s", WIFI_AP_SSID, WIFI_AP_PASSWORD);
         ESP_ERROR_CHECK(esp_wifi_connect());
         break;
+      }
     }
   } else if (event_base == IP_EVENT) {
     if (event_id == IP_EVENT_STA_GOT_IP) {
       ip_event_got_ip_t* event = (ip_event_got_ip_t*)event_data;
       ESP_LOGI(TAG, "Wifi station got IP: " IPSTR, IP2STR(&event->ip_info.ip));
+      mark_boot_stage(BOOT_STAGE_GOT_IP);
       set_gateway_ip(&event->ip_info.gw);
       xEventGroupSetBits(g_wifi_event_group, WIFI_CONNECTED_FLAG);
     }
@@ -101,3 +144,59 @@ static void set_gateway_ip(esp_ip4_addr_t* ip_address) {
   memcpy(&g_gateway_ip, ip_address, sizeof(esp_ip4_addr_t));
   ESP_LOGI(TAG, "Set Wifi AP IP:" IPSTR, IP2STR(&g_gateway_ip));
 }
+
+static bool load_cached_ap() {
+  size_t length = sizeof(g_cached_ap);
+  const esp_err_t res = nvs_get_blob(g_nvs_handle, CACHED_AP_KEY, g_cached_ap, &length);
+  if (res == ESP_ERR_NVS_NOT_FOUND) {
+    return false;
+  }
+  if (res != ESP_OK || length != CACHED_AP_SIZE || g_cached_ap[6] == 0) {
+    ESP_LOGW(TAG, "Ignoring cached Wifi AP, unknown record (0x%x, %u bytes)", res, (unsigned)length);
+    memset(g_cached_ap, 0, sizeof(g_cached_ap));
+    return false;
+  }
+  return true;
+}
+
+/* Only writes the flash when the AP or its channel changed. The cache only
+ * speeds up the next boot, so a failed write is no reason to stop. */
+static void save_cached_ap(const uint8_t* bssid, uint8_t channel) {
+  uint8_t ap[CACHED_AP_SIZE];
+  memcpy(ap, bssid, 6);
+  ap[6] = channel;
+  if (memcmp(ap, g_cached_ap, sizeof(ap)) == 0) {
+    return;
+  }
+  memcpy(g_cached_ap, ap, sizeof(ap));
+  esp_err_t res = nvs_set_blob(g_nvs_handle, CACHED_AP_KEY, g_cached_ap, sizeof(g_cached_ap));
+  if (res == ESP_OK) {
+    res = nvs_commit(g_nvs_handle);
+  }
+  if (res != ESP_OK) {
+    ESP_LOGW(TAG, "Couldn't cache Wifi AP " MACSTR " (0x%x)", MAC2STR(bssid), res);
+    return;
+  }
+  ESP_LOGI(TAG, "Cached Wifi AP " MACSTR " on channel %u", MAC2STR(bssid), channel);
+}
+
+/* The AP moved to another channel or is gone, so scan for the SSID like without a cache */
+static void forget_cached_ap() {
+  ESP_LOGW(TAG, "Cached Wifi AP " MACSTR " failed %u times, scanning for the SSID", MAC2STR(g_cached_ap),
+           g_cached_ap_failures);
+  wifi_config_t wifi_conf;
+  ESP_ERROR_CHECK(esp_wifi_get_config(WIFI_IF_STA, &wifi_conf));
+  wifi_conf.sta.bssid_set = false;
+  wifi_conf.sta.channel = 0;
+  ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_conf));
+  g_cached_ap_used = false;
+  memset(g_cached_ap, 0, sizeof(g_cached_ap));
+  // A record left behind fails again after the next boot and is forgotten then
+  esp_err_t res = nvs_erase_key(g_nvs_handle, CACHED_AP_KEY);
+  if (res == ESP_OK || res == ESP_ERR_NVS_NOT_FOUND) {
+    res = nvs_commit(g_nvs_handle);
+  }
+  if (res != ESP_OK) {
+    ESP_LOGW(TAG, "Couldn't forget cached Wifi AP (0x%x)", res);
+  }
+}
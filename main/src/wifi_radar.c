@@ -1,63 +1,104 @@
 #include <wifi_radar.h>
 
+#include <boot_timeline.h>
+#include <calibration.h>
+#include <csi_features.h>
+#include <csi_stream.h>
+#include <detector_core.h>
 #include <esp_log.h>
 #include <esp_radar.h>
+#include <esp_timer.h>
+#include <frame_bytes.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
-#include <freertos/timers.h>
+#include <freertos/queue.h>
+#include <motion_classifier.h>
 #include <mqtt_handler.h>
 #include <nvs.h>
 #include <ping_handler.h>
+#include <pipeline_metrics.h>
 #include <proj_conf.h>
+#include <radar_mailbox.h>
+#include <room_detector.h>
+#include <sample_rate.h>
+#include <sample_ring.h>
+#include <single_writer.h>
+#include <stdatomic.h>
 #include <string.h>
+#include <telemetry.h>
+#include <trace_recorder.h>
 
 /* PRIVATE CONSTANTS */
 #define TAG "wifi_radar"
 
 #define NVS_NAMESPACE "wifi_radar"
-#define THRESHOLD_KEY "threshold"
 
-#define RADAR_INFO_QUEUE_SIZE              100
 #define TASK_PROCESS_RADAR_DATA_STACK_SIZE 4096
 #define TASK_SEND_ROOM_STATUS_STACK_SIZE   4096
-#define TASK_SEND_ROOM_STATUS_INTERVAL_MS  100
 
-#define NEEDED_MEASUREMENTS_COUNT 10
-#define NEEDED_DETECTIONS_COUNT   2
-#define DETECTION_TIMEOUT_MS      3000
+#define RING_OVERFLOW_LOG_INTERVAL_MS 1000
 
-/* PRIVATE ENUMS */
-typedef enum {
-  ROOM_UNDEFINED = 0x00,
-  NO_MOVEMENT = 0x01,
-  MOVEMENT_DETECTED = 0x02,
-  ROOM_CALIBRATION_ACTIVE = 0x03,
-} RoomStatus;
+#define SAMPLE_RATE_REPORT_INTERVAL_MS 60000
+#define SAMPLE_RATE_REPORT_SIZE        12
 
 /* GLOBAL VARIABLES */
-static wifi_radar_info_t g_detection_threshold = {0};
-static bool g_calibration_in_progress = false;
-
-static bool g_radar_initialized = false;
-
-static xQueueHandle g_radar_info_queue = NULL;
-static TimerHandle_t g_detection_timeout_timer = NULL;
-
-static wifi_radar_info_t g_measurements[NEEDED_MEASUREMENTS_COUNT] = {0};
-static bool g_movement_detected = false;
-static uint32_t g_measurements_count = 0;
+// The radar state is owned by the processing task, other tasks post commands to g_mailbox and read g_room_status
+static RoomDetector g_detector = {0};
+static CalibrationRecord g_calibration = {0};
+static char g_calibration_profile[CALIBRATION_PROFILE_MAX_SIZE] = CALIBRATION_DEFAULT_PROFILE;
+
+static atomic_bool g_radar_initialized = false;
+static RadarMailbox g_mailbox = {0};
+static atomic_int g_room_status = ROOM_UNDEFINED;  // Snapshot of the owned state
+
+static SampleRing g_sample_ring = {0};
+static atomic_int g_last_rssi = 0;
+static atomic_uint_least32_t g_csi_frames_count = 0;
+static atomic_uint_least32_t g_csi_received_us = 0;  // Pipeline metrics time of the latest CSI packet
+static LinkTable g_csi_links = {0};  // Only used by the CSI callback
+static CsiFeatures g_csi_features[LINK_TABLE_CAPACITY] = {0};
+static bool g_csi_links_training[LINK_TABLE_CAPACITY] = {0};  // Only used by the CSI callback
+static atomic_bool g_csi_training = false;  // Calibration of the in-tree features, applied to the links by the CSI callback
+static TaskHandle_t g_process_radar_data_task = NULL;
+static TaskHandle_t g_send_room_status_task = NULL;
+static QueueHandle_t g_sample_rate_reports = NULL;  // Latest report for send_room_status, overwritten by newer ones
+
+static MotionModel g_motion_models[2] = {0};  // A new model goes into the one not in use
+static uint8_t g_motion_model_index = 0;
+static SampleRateController g_sample_rate = {0};
+static bool g_movement_detected = false;  // Decision of g_detector as published
+static bool g_stationary_presence = false;  // Breathing without movement, as published
+static atomic_uint_least32_t g_status_changed_us = 0;  // Pipeline metrics time of the latest status change
+static atomic_uint_least32_t g_movement_csi_us = 0;    // Pipeline metrics time of the CSI that showed movement
 
 static nvs_handle_t g_nvs_handle = 0;
 
 /* PRIVATE PROTOTYPES */
 static void configure_logging();
-static void detect_presence(const wifi_radar_info_t* radar_info);
+static bool detect_presence(const RadarSample* sample);
 static void send_room_status(void* arg);
+static RoomStatus get_room_status();
+static void update_room_status();
+static void post_command(RadarCommandType type, const void* data, size_t size);
+static void handle_commands();
+static void start_calibration();
+static void stop_calibration();
+static void select_profile(const char* name, size_t length);
+static void load_model(const uint8_t* bytes, size_t size);
+static void select_detector(const char* name, size_t length);
 static void wifi_radar_callback(const wifi_radar_info_t* info, void* ctx);
+static void wifi_csi_callback(const wifi_csi_filtered_info_t* info, void* ctx);
+static void push_radar_sample(const wifi_radar_info_t* info, const uint8_t* mac, uint32_t csi_received_us);
 static void process_radar_data();
-static void detection_timeout_callback(TimerHandle_t timer);
+static uint8_t get_trace_state(const RadarSample* sample);
+static void update_sample_rate();
+static void post_sample_rate();
+static void set_movement_detected(bool movement_detected, uint32_t csi_received_us);
+static void set_stationary_presence(bool stationary_presence);
 static void load_threshold();
-static void save_threshold();
+static void load_stored_model();
+static void load_stored_detector();
+static void apply_thresholds(const wifi_radar_info_t* threshold, const LinkThreshold* links, size_t links_count);
 
 /* FUNCTIONS */
 void init_wifi_radar() {
@@ -65,58 +106,192 @@ void init_wifi_radar() {
   ESP_LOGI(TAG, "Initializing Wifi radar");
 
   ESP_ERROR_CHECK(nvs_open(NVS_NAMESPACE, NVS_READWRITE, &g_nvs_handle));
+  RoomDetectorConfig config;
+  room_detector_get_default_config(&config);
+  room_detector_init(&g_detector, &config);
+  link_table_init(&g_csi_links);
   load_threshold();
+  load_stored_model();
+  load_stored_detector();
+  update_room_status();
 
-  g_radar_info_queue = xQueueCreate(RADAR_INFO_QUEUE_SIZE, sizeof(wifi_radar_info_t*));
-  g_detection_timeout_timer = xTimerCreate("detection_timer", pdMS_TO_TICKS(DETECTION_TIMEOUT_MS), pdFALSE, 0, detection_timeout_callback);
-  xTaskCreate(process_radar_data, "process_radar_data", TASK_PROCESS_RADAR_DATA_STACK_SIZE, NULL, 0, NULL);
-  xTaskCreate(send_room_status, "send_room_status", TASK_SEND_ROOM_STATUS_STACK_SIZE, NULL, 0, NULL);
-
-  init_gateway_ping();
+  g_sample_rate_reports = xQueueCreate(1, SAMPLE_RATE_REPORT_SIZE);
+  xTaskCreate(process_radar_data, "process_radar_data", TASK_PROCESS_RADAR_DATA_STACK_SIZE, NULL, 0, &g_process_radar_data_task);
+  xTaskCreate(send_room_status, "send_room_status", TASK_SEND_ROOM_STATUS_STACK_SIZE, NULL, 0, &g_send_room_status_task);
 
   wifi_radar_config_t conf = {
       .filter_mac = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff},  // No filtering based on MAC address
       .wifi_radar_cb = wifi_radar_callback,
+      .wifi_csi_filtered_cb = wifi_csi_callback,
   };
   ESP_ERROR_CHECK(esp_radar_init());
   ESP_ERROR_CHECK(esp_radar_set_config(&conf));
   ESP_ERROR_CHECK(esp_radar_start());
+  mark_boot_stage(BOOT_STAGE_RADAR_STARTED);
 
   ESP_LOGI(TAG, "Started Wifi radar");
-  g_radar_initialized = true;
+  atomic_store_explicit(&g_radar_initialized, true, memory_order_release);
 }
 
 void start_wifi_radar_calibration() {
-  if (!g_radar_initialized) {
-    ESP_LOGW(TAG, "Can't start calibration cause radar is not init");
+  post_command(RADAR_COMMAND_START_CALIBRATION, NULL, 0);
+}
+
+void stop_wifi_radar_calibration() {
+  post_command(RADAR_COMMAND_STOP_CALIBRATION, NULL, 0);
+}
+
+void select_wifi_radar_profile(const char* name, size_t length) {
+  if (!is_calibration_profile_name_valid(name, length)) {
+    ESP_LOGW(TAG, "Invalid calibration profile name: %.*s", (int)length, name);
+    return;
+  }
+  post_command(RADAR_COMMAND_SELECT_PROFILE, name, length);
+}
+
+void load_wifi_radar_model(const uint8_t* bytes, size_t size) {
+  if (size > MOTION_MODEL_MAX_SIZE) {
+    ESP_LOGW(TAG, "Invalid motion model, %u bytes", (unsigned)size);
+    return;
+  }
+  post_command(RADAR_COMMAND_LOAD_MODEL, bytes, size);
+}
+
+void select_wifi_radar_detector(const char* name, size_t length) {
+  if (length >= DETECTOR_VARIANT_NAME_MAX_SIZE) {
+    ESP_LOGW(TAG, "Invalid detector variant name: %.*s", (int)length, name);
+    return;
+  }
+  post_command(RADAR_COMMAND_SELECT_DETECTOR, name, length);
+}
+
+/* Commands are applied by the processing task, so only it changes the radar state */
+static void post_command(RadarCommandType type, const void* data, size_t size) {
+  if (!atomic_load_explicit(&g_radar_initialized, memory_order_acquire)) {
+    ESP_LOGW(TAG, "Can't handle radar command %d cause radar is not init", type);
+    return;
+  }
+  if (!radar_mailbox_push(&g_mailbox, type, data, size)) {
+    ESP_LOGW(TAG, "Radar command %d dropped, the mailbox is full (%u dropped in total)", type,
+             radar_mailbox_dropped_count(&g_mailbox));
+    return;
+  }
+  xTaskNotifyGive(g_process_radar_data_task);
+}
+
+static void handle_commands() {
+  RadarCommand command;
+  while (radar_mailbox_pop(&g_mailbox, &command)) {
+    switch (command.type) {
+      case RADAR_COMMAND_START_CALIBRATION:
+        start_calibration();
+        break;
+      case RADAR_COMMAND_STOP_CALIBRATION:
+        stop_calibration();
+        break;
+      case RADAR_COMMAND_SELECT_PROFILE:
+        select_profile((const char*)command.data, command.size);
+        break;
+      case RADAR_COMMAND_LOAD_MODEL:
+        load_model(command.data, command.size);
+        break;
+      case RADAR_COMMAND_SELECT_DETECTOR:
+        select_detector((const char*)command.data, command.size);
+        break;
+    }
   }
+}
 
-  if (g_calibration_in_progress) {
+static void start_calibration() {
+  if (g_detector.calibrating) {
     ESP_LOGW(TAG, "Previous Wifi radar calibration ongoing");
     return;
   }
 
-  g_calibration_in_progress = true;
+  calibration_record_begin(&g_calibration);
+  room_detector_begin_calibration(&g_detector);
+  update_room_status();
   esp_radar_train_remove();  // Remove previous calibration
   esp_radar_train_start();
+  atomic_store_explicit(&g_csi_training, true, memory_order_relaxed);
   ESP_LOGI(TAG, "Started Wifi radar calibration");
 }
 
-void stop_wifi_radar_calibration() {
-  if (!g_calibration_in_progress) {
+static void stop_calibration() {
+  if (!g_detector.calibrating) {
     ESP_LOGW(TAG, "Can't stop Wifi radar calibration cause it hasn't started");
     return;
   }
 
-  esp_radar_train_stop(&g_detection_threshold.waveform_jitter,
-                       &g_detection_threshold.waveform_wander);
+  // Every transmitter has its own threshold, the room threshold is the largest one
+  wifi_radar_info_t threshold;
+  LinkThreshold links[LINK_TABLE_CAPACITY];
+  size_t links_count = room_detector_finish_calibration(&g_detector, &threshold, links);
+  atomic_store_explicit(&g_csi_training, false, memory_order_relaxed);
+  if (RADAR_IN_TREE_FEATURES) {
+    esp_radar_train_stop(&(float){0}, &(float){0});
+  } else {
+    // esp-csi mixes the transmitters, so its training is the room threshold
+    esp_radar_train_stop(&threshold.waveform_wander, &threshold.waveform_jitter);
+    threshold.waveform_jitter *= g_detector.config.threshold_margin;
+    threshold.waveform_wander *= g_detector.config.threshold_margin;
+    links_count = 0;
+  }
 
-  g_detection_threshold.waveform_jitter *= 1.1;
-  g_detection_threshold.waveform_wander *= 1.1;
+  calibration_record_finish(&g_calibration, &threshold);
+  save_calibration(g_nvs_handle, g_calibration_profile, &g_calibration);
+  save_link_thresholds(g_nvs_handle, g_calibration_profile, links, links_count);
+  apply_thresholds(&threshold, links, links_count);
+  update_room_status();
+  ESP_LOGI(TAG, "Stopped Wifi radar calibration of profile %s: jitter %f (mean %f, variance %f), wander %f (mean %f, variance %f), %u samples",
+           g_calibration_profile, g_calibration.threshold.waveform_jitter, g_calibration.mean.waveform_jitter,
+           g_calibration.variance.waveform_jitter, g_calibration.threshold.waveform_wander, g_calibration.mean.waveform_wander,
+           g_calibration.variance.waveform_wander, g_calibration.samples_count);
+}
+
+static void select_profile(const char* name, size_t length) {
+  if (g_detector.calibrating) {
+    ESP_LOGW(TAG, "Can't change calibration profile during calibration");
+    return;
+  }
 
-  save_threshold();
-  g_calibration_in_progress = false;
-  ESP_LOGI(TAG, "Stopped Wifi radar calibration");
+  memcpy(g_calibration_profile, name, length);
+  g_calibration_profile[length] = '\0';
+  save_calibration_profile(g_nvs_handle, g_calibration_profile);
+  load_threshold();
+  update_room_status();
+}
+
+static void load_model(const uint8_t* bytes, size_t size) {
+  if (size == 0) {
+    erase_motion_model(g_nvs_handle);
+    link_detectors_set_model(&g_detector.links, get_default_motion_model());
+    ESP_LOGI(TAG, "Detecting with the default motion model");
+    return;
+  }
+  MotionModel* model = &g_motion_models[g_motion_model_index ^ 1];
+  if (!motion_model_decode(bytes, size, model)) {
+    ESP_LOGW(TAG, "Invalid motion model, %u bytes", (unsigned)size);
+    return;
+  }
+  save_motion_model(g_nvs_handle, model);
+  g_motion_model_index ^= 1;
+  link_detectors_set_model(&g_detector.links, model);
+  ESP_LOGI(TAG, "Detecting with the loaded motion model, type %d", model->type);
+}
+
+static void select_detector(const char* name, size_t length) {
+  const DetectorVariant* variant = NULL;
+  if (length > 0) {
+    variant = find_detector_variant(name, length);
+    if (!variant) {
+      ESP_LOGW(TAG, "Unknown detector variant: %.*s", (int)length, name);
+      return;
+    }
+  }
+  save_detector_variant(g_nvs_handle, variant);
+  room_detector_set_variant(&g_detector, variant);
+  ESP_LOGI(TAG, "Detecting with the %s detector", variant ? variant->name : "configured");
 }
 
 static void configure_logging() {
@@ -128,101 +303,288 @@ static void configure_logging() {
 }
 
 static void wifi_radar_callback(const wifi_radar_info_t* info, void* ctx) {
-  wifi_radar_info_t* radar_info = malloc(sizeof(wifi_radar_info_t));
-  memcpy(radar_info, info, sizeof(wifi_radar_info_t));
+  static const uint8_t broadcast_mac[LINK_MAC_SIZE] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+  set_csi_stream_radar_info(info);
+  if (!RADAR_IN_TREE_FEATURES) {
+    push_radar_sample(info, broadcast_mac, atomic_load_explicit(&g_csi_received_us, memory_order_relaxed));
+  }
+}
+
+static void wifi_csi_callback(const wifi_csi_filtered_info_t* info, void* ctx) {
+  const uint32_t received_us = get_pipeline_time_us();
+  atomic_store_explicit(&g_csi_received_us, received_us, memory_order_relaxed);
+  atomic_store_explicit(&g_last_rssi, info->rx_ctrl.rssi, memory_order_relaxed);
+  single_writer_add(&g_csi_frames_count, 1);
+  add_csi_stream_frame(info);
 
-  if (xQueueSend(g_radar_info_queue, &radar_info, 0) == pdFALSE) {
-    ESP_LOGW(TAG, "Radar info queue is full");
-    free(radar_info);
+  // The length is signed, and only a positive one converts to the unsigned one of the features
+  if (!RADAR_IN_TREE_FEATURES || info->valid_len <= 0) {
+    return;
+  }
+  bool inserted;
+  const uint32_t now_ms = esp_timer_get_time() / 1000;
+  const int link = link_table_get(&g_csi_links, info->mac, now_ms, &inserted);
+  if (inserted) {
+    csi_features_init(&g_csi_features[link], CSI_WINDOW_FRAMES);
+    g_csi_links_training[link] = false;
+  }
+  // A link that joins after the calibration has no references, like esp-csi before its first training
+  const bool training = atomic_load_explicit(&g_csi_training, memory_order_relaxed);
+  if (training != g_csi_links_training[link]) {
+    if (training) {
+      csi_features_train_start(&g_csi_features[link]);
+    } else {
+      csi_features_train_stop(&g_csi_features[link]);
+    }
+    g_csi_links_training[link] = training;
+  }
+  wifi_radar_info_t features;
+  if (csi_features_push(&g_csi_features[link], info->valid_data, (uint16_t)info->valid_len, now_ms, &features)) {
+    push_radar_sample(&features, info->mac, received_us);
+  }
+}
+
+/* Both callbacks may produce samples, but only one of them does so in a build */
+static void push_radar_sample(const wifi_radar_info_t* info, const uint8_t* mac, uint32_t csi_received_us) {
+  RadarSample sample = {
+      .info = *info,
+      .timestamp_ms = esp_timer_get_time() / 1000,
+      .rssi = atomic_load_explicit(&g_last_rssi, memory_order_relaxed),
+      .csi_received_us = csi_received_us,
+  };
+  memcpy(sample.mac, mac, LINK_MAC_SIZE);
+  add_pipeline_latency(METRICS_CSI_TO_SAMPLE, csi_received_us);
+  sample.queued_us = get_pipeline_time_us();
+  // Drops are counted by the ring and reported by the processing task
+  if (sample_ring_push(&g_sample_ring, &sample)) {
+    xTaskNotifyGive(g_process_radar_data_task);
   }
 }
 
 static void process_radar_data() {
-  wifi_radar_info_t* radar_info;
-  while (xQueueReceive(g_radar_info_queue, &radar_info, portMAX_DELAY)) {
-    detect_presence(radar_info);
+  RadarSample sample;
+  uint32_t reported_overflow_count = 0;
+  TickType_t overflow_reported_at = 0;
+  sample_rate_init(&g_sample_rate, GATEWAY_PING_INTERVAL_MS, GATEWAY_PING_MAX_INTERVAL_MS, GATEWAY_PING_STABLE_MS,
+                   esp_timer_get_time() / 1000);
 
-    free(radar_info);
+  while (true) {
+    // Also wakes up without samples, so a silent AP slows the pings down too
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SAMPLE_RATE_PERIOD_MS));
+    handle_commands();
+    while (sample_ring_pop(&g_sample_ring, &sample)) {
+      add_pipeline_latency(METRICS_QUEUE, sample.queued_us);
+      const uint32_t detection_started_us = get_pipeline_time_us();
+      const bool motion_detected = detect_presence(&sample);
+      add_pipeline_latency(METRICS_DETECT, detection_started_us);
+      mark_boot_stage(BOOT_STAGE_FIRST_SAMPLE);
+      sample_rate_add_sample(&g_sample_rate, motion_detected);
+      if (TRACE_RECORDER_ENABLED) {
+        add_trace_record(sample.timestamp_ms, &sample.info, sample.rssi, get_trace_state(&sample));
+      }
+      add_telemetry_sample(&(TelemetrySample){
+          .timestamp_ms = sample.timestamp_ms,
+          .waveform_jitter = sample.info.waveform_jitter,
+          .waveform_wander = sample.info.waveform_wander,
+          .rssi = sample.rssi,
+          .room_status = get_room_status(),
+      });
+      // Commands take effect between samples, also while the ring is busy
+      handle_commands();
+    }
+    // A room that went quiet along with the AP still turns empty
+    set_movement_detected(room_detector_update(&g_detector, esp_timer_get_time() / 1000),
+                          atomic_load_explicit(&g_csi_received_us, memory_order_relaxed));
+
+    const uint32_t overflow_count = sample_ring_overflow_count(&g_sample_ring);
+    set_pipeline_counter(METRICS_RING_DROPS, overflow_count);
+    set_pipeline_counter(METRICS_RING_HIGH_WATER, sample_ring_high_water(&g_sample_ring));
+    const TickType_t now = xTaskGetTickCount();
+    if (overflow_count != reported_overflow_count && now - overflow_reported_at >= pdMS_TO_TICKS(RING_OVERFLOW_LOG_INTERVAL_MS)) {
+      ESP_LOGW(TAG, "Radar sample ring overflowed, %u samples dropped (%u in total)",
+               overflow_count - reported_overflow_count, overflow_count);
+      reported_overflow_count = overflow_count;
+      overflow_reported_at = now;
+    }
+    update_sample_rate();
   }
 }
 
-static void detect_presence(const wifi_radar_info_t* info) {
-  if (g_calibration_in_progress) {
-    return;
+static uint8_t get_trace_state(const RadarSample* sample) {
+  const RoomStatus room_status = get_room_status();
+  uint8_t state = (room_status == STATIONARY_PRESENCE ? MOVEMENT_DETECTED : room_status) & TRACE_STATE_ROOM_STATUS_MASK;
+  const int slot = link_table_find(&g_detector.links.table, sample->mac);
+  if (slot >= 0) {
+    const LinkDetector* link = &g_detector.links.links[slot];
+    state |= (slot << TRACE_STATE_LINK_SHIFT) & TRACE_STATE_LINK_MASK;
+    state |= link->motion_detected ? TRACE_STATE_MOTION : 0;
+    state |= link->detecting ? TRACE_STATE_DETECTING : 0;
   }
+  return state;
+}
 
-  if (g_detection_threshold.waveform_jitter == 0) {
+static void update_sample_rate() {
+  static uint32_t counted_csi_frames = 0;
+  static uint32_t reported_at_ms = 0;
+  static uint32_t reported_interval_ms = GATEWAY_PING_INTERVAL_MS;
+
+  const uint32_t csi_frames_count = atomic_load_explicit(&g_csi_frames_count, memory_order_relaxed);
+  sample_rate_add_csi_frames(&g_sample_rate, csi_frames_count - counted_csi_frames);
+  counted_csi_frames = csi_frames_count;
+
+  const uint32_t now_ms = esp_timer_get_time() / 1000;
+  // Until the pings start the CSI rate says nothing about the interval, so the first period starts with them
+  if (!is_gateway_ping_started()) {
+    sample_rate_init(&g_sample_rate, GATEWAY_PING_INTERVAL_MS, GATEWAY_PING_MAX_INTERVAL_MS, GATEWAY_PING_STABLE_MS,
+                     now_ms);
     return;
   }
-
-  g_measurements[g_measurements_count++ % NEEDED_MEASUREMENTS_COUNT] = *info;
-  if (g_measurements_count < NEEDED_MEASUREMENTS_COUNT) {
+  const bool room_stable = !g_detector.calibrating && !g_movement_detected;
+  if (!sample_rate_update(&g_sample_rate, now_ms, room_stable)) {
     return;
   }
+  ESP_LOGD(TAG, "Ping interval %u ms; CSI %.1f/s; samples %.1f/s", g_sample_rate.interval_ms, g_sample_rate.csi_rate_hz,
+           g_sample_rate.sample_rate_hz);
+  set_gateway_ping_interval(g_sample_rate.interval_ms);
+  if (g_sample_rate.interval_ms != reported_interval_ms || now_ms - reported_at_ms >= SAMPLE_RATE_REPORT_INTERVAL_MS) {
+    post_sample_rate();
+    reported_interval_ms = g_sample_rate.interval_ms;
+    reported_at_ms = now_ms;
+  }
+}
 
-  uint8_t motion_detection_count = 0;
-  for (int i = 0; i < NEEDED_MEASUREMENTS_COUNT; i++) {
-    if (g_measurements[i].waveform_jitter > g_detection_threshold.waveform_jitter) {
-      motion_detection_count++;
-    }
+/* Publishing may wait for the MQTT client, so the report goes to the status sender */
+static void post_sample_rate() {
+  uint8_t payload[SAMPLE_RATE_REPORT_SIZE];
+  uint8_t* cursor = put_u32(payload, g_sample_rate.interval_ms);
+  cursor = put_f32(cursor, g_sample_rate.csi_rate_hz);
+  put_f32(cursor, g_sample_rate.sample_rate_hz);
+  xQueueOverwrite(g_sample_rate_reports, payload);
+  if (g_send_room_status_task) {
+    xTaskNotifyGive(g_send_room_status_task);
   }
+}
 
-  if (motion_detection_count < NEEDED_DETECTIONS_COUNT) {
-    // Currently no movement detected
-    if (g_movement_detected) {
-      // Movement was previously detected
-      if (!xTimerIsTimerActive(g_detection_timeout_timer)) {
-        /* If movement is still not detected after specified time,
-        then set detection value to false */
-        xTimerStart(g_detection_timeout_timer, 0);
-      }
-    }
-  } else {
-    xTimerStop(g_detection_timeout_timer, 0);
-    g_movement_detected = true;
+/* Returns whether the sample was over the threshold of its link */
+static bool detect_presence(const RadarSample* sample) {
+  if (g_detector.calibrating) {
+    calibration_record_add(&g_calibration, &sample->info);
+  }
+  const bool motion_detected = room_detector_push(&g_detector, &sample->info, sample->mac, sample->timestamp_ms);
+  set_movement_detected(g_detector.presence.present, sample->csi_received_us);
+  set_stationary_presence(room_detector_is_stationary(&g_detector));
+  return motion_detected;
+}
+
+static void set_movement_detected(bool movement_detected, uint32_t csi_received_us) {
+  if (movement_detected == g_movement_detected) {
+    return;
+  }
+  if (movement_detected) {
+    atomic_store_explicit(&g_movement_csi_us, csi_received_us, memory_order_relaxed);
   }
+  g_movement_detected = movement_detected;
+  update_room_status();
 }
 
+static void set_stationary_presence(bool stationary_presence) {
+  if (stationary_presence == g_stationary_presence) {
+    return;
+  }
+  g_stationary_presence = stationary_presence;
+  update_room_status();
+}
+
+/* Publishes the status as soon as it changes and otherwise repeats it every
+ * ROOM_STATUS_HEARTBEAT_INTERVAL_MS so that subscribers know the device is alive.
+ * Also publishes the sample rate reports of the processing task, which must
+ * not wait for the MQTT client itself. */
 static void send_room_status(void* arg) {
-  char room_status = 0;
+  const TickType_t heartbeat_interval = pdMS_TO_TICKS(ROOM_STATUS_HEARTBEAT_INTERVAL_MS);
+  char sent_room_status = 0;
+  TickType_t sent_at = 0;
+  bool sent_once = false;
 
   while (true) {
-    if (g_calibration_in_progress) {
-      room_status = ROOM_CALIBRATION_ACTIVE;
-    } else {
-      if (g_detection_threshold.waveform_jitter == 0) {
-        room_status = ROOM_UNDEFINED;
-      } else {
-        room_status = g_movement_detected ? MOVEMENT_DETECTED : NO_MOVEMENT;
+    const char room_status = atomic_load_explicit(&g_room_status, memory_order_acquire);
+    const TickType_t now = xTaskGetTickCount();
+    if (!sent_once || room_status != sent_room_status || now - sent_at >= heartbeat_interval) {
+      send_mqtt_msg(MQTT_TX_MSG_ROOM_STATUS, &room_status, 1);
+      if (sent_once && room_status != sent_room_status) {
+        add_pipeline_latency(METRICS_PUBLISH, atomic_load_explicit(&g_status_changed_us, memory_order_relaxed));
+        if (room_status == MOVEMENT_DETECTED) {
+          add_pipeline_latency(METRICS_END_TO_END, atomic_load_explicit(&g_movement_csi_us, memory_order_relaxed));
+        }
       }
+      sent_room_status = room_status;
+      sent_at = now;
+      sent_once = true;
+    }
+    uint8_t sample_rate_report[SAMPLE_RATE_REPORT_SIZE];
+    if (xQueueReceive(g_sample_rate_reports, sample_rate_report, 0) == pdPASS) {
+      send_mqtt_msg(MQTT_TX_MSG_SAMPLE_RATE, (const char*)sample_rate_report, sizeof(sample_rate_report));
     }
-    send_mqtt_msg(MQTT_TX_MSG_ROOM_STATUS, &room_status, 1);
-    vTaskDelay(pdMS_TO_TICKS(TASK_SEND_ROOM_STATUS_INTERVAL_MS));
+    const TickType_t elapsed = xTaskGetTickCount() - sent_at;
+    ulTaskNotifyTake(pdTRUE, elapsed < heartbeat_interval ? heartbeat_interval - elapsed : 0);
   }
 }
 
-static void detection_timeout_callback(TimerHandle_t timer) {
-  g_movement_detected = false;
+/* Only for the processing task, the others read g_room_status */
+static RoomStatus get_room_status() {
+  if (g_detector.calibrating) {
+    return ROOM_CALIBRATION_ACTIVE;
+  }
+  if (g_detector.threshold.waveform_jitter == 0) {
+    return ROOM_UNDEFINED;
+  }
+  if (g_movement_detected) {
+    return MOVEMENT_DETECTED;
+  }
+  return g_stationary_presence ? STATIONARY_PRESENCE : NO_MOVEMENT;
 }
 
-static void load_threshold() {
-  size_t bytes_count;
-  uint8_t bytes[sizeof(g_detection_threshold.waveform_jitter)];
+/* Publishes the owned state for the other tasks and wakes up the status sender */
+static void update_room_status() {
+  atomic_store_explicit(&g_status_changed_us, get_pipeline_time_us(), memory_order_relaxed);
+  atomic_store_explicit(&g_room_status, get_room_status(), memory_order_release);
+  if (g_send_room_status_task) {
+    xTaskNotifyGive(g_send_room_status_task);
+  }
+}
 
-  esp_err_t res = nvs_get_blob(g_nvs_handle, THRESHOLD_KEY, bytes, &bytes_count);
-  if (res == ESP_ERR_NVS_NOT_FOUND) {
-    ESP_LOGW(TAG, "Threshold data not found in NVS");
+static void load_threshold() {
+  load_calibration_profile(g_nvs_handle, g_calibration_profile);
+  CalibrationRecord record;
+  if (!load_calibration(g_nvs_handle, g_calibration_profile, &record)) {
+    ESP_LOGW(TAG, "Calibration profile %s not found in NVS", g_calibration_profile);
+    apply_thresholds(&(wifi_radar_info_t){0}, NULL, 0);
     return;
-  } else if (res != ESP_OK) {
-    abort();
   }
+  LinkThreshold links[LINK_TABLE_CAPACITY];
+  const size_t links_count = load_link_thresholds(g_nvs_handle, g_calibration_profile, links, LINK_TABLE_CAPACITY);
+  apply_thresholds(&record.threshold, links, links_count);
+  ESP_LOGI(TAG, "Loaded calibration profile %s: jitter threshold %f, wander threshold %f, %u links",
+           g_calibration_profile, g_detector.threshold.waveform_jitter, g_detector.threshold.waveform_wander, (unsigned)links_count);
+}
+
+static void load_stored_model() {
+  MotionModel* model = &g_motion_models[g_motion_model_index];
+  if (load_motion_model(g_nvs_handle, model)) {
+    link_detectors_set_model(&g_detector.links, model);
+    ESP_LOGI(TAG, "Loaded motion model, type %d", model->type);
+  }
+}
 
-  memcpy(&g_detection_threshold.waveform_jitter, bytes, sizeof(g_detection_threshold.waveform_jitter));
+static void load_stored_detector() {
+  const DetectorVariant* variant = load_detector_variant(g_nvs_handle);
+  if (variant) {
+    room_detector_set_variant(&g_detector, variant);
+    ESP_LOGI(TAG, "Loaded detector variant %s", variant->name);
+  }
 }
 
-static void save_threshold() {
-  size_t bytes_count = sizeof(g_detection_threshold.waveform_jitter);
-  uint8_t bytes[bytes_count];
-  memcpy(bytes, &g_detection_threshold.waveform_jitter, bytes_count);
-  ESP_ERROR_CHECK(nvs_set_blob(g_nvs_handle, THRESHOLD_KEY, bytes, bytes_count));
+/* Links start over with the new thresholds, also their adaptation, so adapted
+ * thresholds never pile up in NVS */
+static void apply_thresholds(const wifi_radar_info_t* threshold, const LinkThreshold* links, size_t links_count) {
+  room_detector_set_thresholds(&g_detector, threshold, links, links_count, esp_timer_get_time() / 1000);
 }
\ No newline at end of file